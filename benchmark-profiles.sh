@@ -0,0 +1,93 @@
+#!/bin/bash
+
+# Comparativa de perfiles de dispositivos (legacy / virtio / q35-virtio)
+#
+# Uso: ./benchmark-profiles.sh <vm> [ruta de kvmctl]
+#
+# Arranca la VM una vez con cada perfil y mide el tiempo hasta que aparece
+# "login:" en la consola serie (~/.VM/<vm>/serial.log). El invitado debe
+# tener la consola en ttyS0 (console=ttyS0 en la línea del kernel).
+#
+# Si BENCH_TIMEOUT > 0 se esperan además resultados del propio invitado:
+# líneas "KVMBENCH <métrica> <valor>" escritas en /dev/ttyS0 (por ejemplo
+# desde un servicio que ejecute fio e iperf3 al arrancar) terminadas con
+# "KVMBENCH done".
+
+VM="$1"
+KVMCTL="${2:-./build/kvmctl}"
+BOOT_TIMEOUT="${BOOT_TIMEOUT:-300}"
+BENCH_TIMEOUT="${BENCH_TIMEOUT:-0}"
+PROFILES="legacy virtio q35-virtio"
+
+if [ -z "$VM" ]; then
+    echo "Uso: $0 <vm> [ruta de kvmctl]"
+    exit 1
+fi
+
+SERIAL="$HOME/.VM/$VM/serial.log"
+ORIGINAL=$("$KVMCTL" info "$VM" | grep -o '"deviceProfile":"[^"]*"' | cut -d'"' -f4)
+if [ -z "$ORIGINAL" ]; then
+    echo "No se pudo leer la configuración de la VM '$VM'"
+    exit 1
+fi
+
+# Espera a que aparezca un patrón en la consola serie; devuelve 1 si vence el plazo
+wait_for_serial() {
+    local pattern="$1" timeout="$2" waited=0
+    while ! grep -q "$pattern" "$SERIAL" 2>/dev/null; do
+        sleep 0.1
+        waited=$((waited + 1))
+        if [ "$waited" -ge $((timeout * 10)) ]; then
+            return 1
+        fi
+    done
+    return 0
+}
+
+restore_profile() {
+    "$KVMCTL" stop "$VM" > /dev/null 2>&1
+    "$KVMCTL" set "$VM" profile "$ORIGINAL" > /dev/null
+}
+trap restore_profile EXIT
+
+RESULTS=""
+for profile in $PROFILES; do
+    echo "=== Perfil: $profile ==="
+    "$KVMCTL" stop "$VM" > /dev/null 2>&1
+    "$KVMCTL" set "$VM" profile "$profile" > /dev/null || exit 1
+    rm -f "$SERIAL"
+
+    start=$(date +%s%N)
+    if ! "$KVMCTL" start "$VM" > /dev/null; then
+        echo "No se pudo iniciar la VM con el perfil $profile"
+        continue
+    fi
+
+    if wait_for_serial "login:" "$BOOT_TIMEOUT"; then
+        boot_ms=$(( ($(date +%s%N) - start) / 1000000 ))
+    else
+        boot_ms="timeout"
+    fi
+    echo "Arranque: $boot_ms ms"
+    RESULTS+="$profile boot_ms $boot_ms"$'\n'
+
+    if [ "$BENCH_TIMEOUT" -gt 0 ]; then
+        if wait_for_serial "KVMBENCH done" "$BENCH_TIMEOUT"; then
+            while read -r _ metric value; do
+                echo "$metric: $value"
+                RESULTS+="$profile $metric $value"$'\n'
+            done < <(grep -a "^KVMBENCH " "$SERIAL" | grep -v "KVMBENCH done" | tr -d '\r')
+        else
+            echo "El invitado no publicó resultados en $BENCH_TIMEOUT s"
+        fi
+    fi
+
+    "$KVMCTL" stop "$VM" > /dev/null
+    echo ""
+done
+
+echo "=== Resumen ==="
+printf "%-12s %-20s %s\n" "PERFIL" "MÉTRICA" "VALOR"
+printf "%s" "$RESULTS" | while read -r profile metric value; do
+    printf "%-12s %-20s %s\n" "$profile" "$metric" "$value"
+done
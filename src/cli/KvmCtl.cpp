@@ -0,0 +1,795 @@
+#include "KvmCtl.h"
+#include "../core/KVMManager.h"
+#include "../core/VirtualMachine.h"
+#include "../core/QemuManager.h"
+#include "../core/ControlServer.h"
+#include "../core/MemoryPressureController.h"
+#include "../core/AdmissionController.h"
+#include "../core/BootScheduler.h"
+#include "../core/WarmPool.h"
+
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QTextStream>
+#include <QFileInfo>
+
+KvmCtl::KvmCtl(QObject *parent)
+    : QObject(parent)
+    , m_kvmManager(new KVMManager(this))
+    , m_controlServer(nullptr)
+    , m_pressureController(nullptr)
+    , m_pretty(false)
+{
+    // Los errores se acumulan y se devuelven en la respuesta JSON
+    connect(m_kvmManager, &KVMManager::errorOccurred, this, [this](const QString &error) {
+        m_errors.append(error);
+    });
+    connect(m_kvmManager->getAdmissionController(), &AdmissionController::warning, this, [this](const QString &warning) {
+        m_warnings.append(warning);
+    });
+    
+    setupParser();
+}
+
+void KvmCtl::setupParser()
+{
+    m_parser.setApplicationDescription(tr(
+        "Control de máquinas virtuales KVM sin interfaz gráfica.\n\n"
+        "Comandos:\n"
+        "  list                              Listar máquinas virtuales\n"
+        "  info <vm>                         Mostrar la configuración de una VM\n"
+        "  create <vm>                       Crear una VM (--os, --memory, --disk-size)\n"
+        "  clone <origen> <destino>          Clonar una VM (--snapshot: los discos de esa instantánea)\n"
+        "  delete <vm>                       Eliminar una VM y sus discos\n"
+        "  set <vm> <opción> <valor>         Cambiar memory, memory-backing, hugepage-size,\n"
+        "                                    prealloc, memory-share, mem-merge, balloon, priority\n"
+        "                                    (low, normal, high), cpus, cpu-model, topology,\n"
+        "                                    pinning, cpuset, profile, disk-controller, start-after\n"
+        "                                    (VMs separadas por comas o none) o la E/S\n"
+        "                                    de los discos (cache, aio, discard, detect-zeroes,\n"
+        "                                    iothread, queues), ephemeral (on: lo escrito en\n"
+        "                                    los discos se descarta al apagar) o group (none\n"
+        "                                    la saca de su grupo)\n"
+        "  stats <vm>                        Estadísticas de una VM en ejecución (CPU, discos,\n"
+        "                                    memoria del invitado)\n"
+        "  balloon <vm> <MB>                 Ajustar la memoria que el balón deja al invitado\n"
+        "  start <vm>                        Iniciar una VM (si no cabe en el anfitrión, según la\n"
+        "                                    política: avisa, espera en cola o se rechaza)\n"
+        "  admission                         RAM y vCPUs comprometidas, capacidad y cola de arranques\n"
+        "  stop <vm>                         Detener una VM (o descartar su estado guardado)\n"
+        "  start-many <vm>...                Iniciar varias VMs escalonadas según sus dependencias\n"
+        "                                    (set <vm> start-after a,b) y prioridad (--parallel,\n"
+        "                                    --ramp, --readiness, --ready-timeout, --io-limit)\n"
+        "  stop-many <vm>...                 Detener varias VMs en orden inverso de dependencias\n"
+        "  save <vm>                         Suspender una VM a disco; start la restaura. Con\n"
+        "                                    --stats, rendimiento del último guardado/restauración\n"
+        "  snapshot list <vm>                Listar instantáneas\n"
+        "  snapshot tree <vm>                Árbol de instantáneas con padre, fecha y tamaño del estado\n"
+        "  snapshot create|delete|revert <vm> <nombre>\n"
+        "                                    En marcha se guarda también la memoria (--description)\n"
+        "  snapshot external <vm> <nombre>   Añadir una capa qcow2 encima de cada disco\n"
+        "  snapshot chain <vm>               Cadena de capas de cada disco y su profundidad\n"
+        "  snapshot commit|stream <vm> <disco>\n"
+        "                                    Fusionar la cadena en la base o en la capa superior\n"
+        "  checkpoint list <vm>              Puntos de control de una VM\n"
+        "  checkpoint create|reset|delete <vm> <nombre>\n"
+        "                                    Congelar discos (y memoria si está en marcha) o volver\n"
+        "                                    a ellos descartando todo lo escrito después\n"
+        "  fork <vm> <n>                     Clonar en caliente una VM en marcha: n clones enlazados\n"
+        "                                    que arrancan desde una única captura de su memoria\n"
+        "                                    (--prefix; por defecto <vm>-fork)\n"
+        "  group                             Grupos de VMs y sus miembros\n"
+        "  group snapshot <grupo> <nombre>   Capa externa en todos los discos del grupo a la vez:\n"
+        "                                    congela (qemu-guest-agent), pausa, captura en\n"
+        "                                    paralelo y reanuda; informa del tiempo en pausa\n"
+        "  template                          Listar las plantillas\n"
+        "  template mark|unmark <vm>         Convertir una VM apagada en plantilla (discos de sólo\n"
+        "                                    lectura; no arranca) o devolverla a VM normal\n"
+        "  template create <plantilla> <vm>  Crear una VM como clon enlazado de la plantilla, con\n"
+        "                                    UUID y MAC propios\n"
+        "  template batch <plantilla> <n>    Crear n VMs <prefijo>-1... de una vez (--prefix; por\n"
+        "                                    defecto el nombre de la plantilla)\n"
+        "  pool                              Reservas de instancias en espera por plantilla\n"
+        "  pool set <plantilla> <n>          Mantener n instancias arrancadas y aparcadas\n"
+        "                                    (--park saved|paused; 0 vacía la reserva). Se repone\n"
+        "                                    desde la interfaz gráfica o serve\n"
+        "  pool start <plantilla>            Entregar una instancia lista (o arrancar un clon\n"
+        "                                    enlazado en frío si no queda ninguna)\n"
+        "  disk create <ruta>                Crear un disco (--size, --format)\n"
+        "  disk info <ruta>                  Mostrar formato y tamaño de un disco\n"
+        "  disk resize <ruta> <GB>           Redimensionar un disco\n"
+        "  disk convert <origen> <destino>   Convertir un disco (--format)\n"
+        "  ksm                               Estado de KSM y memoria ahorrada por cada VM\n"
+        "  ksm on|off|unmerge                Activar o parar KSM, o deshacer las fusiones (root)\n"
+        "  ksm tune <páginas> <ms>           Páginas revisadas por pasada y pausa entre pasadas\n"
+        "  serve                             Atender peticiones JSON-RPC en un socket Unix (--socket)\n"
+        "                                    y vigilar la presión de memoria del anfitrión y\n"
+        "                                    reponer las reservas de instancias\n"
+        "  sync                              Importar/sincronizar dominios de libvirt (--full)"));
+    m_parser.addHelpOption();
+    m_parser.addVersionOption();
+    
+    m_parser.addPositionalArgument("command", tr("Comando a ejecutar"));
+    m_parser.addPositionalArgument("args", tr("Argumentos del comando"), "[args...]");
+    
+    m_parser.addOption(QCommandLineOption("os", tr("Tipo de sistema operativo"), "os", "Linux"));
+    m_parser.addOption(QCommandLineOption({"m", "memory"}, tr("Memoria en MB"), "mb", "2048"));
+    m_parser.addOption(QCommandLineOption("disk-size", tr("Tamaño del disco de la VM en GB"), "gb", "20"));
+    m_parser.addOption(QCommandLineOption("size", tr("Tamaño del disco en GB"), "gb", "20"));
+    m_parser.addOption(QCommandLineOption("format", tr("Formato del disco"), "format", "qcow2"));
+    m_parser.addOption(QCommandLineOption("pretty", tr("Salida JSON indentada")));
+    m_parser.addOption(QCommandLineOption("socket", tr("Ruta del socket de control"), "path",
+                                          ControlServer::defaultSocketPath()));
+    m_parser.addOption(QCommandLineOption("full", tr("Volver a leer la configuración de todos los dominios")));
+    m_parser.addOption(QCommandLineOption("snapshot", tr("Instantánea de la que copiar los discos"), "nombre"));
+    m_parser.addOption(QCommandLineOption("description", tr("Descripción de la instantánea"), "texto"));
+    m_parser.addOption(QCommandLineOption("stats", tr("Mostrar el rendimiento del último guardado y restauración")));
+    m_parser.addOption(QCommandLineOption("prefix", tr("Prefijo de los nombres de las VMs creadas"), "nombre"));
+    m_parser.addOption(QCommandLineOption("park", tr("Cómo se aparcan las instancias de reserva: saved o paused"), "mode"));
+    
+    // start-many / stop-many (por defecto, los valores de las preferencias)
+    m_parser.addOption(QCommandLineOption("parallel", tr("Arranques o paradas simultáneos"), "n"));
+    m_parser.addOption(QCommandLineOption("ramp", tr("Pausa mínima entre arranques en ms"), "ms"));
+    m_parser.addOption(QCommandLineOption("readiness", tr("Cuándo está lista una VM: none, qmp o agent"), "mode"));
+    m_parser.addOption(QCommandLineOption("ready-timeout", tr("Espera máxima a que una VM esté lista"), "s"));
+    m_parser.addOption(QCommandLineOption("io-limit", tr("No arrancar con la presión de E/S por encima de este %"), "pct"));
+}
+
+int KvmCtl::run(const QStringList &arguments)
+{
+    m_parser.process(arguments);
+    m_pretty = m_parser.isSet("pretty");
+    
+    QStringList positional = m_parser.positionalArguments();
+    if (positional.isEmpty()) {
+        m_parser.showHelp(1);
+    }
+    
+    m_command = positional.takeFirst();
+    
+    if (m_command == "list") {
+        return cmdList(positional);
+    } else if (m_command == "info") {
+        return cmdInfo(positional);
+    } else if (m_command == "create") {
+        return cmdCreate(positional);
+    } else if (m_command == "clone") {
+        return cmdClone(positional);
+    } else if (m_command == "delete") {
+        return cmdDelete(positional);
+    } else if (m_command == "set") {
+        return cmdSet(positional);
+    } else if (m_command == "stats") {
+        return cmdStats(positional);
+    } else if (m_command == "balloon") {
+        return cmdBalloon(positional);
+    } else if (m_command == "start") {
+        return cmdStart(positional);
+    } else if (m_command == "stop") {
+        return cmdStop(positional);
+    } else if (m_command == "start-many" || m_command == "stop-many") {
+        return cmdBulk(positional);
+    } else if (m_command == "save") {
+        return cmdSave(positional);
+    } else if (m_command == "snapshot") {
+        return cmdSnapshot(positional);
+    } else if (m_command == "checkpoint") {
+        return cmdCheckpoint(positional);
+    } else if (m_command == "fork") {
+        return cmdFork(positional);
+    } else if (m_command == "disk") {
+        return cmdDisk(positional);
+    } else if (m_command == "admission") {
+        return cmdAdmission(positional);
+    } else if (m_command == "ksm") {
+        return cmdKsm(positional);
+    } else if (m_command == "group") {
+        return cmdGroup(positional);
+    } else if (m_command == "template") {
+        return cmdTemplate(positional);
+    } else if (m_command == "pool") {
+        return cmdPool(positional);
+    } else if (m_command == "serve") {
+        return cmdServe(positional);
+    } else if (m_command == "sync") {
+        return cmdSync(positional);
+    }
+    
+    return printError(tr("Comando desconocido: %1").arg(m_command));
+}
+
+int KvmCtl::cmdList(const QStringList &args)
+{
+    Q_UNUSED(args)
+    
+    QJsonArray vms;
+    for (const QString &name : m_kvmManager->getVirtualMachines()) {
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(name);
+        if (vm) {
+            vms.append(vm->toJson());
+        }
+    }
+    return printResult(vms);
+}
+
+int KvmCtl::cmdInfo(const QStringList &args)
+{
+    if (args.size() != 1) {
+        return printUsage("info <vm>");
+    }
+    
+    VirtualMachine *vm = m_kvmManager->getVirtualMachine(args[0]);
+    if (!vm) {
+        return printError(tr("Máquina virtual '%1' no encontrada").arg(args[0]));
+    }
+    return printResult(vm->toJson());
+}
+
+int KvmCtl::cmdCreate(const QStringList &args)
+{
+    if (args.size() != 1) {
+        return printUsage("create <vm> [--os <tipo>] [--memory <mb>] [--disk-size <gb>]");
+    }
+    
+    const QString name = args[0];
+    int memoryMB = m_parser.value("memory").toInt();
+    int diskSizeGB = m_parser.value("disk-size").toInt();
+    if (memoryMB <= 0 || diskSizeGB <= 0) {
+        return printError(tr("La memoria y el tamaño del disco deben ser positivos"));
+    }
+    
+    if (!m_kvmManager->createVirtualMachine(name, m_parser.value("os"), memoryMB, diskSizeGB)) {
+        return printError(lastError(tr("No se pudo crear la VM '%1'").arg(name)));
+    }
+    return printResult(m_kvmManager->getVirtualMachine(name)->toJson());
+}
+
+int KvmCtl::cmdClone(const QStringList &args)
+{
+    if (args.size() != 2) {
+        return printUsage("clone <origen> <destino>");
+    }
+    
+    if (!m_kvmManager->cloneVirtualMachine(args[0], args[1], m_parser.value("snapshot"))) {
+        return printError(lastError(tr("No se pudo clonar la VM '%1'").arg(args[0])));
+    }
+    
+    VirtualMachine *clone = m_kvmManager->getVirtualMachine(args[1]);
+    return printResult(clone ? QJsonValue(clone->toJson()) : QJsonValue(args[1]));
+}
+
+int KvmCtl::cmdDelete(const QStringList &args)
+{
+    if (args.size() != 1) {
+        return printUsage("delete <vm>");
+    }
+    
+    if (!m_kvmManager->deleteVirtualMachine(args[0])) {
+        return printError(lastError(tr("No se pudo eliminar la VM '%1'").arg(args[0])));
+    }
+    return printResult(args[0]);
+}
+
+int KvmCtl::cmdSet(const QStringList &args)
+{
+    if (args.size() != 3) {
+        return printUsage("set <vm> <opción> <valor>");
+    }
+    
+    if (!m_kvmManager->setVMOption(args[0], args[1], args[2])) {
+        return printError(lastError(tr("No se pudo cambiar '%1' en la VM '%2'").arg(args[1], args[0])));
+    }
+    return printResult(m_kvmManager->getVirtualMachine(args[0])->toJson());
+}
+
+int KvmCtl::cmdStats(const QStringList &args)
+{
+    if (args.size() != 1) {
+        return printUsage("stats <vm>");
+    }
+    
+    QJsonObject stats = m_kvmManager->getVMStats(args[0]);
+    if (stats.isEmpty()) {
+        return printError(lastError(tr("No se pudieron obtener las estadísticas de la VM '%1'").arg(args[0])));
+    }
+    return printResult(stats);
+}
+
+int KvmCtl::cmdBalloon(const QStringList &args)
+{
+    bool ok = false;
+    qint64 targetMB = args.size() == 2 ? args[1].toLongLong(&ok) : 0;
+    if (!ok) {
+        return printUsage("balloon <vm> <MB>");
+    }
+    
+    if (!m_kvmManager->setBalloonTarget(args[0], targetMB)) {
+        return printError(lastError(tr("No se pudo ajustar el balón de la VM '%1'").arg(args[0])));
+    }
+    return printResult(targetMB);
+}
+
+int KvmCtl::cmdStart(const QStringList &args)
+{
+    if (args.size() != 1) {
+        return printUsage("start <vm>");
+    }
+    
+    const QString name = args[0];
+    if (!m_kvmManager->startVM(name)) {
+        return printError(lastError(tr("No se pudo iniciar la VM '%1'").arg(name)));
+    }
+    
+    // QEMU se ejecuta desacoplado: kvmctl termina y la VM sigue en marcha
+    return printResult(m_kvmManager->getVirtualMachine(name)->toJson());
+}
+
+int KvmCtl::cmdStop(const QStringList &args)
+{
+    if (args.size() != 1) {
+        return printUsage("stop <vm>");
+    }
+    
+    if (!m_kvmManager->stopVM(args[0])) {
+        return printError(lastError(tr("No se pudo detener la VM '%1'").arg(args[0])));
+    }
+    return printResult(args[0]);
+}
+
+int KvmCtl::cmdBulk(const QStringList &args)
+{
+    if (args.isEmpty()) {
+        return printUsage(m_command + " <vm>... [--parallel n] [--ramp ms] [--readiness none|qmp|agent]");
+    }
+    
+    QJsonObject overrides;
+    if (m_parser.isSet("parallel")) overrides["maxParallel"] = m_parser.value("parallel").toInt();
+    if (m_parser.isSet("ramp")) overrides["rampUpMs"] = m_parser.value("ramp").toInt();
+    if (m_parser.isSet("readiness")) {
+        if (!BootScheduler::readinessModes().contains(m_parser.value("readiness"))) {
+            return printError(tr("Modo de disponibilidad no válido: %1 (none, qmp o agent)").arg(m_parser.value("readiness")));
+        }
+        overrides["readiness"] = m_parser.value("readiness");
+    }
+    if (m_parser.isSet("ready-timeout")) overrides["readyTimeoutSecs"] = m_parser.value("ready-timeout").toInt();
+    if (m_parser.isSet("io-limit")) overrides["maxIoPressure"] = m_parser.value("io-limit").toDouble();
+    BootScheduler::Options options = BootScheduler::Options::fromJson(overrides, BootScheduler::loadOptions());
+    
+    QJsonObject summary = m_command == "start-many" ? m_kvmManager->startVMs(args, options)
+                                                    : m_kvmManager->stopVMs(args, options);
+    if (summary.isEmpty()) {
+        return printError(lastError(tr("La operación en bloque no terminó")));
+    }
+    
+    // El resumen se devuelve también cuando alguna VM falla
+    int failed = summary.value("failed").toInt();
+    QJsonObject output;
+    output["ok"] = failed == 0;
+    output["command"] = m_command;
+    output["result"] = summary;
+    if (!m_warnings.isEmpty()) {
+        output["warnings"] = QJsonArray::fromStringList(m_warnings);
+    }
+    writeJson(output);
+    return failed ? 1 : 0;
+}
+
+int KvmCtl::cmdSave(const QStringList &args)
+{
+    if (args.size() != 1) {
+        return printUsage("save <vm> [--stats]");
+    }
+    
+    // --stats: sólo el rendimiento del último guardado y restauración
+    if (m_parser.isSet("stats")) {
+        if (!m_kvmManager->getVirtualMachine(args[0])) {
+            return printError(tr("Máquina virtual '%1' no encontrada").arg(args[0]));
+        }
+        return printResult(m_kvmManager->getSaveStateStats(args[0]));
+    }
+    
+    QJsonObject stats;
+    if (!m_kvmManager->saveVMState(args[0], &stats)) {
+        return printError(lastError(tr("No se pudo guardar el estado de la VM '%1'").arg(args[0])));
+    }
+    QJsonObject result = m_kvmManager->getVirtualMachine(args[0])->toJson();
+    if (!stats.isEmpty()) {
+        result["save"] = stats;
+    }
+    return printResult(result);
+}
+
+int KvmCtl::cmdSnapshot(const QStringList &args)
+{
+    const QString usage = "snapshot list|tree|chain <vm> | snapshot create|delete|revert|external <vm> <nombre>"
+                          " | snapshot commit|stream <vm> <disco>";
+    if (args.size() < 2) {
+        return printUsage(usage);
+    }
+    
+    const QString action = args[0];
+    const QString vmName = args[1];
+    
+    if (action == "list") {
+        if (!m_kvmManager->getVirtualMachine(vmName)) {
+            return printError(tr("Máquina virtual '%1' no encontrada").arg(vmName));
+        }
+        return printResult(QJsonArray::fromStringList(m_kvmManager->getSnapshots(vmName)));
+    }
+    
+    if (action == "tree") {
+        if (!m_kvmManager->getVirtualMachine(vmName)) {
+            return printError(tr("Máquina virtual '%1' no encontrada").arg(vmName));
+        }
+        return printResult(m_kvmManager->getSnapshotTree(vmName));
+    }
+    
+    if (action == "chain") {
+        if (!m_kvmManager->getVirtualMachine(vmName)) {
+            return printError(tr("Máquina virtual '%1' no encontrada").arg(vmName));
+        }
+        return printResult(m_kvmManager->getDiskChains(vmName));
+    }
+    
+    if (args.size() != 3) {
+        return printUsage(usage);
+    }
+    
+    if (action == "commit" || action == "stream") {
+        const QString disk = args[2];
+        if (!m_kvmManager->mergeDiskChain(vmName, disk, action)) {
+            return printError(lastError(tr("Error al fusionar la cadena de %1").arg(disk)));
+        }
+        QJsonObject result;
+        result["vm"] = vmName;
+        result["disks"] = QJsonArray::fromStringList(m_kvmManager->getVirtualMachine(vmName)->getHardDisks());
+        return printResult(result);
+    }
+    
+    const QString tag = args[2];
+    bool ok = false;
+    if (action == "create") {
+        ok = m_kvmManager->createSnapshot(vmName, tag, m_parser.value("description"));
+    } else if (action == "delete") {
+        ok = m_kvmManager->deleteSnapshot(vmName, tag);
+    } else if (action == "revert") {
+        ok = m_kvmManager->revertSnapshot(vmName, tag);
+    } else if (action == "external") {
+        ok = m_kvmManager->createExternalSnapshot(vmName, tag);
+    } else {
+        return printUsage(usage);
+    }
+    
+    if (!ok) {
+        return printError(lastError(tr("Error en la operación de instantánea '%1'").arg(tag)));
+    }
+    
+    QJsonObject result;
+    result["vm"] = vmName;
+    result["snapshot"] = tag;
+    return printResult(result);
+}
+
+int KvmCtl::cmdCheckpoint(const QStringList &args)
+{
+    const QString usage = "checkpoint list <vm> | checkpoint create|reset|delete <vm> <nombre>";
+    if (args.size() < 2) {
+        return printUsage(usage);
+    }
+    
+    const QString action = args[0];
+    const QString vmName = args[1];
+    if (!m_kvmManager->getVirtualMachine(vmName)) {
+        return printError(tr("Máquina virtual '%1' no encontrada").arg(vmName));
+    }
+    
+    if (action == "list" && args.size() == 2) {
+        return printResult(m_kvmManager->getCheckpoints(vmName));
+    }
+    if (args.size() != 3) {
+        return printUsage(usage);
+    }
+    
+    const QString checkpoint = args[2];
+    QJsonObject result;
+    if (action == "create") {
+        result = m_kvmManager->createCheckpoint(vmName, checkpoint);
+    } else if (action == "reset") {
+        result = m_kvmManager->resetToCheckpoint(vmName, checkpoint);
+    } else if (action == "delete") {
+        if (m_kvmManager->deleteCheckpoint(vmName, checkpoint)) {
+            result["vm"] = vmName;
+            result["checkpoint"] = checkpoint;
+        }
+    } else {
+        return printUsage(usage);
+    }
+    
+    if (result.isEmpty()) {
+        return printError(lastError(tr("Error en la operación del punto de control '%1'").arg(checkpoint)));
+    }
+    return printResult(result);
+}
+
+int KvmCtl::cmdDisk(const QStringList &args)
+{
+    const QString usage = "disk create|info <ruta> | disk resize <ruta> <GB> | disk convert <origen> <destino>";
+    if (args.size() < 2) {
+        return printUsage(usage);
+    }
+    
+    QemuManager *qemu = m_kvmManager->getQemuManager();
+    const QString action = args[0];
+    const QString path = QFileInfo(args[1]).absoluteFilePath();
+    
+    if (action == "info") {
+        if (!QFileInfo::exists(path)) {
+            return printError(tr("El archivo de disco no existe: %1").arg(path));
+        }
+        QJsonObject result;
+        result["path"] = path;
+        result["format"] = qemu->getDiskFormat(path);
+        result["virtualSize"] = qemu->getDiskSize(path);
+        result["actualSize"] = QFileInfo(path).size();
+        return printResult(result);
+    }
+    
+    bool ok = false;
+    QJsonObject result;
+    result["path"] = path;
+    
+    if (action == "create" && args.size() == 2) {
+        qint64 sizeGB = m_parser.value("size").toLongLong();
+        ok = qemu->createDisk(path, m_parser.value("format"), sizeGB);
+        result["format"] = m_parser.value("format");
+        result["sizeGB"] = sizeGB;
+    } else if (action == "resize" && args.size() == 3) {
+        qint64 sizeGB = args[2].toLongLong();
+        ok = qemu->resizeDisk(path, sizeGB);
+        result["sizeGB"] = sizeGB;
+    } else if (action == "convert" && args.size() == 3) {
+        QString destPath = QFileInfo(args[2]).absoluteFilePath();
+        ok = qemu->convertDisk(path, destPath, m_parser.value("format"));
+        result["destination"] = destPath;
+        result["format"] = m_parser.value("format");
+    } else {
+        return printUsage(usage);
+    }
+    
+    if (!ok) {
+        return printError(lastError(tr("Error en la operación de disco '%1'").arg(action)));
+    }
+    return printResult(result);
+}
+
+int KvmCtl::cmdAdmission(const QStringList &args)
+{
+    if (!args.isEmpty()) {
+        return printUsage("admission");
+    }
+    return printResult(m_kvmManager->getAdmissionController()->status());
+}
+
+int KvmCtl::cmdKsm(const QStringList &args)
+{
+    const QString usage = "ksm [on|off|unmerge] | ksm tune <pages_to_scan> <sleep_millisecs>";
+    bool ok = true;
+    
+    if (args.isEmpty()) {
+        QJsonObject status = m_kvmManager->getKsmStatus();
+        if (!status.value("supported").toBool()) {
+            return printError(tr("El kernel no tiene soporte de KSM (CONFIG_KSM)"));
+        }
+        return printResult(status);
+    } else if (args.size() == 1 && (args[0] == "on" || args[0] == "off" || args[0] == "unmerge")) {
+        int run = args[0] == "on" ? 1 : args[0] == "off" ? 0 : 2;
+        ok = m_kvmManager->setKsm(run);
+    } else if (args.size() == 3 && args[0] == "tune") {
+        bool pagesOk = false;
+        bool sleepOk = false;
+        int pagesToScan = args[1].toInt(&pagesOk);
+        int sleepMillisecs = args[2].toInt(&sleepOk);
+        if (!pagesOk || !sleepOk || pagesToScan < 0 || sleepMillisecs < 0) {
+            return printUsage(usage);
+        }
+        ok = m_kvmManager->setKsm(-1, pagesToScan, sleepMillisecs);
+    } else {
+        return printUsage(usage);
+    }
+    
+    if (!ok) {
+        return printError(lastError(tr("No se pudo cambiar la configuración de KSM")));
+    }
+    return printResult(m_kvmManager->getKsmStatus());
+}
+
+int KvmCtl::cmdFork(const QStringList &args)
+{
+    const QString usage = "fork <vm> <n> [--prefix <nombre>]";
+    bool ok = false;
+    int count = args.size() == 2 ? args[1].toInt(&ok) : 0;
+    if (!ok || count < 1) {
+        return printUsage(usage);
+    }
+    
+    QJsonObject result = m_kvmManager->forkVM(args[0], count, m_parser.value("prefix"));
+    if (result.isEmpty()) {
+        return printError(lastError(tr("No se pudo clonar en caliente '%1'").arg(args[0])));
+    }
+    return printResult(result);
+}
+
+int KvmCtl::cmdGroup(const QStringList &args)
+{
+    const QString usage = "group | group snapshot <grupo> <nombre>";
+    if (args.isEmpty() || (args.size() == 1 && args[0] == "list")) {
+        QJsonObject groups;
+        for (const QString &group : m_kvmManager->getGroups()) {
+            groups[group] = QJsonArray::fromStringList(m_kvmManager->getGroupMembers(group));
+        }
+        return printResult(groups);
+    }
+    
+    if (args[0] == "snapshot" && args.size() == 3) {
+        QJsonObject result = m_kvmManager->createGroupSnapshot(args[1], args[2]);
+        if (result.isEmpty()) {
+            return printError(lastError(tr("No se pudo tomar la instantánea del grupo '%1'").arg(args[1])));
+        }
+        return printResult(result);
+    }
+    return printUsage(usage);
+}
+
+int KvmCtl::cmdTemplate(const QStringList &args)
+{
+    const QString usage = "template | template mark|unmark <vm> | template create <plantilla> <vm> | "
+                          "template batch <plantilla> <n> [--prefix <nombre>]";
+    if (args.isEmpty() || (args.size() == 1 && args[0] == "list")) {
+        return printResult(QJsonArray::fromStringList(m_kvmManager->getTemplates()));
+    }
+    
+    const QString action = args[0];
+    if ((action == "mark" || action == "unmark") && args.size() == 2) {
+        if (!m_kvmManager->setVMTemplate(args[1], action == "mark")) {
+            return printError(lastError(tr("No se pudo cambiar la plantilla '%1'").arg(args[1])));
+        }
+        return printResult(m_kvmManager->getVirtualMachine(args[1])->toJson());
+    } else if (action == "create" && args.size() == 3) {
+        if (!m_kvmManager->createVMFromTemplate(args[1], args[2])) {
+            return printError(lastError(tr("No se pudo crear '%1' desde la plantilla '%2'").arg(args[2], args[1])));
+        }
+        return printResult(m_kvmManager->getVirtualMachine(args[2])->toJson());
+    } else if (action == "batch" && args.size() == 3) {
+        bool ok = false;
+        int count = args[2].toInt(&ok);
+        if (!ok || count < 1) {
+            return printUsage(usage);
+        }
+        QJsonObject result = m_kvmManager->createVMsFromTemplate(args[1], m_parser.value("prefix"), count);
+        if (result.isEmpty()) {
+            return printError(lastError(tr("No se pudo crear ninguna VM desde la plantilla '%1'").arg(args[1])));
+        }
+        return printResult(result);
+    }
+    return printUsage(usage);
+}
+
+int KvmCtl::cmdPool(const QStringList &args)
+{
+    const QString usage = "pool | pool set <plantilla> <n> [--park saved|paused] | pool start <plantilla>";
+    WarmPool *pool = m_kvmManager->getWarmPool();
+    
+    if (args.isEmpty()) {
+        return printResult(pool->status());
+    } else if (args.size() == 3 && args[0] == "set") {
+        bool ok = false;
+        int size = args[2].toInt(&ok);
+        QString park = m_parser.value("park");
+        if (!ok || size < 0 || (!park.isEmpty() && !WarmPool::parkModes().contains(park))) {
+            return printUsage(usage);
+        }
+        if (!m_kvmManager->getVirtualMachine(args[1])) {
+            return printError(tr("La plantilla '%1' no existe").arg(args[1]));
+        }
+        pool->setPool(args[1], size, park);
+        return printResult(pool->status());
+    } else if (args.size() == 2 && args[0] == "start") {
+        QJsonObject result = m_kvmManager->acquireWarmVM(args[1]);
+        if (result.isEmpty()) {
+            return printError(lastError(tr("No se pudo entregar una instancia de '%1'").arg(args[1])));
+        }
+        return printResult(result);
+    }
+    return printUsage(usage);
+}
+
+int KvmCtl::cmdServe(const QStringList &args)
+{
+    if (!args.isEmpty()) {
+        return printUsage("serve [--socket <ruta>]");
+    }
+    
+    m_controlServer = new ControlServer(m_kvmManager, this);
+    connect(m_controlServer, &ControlServer::errorOccurred, this, [this](const QString &error) {
+        m_errors.append(error);
+    });
+    
+    if (!m_controlServer->listen(m_parser.value("socket"))) {
+        return printError(lastError(tr("No se pudo abrir el socket de control")));
+    }
+    
+    // Sin interfaz gráfica abierta, el servicio es quien protege al anfitrión
+    m_pressureController = new MemoryPressureController(m_kvmManager, this);
+    m_controlServer->setMemoryPressureController(m_pressureController);
+    m_pressureController->start();
+    m_kvmManager->getWarmPool()->start();
+    
+    QJsonObject result;
+    result["socket"] = m_controlServer->socketPath();
+    printResult(result);
+    
+    // Atender peticiones hasta que el proceso reciba una señal de terminación
+    return -1;
+}
+
+int KvmCtl::cmdSync(const QStringList &args)
+{
+    if (!args.isEmpty()) {
+        return printUsage("sync [--full]");
+    }
+    
+    QJsonObject summary = m_kvmManager->syncLibvirtDomains(m_parser.isSet("full"));
+    if (summary.isEmpty()) {
+        return printError(lastError(tr("No se pudo sincronizar con libvirt")));
+    }
+    return printResult(summary);
+}
+
+int KvmCtl::printResult(const QJsonValue &result)
+{
+    QJsonObject output;
+    output["ok"] = true;
+    output["command"] = m_command;
+    output["result"] = result;
+    if (!m_warnings.isEmpty()) {
+        output["warnings"] = QJsonArray::fromStringList(m_warnings);
+    }
+    writeJson(output);
+    return 0;
+}
+
+int KvmCtl::printError(const QString &error)
+{
+    QJsonObject output;
+    output["ok"] = false;
+    output["command"] = m_command;
+    output["error"] = error;
+    if (!m_errors.isEmpty()) {
+        output["details"] = QJsonArray::fromStringList(m_errors);
+    }
+    writeJson(output);
+    return 1;
+}
+
+int KvmCtl::printUsage(const QString &usage)
+{
+    return printError(tr("Uso: kvmctl %1").arg(usage));
+}
+
+void KvmCtl::writeJson(const QJsonObject &object)
+{
+    QTextStream out(stdout);
+    QJsonDocument::JsonFormat format = m_pretty ? QJsonDocument::Indented : QJsonDocument::Compact;
+    out << QJsonDocument(object).toJson(format);
+    if (!m_pretty) {
+        out << Qt::endl;
+    } else {
+        out.flush();
+    }
+}
+
+QString KvmCtl::lastError(const QString &fallback) const
+{
+    return m_errors.isEmpty() ? fallback : m_errors.last();
+}
\ No newline at end of file
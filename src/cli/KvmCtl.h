@@ -0,0 +1,78 @@
+#ifndef KVMCTL_H
+#define KVMCTL_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QCommandLineParser>
+
+class KVMManager;
+class ControlServer;
+class MemoryPressureController;
+
+/**
+ * @brief Herramienta de línea de comandos sin interfaz gráfica
+ * Expone las operaciones de KVMManager con salida JSON legible por máquinas
+ */
+class KvmCtl : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit KvmCtl(QObject *parent = nullptr);
+    
+    // Devuelve el código de salida, o -1 si el comando sigue
+    // ejecutándose en el bucle de eventos (se emitirá finished())
+    int run(const QStringList &arguments);
+
+signals:
+    void finished(int exitCode);
+
+private:
+    void setupParser();
+    
+    // Comandos
+    int cmdList(const QStringList &args);
+    int cmdInfo(const QStringList &args);
+    int cmdCreate(const QStringList &args);
+    int cmdClone(const QStringList &args);
+    int cmdDelete(const QStringList &args);
+    int cmdSet(const QStringList &args);
+    int cmdStats(const QStringList &args);
+    int cmdBalloon(const QStringList &args);
+    int cmdStart(const QStringList &args);
+    int cmdStop(const QStringList &args);
+    int cmdBulk(const QStringList &args);
+    int cmdSave(const QStringList &args);
+    int cmdSnapshot(const QStringList &args);
+    int cmdCheckpoint(const QStringList &args);
+    int cmdFork(const QStringList &args);
+    int cmdDisk(const QStringList &args);
+    int cmdAdmission(const QStringList &args);
+    int cmdKsm(const QStringList &args);
+    int cmdGroup(const QStringList &args);
+    int cmdTemplate(const QStringList &args);
+    int cmdPool(const QStringList &args);
+    int cmdServe(const QStringList &args);
+    int cmdSync(const QStringList &args);
+    
+    // Salida JSON
+    int printResult(const QJsonValue &result);
+    int printError(const QString &error);
+    int printUsage(const QString &usage);
+    void writeJson(const QJsonObject &object);
+    QString lastError(const QString &fallback) const;
+    
+    KVMManager *m_kvmManager;
+    ControlServer *m_controlServer;
+    MemoryPressureController *m_pressureController;
+    QCommandLineParser m_parser;
+    QString m_command;
+    QStringList m_errors;
+    QStringList m_warnings;
+    bool m_pretty;
+};
+
+#endif // KVMCTL_H
\ No newline at end of file
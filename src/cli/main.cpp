@@ -0,0 +1,22 @@
+#include <QCoreApplication>
+#include "KvmCtl.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    
+    // Mismos nombres que la GUI para compartir QSettings
+    app.setApplicationName("KVM Manager");
+    app.setApplicationVersion("1.0.0");
+    app.setOrganizationName("KVM Manager Team");
+    
+    KvmCtl ctl;
+    int exitCode = ctl.run(app.arguments());
+    if (exitCode >= 0) {
+        return exitCode;
+    }
+    
+    // El comando continúa de forma asíncrona
+    QObject::connect(&ctl, &KvmCtl::finished, &app, &QCoreApplication::exit);
+    return app.exec();
+}
\ No newline at end of file
@@ -0,0 +1,347 @@
+#include "AdmissionController.h"
+#include "KVMManager.h"
+#include "VirtualMachine.h"
+#include "HostInfo.h"
+
+#include <QTimer>
+#include <QSettings>
+#include <QJsonArray>
+#include <QDebug>
+
+AdmissionController::AdmissionController(KVMManager *kvmManager, QObject *parent)
+    : QObject(parent)
+    , m_kvmManager(kvmManager)
+    , m_queueTimer(new QTimer(this))
+    , m_policy(loadPolicy())
+{
+    // La cola se revisa cuando cambia el estado de una VM y, por si los
+    // recursos se liberan fuera de este proceso, cada pocos segundos
+    m_queueTimer->setInterval(2000);
+    connect(m_queueTimer, &QTimer::timeout, this, &AdmissionController::processQueue);
+    connect(m_kvmManager, &KVMManager::vmStateChanged, this, [this]() {
+        if (!m_queue.isEmpty()) {
+            QTimer::singleShot(0, this, &AdmissionController::processQueue);
+        }
+    });
+}
+
+AdmissionController::Policy AdmissionController::loadPolicy()
+{
+    QSettings settings;
+    Policy policy;
+    
+    policy.enabled = settings.value("admission/enabled", policy.enabled).toBool();
+    QString mode = settings.value("admission/mode", policy.mode).toString();
+    if (modes().contains(mode)) {
+        policy.mode = mode;
+    }
+    policy.memoryOvercommit = qBound(0.5, settings.value("admission/memoryOvercommit", policy.memoryOvercommit).toDouble(), 4.0);
+    policy.cpuOvercommit = qBound(1.0, settings.value("admission/cpuOvercommit", policy.cpuOvercommit).toDouble(), 16.0);
+    policy.reservedMB = qBound(0, settings.value("admission/reservedMB", policy.reservedMB).toInt(), 1024 * 1024);
+    policy.queueTimeoutSecs = qBound(10, settings.value("admission/queueTimeoutSecs", policy.queueTimeoutSecs).toInt(), 3600);
+    
+    return policy;
+}
+
+void AdmissionController::savePolicy(const Policy &policy)
+{
+    QSettings settings;
+    settings.setValue("admission/enabled", policy.enabled);
+    settings.setValue("admission/mode", policy.mode);
+    settings.setValue("admission/memoryOvercommit", policy.memoryOvercommit);
+    settings.setValue("admission/cpuOvercommit", policy.cpuOvercommit);
+    settings.setValue("admission/reservedMB", policy.reservedMB);
+    settings.setValue("admission/queueTimeoutSecs", policy.queueTimeoutSecs);
+}
+
+QStringList AdmissionController::modes()
+{
+    return {"warn", "queue", "refuse"};
+}
+
+void AdmissionController::requestStart(const QString &vmName, const Proceed &proceed)
+{
+    // Las preferencias pueden haber cambiado en otra instancia
+    m_policy = loadPolicy();
+    reconcile();
+    
+    VirtualMachine *vm = m_kvmManager->getVirtualMachine(vmName);
+    if (!vm) {
+        proceed(tr("Máquina virtual '%1' no encontrada").arg(vmName));
+        return;
+    }
+    
+    // Ya activa o ya reservada: sus recursos están contados y el backend
+    // decidirá qué hacer con el arranque
+    if (m_ledger.contains(vmName)) {
+        proceed(QString());
+        return;
+    }
+    
+    Decision decision = m_policy.enabled ? decide(vm, computeUsage()) : Decision();
+    
+    // Por orden de llegada: nadie adelanta a las VMs que ya esperan
+    if (decision.verdict == Admit && !m_queue.isEmpty()) {
+        decision.verdict = Queue;
+        decision.reasons << tr("hay %1 arranques en cola antes").arg(m_queue.size());
+    }
+    
+    QString reasons = decision.reasons.join("; ");
+    switch (decision.verdict) {
+    case Admit:
+        admit(vm);
+        proceed(QString());
+        break;
+    case Warn:
+        admit(vm);
+        emit warning(tr("La VM '%1' arranca sin recursos suficientes: %2").arg(vmName, reasons));
+        proceed(QString());
+        break;
+    case Queue: {
+        Request request;
+        request.vmName = vmName;
+        request.proceed = proceed;
+        request.waiting.start();
+        m_queue.append(request);
+        qInfo().noquote() << "AdmissionController: VM en cola" << vmName << "-" << reasons;
+        emit vmQueued(vmName, reasons);
+        m_queueTimer->start();
+        break;
+    }
+    case Refuse:
+        proceed(tr("No se arranca la VM '%1': %2").arg(vmName, reasons));
+        break;
+    }
+}
+
+void AdmissionController::release(const QString &vmName)
+{
+    auto it = m_ledger.find(vmName);
+    if (it != m_ledger.end() && it->pending) {
+        m_ledger.erase(it);
+    }
+    
+    if (!m_queue.isEmpty()) {
+        QTimer::singleShot(0, this, &AdmissionController::processQueue);
+    }
+}
+
+AdmissionController::Usage AdmissionController::usage()
+{
+    m_policy = loadPolicy();
+    reconcile();
+    return computeUsage();
+}
+
+QJsonObject AdmissionController::status()
+{
+    Usage current = usage();
+    
+    QJsonObject policy;
+    policy["enabled"] = m_policy.enabled;
+    policy["mode"] = m_policy.mode;
+    policy["memoryOvercommit"] = m_policy.memoryOvercommit;
+    policy["cpuOvercommit"] = m_policy.cpuOvercommit;
+    policy["reservedMB"] = m_policy.reservedMB;
+    policy["queueTimeoutSecs"] = m_policy.queueTimeoutSecs;
+    
+    QJsonObject host;
+    host["memoryMB"] = current.hostMemoryMB;
+    host["availableMB"] = current.hostAvailableMB;
+    host["memoryCapacityMB"] = current.memoryCapacityMB;
+    host["committedMemoryMB"] = current.committedMemoryMB;
+    host["freeMemoryMB"] = current.freeMemoryMB();
+    host["cpus"] = current.hostCpus;
+    host["cpuCapacity"] = current.cpuCapacity;
+    host["committedVcpus"] = current.committedVcpus;
+    
+    QJsonArray ledger;
+    for (auto it = m_ledger.constBegin(); it != m_ledger.constEnd(); ++it) {
+        QJsonObject entry;
+        entry["name"] = it.key();
+        entry["memoryMB"] = it.value().memoryMB;
+        entry["vcpus"] = it.value().vcpus;
+        entry["pending"] = it.value().pending;
+        ledger.append(entry);
+    }
+    
+    QJsonArray queue;
+    for (const Request &request : m_queue) {
+        QJsonObject entry;
+        entry["name"] = request.vmName;
+        entry["waitingSecs"] = request.waiting.elapsed() / 1000;
+        queue.append(entry);
+    }
+    
+    QJsonObject status;
+    status["policy"] = policy;
+    status["host"] = host;
+    status["ledger"] = ledger;
+    status["queue"] = queue;
+    return status;
+}
+
+void AdmissionController::processQueue()
+{
+    if (m_queue.isEmpty()) {
+        m_queueTimer->stop();
+        return;
+    }
+    
+    m_policy = loadPolicy();
+    reconcile();
+    qint64 timeoutMs = qint64(m_policy.queueTimeoutSecs) * 1000;
+    
+    // Sólo la primera puede arrancar: la que no cabe bloquea a las demás
+    while (!m_queue.isEmpty()) {
+        Request request = m_queue.first();
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(request.vmName);
+        if (!vm) {
+            m_queue.removeFirst();
+            request.proceed(tr("Máquina virtual '%1' no encontrada").arg(request.vmName));
+            continue;
+        }
+        
+        Decision decision = m_policy.enabled ? decide(vm, computeUsage()) : Decision();
+        if (decision.verdict == Queue && request.waiting.elapsed() < timeoutMs) {
+            break;
+        }
+        
+        m_queue.removeFirst();
+        QString reasons = decision.reasons.join("; ");
+        if (decision.verdict == Admit || decision.verdict == Warn) {
+            admit(vm);
+            if (decision.verdict == Warn) {
+                emit warning(tr("La VM '%1' arranca sin recursos suficientes: %2").arg(request.vmName, reasons));
+            }
+            qInfo().noquote() << "AdmissionController: VM admitida tras" << request.waiting.elapsed() / 1000
+                              << "s en cola:" << request.vmName;
+            request.proceed(QString());
+        } else if (decision.verdict == Queue) {
+            request.proceed(tr("La VM '%1' ha esperado %2 s en cola sin que se liberaran recursos: %3")
+                                .arg(request.vmName).arg(m_policy.queueTimeoutSecs).arg(reasons));
+        } else {
+            request.proceed(tr("No se arranca la VM '%1': %2").arg(request.vmName, reasons));
+        }
+    }
+    
+    // Las que esperan detrás también caducan
+    for (int i = 1; i < m_queue.size();) {
+        if (m_queue[i].waiting.elapsed() < timeoutMs) {
+            ++i;
+            continue;
+        }
+        Request request = m_queue.takeAt(i);
+        request.proceed(tr("La VM '%1' ha esperado %2 s en cola sin que se liberaran recursos")
+                            .arg(request.vmName).arg(m_policy.queueTimeoutSecs));
+    }
+    
+    if (m_queue.isEmpty()) {
+        m_queueTimer->stop();
+    }
+}
+
+void AdmissionController::reconcile()
+{
+    // Las VMs activas que no están en el ledger se arrancaron desde otro
+    // proceso o antes de abrir este; las reservas que nunca llegan a
+    // activarse caducan
+    QStringList names = m_kvmManager->getVirtualMachines();
+    for (const QString &name : names) {
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(name);
+        if (!vm) {
+            continue;
+        }
+        
+        auto it = m_ledger.find(name);
+        if (isActiveState(vm->getState())) {
+            m_ledger[name] = commitmentOf(vm);
+        } else if (it != m_ledger.end() && (!it->pending || it->since.elapsed() > PendingTimeoutMs)) {
+            m_ledger.erase(it);
+        }
+    }
+    
+    for (auto it = m_ledger.begin(); it != m_ledger.end();) {
+        it = names.contains(it.key()) ? std::next(it) : m_ledger.erase(it);
+    }
+}
+
+AdmissionController::Decision AdmissionController::decide(VirtualMachine *vm, const Usage &usage) const
+{
+    Decision decision;
+    Commitment need = commitmentOf(vm);
+    
+    if (usage.committedMemoryMB + need.memoryMB > usage.memoryCapacityMB) {
+        decision.reasons << tr("RAM: %1 MB comprometidos más los %2 MB de la VM superan la capacidad de %3 MB "
+                               "(%4 MB × %5 menos %6 MB reservados)")
+                                .arg(usage.committedMemoryMB).arg(need.memoryMB).arg(usage.memoryCapacityMB)
+                                .arg(usage.hostMemoryMB).arg(m_policy.memoryOvercommit).arg(m_policy.reservedMB);
+    }
+    if (usage.committedVcpus + need.vcpus > usage.cpuCapacity) {
+        decision.reasons << tr("CPU: %1 vCPUs comprometidas más %2 superan la capacidad de %3 (%4 CPUs × %5)")
+                                .arg(usage.committedVcpus).arg(need.vcpus).arg(usage.cpuCapacity)
+                                .arg(usage.hostCpus).arg(m_policy.cpuOvercommit);
+    }
+    // Con reserva previa la RAM se ocupa entera al arrancar: no basta con
+    // que quepa en el ledger, tiene que estar libre ahora
+    if (vm->isMemoryPrealloc() && need.memoryMB > usage.hostAvailableMB - m_policy.reservedMB) {
+        decision.reasons << tr("RAM: la VM reserva sus %1 MB al arrancar y sólo hay %2 MB disponibles")
+                                .arg(need.memoryMB).arg(qMax<qint64>(0, usage.hostAvailableMB - m_policy.reservedMB));
+    }
+    
+    if (decision.reasons.isEmpty()) {
+        return decision;
+    }
+    
+    // Una VM que no cabe ni con el anfitrión vacío nunca saldría de la cola
+    bool neverFits = need.memoryMB > usage.memoryCapacityMB || need.vcpus > usage.cpuCapacity;
+    if (m_policy.mode == "warn") {
+        decision.verdict = Warn;
+    } else if (m_policy.mode == "queue" && !neverFits) {
+        decision.verdict = Queue;
+    } else {
+        decision.verdict = Refuse;
+    }
+    return decision;
+}
+
+AdmissionController::Usage AdmissionController::computeUsage() const
+{
+    Usage usage;
+    HostInfo::HostMemory memory = HostInfo::hostMemory();
+    usage.hostMemoryMB = memory.totalKB / 1024;
+    usage.hostAvailableMB = memory.availableKB / 1024;
+    usage.memoryCapacityMB = qMax<qint64>(0, qint64(usage.hostMemoryMB * m_policy.memoryOvercommit) - m_policy.reservedMB);
+    usage.hostCpus = qMax(1, HostInfo::cpuTopology().logicalCpus());
+    usage.cpuCapacity = int(usage.hostCpus * m_policy.cpuOvercommit);
+    
+    for (const Commitment &commitment : m_ledger) {
+        usage.committedMemoryMB += commitment.memoryMB;
+        usage.committedVcpus += commitment.vcpus;
+        usage.runningVMs++;
+    }
+    return usage;
+}
+
+void AdmissionController::admit(VirtualMachine *vm)
+{
+    Commitment commitment = commitmentOf(vm);
+    commitment.pending = !isActiveState(vm->getState());
+    commitment.since.start();
+    m_ledger[vm->getName()] = commitment;
+    emit vmAdmitted(vm->getName());
+}
+
+bool AdmissionController::isActiveState(const QString &state)
+{
+    return !state.isEmpty() && state != "shut off" && state != "shutoff"
+        && state != "saved" && state != "crashed";
+}
+
+AdmissionController::Commitment AdmissionController::commitmentOf(VirtualMachine *vm)
+{
+    Commitment commitment;
+    commitment.memoryMB = vm->getMemoryMB();
+    commitment.vcpus = qMax(1, vm->getCPUCount());
+    return commitment;
+}
\ No newline at end of file
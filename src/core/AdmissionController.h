@@ -0,0 +1,123 @@
+#ifndef ADMISSIONCONTROLLER_H
+#define ADMISSIONCONTROLLER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QList>
+#include <QJsonObject>
+#include <QElapsedTimer>
+#include <functional>
+
+class QTimer;
+class KVMManager;
+class VirtualMachine;
+
+/**
+ * @brief Control de admisión de arranques
+ * Lleva la cuenta (ledger) de la RAM y las vCPUs comprometidas por las VMs
+ * en marcha y, antes de cada arranque, la compara con la capacidad del
+ * anfitrión multiplicada por el factor de sobreasignación. Si la VM no
+ * cabe, según la política se avisa y se arranca igualmente, se deja en cola
+ * hasta que otra VM libere recursos o se rechaza.
+ */
+class AdmissionController : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Política configurable (grupo "admission" de QSettings)
+    struct Policy {
+        bool enabled = true;
+        QString mode = "queue";         // "warn", "queue" o "refuse"
+        double memoryOvercommit = 1.0;  // RAM comprometida / RAM del anfitrión
+        double cpuOvercommit = 4.0;     // vCPUs / CPUs lógicas
+        int reservedMB = 1024;          // RAM que nunca se compromete (anfitrión)
+        int queueTimeoutSecs = 300;     // espera máxima en cola
+    };
+    
+    // Totales del ledger frente a la capacidad del anfitrión
+    struct Usage {
+        qint64 hostMemoryMB = 0;
+        qint64 hostAvailableMB = 0;     // MemAvailable, para comparar con lo comprometido
+        qint64 memoryCapacityMB = 0;    // hostMemoryMB × sobreasignación − reserva
+        qint64 committedMemoryMB = 0;
+        int hostCpus = 0;
+        int cpuCapacity = 0;
+        int committedVcpus = 0;
+        int runningVMs = 0;
+        
+        qint64 freeMemoryMB() const { return memoryCapacityMB - committedMemoryMB; }
+    };
+    
+    enum Verdict {
+        Admit,
+        Warn,       // no cabe, pero la política permite arrancar
+        Queue,
+        Refuse
+    };
+    
+    struct Decision {
+        Verdict verdict = Admit;
+        QStringList reasons;
+    };
+    
+    using Proceed = std::function<void(const QString &error)>;
+    
+    explicit AdmissionController(KVMManager *kvmManager, QObject *parent = nullptr);
+    
+    static Policy loadPolicy();
+    static void savePolicy(const Policy &policy);
+    static QStringList modes();
+    
+    // Reserva los recursos de la VM y llama a proceed() con un error vacío
+    // cuando puede arrancar: enseguida, al salir de la cola o nunca (error)
+    void requestStart(const QString &vmName, const Proceed &proceed);
+    // Devuelve los recursos reservados si el arranque falló
+    void release(const QString &vmName);
+    
+    Usage usage();
+    QJsonObject status();
+
+signals:
+    void warning(const QString &message);
+    void vmQueued(const QString &vmName, const QString &reason);
+    void vmAdmitted(const QString &vmName);
+
+private slots:
+    void processQueue();
+
+private:
+    // Recursos comprometidos por una VM
+    struct Commitment {
+        qint64 memoryMB = 0;
+        int vcpus = 0;
+        bool pending = false;       // admitida, aún sin estado activo
+        QElapsedTimer since;
+    };
+    
+    struct Request {
+        QString vmName;
+        Proceed proceed;
+        QElapsedTimer waiting;
+    };
+    
+    void reconcile();
+    Decision decide(VirtualMachine *vm, const Usage &usage) const;
+    Usage computeUsage() const;
+    void admit(VirtualMachine *vm);
+    static bool isActiveState(const QString &state);
+    static Commitment commitmentOf(VirtualMachine *vm);
+    
+    KVMManager *m_kvmManager;
+    QTimer *m_queueTimer;
+    Policy m_policy;
+    QHash<QString, Commitment> m_ledger;
+    QList<Request> m_queue;
+    
+    // Tiempo que una reserva espera a que la VM aparezca como activa
+    static const int PendingTimeoutMs = 120000;
+};
+
+#endif // ADMISSIONCONTROLLER_H
\ No newline at end of file
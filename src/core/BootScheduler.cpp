@@ -0,0 +1,538 @@
+#include "BootScheduler.h"
+#include "KVMManager.h"
+#include "QemuManager.h"
+#include "VirtualMachine.h"
+#include "HostInfo.h"
+
+#include <QTimer>
+#include <QSettings>
+#include <QPointer>
+#include <QJsonArray>
+#include <QDebug>
+
+#include <algorithm>
+
+BootScheduler::BootScheduler(KVMManager *kvmManager, Action action, const QStringList &vmNames,
+                             const Options &options, QObject *parent)
+    : QObject(parent)
+    , m_kvmManager(kvmManager)
+    , m_action(action)
+    , m_options(options)
+    , m_timer(new QTimer(this))
+    , m_throttled(false)
+    , m_completed(false)
+{
+    QStringList seen;
+    for (const QString &name : vmNames) {
+        if (name.isEmpty() || seen.contains(name)) {
+            continue;
+        }
+        seen.append(name);
+        
+        Entry entry;
+        entry.name = name;
+        entry.order = m_entries.size();
+        m_entries.append(entry);
+    }
+    
+    // Además del sondeo periódico (tiempos de espera y presión de E/S), cada
+    // señal de disponibilidad o cambio de estado revisa la cola enseguida
+    m_timer->setInterval(500);
+    connect(m_timer, &QTimer::timeout, this, &BootScheduler::schedule);
+    connect(m_kvmManager, &KVMManager::vmStateChanged, this, &BootScheduler::schedule);
+    connect(m_kvmManager->getQemuManager(), &QemuManager::qmpReady, this, &BootScheduler::schedule);
+    connect(m_kvmManager->getQemuManager(), &QemuManager::guestAgentChanged, this, &BootScheduler::schedule);
+}
+
+BootScheduler::Options BootScheduler::loadOptions()
+{
+    QSettings settings;
+    Options options;
+    
+    options.maxParallel = qBound(1, settings.value("bootScheduler/maxParallel", options.maxParallel).toInt(), 64);
+    options.rampUpMs = qBound(0, settings.value("bootScheduler/rampUpMs", options.rampUpMs).toInt(), 600000);
+    QString readiness = settings.value("bootScheduler/readiness", options.readiness).toString();
+    if (readinessModes().contains(readiness)) {
+        options.readiness = readiness;
+    }
+    options.readyTimeoutSecs = qBound(5, settings.value("bootScheduler/readyTimeoutSecs", options.readyTimeoutSecs).toInt(), 3600);
+    options.maxIoPressure = qBound(0.0, settings.value("bootScheduler/maxIoPressure", options.maxIoPressure).toDouble(), 100.0);
+    
+    return options;
+}
+
+void BootScheduler::saveOptions(const Options &options)
+{
+    QSettings settings;
+    settings.setValue("bootScheduler/maxParallel", options.maxParallel);
+    settings.setValue("bootScheduler/rampUpMs", options.rampUpMs);
+    settings.setValue("bootScheduler/readiness", options.readiness);
+    settings.setValue("bootScheduler/readyTimeoutSecs", options.readyTimeoutSecs);
+    settings.setValue("bootScheduler/maxIoPressure", options.maxIoPressure);
+}
+
+QStringList BootScheduler::readinessModes()
+{
+    return {"none", "qmp", "agent"};
+}
+
+int BootScheduler::defaultPriority(VirtualMachine *vm)
+{
+    QString priority = vm->getPriority();
+    return priority == "high" ? 2 : priority == "low" ? 0 : 1;
+}
+
+BootScheduler::Options BootScheduler::Options::fromJson(const QJsonObject &json, const Options &defaults)
+{
+    Options options = defaults;
+    
+    options.maxParallel = qBound(1, json.value("maxParallel").toInt(options.maxParallel), 64);
+    options.rampUpMs = qBound(0, json.value("rampUpMs").toInt(options.rampUpMs), 600000);
+    QString readiness = json.value("readiness").toString(options.readiness);
+    if (readinessModes().contains(readiness)) {
+        options.readiness = readiness;
+    }
+    options.readyTimeoutSecs = qBound(5, json.value("readyTimeoutSecs").toInt(options.readyTimeoutSecs), 3600);
+    options.maxIoPressure = qBound(0.0, json.value("maxIoPressure").toDouble(options.maxIoPressure), 100.0);
+    
+    // {"web": ["db", "cache"]} o {"web": "db,cache"}
+    const QJsonObject dependencies = json.value("dependencies").toObject();
+    for (auto it = dependencies.constBegin(); it != dependencies.constEnd(); ++it) {
+        QStringList vmNames;
+        if (it.value().isArray()) {
+            for (const QJsonValue &value : it.value().toArray()) {
+                vmNames.append(value.toString());
+            }
+        } else {
+            vmNames = it.value().toString().split(',', Qt::SkipEmptyParts);
+        }
+        for (QString &vmName : vmNames) {
+            vmName = vmName.trimmed();
+        }
+        vmNames.removeAll(QString());
+        options.dependencies[it.key()] = vmNames;
+    }
+    
+    // {"db": 10} o {"db": "high"}
+    const QJsonObject priorities = json.value("priorities").toObject();
+    for (auto it = priorities.constBegin(); it != priorities.constEnd(); ++it) {
+        QString level = it.value().toString();
+        options.priorities[it.key()] = it.value().isDouble() ? it.value().toInt()
+                                       : level == "high" ? 2 : level == "low" ? 0 : 1;
+    }
+    
+    return options;
+}
+
+void BootScheduler::run(VMBackend::Callback callback)
+{
+    m_callback = callback;
+    m_elapsed.start();
+    
+    qInfo() << "BootScheduler:" << (m_action == Start ? "arranque" : "parada") << "de" << m_entries.size()
+            << "VMs, paralelismo" << m_options.maxParallel << "rampa" << m_options.rampUpMs << "ms";
+    
+    prepare();
+    m_timer->start();
+    schedule();
+}
+
+void BootScheduler::prepare()
+{
+    QStringList missing;
+    for (Entry &entry : m_entries) {
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(entry.name);
+        if (!vm) {
+            missing.append(entry.name);
+            continue;
+        }
+        
+        entry.dependencies = m_options.dependencies.contains(entry.name)
+            ? m_options.dependencies.value(entry.name) : vm->getStartAfter();
+        entry.priority = m_options.priorities.contains(entry.name)
+            ? m_options.priorities.value(entry.name) : defaultPriority(vm);
+        entry.readiness = m_action == Start ? effectiveReadiness(vm) : QString();
+    }
+    
+    for (const QString &vmName : missing) {
+        finish(vmName, Failed, "failed", tr("Máquina virtual '%1' no encontrada").arg(vmName));
+    }
+    
+    markCycles();
+    
+    QStringList batch;
+    for (const Entry &entry : m_entries) {
+        batch.append(entry.name);
+    }
+    
+    for (const Entry &entry : m_entries) {
+        if (isTerminal(entry.status)) {
+            continue;
+        }
+        
+        // Ya en el estado pedido: cuenta como lista para sus dependientes
+        if (m_action == Start && isVMActive(entry.name)) {
+            finish(entry.name, Done, "already-running");
+            continue;
+        }
+        if (m_action == Stop && !isVMActive(entry.name)) {
+            finish(entry.name, Done, "already-stopped");
+            continue;
+        }
+        
+        // Una dependencia fuera del lote tiene que estar ya en marcha
+        if (m_action == Start) {
+            for (const QString &dependency : entry.dependencies) {
+                if (!batch.contains(dependency) && !isVMActive(dependency)) {
+                    finish(entry.name, Skipped, "skipped",
+                           tr("depende de '%1', que no está en marcha ni en el lote").arg(dependency));
+                    break;
+                }
+            }
+        }
+        
+        if (!isTerminal(entry.status)) {
+            emit progress(entry.name, "waiting", QString());
+        }
+    }
+}
+
+void BootScheduler::markCycles()
+{
+    // Orden topológico dentro del lote: lo que no se puede ordenar está en
+    // un ciclo o depende de uno
+    QHash<QString, QStringList> pending;
+    for (const Entry &entry : m_entries) {
+        if (isTerminal(entry.status)) {
+            continue;
+        }
+        QStringList inBatch;
+        for (const QString &dependency : entry.dependencies) {
+            auto it = std::find_if(m_entries.cbegin(), m_entries.cend(), [&dependency](const Entry &other) {
+                return other.name == dependency;
+            });
+            if (it != m_entries.cend() && !isTerminal(it->status)) {
+                inBatch.append(dependency);
+            }
+        }
+        pending[entry.name] = inBatch;
+    }
+    
+    bool progressed = true;
+    while (progressed) {
+        progressed = false;
+        for (auto it = pending.begin(); it != pending.end();) {
+            if (it.value().isEmpty()) {
+                QString resolved = it.key();
+                it = pending.erase(it);
+                for (QStringList &dependencies : pending) {
+                    dependencies.removeAll(resolved);
+                }
+                progressed = true;
+            } else {
+                ++it;
+            }
+        }
+    }
+    
+    QStringList cycle = pending.keys();
+    cycle.sort();
+    for (const QString &vmName : cycle) {
+        finish(vmName, Failed, "failed", tr("dependencia circular entre %1").arg(cycle.join(", ")));
+    }
+}
+
+void BootScheduler::schedule()
+{
+    if (m_completed) {
+        return;
+    }
+    
+    for (Entry &entry : m_entries) {
+        if (entry.status == Booting) {
+            checkReadiness(entry);
+        }
+    }
+    
+    // Los fallos se propagan a todo lo que dependa de ellos
+    bool cascaded = true;
+    while (cascaded) {
+        cascaded = false;
+        for (const Entry &entry : m_entries) {
+            QStringList pending;
+            QString failed;
+            if (entry.status == Waiting && blockers(entry, &pending, &failed) && !failed.isEmpty()) {
+                finish(entry.name, Skipped, "skipped", m_action == Start
+                       ? tr("depende de '%1', que no llegó a arrancar").arg(failed)
+                       : tr("'%1' depende de ella y no se pudo detener").arg(failed));
+                cascaded = true;
+            }
+        }
+    }
+    
+    int active = 0;
+    bool waiting = false;
+    for (const Entry &entry : m_entries) {
+        active += (entry.status == Launching || entry.status == Booting) ? 1 : 0;
+        waiting = waiting || entry.status == Waiting;
+    }
+    if (!waiting && active == 0) {
+        complete();
+        return;
+    }
+    if (!waiting || active >= m_options.maxParallel) {
+        return;
+    }
+    
+    // Sólo los arranques se espacian y se frenan por E/S: parar libera recursos
+    if (m_action == Start) {
+        if (m_lastLaunch.isValid() && m_lastLaunch.elapsed() < m_options.rampUpMs) {
+            return;
+        }
+        
+        if (m_options.maxIoPressure > 0) {
+            HostInfo::Pressure io = HostInfo::ioPressure();
+            bool throttled = io.supported && io.someAvg10 > m_options.maxIoPressure;
+            if (throttled != m_throttled) {
+                m_throttled = throttled;
+                emit progress(QString(), throttled ? "throttled" : "resumed",
+                              tr("presión de E/S %1 % (límite %2 %)").arg(io.someAvg10, 0, 'f', 1)
+                              .arg(m_options.maxIoPressure, 0, 'f', 1));
+            }
+            if (throttled) {
+                return;
+            }
+        }
+    }
+    
+    QList<int> candidates;
+    for (int i = 0; i < m_entries.size(); ++i) {
+        QStringList pending;
+        QString failed;
+        if (m_entries[i].status == Waiting && !blockers(m_entries[i], &pending, &failed)) {
+            candidates.append(i);
+        }
+    }
+    
+    // Al arrancar va antes la prioridad más alta; al parar, la más baja
+    std::stable_sort(candidates.begin(), candidates.end(), [this](int a, int b) {
+        const Entry &first = m_entries[a];
+        const Entry &second = m_entries[b];
+        if (first.priority != second.priority) {
+            return m_action == Start ? first.priority > second.priority : first.priority < second.priority;
+        }
+        return first.order < second.order;
+    });
+    
+    // Con rampa sólo sale un arranque por vuelta
+    int slots = m_options.maxParallel - active;
+    if (m_action == Start && m_options.rampUpMs > 0) {
+        slots = qMin(slots, 1);
+    }
+    for (int i = 0; i < candidates.size() && i < slots; ++i) {
+        launch(m_entries[candidates[i]]);
+    }
+}
+
+bool BootScheduler::blockers(const Entry &entry, QStringList *pending, QString *failed) const
+{
+    auto statusOf = [this](const QString &vmName, bool *inBatch) {
+        for (const Entry &other : m_entries) {
+            if (other.name == vmName) {
+                *inBatch = true;
+                return other.status;
+            }
+        }
+        *inBatch = false;
+        return Waiting;
+    };
+    
+    if (m_action == Start) {
+        // Una VM que agotó su espera está en marcha: no bloquea a las demás
+        for (const QString &dependency : entry.dependencies) {
+            bool inBatch = false;
+            Status status = statusOf(dependency, &inBatch);
+            if (!inBatch) {
+                continue;
+            }
+            if (status == Failed || status == Skipped) {
+                *failed = dependency;
+            } else if (status != Done && status != TimedOut) {
+                pending->append(dependency);
+            }
+        }
+    } else {
+        // Al parar, primero se detiene lo que depende de esta VM
+        for (const Entry &other : m_entries) {
+            if (!other.dependencies.contains(entry.name)) {
+                continue;
+            }
+            if (other.status == Failed || other.status == Skipped) {
+                *failed = other.name;
+            } else if (other.status != Done) {
+                pending->append(other.name);
+            }
+        }
+    }
+    
+    return !failed->isEmpty() || !pending->isEmpty();
+}
+
+void BootScheduler::launch(Entry &entry)
+{
+    QString vmName = entry.name;
+    entry.status = Launching;
+    entry.launchedMs = m_elapsed.elapsed();
+    m_lastLaunch.restart();
+    
+    QPointer<BootScheduler> self(this);
+    if (m_action == Start) {
+        emit progress(vmName, "starting", QString());
+        m_kvmManager->startVMAsync(vmName, [self, vmName](const VMBackend::Result &result) {
+            if (!self) {
+                return;
+            }
+            if (!result.ok) {
+                self->finish(vmName, Failed, "failed",
+                             result.error.isEmpty() ? tr("No se pudo arrancar la VM '%1'").arg(vmName) : result.error);
+                return;
+            }
+            
+            for (Entry &started : self->m_entries) {
+                if (started.name == vmName && started.status == Launching) {
+                    started.status = Booting;
+                    started.booting.start();
+                    emit self->progress(vmName, "booting", started.readiness);
+                    self->checkReadiness(started);
+                }
+            }
+        });
+    } else {
+        emit progress(vmName, "stopping", QString());
+        m_kvmManager->stopVMAsync(vmName, [self, vmName](const VMBackend::Result &result) {
+            if (!self) {
+                return;
+            }
+            if (result.ok) {
+                self->finish(vmName, Done, "stopped");
+            } else {
+                self->finish(vmName, Failed, "failed",
+                             result.error.isEmpty() ? tr("No se pudo detener la VM '%1'").arg(vmName) : result.error);
+            }
+        });
+    }
+}
+
+void BootScheduler::checkReadiness(Entry &entry)
+{
+    QemuManager *qemuManager = m_kvmManager->getQemuManager();
+    
+    if (entry.readiness == "none") {
+        finish(entry.name, Done, "ready");
+    } else if (!qemuManager->isVMRunning(entry.name)) {
+        finish(entry.name, Failed, "failed", tr("QEMU terminó antes de que la VM estuviera lista"));
+    } else if (entry.readiness == "qmp" ? qemuManager->isQmpReady(entry.name)
+                                        : qemuManager->isGuestAgentConnected(entry.name)) {
+        finish(entry.name, Done, "ready");
+    } else if (entry.booting.elapsed() > m_options.readyTimeoutSecs * 1000LL) {
+        finish(entry.name, TimedOut, "timeout",
+               tr("sin señal de disponibilidad (%1) tras %2 s").arg(entry.readiness).arg(m_options.readyTimeoutSecs));
+    }
+}
+
+void BootScheduler::finish(const QString &vmName, Status status, const QString &result, const QString &error)
+{
+    for (Entry &entry : m_entries) {
+        if (entry.name != vmName || isTerminal(entry.status)) {
+            continue;
+        }
+        
+        entry.status = status;
+        entry.result = result;
+        entry.error = error;
+        if (entry.launchedMs >= 0) {
+            entry.readyMs = m_elapsed.elapsed() - entry.launchedMs;
+        }
+        
+        QString stage = status == Done ? (m_action == Start ? "ready" : "stopped")
+                      : status == TimedOut ? "timeout"
+                      : status == Skipped ? "skipped" : "failed";
+        if (!error.isEmpty()) {
+            qWarning().noquote() << "BootScheduler:" << vmName << stage << "-" << error;
+        }
+        emit progress(vmName, stage, error);
+        break;
+    }
+    
+    // El hueco liberado se reparte fuera de la llamada que lo liberó
+    QTimer::singleShot(0, this, &BootScheduler::schedule);
+}
+
+QString BootScheduler::effectiveReadiness(VirtualMachine *vm) const
+{
+    // libvirt no expone QMP a este proceso: basta con que el backend arranque
+    if (vm->getBackend() != "qemu" || m_options.readiness == "none") {
+        return "none";
+    }
+    if (m_options.readiness == "agent" && QemuManager::hasGuestAgentChannel(vm)) {
+        return "agent";
+    }
+    return "qmp";
+}
+
+bool BootScheduler::isTerminal(Status status) const
+{
+    return status == Done || status == TimedOut || status == Failed || status == Skipped;
+}
+
+bool BootScheduler::isVMActive(const QString &vmName) const
+{
+    QString state = m_kvmManager->getVMState(vmName);
+    return state == "running" || state == "paused";
+}
+
+void BootScheduler::complete()
+{
+    m_completed = true;
+    m_timer->stop();
+    
+    QJsonArray vms;
+    int failures = 0;
+    for (const Entry &entry : m_entries) {
+        QJsonObject vm;
+        vm["name"] = entry.name;
+        vm["result"] = entry.result;
+        vm["priority"] = entry.priority;
+        if (!entry.dependencies.isEmpty()) {
+            vm["dependencies"] = QJsonArray::fromStringList(entry.dependencies);
+        }
+        if (!entry.readiness.isEmpty()) {
+            vm["readiness"] = entry.readiness;
+        }
+        if (!entry.error.isEmpty()) {
+            vm["error"] = entry.error;
+        }
+        if (entry.launchedMs >= 0) {
+            vm["launchedMs"] = entry.launchedMs;
+            vm["durationMs"] = entry.readyMs;
+        }
+        vms.append(vm);
+        failures += (entry.status == Failed || entry.status == Skipped) ? 1 : 0;
+    }
+    
+    QJsonObject summary;
+    summary["action"] = m_action == Start ? "start" : "stop";
+    summary["elapsedMs"] = m_elapsed.elapsed();
+    summary["failed"] = failures;
+    summary["vms"] = vms;
+    
+    qInfo() << "BootScheduler: terminado en" << m_elapsed.elapsed() << "ms," << failures << "fallos";
+    
+    VMBackend::Result result = failures ? VMBackend::failure(tr("%1 de %2 VMs no se completaron").arg(failures).arg(m_entries.size()))
+                                        : VMBackend::success(summary);
+    result.value = summary;
+    if (m_callback) {
+        m_callback(result);
+    }
+    deleteLater();
+}
\ No newline at end of file
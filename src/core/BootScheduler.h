@@ -0,0 +1,124 @@
+#ifndef BOOTSCHEDULER_H
+#define BOOTSCHEDULER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QList>
+#include <QJsonObject>
+#include <QElapsedTimer>
+
+#include "VMBackend.h"
+
+class QTimer;
+class KVMManager;
+class VirtualMachine;
+
+/**
+ * @brief Arranque y parada en bloque de varias VMs ("boot storm")
+ * Lanza las VMs de una en una con un límite de arranques simultáneos y un
+ * intervalo mínimo entre lanzamientos, respetando las dependencias (una VM
+ * espera a que estén listas las de su lista "arrancar después de") y la
+ * prioridad. Un arranque ocupa su hueco hasta que la VM está lista: QMP
+ * responde o, si el invitado tiene qemu-guest-agent, el agente abre su
+ * canal. Con PSI disponible, no se lanza nada mientras la presión de E/S
+ * del anfitrión supere el límite. La parada recorre las dependencias en
+ * orden inverso.
+ *
+ * Cada operación crea su propio planificador, que se destruye al terminar.
+ */
+class BootScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Action {
+        Start,
+        Stop
+    };
+    
+    // Valores por defecto en el grupo "bootScheduler" de QSettings; las
+    // dependencias y prioridades sustituyen a las guardadas en cada VM
+    struct Options {
+        int maxParallel = 4;            // arranques sin terminar a la vez
+        int rampUpMs = 2000;            // pausa mínima entre lanzamientos
+        QString readiness = "agent";    // "none", "qmp" o "agent" (QMP si no hay canal)
+        int readyTimeoutSecs = 180;     // tras ello la VM deja libre su hueco
+        double maxIoPressure = 0;       // % "some" avg10 de /proc/pressure/io; 0 = sin límite
+        QHash<QString, QStringList> dependencies;
+        QHash<QString, int> priorities; // mayor = antes
+        
+        static Options fromJson(const QJsonObject &json, const Options &defaults);
+    };
+    
+    BootScheduler(KVMManager *kvmManager, Action action, const QStringList &vmNames,
+                  const Options &options, QObject *parent = nullptr);
+    
+    static Options loadOptions();
+    static void saveOptions(const Options &options);
+    static QStringList readinessModes();
+    // "high" = 2, "normal" = 1, "low" = 0
+    static int defaultPriority(VirtualMachine *vm);
+    
+    // Termina con un resumen por VM en result.value; ok si ninguna falló.
+    // El planificador se destruye después de llamar al callback
+    void run(VMBackend::Callback callback);
+
+signals:
+    // Etapas: waiting, starting, booting, ready, stopping, stopped,
+    // timeout, failed, skipped; throttled/resumed (sin VM) por la E/S
+    void progress(const QString &vmName, const QString &stage, const QString &detail);
+
+private slots:
+    void schedule();
+
+private:
+    enum Status {
+        Waiting,
+        Launching,      // start/stop enviado al backend
+        Booting,        // arrancada, esperando la señal de disponibilidad
+        Done,
+        TimedOut,
+        Failed,
+        Skipped
+    };
+    
+    struct Entry {
+        QString name;
+        QStringList dependencies;
+        int priority = 1;
+        int order = 0;
+        Status status = Waiting;
+        QString readiness;          // señal efectiva: none, qmp, agent
+        QString result;
+        QString error;
+        qint64 launchedMs = -1;     // desde el inicio de la operación
+        qint64 readyMs = -1;
+        QElapsedTimer booting;
+    };
+    
+    void prepare();
+    void markCycles();
+    bool blockers(const Entry &entry, QStringList *pending, QString *failed) const;
+    void launch(Entry &entry);
+    void checkReadiness(Entry &entry);
+    void finish(const QString &vmName, Status status, const QString &result, const QString &error = QString());
+    QString effectiveReadiness(VirtualMachine *vm) const;
+    bool isTerminal(Status status) const;
+    bool isVMActive(const QString &vmName) const;
+    void complete();
+    
+    KVMManager *m_kvmManager;
+    Action m_action;
+    Options m_options;
+    QList<Entry> m_entries;
+    QTimer *m_timer;
+    QElapsedTimer m_elapsed;
+    QElapsedTimer m_lastLaunch;
+    bool m_throttled;
+    bool m_completed;
+    VMBackend::Callback m_callback;
+};
+
+#endif // BOOTSCHEDULER_H
\ No newline at end of file
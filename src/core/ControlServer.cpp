@@ -0,0 +1,866 @@
+#include "ControlServer.h"
+#include "KVMManager.h"
+#include "VirtualMachine.h"
+#include "MemoryPressureController.h"
+#include "AdmissionController.h"
+#include "WarmPool.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QStandardPaths>
+#include <QDir>
+#include <QTimer>
+#include <QSharedPointer>
+#include <QDebug>
+
+namespace {
+// Códigos de error JSON-RPC 2.0
+const int ParseError = -32700;
+const int InvalidRequest = -32600;
+const int MethodNotFound = -32601;
+const int InvalidParams = -32602;
+const int OperationFailed = -32000;
+
+// Tope de una línea sin terminar: quien lo supera sin enviar '\n' se desconecta
+const int MaxMessageBytes = 1024 * 1024;
+
+// done con el valor que devuelve el método si la operación sale bien
+VMBackend::Callback replyWith(const VMBackend::Callback &done, const std::function<QJsonValue()> &value)
+{
+    return [done, value](const VMBackend::Result &result) {
+        done(result.ok ? VMBackend::success(value()) : result);
+    };
+}
+}
+
+ControlServer::ControlServer(KVMManager *kvmManager, QObject *parent)
+    : QObject(parent)
+    , m_kvmManager(kvmManager)
+    , m_server(new QLocalServer(this))
+    , m_processingScheduled(false)
+    , m_callErrorCode(0)
+    , m_inCall(false)
+{
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(m_server, &QLocalServer::newConnection, this, &ControlServer::onNewConnection);
+    
+    // Los errores emitidos durante una llamada se devuelven en su respuesta
+    connect(m_kvmManager, &KVMManager::errorOccurred, this, [this](const QString &error) {
+        if (m_inCall) {
+            m_callErrors.append(error);
+        }
+    });
+    
+    // Notificaciones enviadas a todos los clientes conectados
+    connect(m_kvmManager, &KVMManager::vmStateChanged, this, [this](const QString &name, const QString &state) {
+        QJsonObject params;
+        params["name"] = name;
+        params["state"] = state;
+        broadcastNotification("vmStateChanged", params);
+    });
+    connect(m_kvmManager, &KVMManager::vmCreated, this, [this](const QString &name) {
+        QJsonObject params;
+        params["name"] = name;
+        broadcastNotification("vmCreated", params);
+    });
+    connect(m_kvmManager, &KVMManager::vmDeleted, this, [this](const QString &name) {
+        QJsonObject params;
+        params["name"] = name;
+        broadcastNotification("vmDeleted", params);
+    });
+    connect(m_kvmManager->getAdmissionController(), &AdmissionController::vmQueued, this,
+            [this](const QString &name, const QString &reason) {
+        QJsonObject params;
+        params["name"] = name;
+        params["reason"] = reason;
+        broadcastNotification("vmQueued", params);
+    });
+    connect(m_kvmManager->getAdmissionController(), &AdmissionController::warning, this, [this](const QString &message) {
+        QJsonObject params;
+        params["message"] = message;
+        broadcastNotification("admissionWarning", params);
+    });
+    connect(m_kvmManager, &KVMManager::bulkProgress, this,
+            [this](const QString &name, const QString &stage, const QString &detail) {
+        QJsonObject params;
+        params["name"] = name;
+        params["stage"] = stage;
+        if (!detail.isEmpty()) {
+            params["detail"] = detail;
+        }
+        broadcastNotification("bulkProgress", params);
+    });
+    connect(m_kvmManager, &KVMManager::jobProgress, this,
+            [this](const QString &name, const QString &job, int percent) {
+        QJsonObject params;
+        params["name"] = name;
+        params["job"] = job;
+        params["percent"] = percent;
+        broadcastNotification("jobProgress", params);
+    });
+    
+    connect(m_kvmManager, &KVMManager::chainDepthWarning, this,
+            [this](const QString &name, const QString &disk, int depth) {
+        QJsonObject params;
+        params["name"] = name;
+        params["disk"] = disk;
+        params["depth"] = depth;
+        broadcastNotification("chainDepthWarning", params);
+    });
+    
+    connect(m_kvmManager->getWarmPool(), &WarmPool::instanceReady, this,
+            [this](const QString &templateName, const QString &name) {
+        QJsonObject params;
+        params["template"] = templateName;
+        params["name"] = name;
+        broadcastNotification("poolInstanceReady", params);
+    });
+    connect(m_kvmManager->getWarmPool(), &WarmPool::instanceFailed, this,
+            [this](const QString &templateName, const QString &name, const QString &error) {
+        QJsonObject params;
+        params["template"] = templateName;
+        params["name"] = name;
+        params["error"] = error;
+        broadcastNotification("poolInstanceFailed", params);
+    });
+    
+    registerMethods();
+}
+
+ControlServer::~ControlServer()
+{
+    close();
+}
+
+QString ControlServer::defaultSocketPath()
+{
+    QString runtimeDir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (runtimeDir.isEmpty()) {
+        runtimeDir = QDir::homePath() + "/.VM";
+    }
+    return runtimeDir + "/kvm-manager.sock";
+}
+
+void ControlServer::setMemoryPressureController(MemoryPressureController *controller)
+{
+    m_methods["host.memoryPressure"] = [controller](const QJsonObject &) -> QJsonValue {
+        return controller->status();
+    };
+    
+    connect(controller, &MemoryPressureController::decisionMade, this, [this](const QString &message) {
+        QJsonObject params;
+        params["message"] = message;
+        broadcastNotification("memoryPressureDecision", params);
+    });
+}
+
+bool ControlServer::listen(const QString &socketPath)
+{
+    QString path = socketPath.isEmpty() ? defaultSocketPath() : socketPath;
+    
+    if (m_server->listen(path)) {
+        qDebug() << "ControlServer: Escuchando en" << path;
+        return true;
+    }
+    
+    // Si el socket existe pero nadie responde, es un resto de una ejecución anterior
+    if (m_server->serverError() == QAbstractSocket::AddressInUseError) {
+        QLocalSocket probe;
+        probe.connectToServer(path);
+        if (probe.waitForConnected(500)) {
+            emit errorOccurred(tr("Ya hay otra instancia escuchando en %1").arg(path));
+            return false;
+        }
+        
+        QLocalServer::removeServer(path);
+        if (m_server->listen(path)) {
+            qDebug() << "ControlServer: Escuchando en" << path << "(socket anterior eliminado)";
+            return true;
+        }
+    }
+    
+    emit errorOccurred(tr("No se pudo abrir el socket de control %1: %2").arg(path, m_server->errorString()));
+    return false;
+}
+
+void ControlServer::close()
+{
+    for (QLocalSocket *client : m_clients) {
+        client->disconnect(this);
+        client->abort();
+        client->deleteLater();
+    }
+    m_clients.clear();
+    m_buffers.clear();
+    m_jobs.clear();
+    
+    if (m_server->isListening()) {
+        m_server->close();
+    }
+}
+
+bool ControlServer::isListening() const
+{
+    return m_server->isListening();
+}
+
+QString ControlServer::socketPath() const
+{
+    return m_server->fullServerName();
+}
+
+void ControlServer::onNewConnection()
+{
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        m_clients.append(socket);
+        connect(socket, &QLocalSocket::readyRead, this, &ControlServer::onReadyRead);
+        connect(socket, &QLocalSocket::disconnected, this, &ControlServer::onClientDisconnected);
+    }
+}
+
+void ControlServer::onReadyRead()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket*>(sender());
+    if (!socket) return;
+    
+    QByteArray &buffer = m_buffers[socket];
+    buffer.append(socket->readAll());
+    
+    // Un mensaje por línea
+    int newline;
+    while ((newline = buffer.indexOf('\n')) >= 0) {
+        QByteArray line = buffer.left(newline).trimmed();
+        buffer.remove(0, newline + 1);
+        if (!line.isEmpty()) {
+            handleMessage(socket, line);
+        }
+    }
+    
+    if (buffer.size() > MaxMessageBytes) {
+        qWarning() << "ControlServer: mensaje de más de" << MaxMessageBytes << "bytes sin terminar; se cierra la conexión";
+        m_buffers.remove(socket);
+        sendJson(socket, makeError(QJsonValue::Null, InvalidRequest,
+                                   tr("Mensaje demasiado grande (máximo %1 bytes por línea)").arg(MaxMessageBytes)));
+        disconnect(socket, &QLocalSocket::readyRead, this, &ControlServer::onReadyRead);
+        socket->disconnectFromServer();
+    }
+}
+
+void ControlServer::onClientDisconnected()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket*>(sender());
+    if (!socket) return;
+    
+    m_clients.removeAll(socket);
+    m_buffers.remove(socket);
+    socket->deleteLater();
+}
+
+void ControlServer::handleMessage(QLocalSocket *socket, const QByteArray &line)
+{
+    QJsonParseError parseError;
+    QJsonDocument doc = QJsonDocument::fromJson(line, &parseError);
+    if (parseError.error != QJsonParseError::NoError) {
+        sendJson(socket, makeError(QJsonValue::Null, ParseError, parseError.errorString()));
+        return;
+    }
+    
+    Job job;
+    job.socket = socket;
+    job.received.start();
+    
+    if (doc.isArray()) {
+        job.isBatch = true;
+        job.requests = doc.array();
+        if (job.requests.isEmpty()) {
+            sendJson(socket, makeError(QJsonValue::Null, InvalidRequest, tr("Lote vacío")));
+            return;
+        }
+    } else {
+        job.requests.append(doc.object());
+    }
+    
+    m_jobs.enqueue(job);
+    scheduleProcessing();
+}
+
+void ControlServer::scheduleProcessing()
+{
+    // Los métodos síncronos que esperan en un bucle de eventos anidado no
+    // admiten otra petición hasta que terminan
+    if (!m_processingScheduled && !m_inCall && !m_jobs.isEmpty()) {
+        m_processingScheduled = true;
+        QTimer::singleShot(0, this, &ControlServer::processNextRequest);
+    }
+}
+
+void ControlServer::processNextRequest()
+{
+    m_processingScheduled = false;
+    if (m_jobs.isEmpty()) return;
+    
+    // El mensaje sale de la cola mientras se ejecuta su petición; un lote
+    // vuelve al frente para la siguiente cuando llega la respuesta
+    Job job = m_jobs.dequeue();
+    
+    // El cliente se desconectó: descartar el resto del mensaje
+    if (job.socket.isNull()) {
+        scheduleProcessing();
+        return;
+    }
+    
+    QJsonValue request = job.requests.at(job.index);
+    qint64 queuedUs = job.received.nsecsElapsed() / 1000;
+    
+    executeRequest(request, queuedUs, [this, job](const QJsonObject &response, bool isNotification) mutable {
+        if (!isNotification) {
+            job.responses.append(response);
+        }
+        job.index++;
+        
+        if (job.index < job.requests.size()) {
+            m_jobs.prepend(job);
+        } else if (!job.responses.isEmpty() && !job.socket.isNull()) {
+            if (job.isBatch) {
+                sendJson(job.socket, job.responses);
+            } else {
+                sendJson(job.socket, job.responses.first());
+            }
+        }
+        
+        // Devolver el control al bucle de eventos entre peticiones
+        scheduleProcessing();
+    });
+}
+
+void ControlServer::executeRequest(const QJsonValue &request, qint64 queuedUs, const Reply &reply)
+{
+    if (!request.isObject()) {
+        reply(makeError(QJsonValue::Null, InvalidRequest, tr("La petición debe ser un objeto")), false);
+        return;
+    }
+    
+    QJsonObject object = request.toObject();
+    QJsonValue id = object.value("id");
+    bool isNotification = !object.contains("id");
+    
+    if (object.value("jsonrpc").toString() != "2.0" || !object.value("method").isString()) {
+        reply(makeError(id, InvalidRequest, tr("Petición JSON-RPC 2.0 no válida")), isNotification);
+        return;
+    }
+    
+    QString methodName = object.value("method").toString();
+    auto method = m_methods.constFind(methodName);
+    auto asyncMethod = m_asyncMethods.constFind(methodName);
+    if (method == m_methods.constEnd() && asyncMethod == m_asyncMethods.constEnd()) {
+        reply(makeError(id, MethodNotFound, tr("Método desconocido: %1").arg(methodName)), isNotification);
+        return;
+    }
+    
+    QJsonValue params = object.value("params");
+    if (!params.isUndefined() && !params.isObject()) {
+        reply(makeError(id, InvalidParams, tr("Los parámetros deben ser un objeto")), isNotification);
+        return;
+    }
+    
+    m_callErrorCode = 0;
+    m_callErrorMessage.clear();
+    m_callErrors.clear();
+    m_inCall = true;
+    
+    QElapsedTimer timer;
+    timer.start();
+    
+    // Extensión: latencia medida en el servidor
+    auto finish = [timer, queuedUs, isNotification, reply](QJsonObject response) {
+        response["latencyUs"] = timer.nsecsElapsed() / 1000;
+        response["queuedUs"] = queuedUs;
+        reply(response, isNotification);
+    };
+    
+    if (method != m_methods.constEnd()) {
+        QJsonValue result = (*method)(params.toObject());
+        m_inCall = false;
+        finish(callResponse(id, result));
+        return;
+    }
+    
+    // Si done llega durante la llamada (parámetros que faltan, VM
+    // desconocida...) valen los errores recogidos; si llega después, sólo
+    // el del resultado, pues puede haber otra llamada en curso
+    QPointer<ControlServer> self(this);
+    auto returned = QSharedPointer<bool>::create(false);
+    (*asyncMethod)(params.toObject(), [self, returned, id, finish](const VMBackend::Result &result) {
+        if (!self) return;
+        if (!*returned) {
+            if (!result.ok && self->m_callErrorCode == 0 && !result.error.isEmpty()) {
+                self->setCallError(OperationFailed, result.error);
+            }
+            finish(self->callResponse(id, self->operationResult(result.ok, result.value)));
+        } else if (result.ok) {
+            finish(makeResult(id, result.value));
+        } else {
+            finish(makeError(id, OperationFailed, result.error.isEmpty() ? tr("La operación falló") : result.error));
+        }
+    });
+    *returned = true;
+    m_inCall = false;
+    scheduleProcessing();
+}
+
+QJsonObject ControlServer::callResponse(const QJsonValue &id, const QJsonValue &result) const
+{
+    if (m_callErrorCode == 0) {
+        return makeResult(id, result);
+    }
+    
+    QJsonObject response = makeError(id, m_callErrorCode, m_callErrorMessage);
+    if (!m_callErrors.isEmpty()) {
+        QJsonObject error = response["error"].toObject();
+        error["data"] = QJsonArray::fromStringList(m_callErrors);
+        response["error"] = error;
+    }
+    return response;
+}
+
+void ControlServer::sendJson(QLocalSocket *socket, const QJsonValue &message)
+{
+    if (!socket || socket->state() != QLocalSocket::ConnectedState) return;
+    
+    QJsonDocument doc = message.isArray() ? QJsonDocument(message.toArray())
+                                          : QJsonDocument(message.toObject());
+    socket->write(doc.toJson(QJsonDocument::Compact));
+    socket->write("\n");
+}
+
+void ControlServer::broadcastNotification(const QString &method, const QJsonObject &params)
+{
+    QJsonObject notification;
+    notification["jsonrpc"] = "2.0";
+    notification["method"] = method;
+    notification["params"] = params;
+    
+    for (QLocalSocket *client : m_clients) {
+        sendJson(client, notification);
+    }
+}
+
+QJsonObject ControlServer::makeResult(const QJsonValue &id, const QJsonValue &result)
+{
+    QJsonObject response;
+    response["jsonrpc"] = "2.0";
+    response["id"] = id;
+    response["result"] = result;
+    return response;
+}
+
+QJsonObject ControlServer::makeError(const QJsonValue &id, int code, const QString &message)
+{
+    QJsonObject error;
+    error["code"] = code;
+    error["message"] = message;
+    
+    QJsonObject response;
+    response["jsonrpc"] = "2.0";
+    response["id"] = id.isUndefined() ? QJsonValue(QJsonValue::Null) : id;
+    response["error"] = error;
+    return response;
+}
+
+QString ControlServer::requireString(const QJsonObject &params, const QString &key)
+{
+    QString value = params.value(key).toString();
+    if (value.isEmpty() && m_callErrorCode == 0) {
+        setCallError(InvalidParams, tr("Falta el parámetro '%1'").arg(key));
+    }
+    return value;
+}
+
+QJsonValue ControlServer::operationResult(bool ok, const QJsonValue &result)
+{
+    if (!ok && m_callErrorCode == 0) {
+        setCallError(OperationFailed, m_callErrors.isEmpty() ? tr("La operación falló")
+                                                             : m_callErrors.last());
+    }
+    return ok ? result : QJsonValue();
+}
+
+void ControlServer::setCallError(int code, const QString &message)
+{
+    m_callErrorCode = code;
+    m_callErrorMessage = message;
+}
+
+void ControlServer::registerMethods()
+{
+    // Consultas
+    m_methods["vm.list"] = [this](const QJsonObject &) -> QJsonValue {
+        QJsonArray vms;
+        for (const QString &name : m_kvmManager->getVirtualMachines()) {
+            if (VirtualMachine *vm = m_kvmManager->getVirtualMachine(name)) {
+                vms.append(vm->toJson());
+            }
+        }
+        return vms;
+    };
+    
+    m_methods["vm.info"] = [this](const QJsonObject &params) -> QJsonValue {
+        QString name = requireString(params, "name");
+        if (m_callErrorCode) return QJsonValue();
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(name);
+        if (!vm) {
+            setCallError(OperationFailed, tr("Máquina virtual '%1' no encontrada").arg(name));
+            return QJsonValue();
+        }
+        return vm->toJson();
+    };
+    
+    m_methods["vm.state"] = [this](const QJsonObject &params) -> QJsonValue {
+        QString name = requireString(params, "name");
+        if (m_callErrorCode) return QJsonValue();
+        return m_kvmManager->getVMState(name);
+    };
+    
+    m_asyncMethods["vm.stats"] = [this](const QJsonObject &params, VMBackend::Callback done) {
+        QString name = requireString(params, "name");
+        if (m_callErrorCode) return done(VMBackend::failure());
+        m_kvmManager->queryVMStats(name, done);
+    };
+    
+    m_asyncMethods["vm.balloon"] = [this](const QJsonObject &params, VMBackend::Callback done) {
+        QString name = requireString(params, "name");
+        if (m_callErrorCode) return done(VMBackend::failure());
+        if (!params.value("targetMB").isDouble()) {
+            setCallError(InvalidParams, tr("Falta el parámetro numérico 'targetMB'"));
+            return done(VMBackend::failure());
+        }
+        qint64 targetMB = params.value("targetMB").toInteger();
+        m_kvmManager->setBalloonTargetAsync(name, targetMB, replyWith(done, [targetMB]() {
+            return QJsonValue(targetMB);
+        }));
+    };
+    
+    // Ciclo de vida; qemu-img crea el disco sin detener al servidor
+    m_asyncMethods["vm.create"] = [this](const QJsonObject &params, VMBackend::Callback done) {
+        QString name = requireString(params, "name");
+        if (m_callErrorCode) return done(VMBackend::failure());
+        m_kvmManager->createVirtualMachineAsync(name,
+                                                params.value("osType").toString("Linux"),
+                                                params.value("memoryMB").toInt(2048),
+                                                params.value("diskSizeGB").toInt(20),
+                                                replyWith(done, [this, name]() {
+            VirtualMachine *vm = m_kvmManager->getVirtualMachine(name);
+            return vm ? QJsonValue(vm->toJson()) : QJsonValue(name);
+        }));
+    };
+    
+    // "snapshot" opcional: copiar los discos tal como estaban en esa instantánea
+    m_asyncMethods["vm.clone"] = [this](const QJsonObject &params, VMBackend::Callback done) {
+        QString source = requireString(params, "source");
+        QString target = requireString(params, "target");
+        if (m_callErrorCode) return done(VMBackend::failure());
+        m_kvmManager->cloneVirtualMachineAsync(source, target, params.value("snapshot").toString(), done);
+    };
+    
+    // Sólo borra ficheros, sin esperar a ningún proceso
+    m_asyncMethods["vm.delete"] = [this](const QJsonObject &params, VMBackend::Callback done) {
+        QString name = requireString(params, "name");
+        if (m_callErrorCode) return done(VMBackend::failure());
+        done(m_kvmManager->deleteVirtualMachine(name) ? VMBackend::success(name) : VMBackend::failure());
+    };
+    
+    m_methods["vm.set"] = [this](const QJsonObject &params) -> QJsonValue {
+        QString name = requireString(params, "name");
+        QString key = requireString(params, "key");
+        if (m_callErrorCode) return QJsonValue();
+        // Admite valores numéricos además de cadenas
+        QString value = params.value("value").toVariant().toString();
+        bool ok = m_kvmManager->setVMOption(name, key, value);
+        VirtualMachine *vm = ok ? m_kvmManager->getVirtualMachine(name) : nullptr;
+        return operationResult(ok, vm ? QJsonValue(vm->toJson()) : QJsonValue(name));
+    };
+    
+    // Control
+    using Control = std::function<void(const QString &, VMBackend::Callback)>;
+    const QHash<QString, Control> controls = {
+        {"vm.start",  [this](const QString &name, VMBackend::Callback done) { m_kvmManager->startVMAsync(name, done); }},
+        {"vm.stop",   [this](const QString &name, VMBackend::Callback done) { m_kvmManager->stopVMAsync(name, done); }},
+        {"vm.pause",  [this](const QString &name, VMBackend::Callback done) { m_kvmManager->pauseVMAsync(name, done); }},
+        {"vm.resume", [this](const QString &name, VMBackend::Callback done) { m_kvmManager->resumeVMAsync(name, done); }},
+        {"vm.reset",  [this](const QString &name, VMBackend::Callback done) { m_kvmManager->resetVMAsync(name, done); }},
+        {"vm.save",   [this](const QString &name, VMBackend::Callback done) { m_kvmManager->saveVMStateAsync(name, done); }}
+    };
+    for (auto it = controls.constBegin(); it != controls.constEnd(); ++it) {
+        Control control = it.value();
+        m_asyncMethods[it.key()] = [this, control](const QJsonObject &params, VMBackend::Callback done) {
+            QString name = requireString(params, "name");
+            if (m_callErrorCode) return done(VMBackend::failure());
+            control(name, replyWith(done, [this, name]() {
+                return QJsonValue(m_kvmManager->getVMState(name));
+            }));
+        };
+    }
+    
+    // Arranque/parada en bloque: {"names": [...], "maxParallel": 4, "rampUpMs": 2000,
+    // "readiness": "agent", "dependencies": {...}, "priorities": {...}}. Devuelve
+    // el resumen por VM aunque alguna falle; el progreso llega como bulkProgress
+    using Bulk = std::function<void(const QStringList &, const BootScheduler::Options &, VMBackend::Callback)>;
+    const QHash<QString, Bulk> bulk = {
+        {"vm.startMany", [this](const QStringList &names, const BootScheduler::Options &options, VMBackend::Callback done) {
+            m_kvmManager->startVMsAsync(names, options, done);
+        }},
+        {"vm.stopMany", [this](const QStringList &names, const BootScheduler::Options &options, VMBackend::Callback done) {
+            m_kvmManager->stopVMsAsync(names, options, done);
+        }}
+    };
+    for (auto it = bulk.constBegin(); it != bulk.constEnd(); ++it) {
+        Bulk operation = it.value();
+        m_asyncMethods[it.key()] = [this, operation](const QJsonObject &params, VMBackend::Callback done) {
+            QStringList names;
+            for (const QJsonValue &value : params.value("names").toArray()) {
+                names.append(value.toString());
+            }
+            if (names.isEmpty()) {
+                setCallError(InvalidParams, tr("Falta el parámetro 'names' (lista de VMs)"));
+                return done(VMBackend::failure());
+            }
+            BootScheduler::Options options = BootScheduler::Options::fromJson(params, BootScheduler::loadOptions());
+            operation(names, options, [done](const VMBackend::Result &result) {
+                QJsonObject summary = result.value.toObject();
+                done(summary.isEmpty() ? result : VMBackend::success(summary));
+            });
+        };
+    }
+    
+    // Rendimiento del último guardado y la última restauración a disco
+    m_methods["vm.saveStats"] = [this](const QJsonObject &params) -> QJsonValue {
+        QString name = requireString(params, "name");
+        if (m_callErrorCode) return QJsonValue();
+        return m_kvmManager->getSaveStateStats(name);
+    };
+    
+    // Instantáneas
+    m_asyncMethods["snapshot.list"] = [this](const QJsonObject &params, VMBackend::Callback done) {
+        QString name = requireString(params, "name");
+        if (m_callErrorCode) return done(VMBackend::failure());
+        m_kvmManager->querySnapshotTree(name, [done](const VMBackend::Result &result) {
+            if (!result.ok) return done(result);
+            QJsonArray tags;
+            for (const QJsonValue &snapshot : result.value.toArray()) {
+                tags.append(snapshot.toObject().value("name"));
+            }
+            done(VMBackend::success(tags));
+        });
+    };
+    
+    // Árbol con padre, descripción y datos de la imagen; el avance de las
+    // operaciones llega como notificación jobProgress
+    m_asyncMethods["snapshot.tree"] = [this](const QJsonObject &params, VMBackend::Callback done) {
+        QString name = requireString(params, "name");
+        if (m_callErrorCode) return done(VMBackend::failure());
+        m_kvmManager->querySnapshotTree(name, done);
+    };
+    
+    using SnapshotOperation = std::function<void(const QString &, const QString &, const QJsonObject &, VMBackend::Callback)>;
+    const QHash<QString, SnapshotOperation> snapshots = {
+        {"snapshot.create", [this](const QString &name, const QString &tag, const QJsonObject &params, VMBackend::Callback done) {
+            m_kvmManager->createSnapshotAsync(name, tag, params.value("description").toString(), done);
+        }},
+        {"snapshot.delete", [this](const QString &name, const QString &tag, const QJsonObject &, VMBackend::Callback done) {
+            m_kvmManager->deleteSnapshotAsync(name, tag, done);
+        }},
+        {"snapshot.revert", [this](const QString &name, const QString &tag, const QJsonObject &, VMBackend::Callback done) {
+            m_kvmManager->revertSnapshotAsync(name, tag, done);
+        }},
+        {"snapshot.external", [this](const QString &name, const QString &tag, const QJsonObject &, VMBackend::Callback done) {
+            m_kvmManager->createExternalSnapshotAsync(name, tag, done);
+        }}
+    };
+    for (auto it = snapshots.constBegin(); it != snapshots.constEnd(); ++it) {
+        SnapshotOperation operation = it.value();
+        m_asyncMethods[it.key()] = [this, operation](const QJsonObject &params, VMBackend::Callback done) {
+            QString name = requireString(params, "name");
+            QString tag = requireString(params, "tag");
+            if (m_callErrorCode) return done(VMBackend::failure());
+            operation(name, tag, params, replyWith(done, [tag]() { return QJsonValue(tag); }));
+        };
+    }
+    
+    // Cadenas de capas externas: commit las vuelca en la base, stream deja
+    // independiente la capa superior
+    m_methods["snapshot.chain"] = [this](const QJsonObject &params) -> QJsonValue {
+        QString name = requireString(params, "name");
+        if (m_callErrorCode) return QJsonValue();
+        return m_kvmManager->getDiskChains(name);
+    };
+    
+    for (const QString &mode : {QString("commit"), QString("stream")}) {
+        m_asyncMethods["snapshot." + mode] = [this, mode](const QJsonObject &params, VMBackend::Callback done) {
+            QString name = requireString(params, "name");
+            QString disk = requireString(params, "disk");
+            if (m_callErrorCode) return done(VMBackend::failure());
+            m_kvmManager->mergeDiskChainAsync(name, disk, mode, replyWith(done, [disk]() { return QJsonValue(disk); }));
+        };
+    }
+    
+    // Puntos de control para devolver una VM de pruebas a un estado conocido
+    m_methods["checkpoint.list"] = [this](const QJsonObject &params) -> QJsonValue {
+        QString name = requireString(params, "name");
+        if (m_callErrorCode) return QJsonValue();
+        return m_kvmManager->getCheckpoints(name);
+    };
+    
+    m_asyncMethods["checkpoint.create"] = [this](const QJsonObject &params, VMBackend::Callback done) {
+        QString name = requireString(params, "name");
+        QString checkpoint = requireString(params, "checkpoint");
+        if (m_callErrorCode) return done(VMBackend::failure());
+        m_kvmManager->createCheckpointAsync(name, checkpoint, done);
+    };
+    
+    // Devuelve {checkpoint, memory, overlays, msecs}; con memoria, la VM ya está en marcha
+    m_asyncMethods["checkpoint.reset"] = [this](const QJsonObject &params, VMBackend::Callback done) {
+        QString name = requireString(params, "name");
+        QString checkpoint = requireString(params, "checkpoint");
+        if (m_callErrorCode) return done(VMBackend::failure());
+        m_kvmManager->resetToCheckpointAsync(name, checkpoint, done);
+    };
+    
+    m_asyncMethods["checkpoint.delete"] = [this](const QJsonObject &params, VMBackend::Callback done) {
+        QString name = requireString(params, "name");
+        QString checkpoint = requireString(params, "checkpoint");
+        if (m_callErrorCode) return done(VMBackend::failure());
+        m_kvmManager->deleteCheckpointAsync(name, checkpoint, replyWith(done, [checkpoint]() {
+            return QJsonValue(checkpoint);
+        }));
+    };
+    
+    // Clones en caliente de una VM en marcha, {"name", "count", "prefix"}:
+    // {source, checkpoint, created, failed, captureMsecs, msecs}
+    m_asyncMethods["vm.fork"] = [this](const QJsonObject &params, VMBackend::Callback done) {
+        QString name = requireString(params, "name");
+        if (m_callErrorCode) return done(VMBackend::failure());
+        m_kvmManager->forkVMAsync(name, params.value("count").toInt(1), params.value("prefix").toString(), done);
+    };
+    
+    // Grupos de VMs: {grupo: [miembros]}
+    m_methods["group.list"] = [this](const QJsonObject &) -> QJsonValue {
+        QJsonObject groups;
+        for (const QString &group : m_kvmManager->getGroups()) {
+            groups[group] = QJsonArray::fromStringList(m_kvmManager->getGroupMembers(group));
+        }
+        return groups;
+    };
+    
+    // {"name": "...", "group": "..."}; sin grupo la VM sale del suyo
+    m_methods["group.set"] = [this](const QJsonObject &params) -> QJsonValue {
+        QString name = requireString(params, "name");
+        if (m_callErrorCode) return QJsonValue();
+        bool ok = m_kvmManager->setVMGroup(name, params.value("group").toString());
+        VirtualMachine *vm = ok ? m_kvmManager->getVirtualMachine(name) : nullptr;
+        return operationResult(ok, vm ? QJsonValue(vm->toJson()) : QJsonValue(name));
+    };
+    
+    // {group, tag, members, quiesced, rolledBack, pauseMsecs, pauseSpreadMsecs, msecs}
+    m_asyncMethods["group.snapshot"] = [this](const QJsonObject &params, VMBackend::Callback done) {
+        QString group = requireString(params, "group");
+        QString tag = requireString(params, "tag");
+        if (m_callErrorCode) return done(VMBackend::failure());
+        m_kvmManager->createGroupSnapshotAsync(group, tag, done);
+    };
+    
+    // Plantillas: discos base de sólo lectura para crear VMs como clones enlazados
+    m_methods["template.list"] = [this](const QJsonObject &) -> QJsonValue {
+        return QJsonArray::fromStringList(m_kvmManager->getTemplates());
+    };
+    
+    // {"name": "...", "template": true|false}
+    m_methods["template.set"] = [this](const QJsonObject &params) -> QJsonValue {
+        QString name = requireString(params, "name");
+        if (m_callErrorCode) return QJsonValue();
+        bool ok = m_kvmManager->setVMTemplate(name, params.value("template").toBool(true));
+        VirtualMachine *vm = ok ? m_kvmManager->getVirtualMachine(name) : nullptr;
+        return operationResult(ok, vm ? QJsonValue(vm->toJson()) : QJsonValue(name));
+    };
+    
+    // Con "name" crea esa VM; con "count" (y "prefix" opcional), una tanda:
+    // {template, created, failed, msecs}
+    m_asyncMethods["template.create"] = [this](const QJsonObject &params, VMBackend::Callback done) {
+        QString templateName = requireString(params, "template");
+        if (m_callErrorCode) return done(VMBackend::failure());
+        if (params.contains("count")) {
+            m_kvmManager->createVMsFromTemplateAsync(templateName, params.value("prefix").toString(),
+                                                     params.value("count").toInt(), done);
+            return;
+        }
+        QString name = requireString(params, "name");
+        if (m_callErrorCode) return done(VMBackend::failure());
+        m_kvmManager->createVMFromTemplateAsync(templateName, name, replyWith(done, [this, name]() {
+            VirtualMachine *vm = m_kvmManager->getVirtualMachine(name);
+            return vm ? QJsonValue(vm->toJson()) : QJsonValue(name);
+        }));
+    };
+    
+    // Reserva de instancias en espera por plantilla
+    m_methods["pool.status"] = [this](const QJsonObject &) -> QJsonValue {
+        return m_kvmManager->getWarmPool()->status();
+    };
+    
+    // {"template": "...", "size": 2, "park": "saved"|"paused"}; size 0 la vacía
+    m_methods["pool.set"] = [this](const QJsonObject &params) -> QJsonValue {
+        QString templateName = requireString(params, "template");
+        if (m_callErrorCode) return QJsonValue();
+        if (!m_kvmManager->getVirtualMachine(templateName)) {
+            setCallError(InvalidParams, tr("La plantilla '%1' no existe").arg(templateName));
+            return QJsonValue();
+        }
+        m_kvmManager->getWarmPool()->setPool(templateName, params.value("size").toInt(),
+                                             params.value("park").toString());
+        return m_kvmManager->getWarmPool()->status();
+    };
+    
+    // Entrega una instancia lista (o arranca un clon en frío): {name, warm, from, msecs}
+    m_asyncMethods["pool.acquire"] = [this](const QJsonObject &params, VMBackend::Callback done) {
+        QString templateName = requireString(params, "template");
+        if (m_callErrorCode) return done(VMBackend::failure());
+        m_kvmManager->acquireWarmVMAsync(templateName, done);
+    };
+    
+    // libvirt
+    m_asyncMethods["libvirt.sync"] = [this](const QJsonObject &params, VMBackend::Callback done) {
+        m_kvmManager->syncLibvirtDomainsAsync(params.value("full").toBool(), done);
+    };
+    
+    // Sistema
+    m_methods["system.info"] = [this](const QJsonObject &) -> QJsonValue {
+        QJsonObject info;
+        info["kvmAvailable"] = m_kvmManager->isKVMAvailable();
+        info["libvirtRunning"] = m_kvmManager->isLibvirtRunning();
+        info["backends"] = QJsonArray::fromStringList(m_kvmManager->getBackendIds());
+        info["vmCount"] = m_kvmManager->getVirtualMachines().size();
+        return info;
+    };
+    
+    m_methods["host.admission"] = [this](const QJsonObject &) -> QJsonValue {
+        return m_kvmManager->getAdmissionController()->status();
+    };
+    
+    m_methods["host.ksm"] = [this](const QJsonObject &) -> QJsonValue {
+        return m_kvmManager->getKsmStatus();
+    };
+    
+    // Los parámetros que faltan se dejan como están
+    m_methods["host.ksm.set"] = [this](const QJsonObject &params) -> QJsonValue {
+        bool ok = m_kvmManager->setKsm(params.value("run").toInt(-1),
+                                       params.value("pagesToScan").toInt(-1),
+                                       params.value("sleepMillisecs").toInt(-1));
+        return operationResult(ok, m_kvmManager->getKsmStatus());
+    };
+    
+    m_methods["rpc.methods"] = [this](const QJsonObject &) -> QJsonValue {
+        QStringList names = m_methods.keys() + m_asyncMethods.keys();
+        names.sort();
+        return QJsonArray::fromStringList(names);
+    };
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+#ifndef CONTROLSERVER_H
+#define CONTROLSERVER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QQueue>
+#include <QPointer>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonValue>
+#include <QElapsedTimer>
+#include <functional>
+
+#include "VMBackend.h"
+
+class QLocalServer;
+class QLocalSocket;
+class KVMManager;
+class MemoryPressureController;
+
+/**
+ * @brief Servidor JSON-RPC 2.0 sobre un socket Unix local
+ * Expone las operaciones de KVMManager a scripts externos. Cada mensaje es
+ * una línea JSON (petición individual o lote); las peticiones se ejecutan
+ * una por iteración del bucle de eventos para no bloquear la interfaz. Las
+ * operaciones largas responden al terminar sin detener a las demás; las
+ * peticiones de un mismo lote se ejecutan en orden.
+ */
+class ControlServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ControlServer(KVMManager *kvmManager, QObject *parent = nullptr);
+    ~ControlServer();
+    
+    bool listen(const QString &socketPath = QString());
+    void close();
+    bool isListening() const;
+    QString socketPath() const;
+    
+    static QString defaultSocketPath();
+    
+    // Publica el estado del controlador en "host.memoryPressure"
+    void setMemoryPressureController(MemoryPressureController *controller);
+
+signals:
+    void errorOccurred(const QString &error);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onClientDisconnected();
+    void processNextRequest();
+
+private:
+    using Method = std::function<QJsonValue(const QJsonObject &params)>;
+    // Llama a done exactamente una vez, ahora o cuando termine la operación
+    using AsyncMethod = std::function<void(const QJsonObject &params, VMBackend::Callback done)>;
+    using Reply = std::function<void(const QJsonObject &response, bool isNotification)>;
+    
+    // Mensaje recibido pendiente de procesar (petición o lote)
+    struct Job {
+        QPointer<QLocalSocket> socket;
+        QJsonArray requests;
+        QJsonArray responses;
+        int index = 0;
+        bool isBatch = false;
+        QElapsedTimer received;
+    };
+    
+    void registerMethods();
+    void handleMessage(QLocalSocket *socket, const QByteArray &line);
+    void executeRequest(const QJsonValue &request, qint64 queuedUs, const Reply &reply);
+    QJsonObject callResponse(const QJsonValue &id, const QJsonValue &result) const;
+    void scheduleProcessing();
+    void sendJson(QLocalSocket *socket, const QJsonValue &message);
+    void broadcastNotification(const QString &method, const QJsonObject &params);
+    
+    // Utilidades para los métodos
+    QString requireString(const QJsonObject &params, const QString &key);
+    QJsonValue operationResult(bool ok, const QJsonValue &result);
+    void setCallError(int code, const QString &message);
+    
+    static QJsonObject makeResult(const QJsonValue &id, const QJsonValue &result);
+    static QJsonObject makeError(const QJsonValue &id, int code, const QString &message);
+    
+    KVMManager *m_kvmManager;
+    QLocalServer *m_server;
+    QList<QLocalSocket*> m_clients;
+    QHash<QLocalSocket*, QByteArray> m_buffers;
+    QHash<QString, Method> m_methods;
+    QHash<QString, AsyncMethod> m_asyncMethods;
+    QQueue<Job> m_jobs;
+    bool m_processingScheduled;
+    
+    // Estado de la llamada en curso
+    int m_callErrorCode;
+    QString m_callErrorMessage;
+    QStringList m_callErrors;
+    bool m_inCall;
+};
+
+#endif // CONTROLSERVER_H
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "DiskImageProbe.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QMutexLocker>
+#include <QtEndian>
+
+QHash<QString, DiskImageProbe::CacheEntry> DiskImageProbe::s_cache;
+QMutex DiskImageProbe::s_mutex;
+
+DiskImageProbe::Info DiskImageProbe::probe(const QString &path)
+{
+    QFileInfo fileInfo(path);
+    if (!fileInfo.exists()) {
+        return Info();
+    }
+    
+    QString key = fileInfo.absoluteFilePath();
+    qint64 fileSize = fileInfo.size();
+    QDateTime modified = fileInfo.lastModified();
+    
+    QMutexLocker locker(&s_mutex);
+    auto it = s_cache.constFind(key);
+    if (it != s_cache.constEnd() && it->fileSize == fileSize && it->modified == modified) {
+        return it->info;
+    }
+    locker.unlock();
+    
+    Info info = readHeader(key, fileSize);
+    if (info.valid) {
+        locker.relock();
+        s_cache.insert(key, CacheEntry{fileSize, modified, info});
+    }
+    return info;
+}
+
+void DiskImageProbe::clearCache()
+{
+    QMutexLocker locker(&s_mutex);
+    s_cache.clear();
+}
+
+qint64 DiskImageProbe::qcow2L2CacheSize(const Info &info)
+{
+    if (info.format != "qcow2" || info.clusterSize <= 0 || info.virtualSize <= 0) {
+        return 0;
+    }
+    
+    // Cada entrada L2 mapea un cluster; las tablas se cargan por clusters
+    qint64 entrySize = info.extendedL2 ? 16 : 8;
+    qint64 clusters = (info.virtualSize + info.clusterSize - 1) / info.clusterSize;
+    qint64 bytes = clusters * entrySize;
+    bytes = (bytes + info.clusterSize - 1) / info.clusterSize * info.clusterSize;
+    
+    // QEMU necesita al menos dos tablas; el tope evita reservar memoria
+    // desproporcionada con imágenes de varios TB
+    const qint64 maxCache = 64LL * 1024 * 1024;
+    return qBound(2LL * info.clusterSize, bytes, qMax(maxCache, 2LL * info.clusterSize));
+}
+
+QList<DiskImageProbe::Qcow2Snapshot> DiskImageProbe::qcow2Snapshots(const QString &path)
+{
+    QList<Qcow2Snapshot> snapshots;
+    
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return snapshots;
+    }
+    
+    QByteArray header = file.read(72);
+    if (header.size() < 72 || !header.startsWith("QFI\xfb") || qFromBigEndian<quint32>(header.constData() + 4) < 2) {
+        return snapshots;
+    }
+    
+    // nb_snapshots y snapshots_offset; QEMU limita la tabla a 65536 entradas
+    quint32 count = qFromBigEndian<quint32>(header.constData() + 60);
+    quint64 offset = qFromBigEndian<quint64>(header.constData() + 64);
+    if (count == 0 || count > 65536 || !file.seek(qint64(offset))) {
+        return snapshots;
+    }
+    
+    for (quint32 i = 0; i < count; ++i) {
+        // Parte fija de 40 bytes, datos extra, id, nombre y relleno hasta 8 bytes
+        QByteArray entry = file.read(40);
+        if (entry.size() < 40) {
+            return QList<Qcow2Snapshot>();
+        }
+        auto be16 = [&entry](int at) { return qFromBigEndian<quint16>(entry.constData() + at); };
+        auto be32 = [&entry](int at) { return qFromBigEndian<quint32>(entry.constData() + at); };
+        auto be64 = [&entry](int at) { return qFromBigEndian<quint64>(entry.constData() + at); };
+        
+        Qcow2Snapshot snapshot;
+        snapshot.l1Size = qint64(be32(8)) * 8;
+        quint16 idSize = be16(12);
+        quint16 nameSize = be16(14);
+        snapshot.created = QDateTime::fromSecsSinceEpoch(be32(16));
+        snapshot.vmClockNsec = qint64(be64(24));
+        snapshot.vmStateSize = be32(32);
+        quint32 extraSize = be32(36);
+        if (extraSize > 1024) {
+            return QList<Qcow2Snapshot>();
+        }
+        
+        QByteArray extra = file.read(extraSize);
+        QByteArray id = file.read(idSize);
+        QByteArray name = file.read(nameSize);
+        if (quint32(extra.size()) != extraSize || id.size() != idSize || name.size() != nameSize) {
+            return QList<Qcow2Snapshot>();
+        }
+        
+        // Versión 3: tamaño de estado de 64 bits y tamaño virtual del disco
+        if (extra.size() >= 8) {
+            snapshot.vmStateSize = qint64(qFromBigEndian<quint64>(extra.constData()));
+        }
+        if (extra.size() >= 16) {
+            snapshot.diskSize = qint64(qFromBigEndian<quint64>(extra.constData() + 8));
+        }
+        snapshot.id = QString::fromUtf8(id);
+        snapshot.name = QString::fromUtf8(name);
+        snapshots.append(snapshot);
+        
+        qint64 entrySize = 40 + extraSize + idSize + nameSize;
+        if (entrySize % 8 && !file.seek(file.pos() + 8 - entrySize % 8)) {
+            return QList<Qcow2Snapshot>();
+        }
+    }
+    
+    return snapshots;
+}
+
+QStringList DiskImageProbe::backingChain(const QString &path)
+{
+    QStringList chain;
+    QString current = QFileInfo(path).absoluteFilePath();
+    // El tope evita bucles con cadenas mal formadas
+    while (!current.isEmpty() && !chain.contains(current) && chain.size() < 256) {
+        chain.append(current);
+        current = probe(current).backingFile;
+    }
+    return chain;
+}
+
+DiskImageProbe::Info DiskImageProbe::readHeader(const QString &path, qint64 fileSize)
+{
+    Info info;
+    
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return info;
+    }
+    
+    // La cabecera VDI ocupa hasta 0x178; el resto de formatos menos
+    QByteArray header = file.read(512);
+    info.valid = true;
+    
+    auto be32 = [&header](int offset) { return qFromBigEndian<quint32>(header.constData() + offset); };
+    auto be64 = [&header](int offset) { return qFromBigEndian<quint64>(header.constData() + offset); };
+    auto le32 = [&header](int offset) { return qFromLittleEndian<quint32>(header.constData() + offset); };
+    auto le64 = [&header](int offset) { return qFromLittleEndian<quint64>(header.constData() + offset); };
+    
+    if (header.size() >= 104 && header.startsWith("QFI\xfb")) {
+        info.format = "qcow2";
+        quint32 version = be32(4);
+        quint32 clusterBits = be32(20);
+        info.virtualSize = qint64(be64(24));
+        info.clusterSize = (clusterBits >= 9 && clusterBits <= 21) ? (1 << clusterBits) : 65536;
+        // incompatible_features (v3), bit 4: entradas L2 extendidas
+        info.extendedL2 = version >= 3 && (be64(72) & (1ULL << 4));
+        
+        // Nombre de la imagen base; las rutas relativas lo son a esta imagen
+        quint64 backingOffset = be64(8);
+        quint32 backingSize = be32(16);
+        if (backingOffset > 0 && backingSize > 0 && backingSize < 4096 && file.seek(qint64(backingOffset))) {
+            QString backing = QString::fromUtf8(file.read(backingSize));
+            if (!backing.isEmpty() && !backing.contains(':')) {
+                info.backingFile = QFileInfo(QFileInfo(path).absoluteDir(), backing).absoluteFilePath();
+            } else {
+                info.backingFile = backing;
+            }
+        }
+        if (version < 2) {
+            // qcow (v1) es otro formato y QEMU lo abre como "qcow"
+            info.format = "qcow";
+            info.clusterSize = 0;
+        }
+    } else if (header.size() >= 32 && header.startsWith(QByteArray("QED\0", 4))) {
+        info.format = "qed";
+    } else if (header.size() >= 20 && header.startsWith("KDMV")) {
+        info.format = "vmdk";
+        info.virtualSize = qint64(le64(12)) * 512;
+    } else if (header.startsWith("COWD") || header.startsWith("# Disk DescriptorFile")) {
+        info.format = "vmdk";
+    } else if (header.size() >= 0x178 && le32(0x40) == 0xbeda107f) {
+        info.format = "vdi";
+        info.virtualSize = qint64(le64(0x170));
+    } else if (header.startsWith("vhdxfile")) {
+        info.format = "vhdx";
+    } else if (header.size() >= 56 && header.startsWith("conectix")) {
+        // VHD dinámico: copia del pie al principio del archivo
+        info.format = "vpc";
+        info.virtualSize = qint64(be64(48));
+    } else {
+        // VHD fijo: sólo lleva el pie en los últimos 512 bytes
+        QByteArray footer;
+        if (fileSize >= 1024 && file.seek(fileSize - 512)) {
+            footer = file.read(512);
+        }
+        if (footer.size() >= 56 && footer.startsWith("conectix")) {
+            info.format = "vpc";
+            info.virtualSize = qint64(qFromBigEndian<quint64>(footer.constData() + 48));
+        } else {
+            info.format = "raw";
+            info.virtualSize = fileSize;
+        }
+    }
+    
+    return info;
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#ifndef DISKIMAGEPROBE_H
+#define DISKIMAGEPROBE_H
+
+#include <QString>
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <QMutex>
+
+/**
+ * @brief Detección rápida del formato de una imagen de disco
+ * Lee sólo la cabecera del archivo, sin lanzar qemu-img, y guarda el
+ * resultado mientras no cambien el tamaño ni la fecha de modificación.
+ * Funciona también con imágenes en uso, que qemu-img no abre por el
+ * bloqueo de QEMU. También lee la tabla de instantáneas internas de qcow2.
+ */
+class DiskImageProbe
+{
+public:
+    struct Info {
+        bool valid = false;
+        QString format;             // qcow2, raw, vmdk, vdi, vhdx, vpc, qed
+        qint64 virtualSize = 0;     // bytes; 0 si la cabecera no lo indica
+        int clusterSize = 0;        // qcow2
+        bool extendedL2 = false;    // qcow2 con subclusters (entradas L2 de 16 bytes)
+        QString backingFile;        // qcow2: imagen base, ruta absoluta; vacía si no tiene
+    };
+    
+    // Entrada de la tabla de instantáneas internas de qcow2
+    struct Qcow2Snapshot {
+        QString id;
+        QString name;
+        QDateTime created;
+        qint64 vmClockNsec = 0;     // tiempo de ejecución del invitado al tomarla
+        qint64 vmStateSize = 0;     // bytes de RAM y dispositivos; 0 = sólo disco
+        qint64 diskSize = 0;        // tamaño virtual del disco en ese momento
+        qint64 l1Size = 0;          // bytes de la tabla L1 propia de la instantánea
+    };
+    
+    static Info probe(const QString &path);
+    // Vacía si la imagen no es qcow2 o la tabla está dañada
+    static QList<Qcow2Snapshot> qcow2Snapshots(const QString &path);
+    // La imagen y sus bases, de la capa superior a la base de todo
+    static QStringList backingChain(const QString &path);
+    static void clearCache();
+    
+    // Caché L2 que cubre la imagen completa (0 si no es qcow2)
+    static qint64 qcow2L2CacheSize(const Info &info);
+
+private:
+    struct CacheEntry {
+        qint64 fileSize = 0;
+        QDateTime modified;
+        Info info;
+    };
+    
+    static Info readHeader(const QString &path, qint64 fileSize);
+    
+    static QHash<QString, CacheEntry> s_cache;
+    static QMutex s_mutex;
+};
+
+#endif // DISKIMAGEPROBE_H
\ No newline at end of file
@@ -0,0 +1,314 @@
+#include "GroupSnapshot.h"
+#include "KVMManager.h"
+#include "QemuManager.h"
+#include "QmpClient.h"
+#include "VirtualMachine.h"
+
+#include <QJsonObject>
+#include <QDebug>
+
+GroupSnapshot::GroupSnapshot(KVMManager *kvmManager, const QString &group, const QString &tag, QObject *parent)
+    : QObject(parent)
+    , m_kvmManager(kvmManager)
+    , m_group(group)
+    , m_tag(tag)
+    , m_pending(0)
+    , m_aborted(false)
+    , m_rolledBack(false)
+{
+}
+
+void GroupSnapshot::run(VMBackend::Callback callback)
+{
+    m_callback = callback;
+    m_elapsed.start();
+    
+    QString error;
+    if (!prepare(&error)) {
+        m_callback(VMBackend::failure(error));
+        deleteLater();
+        return;
+    }
+    
+    qInfo() << "GroupSnapshot: instantánea" << m_tag << "del grupo" << m_group << "con" << m_members.size() << "VMs";
+    freeze();
+}
+
+bool GroupSnapshot::prepare(QString *error)
+{
+    if (m_tag.trimmed().isEmpty()) {
+        *error = tr("El nombre de la instantánea no puede estar vacío");
+        return false;
+    }
+    const QStringList names = m_kvmManager->getGroupMembers(m_group);
+    if (names.isEmpty()) {
+        *error = tr("El grupo '%1' no tiene máquinas virtuales").arg(m_group);
+        return false;
+    }
+    
+    // Todo se comprueba antes de pausar nada: un conjunto a medias no sirve.
+    // Sólo QEMU permite deshacer la capa de un miembro si otro falla
+    QemuManager *qemuManager = m_kvmManager->getQemuManager();
+    for (const QString &name : names) {
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(name);
+        if (vm->getBackend() != "qemu") {
+            *error = tr("La VM '%1' no usa el backend QEMU: las instantáneas de grupo no pueden deshacer su capa").arg(name);
+            return false;
+        }
+        if (QemuManager::hasSavedState(name)) {
+            *error = tr("La VM '%1' está suspendida a disco; arránquela o apáguela antes de la instantánea del grupo").arg(name);
+            return false;
+        }
+        QString check = m_kvmManager->checkExternalSnapshot(name, m_tag);
+        if (!check.isEmpty()) {
+            *error = check;
+            return false;
+        }
+        
+        Member member;
+        member.name = name;
+        member.live = vm->getState() == "running";
+        member.agent = member.live && qemuManager->isGuestAgentConnected(name);
+        member.disks = vm->getHardDisks();
+        m_members.append(member);
+    }
+    return true;
+}
+
+void GroupSnapshot::freeze()
+{
+    QList<int> agents;
+    for (int i = 0; i < m_members.size(); ++i) {
+        if (m_members[i].agent) {
+            agents.append(i);
+        }
+    }
+    if (agents.isEmpty()) {
+        pause();
+        return;
+    }
+    
+    // Vacía las cachés del invitado y bloquea sus escrituras hasta thaw()
+    m_pending = agents.size();
+    for (int i : agents) {
+        m_kvmManager->getQemuManager()->executeGuestAgent(m_members[i].name, "guest-fsfreeze-freeze", QJsonObject(),
+                                                          FreezeTimeoutMs, [this, i](const QJsonObject &reply) {
+            m_members[i].quiesced = reply.contains("return");
+            if (!m_members[i].quiesced) {
+                qWarning() << "GroupSnapshot: sin congelar" << m_members[i].name << "-" << QmpClient::errorString(reply);
+            }
+            if (--m_pending == 0) {
+                pause();
+            }
+        });
+    }
+}
+
+void GroupSnapshot::pause()
+{
+    QList<int> live;
+    for (int i = 0; i < m_members.size(); ++i) {
+        if (m_members[i].live) {
+            live.append(i);
+        }
+    }
+    m_pauseTimer.start();
+    if (live.isEmpty()) {
+        snapshot();
+        return;
+    }
+    
+    // Todas las órdenes salen seguidas; la ventana real es la de las confirmaciones
+    m_pending = live.size();
+    for (int i : live) {
+        m_kvmManager->pauseVMAsync(m_members[i].name, [this, i](const VMBackend::Result &result) {
+            if (result.ok) {
+                m_members[i].pausedMs = m_pauseTimer.elapsed();
+            } else {
+                m_members[i].error = result.error.isEmpty() ? tr("No se pudo pausar") : result.error;
+                m_aborted = true;
+            }
+            if (--m_pending == 0) {
+                if (m_aborted) {
+                    resume();
+                } else {
+                    snapshot();
+                }
+            }
+        });
+    }
+}
+
+void GroupSnapshot::snapshot()
+{
+    m_pending = m_members.size();
+    for (int i = 0; i < m_members.size(); ++i) {
+        m_kvmManager->createExternalSnapshotAsync(m_members[i].name, m_tag, [this, i](const VMBackend::Result &result) {
+            if (result.ok) {
+                m_members[i].overlays = result.value.toArray();
+            } else {
+                m_members[i].error = result.error.isEmpty() ? tr("No se pudo crear la capa") : result.error;
+            }
+            if (--m_pending == 0) {
+                rollback();
+            }
+        });
+    }
+}
+
+void GroupSnapshot::rollback()
+{
+    QList<int> captured;
+    bool failed = false;
+    for (int i = 0; i < m_members.size(); ++i) {
+        if (!m_members[i].overlays.isEmpty()) {
+            captured.append(i);
+        }
+        failed = failed || !m_members[i].error.isEmpty();
+    }
+    if (!failed || captured.isEmpty()) {
+        resume();
+        return;
+    }
+    
+    // Todavía en pausa: se quitan las capas ya creadas para no dejar un
+    // conjunto a medias; lo escrito en ellas es casi nada
+    m_rolledBack = true;
+    m_pending = captured.size();
+    for (int i : captured) {
+        m_kvmManager->discardExternalSnapshotAsync(m_members[i].name, m_members[i].disks,
+                                                   [this, i](const VMBackend::Result &result) {
+            if (result.ok) {
+                m_members[i].overlays = QJsonArray();
+            } else {
+                qWarning() << "GroupSnapshot: no se pudo deshacer la capa de" << m_members[i].name << "-" << result.error;
+                m_members[i].error = tr("No se pudo deshacer la capa: %1").arg(result.error);
+            }
+            if (--m_pending == 0) {
+                resume();
+            }
+        });
+    }
+}
+
+void GroupSnapshot::resume()
+{
+    QList<int> paused;
+    for (int i = 0; i < m_members.size(); ++i) {
+        if (m_members[i].pausedMs >= 0) {
+            paused.append(i);
+        }
+    }
+    if (paused.isEmpty()) {
+        thaw();
+        return;
+    }
+    
+    m_pending = paused.size();
+    for (int i : paused) {
+        m_kvmManager->resumeVMAsync(m_members[i].name, [this, i](const VMBackend::Result &result) {
+            m_members[i].resumedMs = m_pauseTimer.elapsed();
+            if (!result.ok && m_members[i].error.isEmpty()) {
+                m_members[i].error = result.error.isEmpty() ? tr("No se pudo reanudar") : result.error;
+            }
+            if (--m_pending == 0) {
+                thaw();
+            }
+        });
+    }
+}
+
+void GroupSnapshot::thaw()
+{
+    // También los que no confirmaron la congelación: pudo completarse tras el timeout
+    QList<int> agents;
+    for (int i = 0; i < m_members.size(); ++i) {
+        if (m_members[i].agent) {
+            agents.append(i);
+        }
+    }
+    if (agents.isEmpty()) {
+        complete();
+        return;
+    }
+    
+    m_pending = agents.size();
+    for (int i : agents) {
+        m_kvmManager->getQemuManager()->executeGuestAgent(m_members[i].name, "guest-fsfreeze-thaw", QJsonObject(),
+                                                          FreezeTimeoutMs, [this, i](const QJsonObject &reply) {
+            if (reply.contains("error")) {
+                qWarning() << "GroupSnapshot: no se pudo descongelar" << m_members[i].name
+                           << "-" << QmpClient::errorString(reply);
+            }
+            if (--m_pending == 0) {
+                complete();
+            }
+        });
+    }
+}
+
+void GroupSnapshot::complete()
+{
+    qint64 firstPaused = -1;
+    qint64 lastPaused = -1;
+    qint64 lastResumed = 0;
+    QJsonArray quiesced;
+    bool ok = !m_aborted;
+    for (const Member &member : m_members) {
+        if (member.pausedMs >= 0) {
+            firstPaused = firstPaused < 0 ? member.pausedMs : qMin(firstPaused, member.pausedMs);
+            lastPaused = qMax(lastPaused, member.pausedMs);
+        }
+        lastResumed = qMax(lastResumed, member.resumedMs);
+        if (member.quiesced) {
+            quiesced.append(member.name);
+        }
+        ok = ok && member.error.isEmpty();
+    }
+    
+    QJsonObject result;
+    result["group"] = m_group;
+    result["tag"] = m_tag;
+    result["members"] = summary();
+    result["quiesced"] = quiesced;
+    result["rolledBack"] = m_rolledBack;
+    result["pauseMsecs"] = lastResumed;
+    result["pauseSpreadMsecs"] = firstPaused < 0 ? 0 : lastPaused - firstPaused;
+    result["msecs"] = m_elapsed.elapsed();
+    qInfo() << "GroupSnapshot:" << m_group << m_tag << (ok ? "completada" : "fallida") << "- pausa"
+            << lastResumed << "ms, total" << m_elapsed.elapsed() << "ms";
+    
+    VMBackend::Result reply = VMBackend::success(result);
+    if (!ok) {
+        if (m_aborted) {
+            reply = VMBackend::failure(tr("No se pudieron pausar todas las VMs del grupo '%1'; no se ha tomado ninguna instantánea").arg(m_group));
+        } else if (m_rolledBack) {
+            reply = VMBackend::failure(tr("La instantánea '%1' del grupo '%2' falló en alguna VM; se han deshecho las capas de las demás").arg(m_tag, m_group));
+        } else {
+            reply = VMBackend::failure(tr("La instantánea '%1' del grupo '%2' no se completó en todas las VMs").arg(m_tag, m_group));
+        }
+        reply.value = result;
+    }
+    m_callback(reply);
+    deleteLater();
+}
+
+QJsonArray GroupSnapshot::summary() const
+{
+    QJsonArray members;
+    for (const Member &member : m_members) {
+        QJsonObject entry;
+        entry["name"] = member.name;
+        entry["live"] = member.live;
+        entry["quiesced"] = member.quiesced;
+        if (member.pausedMs >= 0 && member.resumedMs >= 0) {
+            entry["pausedMsecs"] = member.resumedMs - member.pausedMs;
+        }
+        entry["overlays"] = member.overlays;
+        if (!member.error.isEmpty()) {
+            entry["error"] = member.error;
+        }
+        members.append(entry);
+    }
+    return members;
+}
@@ -0,0 +1,81 @@
+#ifndef GROUPSNAPSHOT_H
+#define GROUPSNAPSHOT_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QJsonArray>
+#include <QElapsedTimer>
+
+#include "VMBackend.h"
+
+class KVMManager;
+
+/**
+ * @brief Instantánea coherente de todas las VMs de un grupo
+ * Las VMs de una aplicación repartida (web, base de datos...) sólo forman un
+ * conjunto válido si sus discos se capturan en el mismo instante. Se hace en
+ * fases: congelar los sistemas de archivos de las VMs en marcha cuyo
+ * qemu-guest-agent está conectado (guest-fsfreeze-freeze), pausarlas todas
+ * a la vez, añadir en paralelo una capa externa a los discos de cada
+ * miembro, reanudarlas y descongelarlas. Sin agente, el miembro queda como
+ * tras un corte de corriente (consistencia ante fallos).
+ *
+ * Antes de pausar nada se comprueba que todos los miembros (sólo QEMU)
+ * admiten la capa. Si alguno no llega a pausarse no se captura nada; si
+ * alguno no consigue su capa, las de los demás se deshacen antes de
+ * reanudarlos. Cada operación crea su propio objeto, que se destruye al
+ * terminar.
+ */
+class GroupSnapshot : public QObject
+{
+    Q_OBJECT
+
+public:
+    GroupSnapshot(KVMManager *kvmManager, const QString &group, const QString &tag, QObject *parent = nullptr);
+    
+    // result.value = {group, tag, members, quiesced, rolledBack, pauseMsecs,
+    // pauseSpreadMsecs, msecs}; ok si todos los miembros tienen su capa. pauseMsecs va de la
+    // primera pausa a la última reanudación; pauseSpreadMsecs, de la primera
+    // pausa confirmada a la última
+    void run(VMBackend::Callback callback);
+    
+    static const int FreezeTimeoutMs = 10000;
+
+private:
+    struct Member {
+        QString name;
+        bool live = false;          // en marcha: se pausa y se reanuda
+        bool agent = false;         // qemu-ga conectado: se congela
+        bool quiesced = false;
+        qint64 pausedMs = -1;       // desde el inicio de la pausa
+        qint64 resumedMs = -1;
+        QStringList disks;          // antes de la capa, para deshacerla
+        QJsonArray overlays;
+        QString error;
+    };
+    
+    bool prepare(QString *error);
+    void freeze();
+    void pause();
+    void snapshot();
+    void rollback();
+    void resume();
+    void thaw();
+    void complete();
+    QJsonArray summary() const;
+    
+    KVMManager *m_kvmManager;
+    QString m_group;
+    QString m_tag;
+    QList<Member> m_members;
+    QElapsedTimer m_elapsed;
+    QElapsedTimer m_pauseTimer;
+    int m_pending;
+    bool m_aborted;                 // algún miembro no se pausó
+    bool m_rolledBack;              // se deshicieron las capas de los que sí la tenían
+    VMBackend::Callback m_callback;
+};
+
+#endif // GROUPSNAPSHOT_H
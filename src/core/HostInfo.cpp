@@ -0,0 +1,425 @@
+#include "HostInfo.h"
+
+#include <QObject>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSet>
+#include <QPair>
+
+#include <algorithm>
+#include <unistd.h>
+
+HostInfo::CpuTopology HostInfo::cpuTopology()
+{
+    static const CpuTopology topology = readCpuTopology();
+    return topology;
+}
+
+bool HostInfo::isKvmAccessible()
+{
+    QFileInfo kvm("/dev/kvm");
+    return kvm.exists() && kvm.isReadable() && kvm.isWritable();
+}
+
+QList<HostInfo::NumaNode> HostInfo::numaNodes()
+{
+    QList<NumaNode> nodes;
+    const QString base = "/sys/devices/system/node/";
+    
+    QFile online(base + "online");
+    if (online.open(QIODevice::ReadOnly)) {
+        for (int id : parseCpuList(QString::fromLatin1(online.readAll()))) {
+            NumaNode node;
+            node.id = id;
+            
+            QFile cpuList(base + QString("node%1/cpulist").arg(id));
+            if (cpuList.open(QIODevice::ReadOnly)) {
+                node.cpus = parseCpuList(QString::fromLatin1(cpuList.readAll()));
+            }
+            readNodeMemory(base + QString("node%1/meminfo").arg(id), &node);
+            
+            // Nodos sólo de memoria (CXL, PMEM): no alojan vCPUs
+            if (!node.cpus.isEmpty()) {
+                nodes.append(node);
+            }
+        }
+    }
+    
+    if (nodes.isEmpty()) {
+        NumaNode node;
+        for (const LogicalCpu &cpu : cpuTopology().cpus) {
+            node.cpus.append(cpu.id);
+        }
+        readNodeMemory("/proc/meminfo", &node);
+        nodes.append(node);
+    }
+    
+    return nodes;
+}
+
+QList<HostInfo::HugePagePool> HostInfo::hugePagePools()
+{
+    QList<HugePagePool> pools;
+    
+    // Un directorio por tamaño: hugepages-2048kB, hugepages-1048576kB
+    QDir dir("/sys/kernel/mm/hugepages");
+    for (const QString &entry : dir.entryList({"hugepages-*kB"}, QDir::Dirs)) {
+        int sizeKB = entry.mid(10, entry.size() - 12).toInt();
+        if (sizeKB > 0) {
+            pools.append(hugePagePool(sizeKB));
+        }
+    }
+    
+    std::sort(pools.begin(), pools.end(), [](const HugePagePool &a, const HugePagePool &b) {
+        return a.sizeKB < b.sizeKB;
+    });
+    return pools;
+}
+
+HostInfo::HugePagePool HostInfo::hugePagePool(int sizeKB, int node)
+{
+    QString dir = node < 0
+        ? QString("/sys/kernel/mm/hugepages/hugepages-%1kB/").arg(sizeKB)
+        : QString("/sys/devices/system/node/node%1/hugepages/hugepages-%2kB/").arg(node).arg(sizeKB);
+    
+    HugePagePool pool;
+    pool.sizeKB = sizeKB;
+    pool.total = readSysLong(dir + "nr_hugepages");
+    pool.free = readSysLong(dir + "free_hugepages");
+    return pool;
+}
+
+HostInfo::HostMemory HostInfo::hostMemory()
+{
+    HostMemory memory;
+    QFile file("/proc/meminfo");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return memory;
+    }
+    
+    for (const QByteArray &line : file.readAll().split('\n')) {
+        QList<QByteArray> fields = line.simplified().split(' ');
+        if (fields.size() < 2) {
+            continue;
+        }
+        
+        qint64 value = fields[1].toLongLong();
+        if (fields[0] == "MemTotal:") {
+            memory.totalKB = value;
+        } else if (fields[0] == "MemAvailable:") {
+            memory.availableKB = value;
+        } else if (fields[0] == "MemFree:") {
+            memory.freeKB = value;
+        } else if (fields[0] == "SwapTotal:") {
+            memory.swapTotalKB = value;
+        } else if (fields[0] == "SwapFree:") {
+            memory.swapFreeKB = value;
+        }
+    }
+    return memory;
+}
+
+HostInfo::Pressure HostInfo::memoryPressure()
+{
+    return readPressure("/proc/pressure/memory");
+}
+
+HostInfo::Pressure HostInfo::ioPressure()
+{
+    return readPressure("/proc/pressure/io");
+}
+
+HostInfo::Pressure HostInfo::readPressure(const QString &path)
+{
+    Pressure pressure;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return pressure;
+    }
+    
+    // "some avg10=1.23 avg60=0.50 avg300=0.10 total=123456"
+    for (const QByteArray &line : file.readAll().split('\n')) {
+        QList<QByteArray> fields = line.simplified().split(' ');
+        if (fields.size() < 3) {
+            continue;
+        }
+        
+        double avg10 = 0;
+        double avg60 = 0;
+        for (const QByteArray &field : fields) {
+            if (field.startsWith("avg10=")) {
+                avg10 = field.mid(6).toDouble();
+            } else if (field.startsWith("avg60=")) {
+                avg60 = field.mid(6).toDouble();
+            }
+        }
+        
+        if (fields[0] == "some") {
+            pressure.someAvg10 = avg10;
+            pressure.someAvg60 = avg60;
+            pressure.supported = true;
+        } else if (fields[0] == "full") {
+            pressure.fullAvg10 = avg10;
+            pressure.fullAvg60 = avg60;
+        }
+    }
+    return pressure;
+}
+
+HostInfo::KsmStatus HostInfo::ksmStatus()
+{
+    KsmStatus status;
+    const QString dir = "/sys/kernel/mm/ksm/";
+    if (!QFileInfo::exists(dir + "run")) {
+        return status;
+    }
+    
+    status.supported = true;
+    status.run = readSysInt(dir + "run", 0);
+    status.pagesToScan = readSysInt(dir + "pages_to_scan", 0);
+    status.sleepMillisecs = readSysInt(dir + "sleep_millisecs", 0);
+    status.pagesShared = readSysLong(dir + "pages_shared");
+    status.pagesSharing = readSysLong(dir + "pages_sharing");
+    status.pagesUnshared = readSysLong(dir + "pages_unshared");
+    status.pagesVolatile = readSysLong(dir + "pages_volatile");
+    status.zeroPages = readSysLong(dir + "ksm_zero_pages");
+    status.fullScans = readSysLong(dir + "full_scans");
+    status.hasGeneralProfit = QFileInfo::exists(dir + "general_profit");
+    if (status.hasGeneralProfit) {
+        status.generalProfit = readSysLong(dir + "general_profit");
+    }
+    status.pageSizeKB = int(sysconf(_SC_PAGESIZE) / 1024);
+    
+    // Tiempo de CPU de ksmd (utime + stime, campos 14 y 15 de /proc/<pid>/stat)
+    qint64 pid = ksmdPid();
+    QFile stat(QString("/proc/%1/stat").arg(pid));
+    if (pid > 0 && stat.open(QIODevice::ReadOnly)) {
+        QByteArray content = stat.readAll();
+        QList<QByteArray> fields = content.mid(content.lastIndexOf(')') + 2).split(' ');
+        if (fields.size() > 12) {
+            qint64 ticks = fields[11].toLongLong() + fields[12].toLongLong();
+            status.ksmdCpuTimeMs = ticks * 1000 / sysconf(_SC_CLK_TCK);
+        }
+    }
+    return status;
+}
+
+bool HostInfo::setKsm(int run, int pagesToScan, int sleepMillisecs, QString *error)
+{
+    const QList<QPair<QString, int>> values = {
+        {"run", run},
+        {"pages_to_scan", pagesToScan},
+        {"sleep_millisecs", sleepMillisecs}
+    };
+    
+    if (!QFileInfo::exists("/sys/kernel/mm/ksm/run")) {
+        if (error) *error = QObject::tr("El kernel no tiene soporte de KSM (CONFIG_KSM)");
+        return false;
+    }
+    
+    for (const auto &value : values) {
+        if (value.second < 0) {
+            continue;
+        }
+        
+        QString path = "/sys/kernel/mm/ksm/" + value.first;
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) {
+            if (error) {
+                *error = QObject::tr("Sin permiso para escribir en %1; ejecútelo como root o use: echo %2 | sudo tee %1")
+                             .arg(path).arg(value.second);
+            }
+            return false;
+        }
+        // El kernel rechaza aquí los valores fuera de rango
+        if (file.write(QByteArray::number(value.second)) < 0 || !file.flush()) {
+            if (error) *error = QObject::tr("No se pudo escribir en %1: %2").arg(path, file.errorString());
+            return false;
+        }
+    }
+    return true;
+}
+
+qint64 HostInfo::ksmMergingPages(qint64 pid)
+{
+    QFile file(QString("/proc/%1/ksm_merging_pages").arg(pid));
+    if (pid <= 0 || !file.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    return file.readAll().trimmed().toLongLong();
+}
+
+bool HostInfo::validateCpuTopology(int vcpus, int sockets, int dies, int cores, int threads,
+                                   QString *error, QStringList *warnings)
+{
+    if (sockets < 1 || dies < 1 || cores < 1 || threads < 1) {
+        if (error) {
+            *error = QObject::tr("Los valores de la topología deben ser al menos 1");
+        }
+        return false;
+    }
+    
+    if (sockets * dies * cores * threads != vcpus) {
+        if (error) {
+            *error = QObject::tr("La topología (%1 × %2 × %3 × %4) no suma los %5 procesadores")
+                     .arg(sockets).arg(dies).arg(cores).arg(threads).arg(vcpus);
+        }
+        return false;
+    }
+    
+    if (!warnings) {
+        return true;
+    }
+    
+    CpuTopology host = cpuTopology();
+    if (host.logicalCpus() > 0 && vcpus > host.logicalCpus()) {
+        warnings->append(QObject::tr("La VM tiene %1 procesadores y el anfitrión sólo %2 CPUs lógicas")
+                         .arg(vcpus).arg(host.logicalCpus()));
+    }
+    if (threads > host.threadsPerCore) {
+        // El invitado supondría hermanos SMT que comparten núcleo y no es así
+        warnings->append(QObject::tr("%1 hilos por núcleo, pero el anfitrión tiene %2")
+                         .arg(threads).arg(host.threadsPerCore));
+    }
+    if (dies > host.diesPerSocket && dies > 1) {
+        warnings->append(QObject::tr("%1 dies por socket, pero el anfitrión tiene %2")
+                         .arg(dies).arg(host.diesPerSocket));
+    }
+    
+    return true;
+}
+
+QList<int> HostInfo::parseCpuList(const QString &list)
+{
+    QList<int> cpus;
+    for (const QString &part : list.trimmed().split(',', Qt::SkipEmptyParts)) {
+        int dash = part.indexOf('-');
+        if (dash < 0) {
+            bool ok = false;
+            int cpu = part.toInt(&ok);
+            if (ok) {
+                cpus.append(cpu);
+            }
+            continue;
+        }
+        
+        bool okFirst = false, okLast = false;
+        int first = part.left(dash).toInt(&okFirst);
+        int last = part.mid(dash + 1).toInt(&okLast);
+        if (okFirst && okLast) {
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.append(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+HostInfo::CpuTopology HostInfo::readCpuTopology()
+{
+    CpuTopology topology;
+    const QString base = "/sys/devices/system/cpu/";
+    
+    QFile online(base + "online");
+    if (!online.open(QIODevice::ReadOnly)) {
+        return topology;
+    }
+    
+    QSet<int> sockets;
+    QSet<QPair<int, int>> dies;
+    QSet<QString> cores;
+    
+    for (int id : parseCpuList(QString::fromLatin1(online.readAll()))) {
+        QString dir = base + QString("cpu%1/topology/").arg(id);
+        LogicalCpu cpu;
+        cpu.id = id;
+        cpu.socket = readSysInt(dir + "physical_package_id", 0);
+        cpu.die = readSysInt(dir + "die_id", 0);
+        cpu.core = readSysInt(dir + "core_id", id);
+        topology.cpus.append(cpu);
+        
+        sockets.insert(cpu.socket);
+        dies.insert(qMakePair(cpu.socket, cpu.die));
+        cores.insert(QString("%1:%2:%3").arg(cpu.socket).arg(cpu.die).arg(cpu.core));
+    }
+    
+    if (topology.cpus.isEmpty()) {
+        return topology;
+    }
+    
+    topology.sockets = sockets.size();
+    topology.diesPerSocket = qMax(1, int(dies.size()) / topology.sockets);
+    topology.coresPerDie = qMax(1, int(cores.size()) / int(dies.size()));
+    topology.threadsPerCore = qMax(1, topology.logicalCpus() / int(cores.size()));
+    return topology;
+}
+
+int HostInfo::readSysInt(const QString &path, int fallback)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return fallback;
+    }
+    
+    bool ok = false;
+    int value = file.readAll().trimmed().toInt(&ok);
+    return ok ? value : fallback;
+}
+
+qint64 HostInfo::readSysLong(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    return file.readAll().trimmed().toLongLong();
+}
+
+qint64 HostInfo::ksmdPid()
+{
+    // Hilo del kernel: su PID no cambia mientras el anfitrión siga encendido
+    static qint64 pid = 0;
+    if (pid > 0) {
+        return pid;
+    }
+    
+    QDir proc("/proc");
+    for (const QString &entry : proc.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        bool numeric = false;
+        qint64 candidate = entry.toLongLong(&numeric);
+        if (!numeric) {
+            continue;
+        }
+        
+        QFile comm(QString("/proc/%1/comm").arg(candidate));
+        if (comm.open(QIODevice::ReadOnly) && comm.readAll().trimmed() == "ksmd") {
+            pid = candidate;
+            break;
+        }
+    }
+    return pid;
+}
+
+void HostInfo::readNodeMemory(const QString &path, NumaNode *node)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    
+    // "Node 0 MemTotal:  32768000 kB" en /sys, "MemTotal:  32768000 kB" en /proc
+    for (const QByteArray &line : file.readAll().split('\n')) {
+        QList<QByteArray> fields = line.simplified().split(' ');
+        int key = fields.size() >= 4 && fields[0] == "Node" ? 2 : 0;
+        if (fields.size() < key + 2) {
+            continue;
+        }
+        
+        if (fields[key] == "MemTotal:") {
+            node->memTotalKB = fields[key + 1].toLongLong();
+        } else if (fields[key] == "MemFree:") {
+            node->memFreeKB = fields[key + 1].toLongLong();
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#ifndef HOSTINFO_H
+#define HOSTINFO_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+/**
+ * @brief Información del anfitrión leída de /sys y /proc
+ * Se usa para proponer valores por defecto y validar la configuración de
+ * las VMs contra el hardware real. Los ajustes de KSM son lo único que se
+ * escribe.
+ */
+class HostInfo
+{
+public:
+    struct LogicalCpu {
+        int id = 0;
+        int socket = 0;
+        int die = 0;
+        int core = 0;
+    };
+    
+    struct CpuTopology {
+        int sockets = 1;
+        int diesPerSocket = 1;
+        int coresPerDie = 1;
+        int threadsPerCore = 1;
+        QList<LogicalCpu> cpus;     // CPUs en línea
+        
+        int logicalCpus() const { return cpus.size(); }
+    };
+    
+    struct NumaNode {
+        int id = 0;
+        QList<int> cpus;
+        qint64 memTotalKB = 0;
+        qint64 memFreeKB = 0;
+    };
+    
+    struct HugePagePool {
+        int sizeKB = 0;
+        qint64 total = 0;
+        qint64 free = 0;
+    };
+    
+    struct HostMemory {
+        qint64 totalKB = 0;
+        qint64 availableKB = 0;     // estimación del kernel (MemAvailable)
+        qint64 freeKB = 0;
+        qint64 swapTotalKB = 0;
+        qint64 swapFreeKB = 0;
+    };
+    
+    // Porcentaje del tiempo en que las tareas esperaron por un recurso
+    // ("some": al menos una, "full": todas a la vez)
+    struct Pressure {
+        bool supported = false;     // kernel sin CONFIG_PSI o con psi=0
+        double someAvg10 = 0;
+        double someAvg60 = 0;
+        double fullAvg10 = 0;
+        double fullAvg60 = 0;
+    };
+    
+    // Kernel samepage merging (/sys/kernel/mm/ksm). Las páginas ahorradas
+    // son pages_sharing: cada una es una copia que apunta a una de las
+    // pages_shared en lugar de ocupar memoria propia
+    struct KsmStatus {
+        bool supported = false;     // kernel sin CONFIG_KSM
+        int run = 0;                // 0 parado, 1 en marcha, 2 deshaciendo las fusiones
+        int pagesToScan = 0;        // páginas revisadas en cada pasada de ksmd
+        int sleepMillisecs = 0;     // pausa entre pasadas
+        qint64 pagesShared = 0;
+        qint64 pagesSharing = 0;
+        qint64 pagesUnshared = 0;   // candidatas revisadas sin pareja
+        qint64 pagesVolatile = 0;   // cambian demasiado deprisa para fusionarlas
+        qint64 zeroPages = 0;       // fusionadas con la página cero (use_zero_pages)
+        qint64 fullScans = 0;
+        bool hasGeneralProfit = false;  // general_profit sólo existe desde el kernel 6.1
+        qint64 generalProfit = 0;   // bytes ahorrados menos metadatos; negativo si éstos pesan más
+        qint64 ksmdCpuTimeMs = -1;  // CPU acumulada del hilo ksmd
+        int pageSizeKB = 4;
+        
+        qint64 savedKB() const { return (pagesSharing + zeroPages) * pageSizeKB; }
+    };
+    
+    // Topología de /sys/devices/system/cpu (se lee una sola vez)
+    static CpuTopology cpuTopology();
+    static bool isKvmAccessible();
+    
+    // Nodos de /sys/devices/system/node (la memoria libre se lee en cada
+    // llamada); sin soporte NUMA se devuelve un único nodo con todas las CPUs
+    static QList<NumaNode> numaNodes();
+    
+    // Páginas enormes reservadas (/sys/kernel/mm/hugepages), en todo el
+    // anfitrión o sólo en un nodo NUMA
+    static QList<HugePagePool> hugePagePools();
+    static HugePagePool hugePagePool(int sizeKB, int node = -1);
+    
+    // /proc/meminfo y /proc/pressure/{memory,io} (se leen en cada llamada)
+    static HostMemory hostMemory();
+    static Pressure memoryPressure();
+    static Pressure ioPressure();
+    
+    // Estado de KSM (se lee en cada llamada)
+    static KsmStatus ksmStatus();
+    // Escribe run, pages_to_scan y sleep_millisecs (requiere root); los
+    // valores negativos se dejan como están
+    static bool setKsm(int run, int pagesToScan, int sleepMillisecs, QString *error);
+    // Páginas de un proceso fusionadas por KSM (/proc/<pid>/ksm_merging_pages,
+    // kernel 5.19 o posterior); -1 si no se puede leer
+    static qint64 ksmMergingPages(qint64 pid);
+    
+    // Comprueba sockets × dies × cores × threads == vCPUs; las diferencias
+    // con el anfitrión que no impiden arrancar se devuelven como avisos
+    static bool validateCpuTopology(int vcpus, int sockets, int dies, int cores, int threads,
+                                    QString *error, QStringList *warnings = nullptr);
+    
+    // Listas del kernel como "0-3,8,10-11"
+    static QList<int> parseCpuList(const QString &list);
+
+private:
+    static CpuTopology readCpuTopology();
+    static int readSysInt(const QString &path, int fallback);
+    static qint64 readSysLong(const QString &path);
+    static void readNodeMemory(const QString &path, NumaNode *node);
+    static qint64 ksmdPid();
+    static Pressure readPressure(const QString &path);
+};
+
+#endif // HOSTINFO_H
\ No newline at end of file
@@ -2,15 +2,38 @@
 #include "VirtualMachine.h"
 #include "VMXmlManager.h"
 #include "QemuManager.h"
+#include "QemuBackend.h"
+#include "LibvirtBackend.h"
+#include "VirshSession.h"
+#include "DiskImageProbe.h"
+#include "HostInfo.h"
+#include "MemoryPressureController.h"
+#include "AdmissionController.h"
+#include "WarmPool.h"
+#include "GroupSnapshot.h"
 
 #include <QDebug>
+#include <QEventLoop>
+#include <QSharedPointer>
+#include <QPointer>
+#include <QJsonArray>
+#include <QSet>
+#include <QElapsedTimer>
+#include <QSignalBlocker>
+#include <QDomDocument>
+#include <QDomElement>
 #include <QDir>
+#include <QDirIterator>
 #include <QStandardPaths>
 #include <QProcess>
 #include <QTimer>
+#include <QThread>
 #include <QUuid>
 #include <QRegularExpression>
 
+#include <algorithm>
+#include <limits>
+
 KVMManager::KVMManager(QObject *parent)
     : QObject(parent)
     , m_stateCheckTimer(new QTimer(this))
@@ -18,8 +41,11 @@ KVMManager::KVMManager(QObject *parent)
     , m_kvmAvailable(false)
     , m_xmlManager(new VMXmlManager(this))
     , m_qemuManager(new QemuManager(this))
+    , m_admission(new AdmissionController(this, this))
+    , m_warmPool(nullptr)
     , m_libvirtRunning(false)
     , m_loadingVMs(false)
+    , m_libvirtSyncing(false)
 {
     // Set default VM path
     m_defaultVMPath = QStandardPaths::writableLocation(QStandardPaths::HomeLocation) 
@@ -40,19 +66,16 @@ KVMManager::KVMManager(QObject *parent)
     
     // Connect QEMU manager signals
     connect(m_qemuManager, &QemuManager::errorOccurred, this, &KVMManager::errorOccurred);
-    connect(m_qemuManager, &QemuManager::processStarted, this, [this](const QString &vmName) {
-        emit vmStateChanged(vmName, "running");
-    });
-    connect(m_qemuManager, &QemuManager::processFinished, this, [this](const QString &vmName, int exitCode) {
-        emit vmStateChanged(vmName, "shut off");
-        if (exitCode != 0) {
-            emit errorOccurred(tr("La VM '%1' terminó con código de error %2").arg(vmName).arg(exitCode));
-        }
-    });
+    
+    // Execution backends: each VM records which one owns it
+    registerBackend(new QemuBackend(m_qemuManager, this));
+    registerBackend(new LibvirtBackend(this));
     
     // Always load VMs from XML files, regardless of libvirt status
     loadVirtualMachines();
     
+    m_warmPool = new WarmPool(this, this);
+    
     // Disable timer-based state checking for now to prevent excessive reloading
     // if (m_libvirtRunning) {
     //     m_stateCheckTimer->start();
@@ -119,27 +142,454 @@ void KVMManager::loadVirtualMachines()
         }
     }
     
+    // Reasociar las VMs que siguieron ejecutándose sin gestor
+    m_qemuManager->reattachVMs(m_virtualMachines);
+    
     m_loadingVMs = false;
     emit vmListChanged();
 }
 
 bool KVMManager::executeLibvirtCommand(const QString &command, QStringList &output)
 {
-    QProcess process;
-    process.start(command);
-    process.waitForFinished();
+    // Runs through the persistent virsh session instead of spawning a process
+    LibvirtBackend *libvirt = qobject_cast<LibvirtBackend*>(getBackend("libvirt"));
+    if (!libvirt) {
+        return false;
+    }
+    
+    QStringList arguments = QProcess::splitCommand(command);
+    if (!arguments.isEmpty() && arguments.first() == "virsh") {
+        arguments.removeFirst();
+    }
     
-    if (process.exitCode() != 0) {
-        QString error = process.readAllStandardError();
-        qDebug() << "Libvirt command failed:" << command << "Error:" << error;
+    VirshSession::Result result = libvirt->session()->executeSync(arguments);
+    if (!result.ok) {
+        qDebug() << "Libvirt command failed:" << command << "Error:" << result.error;
         return false;
     }
     
-    QString result = process.readAllStandardOutput();
-    output = result.split('\n', Qt::SkipEmptyParts);
+    output = result.output.split('\n', Qt::SkipEmptyParts);
     return true;
 }
 
+static qint64 libvirtSizeToMB(const QDomElement &element)
+{
+    // libvirt expresa la memoria en KiB salvo que se indique otra unidad
+    qint64 value = element.text().toLongLong();
+    QString unit = element.attribute("unit", "KiB");
+    
+    if (unit == "b" || unit == "bytes") return value / (1024 * 1024);
+    if (unit == "KB") return value * 1000 / (1024 * 1024);
+    if (unit == "k" || unit == "KiB") return value / 1024;
+    if (unit == "MB") return value * 1000 * 1000 / (1024 * 1024);
+    if (unit == "M" || unit == "MiB") return value;
+    if (unit == "GB") return value * 1000 * 1000 * 1000 / (1024 * 1024);
+    if (unit == "G" || unit == "GiB") return value * 1024;
+    if (unit == "T" || unit == "TiB") return value * 1024 * 1024;
+    return value / 1024;
+}
+
+VirtualMachine* KVMManager::parseVMInfo(const QString &vmXML)
+{
+    QDomDocument doc;
+    if (!doc.setContent(vmXML)) {
+        qDebug() << "KVMManager: XML de dominio inválido";
+        return nullptr;
+    }
+    
+    QDomElement domain = doc.documentElement();
+    QString name = domain.firstChildElement("name").text();
+    if (domain.tagName() != "domain" || name.isEmpty()) {
+        return nullptr;
+    }
+    
+    VirtualMachine *vm = new VirtualMachine(name, this);
+    vm->setBackend("libvirt");
+    vm->setUUID(domain.firstChildElement("uuid").text());
+    vm->setDescription(domain.firstChildElement("description").text());
+    vm->setState("shut off");
+    
+    QDomElement memory = domain.firstChildElement("memory");
+    if (!memory.isNull()) {
+        vm->setMemoryMB(int(libvirtSizeToMB(memory)));
+    }
+    
+    int vcpus = domain.firstChildElement("vcpu").text().toInt();
+    if (vcpus > 0) {
+        vm->setCPUCount(vcpus);
+    }
+    
+    // Modelo y topología de CPU
+    QDomElement cpu = domain.firstChildElement("cpu");
+    QString cpuMode = cpu.attribute("mode", "custom");
+    if (cpuMode == "host-passthrough" || cpuMode == "host-model") {
+        vm->setCPUModel(cpuMode);
+    } else if (!cpu.firstChildElement("model").text().isEmpty()) {
+        vm->setCPUModel(cpu.firstChildElement("model").text());
+    } else {
+        vm->setCPUModel("qemu64");
+    }
+    QDomElement topology = cpu.firstChildElement("topology");
+    if (!topology.isNull() && vcpus > 0) {
+        vm->setCPUTopology(topology.attribute("sockets", "1").toInt(), topology.attribute("dies", "1").toInt(),
+                           topology.attribute("cores", "1").toInt(), topology.attribute("threads", "1").toInt());
+    }
+    
+    // Tipo de sistema desde los metadatos de libosinfo, si existen
+    QDomNodeList osInfo = doc.elementsByTagName("libosinfo:os");
+    QString osId = osInfo.isEmpty() ? QString() : osInfo.at(0).toElement().attribute("id");
+    if (osId.contains("microsoft.com")) {
+        vm->setOSType("Windows");
+    } else if (osId.contains("apple.com")) {
+        vm->setOSType("macOS");
+    } else {
+        vm->setOSType("Linux");
+    }
+    
+    // Orden de arranque
+    QStringList bootOrder;
+    QDomElement boot = domain.firstChildElement("os").firstChildElement("boot");
+    while (!boot.isNull()) {
+        QString dev = boot.attribute("dev");
+        if (dev == "hd") {
+            bootOrder << "Hard Disk";
+        } else if (dev == "cdrom") {
+            bootOrder << "CD/DVD";
+        } else if (dev == "network") {
+            bootOrder << "Network";
+        } else if (dev == "fd") {
+            bootOrder << "Floppy";
+        }
+        boot = boot.nextSiblingElement("boot");
+    }
+    if (!bootOrder.isEmpty()) {
+        vm->setBootOrder(bootOrder);
+    }
+    
+    QDomElement devices = domain.firstChildElement("devices");
+    
+    // Discos y CD-ROM
+    QStringList hardDisks;
+    QDomElement disk = devices.firstChildElement("disk");
+    while (!disk.isNull()) {
+        QDomElement source = disk.firstChildElement("source");
+        QString path = source.attribute("file", source.attribute("dev", source.attribute("name")));
+        if (disk.attribute("device", "disk") == "disk" && !path.isEmpty()) {
+            hardDisks.append(path);
+            QString format = disk.firstChildElement("driver").attribute("type");
+            if (!format.isEmpty()) {
+                vm->setDiskFormat(path, format);
+            }
+        } else if (disk.attribute("device") == "cdrom" && !path.isEmpty()) {
+            vm->setCDROMImage(path);
+        }
+        disk = disk.nextSiblingElement("disk");
+    }
+    vm->setHardDisks(hardDisks);
+    
+    // Interfaces de red
+    QStringList adapters;
+    QDomElement nic = devices.firstChildElement("interface");
+    while (!nic.isNull()) {
+        QString type = nic.attribute("type");
+        QDomElement source = nic.firstChildElement("source");
+        if (type == "network" && source.attribute("network") == "default") {
+            adapters << "NAT";
+        } else if (type == "network") {
+            adapters << QString("Red: %1").arg(source.attribute("network"));
+        } else if (type == "bridge") {
+            adapters << QString("Puente: %1").arg(source.attribute("bridge"));
+        } else {
+            adapters << type;
+        }
+        nic = nic.nextSiblingElement("interface");
+    }
+    vm->setNetworkAdapters(adapters);
+    
+    // Vídeo
+    QDomElement videoModel = devices.firstChildElement("video").firstChildElement("model");
+    if (!videoModel.isNull()) {
+        int vram = videoModel.attribute("vram").toInt();
+        if (vram > 0) {
+            vm->setVideoMemoryMB(vram / 1024);
+        }
+        vm->setMonitorCount(qMax(1, videoModel.attribute("heads", "1").toInt()));
+    }
+    
+    return vm;
+}
+
+QJsonObject KVMManager::syncLibvirtDomains(bool fullRefresh)
+{
+    // El XML de los dominios llega por lotes de hasta un minuto cada uno
+    QJsonValue summary;
+    bool ok = waitForResult([this, fullRefresh](VMBackend::Callback callback) {
+        syncLibvirtDomainsAsync(fullRefresh, callback);
+    }, &summary, 10 * 60000);
+    return ok ? summary.toObject() : QJsonObject();
+}
+
+// Estado de una sincronización con libvirt entre las respuestas de virsh
+struct KVMManager::LibvirtSync {
+    bool fullRefresh = false;
+    QElapsedTimer timer;
+    int domains = 0;
+    QHash<QString, QString> states;     // nombre -> estado
+    QHash<QString, QString> known;      // UUID -> nombre de las VMs de libvirt ya conocidas
+    QStringList toFetch;
+    QStringList removed;                // UUIDs conocidos que libvirt ya no tiene
+    int imported = 0;
+    int updated = 0;
+    int skipped = 0;
+    QStringList createdNames;
+    QStringList deletedNames;
+};
+
+void KVMManager::syncLibvirtDomainsAsync(bool fullRefresh, VMBackend::Callback callback)
+{
+    auto finish = [this, callback](const VMBackend::Result &result) {
+        m_libvirtSyncing = false;
+        if (!result.ok) {
+            emit errorOccurred(result.error);
+        }
+        if (callback) {
+            callback(result);
+        }
+    };
+    
+    LibvirtBackend *libvirt = qobject_cast<LibvirtBackend*>(getBackend("libvirt"));
+    if (!libvirt || !libvirt->isAvailable()) {
+        emit errorOccurred(tr("Libvirt no está disponible"));
+        if (callback) {
+            callback(VMBackend::failure(tr("Libvirt no está disponible")));
+        }
+        return;
+    }
+    // Dos a la vez importarían los mismos dominios dos veces
+    if (m_libvirtSyncing) {
+        emit errorOccurred(tr("Ya hay una sincronización con libvirt en curso"));
+        if (callback) {
+            callback(VMBackend::failure(tr("Ya hay una sincronización con libvirt en curso")));
+        }
+        return;
+    }
+    m_libvirtSyncing = true;
+    
+    auto sync = QSharedPointer<LibvirtSync>::create();
+    sync->fullRefresh = fullRefresh;
+    sync->timer.start();
+    
+    // Una llamada enumera todos los dominios y otra obtiene su estado
+    libvirt->session()->executeBatchAsync(QList<QStringList>()
+        << (QStringList() << "list" << "--all" << "--uuid" << "--name")
+        << (QStringList() << "list" << "--all"),
+        [this, sync, finish](const QList<VirshSession::Result> &listing) {
+        if (!listing[0].ok) {
+            finish(VMBackend::failure(tr("Error enumerando dominios de libvirt: %1").arg(listing[0].error)));
+            return;
+        }
+        planLibvirtSync(sync, listing[0].output, listing[1].output);
+        fetchLibvirtDomains(sync, 0, finish);
+    });
+}
+
+void KVMManager::planLibvirtSync(const QSharedPointer<LibvirtSync> &sync, const QString &uuidListing,
+                                 const QString &stateListing)
+{
+    // "<uuid> <nombre>" por línea
+    QStringList domainUuids;
+    QHash<QString, QString> domainNames;
+    for (const QString &line : uuidListing.split('\n', Qt::SkipEmptyParts)) {
+        QString simplified = line.simplified();
+        QString uuid = simplified.section(' ', 0, 0).toLower();
+        QString name = simplified.section(' ', 1);
+        if (!uuid.isEmpty() && !name.isEmpty()) {
+            domainUuids.append(uuid);
+            domainNames[uuid] = name;
+        }
+    }
+    sync->domains = domainUuids.size();
+    
+    // Tabla " Id   Name   State"; el estado puede tener espacios ("shut off")
+    static const QRegularExpression stateLine(R"(^\s*(\S+)\s+(\S+)\s+(.+)$)");
+    for (const QString &line : stateListing.split('\n', Qt::SkipEmptyParts)) {
+        QRegularExpressionMatch match = stateLine.match(line);
+        if (match.hasMatch() && match.captured(1) != "Id" && !line.trimmed().startsWith("---")) {
+            sync->states[match.captured(2)] = match.captured(3).trimmed();
+        }
+    }
+    
+    // VMs de libvirt ya conocidas, indexadas por UUID
+    for (VirtualMachine *vm : m_virtualMachines) {
+        if (vm->getBackend() == "libvirt") {
+            sync->known[vm->getUUID().toLower()] = vm->getName();
+        }
+    }
+    
+    for (const QString &uuid : domainUuids) {
+        QString name = domainNames[uuid];
+        VirtualMachine *vm = libvirtVM(sync->known.value(uuid), uuid);
+        
+        // Dominio sin cambios de identidad: sólo se actualiza el estado
+        if (vm && vm->getName() == name && !sync->fullRefresh) {
+            QString state = sync->states.value(name);
+            if (!state.isEmpty() && state != vm->getState()) {
+                vm->setState(state);
+                emit vmStateChanged(name, state);
+            }
+            sync->updated++;
+            continue;
+        }
+        
+        VirtualMachine *existing = getVirtualMachine(name);
+        if (existing && existing != vm) {
+            qWarning() << "KVMManager: Dominio de libvirt omitido, ya existe una VM llamada" << name;
+            sync->skipped++;
+            continue;
+        }
+        
+        sync->toFetch.append(uuid);
+    }
+    
+    for (auto it = sync->known.constBegin(); it != sync->known.constEnd(); ++it) {
+        if (!domainNames.contains(it.key())) {
+            sync->removed.append(it.key());
+        }
+    }
+}
+
+void KVMManager::fetchLibvirtDomains(const QSharedPointer<LibvirtSync> &sync, int offset, VMBackend::Callback done)
+{
+    LibvirtBackend *libvirt = qobject_cast<LibvirtBackend*>(getBackend("libvirt"));
+    if (offset >= sync->toFetch.size() || !libvirt) {
+        finishLibvirtSync(sync, done);
+        return;
+    }
+    
+    // El XML de los dominios se pide por lotes en la misma sesión
+    const int batchSize = 100;
+    QStringList batch = sync->toFetch.mid(offset, batchSize);
+    QList<QStringList> commands;
+    for (const QString &uuid : batch) {
+        commands.append(QStringList() << "dumpxml" << uuid);
+    }
+    
+    libvirt->session()->executeBatchAsync(commands, [this, sync, batch, offset, batchSize, done](const QList<VirshSession::Result> &results) {
+        // El guardado no debe refrescar la interfaz por cada VM
+        QSignalBlocker blocker(m_xmlManager);
+        for (int i = 0; i < batch.size(); ++i) {
+            VirtualMachine *parsed = results[i].ok ? parseVMInfo(results[i].output) : nullptr;
+            if (!parsed) {
+                qWarning() << "KVMManager: No se pudo importar el dominio" << batch[i] << results[i].error;
+                sync->skipped++;
+                continue;
+            }
+            
+            // Mientras se esperaba el XML pudo borrarse la entrada o ocuparse el nombre
+            VirtualMachine *previous = libvirtVM(sync->known.value(batch[i]), batch[i]);
+            VirtualMachine *existing = getVirtualMachine(parsed->getName());
+            if (existing && existing != previous) {
+                qWarning() << "KVMManager: Dominio de libvirt omitido, ya existe una VM llamada" << parsed->getName();
+                delete parsed;
+                sync->skipped++;
+                continue;
+            }
+            
+            QString state = sync->states.value(parsed->getName());
+            if (!state.isEmpty()) {
+                parsed->setState(state);
+            }
+            
+            if (previous) {
+                // Dominio renombrado o refresco completo: sustituir la entrada
+                if (previous->getName() != parsed->getName()) {
+                    sync->deletedNames.append(previous->getName());
+                    sync->createdNames.append(parsed->getName());
+                }
+                removeVMEntry(previous);
+                sync->updated++;
+            } else {
+                sync->createdNames.append(parsed->getName());
+                sync->imported++;
+            }
+            
+            m_xmlManager->saveVM(parsed);
+            m_virtualMachines.append(parsed);
+        }
+        blocker.unblock();
+        fetchLibvirtDomains(sync, offset + batchSize, done);
+    });
+}
+
+void KVMManager::finishLibvirtSync(const QSharedPointer<LibvirtSync> &sync, VMBackend::Callback done)
+{
+    int removed = 0;
+    {
+        QSignalBlocker blocker(m_xmlManager);
+        for (const QString &uuid : sync->removed) {
+            if (VirtualMachine *vm = libvirtVM(sync->known.value(uuid), uuid)) {
+                sync->deletedNames.append(vm->getName());
+                removeVMEntry(vm);
+                removed++;
+            }
+        }
+    }
+    
+    for (const QString &name : sync->deletedNames) {
+        emit vmDeleted(name);
+    }
+    for (const QString &name : sync->createdNames) {
+        emit vmCreated(name);
+    }
+    emit vmListChanged();
+    
+    QJsonObject summary;
+    summary["domains"] = sync->domains;
+    summary["imported"] = sync->imported;
+    summary["updated"] = sync->updated;
+    summary["removed"] = removed;
+    summary["skipped"] = sync->skipped;
+    summary["elapsedMs"] = sync->timer.elapsed();
+    
+    qDebug() << "KVMManager: Sincronización con libvirt:" << summary;
+    done(VMBackend::success(summary));
+}
+
+VirtualMachine *KVMManager::libvirtVM(const QString &name, const QString &uuid) const
+{
+    VirtualMachine *vm = name.isEmpty() ? nullptr : getVirtualMachine(name);
+    return vm && vm->getBackend() == "libvirt" && vm->getUUID().toLower() == uuid ? vm : nullptr;
+}
+
+void KVMManager::recordDiskFormats(VirtualMachine *vm)
+{
+    // Disks from older configurations are probed once and the format is
+    // stored; later starts never look at the (guest-writable) header again
+    bool changed = false;
+    for (const QString &disk : vm->getHardDisks()) {
+        if (!vm->getDiskFormat(disk).isEmpty()) {
+            continue;
+        }
+        DiskImageProbe::Info info = DiskImageProbe::probe(disk);
+        if (info.valid) {
+            vm->setDiskFormat(disk, info.format);
+            changed = true;
+        }
+    }
+    
+    if (changed) {
+        m_xmlManager->saveVM(vm);
+    }
+}
+
+void KVMManager::removeVMEntry(VirtualMachine *vm)
+{
+    // Sólo la configuración local: los discos pertenecen al dominio de libvirt
+    m_xmlManager->deleteVM(vm->getName());
+    m_virtualMachines.removeAll(vm);
+    delete vm;
+}
+
 QStringList KVMManager::getVirtualMachines() const
 {
     QStringList names;
@@ -161,11 +611,69 @@ VirtualMachine* KVMManager::getVirtualMachine(const QString &name) const
 
 bool KVMManager::createVirtualMachine(const QString &name, const QString &osType, 
                                     int memoryMB, int diskSizeGB)
+{
+    QString diskPath;
+    VirtualMachine *vm = prepareVirtualMachine(name, osType, memoryMB, &diskPath);
+    if (!vm) {
+        return false;
+    }
+    
+    // Create disk with the specified size (use diskSizeGB parameter)
+    qDebug() << "KVMManager: Creando disco de" << diskSizeGB << "GB en" << diskPath;
+    if (!m_qemuManager->createDisk(diskPath, "qcow2", diskSizeGB, false)) {
+        delete vm;
+        emit errorOccurred(tr("No se pudo crear el disco virtual para '%1'").arg(name));
+        return false;
+    }
+    return registerVirtualMachine(vm, diskPath);
+}
+
+void KVMManager::createVirtualMachineAsync(const QString &name, const QString &osType,
+                                           int memoryMB, int diskSizeGB, VMBackend::Callback callback)
+{
+    QString diskPath;
+    VirtualMachine *vm = prepareVirtualMachine(name, osType, memoryMB, &diskPath);
+    if (!vm) {
+        callback(VMBackend::failure(tr("No se pudo crear la máquina virtual '%1'").arg(name)));
+        return;
+    }
+    
+    // qemu-img runs in the background: the same name may be taken meanwhile
+    qDebug() << "KVMManager: Creando disco de" << diskSizeGB << "GB en" << diskPath;
+    QPointer<VirtualMachine> guard(vm);
+    m_qemuManager->createDiskAsync(diskPath, "qcow2", diskSizeGB, false,
+                                   [this, guard, name, diskPath, callback](bool ok) {
+        if (!guard) {
+            callback(VMBackend::failure(tr("No se pudo crear la máquina virtual '%1'").arg(name)));
+            return;
+        }
+        QString error;
+        if (!ok) {
+            error = tr("No se pudo crear el disco virtual para '%1'").arg(name);
+        } else if (m_xmlManager->vmExists(name) || getVirtualMachine(name)) {
+            error = tr("Ya existe una máquina virtual con el nombre '%1'").arg(name);
+        }
+        if (!error.isEmpty()) {
+            delete guard.data();
+            emit errorOccurred(error);
+            callback(VMBackend::failure(error));
+            return;
+        }
+        if (!registerVirtualMachine(guard.data(), diskPath)) {
+            callback(VMBackend::failure(tr("No se pudo guardar la configuración de '%1'").arg(name)));
+            return;
+        }
+        callback(VMBackend::success(name));
+    });
+}
+
+VirtualMachine *KVMManager::prepareVirtualMachine(const QString &name, const QString &osType,
+                                                  int memoryMB, QString *diskPath)
 {
     // Check if VM already exists
     if (m_xmlManager->vmExists(name)) {
         emit errorOccurred(tr("Ya existe una máquina virtual con el nombre '%1'").arg(name));
-        return false;
+        return nullptr;
     }
     
     // Create new VM object
@@ -174,24 +682,30 @@ bool KVMManager::createVirtualMachine(const QString &name, const QString &osType
     vm->setMemoryMB(memoryMB);
     vm->setState("shut off");
     
+    // Linux guests ship virtio drivers; other systems keep emulated devices
+    // so that their installers can see the disk
+    if (osType == "Linux") {
+        vm->setDeviceProfile("q35-virtio");
+    }
+    
     // Generate UUID
     QString uuid = QUuid::createUuid().toString(QUuid::WithoutBraces);
     vm->setUUID(uuid);
+    vm->setMacAddress(VirtualMachine::generateMacAddress());
     
     // Create VM directory and disk if needed
     QString vmDir = QDir::homePath() + "/.VM/" + name;
     QDir().mkpath(vmDir);
-    
-    // Create disk with the specified size (use diskSizeGB parameter)
-    QString diskPath = vmDir + "/" + name + ".qcow2";
-    qDebug() << "KVMManager: Creando disco de" << diskSizeGB << "GB en" << diskPath;
-    if (!m_qemuManager->createDisk(diskPath, "qcow2", diskSizeGB, false)) {
-        delete vm;
-        emit errorOccurred(tr("No se pudo crear el disco virtual para '%1'").arg(name));
-        return false;
-    }
-    
+    *diskPath = vmDir + "/" + name + ".qcow2";
+    return vm;
+}
+
+bool KVMManager::registerVirtualMachine(VirtualMachine *vm, const QString &diskPath)
+{
+    const QString name = vm->getName();
     vm->addHardDisk(diskPath);
+    vm->setDiskFormat(diskPath, "qcow2");
+    vm->setDiskTuning(diskPath, QemuManager::defaultDiskTuning(diskPath, vm->getDeviceProfile()));
     
     // Save VM to XML
     if (m_xmlManager->saveVM(vm)) {
@@ -214,15 +728,36 @@ bool KVMManager::deleteVirtualMachine(const QString &name)
         return false;
     }
     
+    // Sus discos son la base de otros clones: borrarlos los dejaría inservibles
+    QStringList linkedClones = getLinkedClones(name);
+    if (!linkedClones.isEmpty()) {
+        emit errorOccurred(tr("No se puede eliminar '%1': es la base de los clones enlazados %2")
+                           .arg(name, linkedClones.join(", ")));
+        return false;
+    }
+    
     // Get disk paths before deleting VM
     QStringList diskPaths = vm->getHardDisks();
     
+    // After a checkpoint the disks are only the top overlays; the frozen
+    // images below them may still back another VM (an instant clone's disks)
+    QStringList otherImages;
+    for (VirtualMachine *other : m_virtualMachines) {
+        if (other != vm && other->getBackend() == "qemu") {
+            otherImages.append(other->getHardDisks());
+            otherImages.append(QemuManager::checkpointImages(other->getName()));
+        }
+    }
+    QSet<QString> inUse = backingImages(otherImages);
+    
     // Delete XML file first
     if (m_xmlManager->deleteVM(name)) {
         // Delete associated disk files
         for (const QString &diskPath : diskPaths) {
             QFile diskFile(diskPath);
-            if (diskFile.exists()) {
+            if (inUse.contains(QFileInfo(diskPath).absoluteFilePath())) {
+                qDebug() << "KVMManager: Disco conservado, lo usa otra VM:" << diskPath;
+            } else if (diskFile.exists()) {
                 if (diskFile.remove()) {
                     qDebug() << "KVMManager: Disco eliminado:" << diskPath;
                 } else {
@@ -231,12 +766,35 @@ bool KVMManager::deleteVirtualMachine(const QString &name)
             }
         }
         
-        // Delete VM directory if empty
+        // Delete the VM directory (checkpoints with their RAM and frozen
+        // images included), keeping only the images other VMs still use
         QString vmDir = QDir::homePath() + "/.VM/" + name;
         QDir dir(vmDir);
-        if (dir.exists() && dir.isEmpty()) {
-            dir.rmdir(vmDir);
-            qDebug() << "KVMManager: Directorio VM eliminado:" << vmDir;
+        if (dir.exists()) {
+            QDirIterator files(vmDir, QDir::Files | QDir::Hidden | QDir::System, QDirIterator::Subdirectories);
+            while (files.hasNext()) {
+                QString path = files.next();
+                if (!inUse.contains(QFileInfo(path).absoluteFilePath())) {
+                    QFile::remove(path);
+                }
+            }
+            QDirIterator folders(vmDir, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+            QStringList subdirectories;
+            while (folders.hasNext()) {
+                subdirectories.append(folders.next());
+            }
+            // Deepest first; rmdir leaves the folders that still hold images
+            std::sort(subdirectories.begin(), subdirectories.end(), [](const QString &a, const QString &b) {
+                return a.count('/') > b.count('/');
+            });
+            for (const QString &subdirectory : subdirectories) {
+                dir.rmdir(subdirectory);
+            }
+            if (dir.rmdir(vmDir)) {
+                qDebug() << "KVMManager: Directorio VM eliminado:" << vmDir;
+            } else {
+                qDebug() << "KVMManager: Directorio VM conservado con imágenes en uso:" << vmDir;
+            }
         }
         
         // Remove from memory list
@@ -251,40 +809,23 @@ bool KVMManager::deleteVirtualMachine(const QString &name)
     }
 }
 
-bool KVMManager::cloneVirtualMachine(const QString &sourceName, const QString &cloneName)
+bool KVMManager::cloneVirtualMachine(const QString &sourceName, const QString &cloneName,
+                                     const QString &snapshot)
 {
-    // Verificar que la VM origen existe
-    VirtualMachine *sourceVM = getVirtualMachine(sourceName);
-    if (!sourceVM) {
-        emit errorOccurred(tr("La máquina virtual '%1' no existe").arg(sourceName));
-        return false;
-    }
-    
-    // Verificar que el nombre del clon no existe
-    if (getVirtualMachine(cloneName)) {
-        emit errorOccurred(tr("Ya existe una máquina virtual con el nombre '%1'").arg(cloneName));
-        return false;
-    }
-    
-    qDebug() << "KVMManager: Iniciando clonado de" << sourceName << "a" << cloneName;
-    
-    // Crear directorio para el clon
-    QString cloneDir = QDir::homePath() + "/.VM/" + cloneName;
-    QDir dir;
-    if (!dir.mkpath(cloneDir)) {
-        emit errorOccurred(tr("No se pudo crear el directorio para el clon: %1").arg(cloneDir));
+    QString cloneDir = prepareClone(sourceName, cloneName);
+    if (cloneDir.isEmpty()) {
         return false;
     }
     
     // Clonar los discos duros
-    QStringList sourceDisks = sourceVM->getHardDisks();
+    QStringList sourceDisks = getVirtualMachine(sourceName)->getHardDisks();
     for (const QString &sourceDiskPath : sourceDisks) {
         QFileInfo sourceInfo(sourceDiskPath);
         QString cloneDiskPath = cloneDir + "/" + cloneName + "." + sourceInfo.suffix();
         
         qDebug() << "KVMManager: Clonando disco de" << sourceDiskPath << "a" << cloneDiskPath;
         
-        if (!m_qemuManager->copyDisk(sourceDiskPath, cloneDiskPath)) {
+        if (!m_qemuManager->copyDisk(sourceDiskPath, cloneDiskPath, snapshot)) {
             emit errorOccurred(tr("Error al clonar el disco: %1 -> %2").arg(sourceDiskPath).arg(cloneDiskPath));
             
             // Limpiar archivos parciales en caso de error
@@ -296,124 +837,1623 @@ bool KVMManager::cloneVirtualMachine(const QString &sourceName, const QString &c
         qDebug() << "KVMManager: Disco clonado exitosamente:" << cloneDiskPath;
     }
     
-    // Clonar la configuración XML
-    if (!m_xmlManager->cloneVM(sourceName, cloneName)) {
-        emit errorOccurred(tr("Error al clonar la configuración XML"));
-        
-        // Limpiar archivos en caso de error
-        QDir cleanupDir(cloneDir);
-        cleanupDir.removeRecursively();
-        return false;
-    }
-    
-    // Recargar las VMs para incluir el clon
-    loadVirtualMachines();
-    
-    emit vmCreated(cloneName);
-    qDebug() << "KVMManager: VM clonada exitosamente:" << cloneName;
-    
-    return true;
+    return registerClone(sourceName, cloneName);
 }
 
-bool KVMManager::startVM(const QString &name)
+void KVMManager::cloneVirtualMachineAsync(const QString &sourceName, const QString &cloneName,
+                                          const QString &snapshot, VMBackend::Callback callback)
 {
-    VirtualMachine *vm = getVirtualMachine(name);
-    if (!vm) {
-        emit errorOccurred(tr("Máquina virtual '%1' no encontrada").arg(name));
-        return false;
+    QString cloneDir = prepareClone(sourceName, cloneName);
+    if (cloneDir.isEmpty()) {
+        callback(VMBackend::failure(tr("No se pudo clonar '%1'").arg(sourceName)));
+        return;
     }
     
-    // Usar QemuManager para iniciar la VM
-    if (m_qemuManager->startVM(vm)) {
-        emit vmStateChanged(name, "running");
-        return true;
-    } else {
-        // El error ya se emitirá desde QemuManager
-        return false;
+    QList<QPair<QString, QString>> copies;
+    for (const QString &sourceDiskPath : getVirtualMachine(sourceName)->getHardDisks()) {
+        copies.append(qMakePair(sourceDiskPath,
+                                cloneDir + "/" + cloneName + "." + QFileInfo(sourceDiskPath).suffix()));
     }
+    copyCloneDisks(sourceName, cloneName, snapshot, copies, 0, callback);
 }
 
-bool KVMManager::stopVM(const QString &name)
+void KVMManager::copyCloneDisks(const QString &sourceName, const QString &cloneName, const QString &snapshot,
+                                const QList<QPair<QString, QString>> &copies, int index, VMBackend::Callback callback)
 {
-    if (!m_libvirtRunning) {
-        emit errorOccurred(tr("Libvirt no está disponible"));
-        return false;
+    if (index >= copies.size()) {
+        // Las copias pueden tardar minutos: el nombre puede haberse ocupado
+        // entretanto, y su directorio ya no es sólo del clon
+        if (getVirtualMachine(cloneName) || m_xmlManager->vmExists(cloneName)) {
+            QString error = tr("Ya existe una máquina virtual con el nombre '%1'").arg(cloneName);
+            emit errorOccurred(error);
+            callback(VMBackend::failure(error));
+            return;
+        }
+        if (!registerClone(sourceName, cloneName)) {
+            callback(VMBackend::failure(tr("No se pudo clonar '%1'").arg(sourceName)));
+            return;
+        }
+        callback(VMBackend::success(cloneName));
+        return;
     }
     
-    QProcess process;
-    process.start("virsh", QStringList() << "shutdown" << name);
-    process.waitForFinished();
-    
-    if (process.exitCode() == 0) {
-        emit vmStateChanged(name, "shut off");
-        return true;
-    } else {
-        QString error = process.readAllStandardError();
-        emit errorOccurred(tr("Error al detener VM '%1': %2").arg(name, error));
+    const QPair<QString, QString> copy = copies.at(index);
+    qDebug() << "KVMManager: Clonando disco de" << copy.first << "a" << copy.second;
+    m_qemuManager->copyDiskAsync(copy.first, copy.second, snapshot,
+                                 [this, sourceName, cloneName, snapshot, copies, index, callback](bool ok) {
+        if (!ok) {
+            QString error = tr("Error al clonar el disco: %1 -> %2").arg(copies.at(index).first, copies.at(index).second);
+            emit errorOccurred(error);
+            QDir(QFileInfo(copies.at(index).second).absolutePath()).removeRecursively();
+            callback(VMBackend::failure(error));
+            return;
+        }
+        copyCloneDisks(sourceName, cloneName, snapshot, copies, index + 1, callback);
+    });
+}
+
+QString KVMManager::prepareClone(const QString &sourceName, const QString &cloneName)
+{
+    // Verificar que la VM origen existe
+    VirtualMachine *sourceVM = getVirtualMachine(sourceName);
+    if (!sourceVM) {
+        emit errorOccurred(tr("La máquina virtual '%1' no existe").arg(sourceName));
+        return QString();
+    }
+    
+    // Verificar que el nombre del clon no existe
+    if (getVirtualMachine(cloneName)) {
+        emit errorOccurred(tr("Ya existe una máquina virtual con el nombre '%1'").arg(cloneName));
+        return QString();
+    }
+    
+    qDebug() << "KVMManager: Iniciando clonado de" << sourceName << "a" << cloneName;
+    
+    // Crear directorio para el clon
+    QString cloneDir = QDir::homePath() + "/.VM/" + cloneName;
+    QDir dir;
+    if (!dir.mkpath(cloneDir)) {
+        emit errorOccurred(tr("No se pudo crear el directorio para el clon: %1").arg(cloneDir));
+        return QString();
+    }
+    return cloneDir;
+}
+
+bool KVMManager::registerClone(const QString &sourceName, const QString &cloneName)
+{
+    QString cloneDir = QDir::homePath() + "/.VM/" + cloneName;
+    
+    // Clonar la configuración XML
+    if (!m_xmlManager->cloneVM(sourceName, cloneName)) {
+        emit errorOccurred(tr("Error al clonar la configuración XML"));
+        
+        // Limpiar archivos en caso de error
+        QDir cleanupDir(cloneDir);
+        cleanupDir.removeRecursively();
+        return false;
+    }
+    
+    // Sólo se carga el clon: recargar todas las VMs destruiría objetos que
+    // las operaciones en curso todavía usan
+    VirtualMachine *cloneVM = m_xmlManager->loadVM(cloneName);
+    if (!cloneVM) {
+        emit errorOccurred(tr("No se pudo cargar la configuración del clon '%1'").arg(cloneName));
+        m_xmlManager->deleteVM(cloneName);
+        QDir(cloneDir).removeRecursively();
+        return false;
+    }
+    m_virtualMachines.append(cloneVM);
+    
+    emit vmListChanged();
+    emit vmCreated(cloneName);
+    qDebug() << "KVMManager: VM clonada exitosamente:" << cloneName;
+    
+    return true;
+}
+
+bool KVMManager::createLinkedClone(const QString &sourceName, const QString &cloneName)
+{
+    VirtualMachine *sourceVM = getVirtualMachine(sourceName);
+    if (!sourceVM) {
+        emit errorOccurred(tr("La máquina virtual '%1' no existe").arg(sourceName));
+        return false;
+    }
+    if (sourceVM->getBackend() != "qemu") {
+        emit errorOccurred(tr("Los clones enlazados sólo están disponibles con el backend QEMU"));
+        return false;
+    }
+    if (getVirtualMachine(cloneName)) {
+        emit errorOccurred(tr("Ya existe una máquina virtual con el nombre '%1'").arg(cloneName));
+        return false;
+    }
+    
+    // Una capa vacía por disco: el clon sólo ocupa lo que escribe
+    QString cloneDir = QemuManager::vmDirectory(cloneName);
+    if (!QDir().mkpath(cloneDir)) {
+        emit errorOccurred(tr("No se pudo crear el directorio para el clon: %1").arg(cloneDir));
+        return false;
+    }
+    
+    QStringList sourceDisks = sourceVM->getHardDisks();
+    QStringList overlays;
+    for (int i = 0; i < sourceDisks.size(); ++i) {
+        QString overlay = linkedCloneOverlay(cloneName, i);
+        if (!m_qemuManager->createOverlayDisk(sourceDisks.at(i), overlay)) {
+            QDir(cloneDir).removeRecursively();
+            return false;
+        }
+        overlays.append(overlay);
+    }
+    
+    return registerLinkedClone(sourceName, cloneName, overlays, tr("Clon enlazado de %1").arg(sourceName));
+}
+
+QString KVMManager::linkedCloneOverlay(const QString &cloneName, int index)
+{
+    return QemuManager::vmDirectory(cloneName) + "/" + cloneName
+           + (index > 0 ? QString("-%1").arg(index) : QString()) + ".qcow2";
+}
+
+bool KVMManager::registerLinkedClone(const QString &sourceName, const QString &cloneName,
+                                     const QStringList &overlays, const QString &description)
+{
+    QString cloneDir = QemuManager::vmDirectory(cloneName);
+    if (!m_xmlManager->cloneVM(sourceName, cloneName)) {
+        emit errorOccurred(tr("Error al clonar la configuración XML"));
+        QDir(cloneDir).removeRecursively();
+        return false;
+    }
+    
+    // Sólo se carga el clon: recargar todas las VMs costaría una lectura de
+    // XML por VM existente en cada clon de una tanda
+    VirtualMachine *cloneVM = m_xmlManager->loadVM(cloneName);
+    if (!cloneVM) {
+        m_xmlManager->deleteVM(cloneName);
+        QDir(cloneDir).removeRecursively();
+        return false;
+    }
+    m_virtualMachines.append(cloneVM);
+    
+    // cloneVM deduce las rutas de los discos del nombre; aquí son las capas
+    QStringList cloneDisks = cloneVM->getHardDisks();
+    for (int i = 0; i < cloneDisks.size() && i < overlays.size(); ++i) {
+        cloneVM->replaceHardDisk(cloneDisks.at(i), overlays.at(i), "qcow2");
+    }
+    cloneVM->setDescription(description);
+    saveVMConfiguration(cloneVM);
+    
+    emit vmListChanged();
+    emit vmCreated(cloneName);
+    qDebug() << "KVMManager: Clon enlazado creado:" << cloneName << "sobre" << sourceName;
+    return true;
+}
+
+QStringList KVMManager::getTemplates() const
+{
+    QStringList templates;
+    for (VirtualMachine *vm : m_virtualMachines) {
+        if (vm->isTemplate()) {
+            templates.append(vm->getName());
+        }
+    }
+    return templates;
+}
+
+bool KVMManager::setVMTemplate(const QString &name, bool isTemplate)
+{
+    VirtualMachine *vm = getVirtualMachine(name);
+    if (!vm) {
+        emit errorOccurred(tr("Máquina virtual '%1' no encontrada").arg(name));
+        return false;
+    }
+    if (vm->isTemplate() == isTemplate) {
+        return true;
+    }
+    if (isTemplate) {
+        if (vm->getBackend() != "qemu") {
+            emit errorOccurred(tr("Las plantillas sólo están disponibles con el backend QEMU"));
+            return false;
+        }
+        // La plantilla se congela tal como está: sin invitado en marcha ni memoria guardada
+        if (!vm->isStopped() || QemuManager::hasSavedState(name)) {
+            emit errorOccurred(tr("'%1' debe estar apagada (y sin estado guardado) para convertirla en plantilla").arg(name));
+            return false;
+        }
+        if (vm->getHardDisks().isEmpty()) {
+            emit errorOccurred(tr("'%1' no tiene discos que sirvan de base").arg(name));
+            return false;
+        }
+    }
+    
+    // Discos de sólo lectura: nada puede escribir en la base de los clones por
+    // error; qemu-img y QEMU abren así las imágenes de respaldo
+    const QFileDevice::Permissions writable = QFileDevice::WriteOwner | QFileDevice::WriteUser;
+    for (const QString &disk : vm->getHardDisks()) {
+        QFileDevice::Permissions permissions = QFile::permissions(disk);
+        permissions = isTemplate
+            ? permissions & ~(writable | QFileDevice::WriteGroup | QFileDevice::WriteOther)
+            : permissions | writable;
+        if (!QFile::setPermissions(disk, permissions)) {
+            emit errorOccurred(tr("No se pudieron cambiar los permisos de %1").arg(disk));
+            return false;
+        }
+    }
+    
+    vm->setTemplate(isTemplate);
+    saveVMConfiguration(vm);
+    emit vmStateChanged(name, vm->getState());
+    qDebug() << "KVMManager:" << name << (isTemplate ? "es ahora una plantilla" : "ya no es una plantilla");
+    return true;
+}
+
+bool KVMManager::createVMFromTemplate(const QString &templateName, const QString &name)
+{
+    VirtualMachine *templateVM = getVirtualMachine(templateName);
+    if (!templateVM || !templateVM->isTemplate()) {
+        emit errorOccurred(tr("'%1' no es una plantilla").arg(templateName));
+        return false;
+    }
+    if (!createLinkedClone(templateName, name)) {
+        return false;
+    }
+    
+    VirtualMachine *vm = getVirtualMachine(name);
+    vm->setDescription(tr("Creada a partir de la plantilla %1").arg(templateName));
+    saveVMConfiguration(vm);
+    return true;
+}
+
+void KVMManager::createVMFromTemplateAsync(const QString &templateName, const QString &name,
+                                           VMBackend::Callback callback)
+{
+    VirtualMachine *templateVM = getVirtualMachine(templateName);
+    if (!templateVM || !templateVM->isTemplate()) {
+        emit errorOccurred(tr("'%1' no es una plantilla").arg(templateName));
+        callback(VMBackend::failure());
+        return;
+    }
+    if (getVirtualMachine(name)) {
+        emit errorOccurred(tr("Ya existe una máquina virtual con el nombre '%1'").arg(name));
+        callback(VMBackend::failure());
+        return;
+    }
+    
+    createLinkedClonesAsync(templateName, templateVM->getHardDisks(), QStringList{name},
+                            tr("Creada a partir de la plantilla %1").arg(templateName),
+                            [name, callback](const QStringList &created, const QJsonArray &failed) {
+        if (created.isEmpty()) {
+            callback(VMBackend::failure(failed.isEmpty() ? QString()
+                                                         : failed.first().toObject().value("error").toString()));
+            return;
+        }
+        callback(VMBackend::success(name));
+    });
+}
+
+QJsonObject KVMManager::createVMsFromTemplate(const QString &templateName, const QString &prefix, int count)
+{
+    QElapsedTimer timer;
+    timer.start();
+    
+    QStringList names = templateBatchNames(templateName, prefix, count);
+    if (names.isEmpty()) {
+        return QJsonObject();
+    }
+    
+    QJsonArray failed;
+    QStringList created = createLinkedClones(templateName, getVirtualMachine(templateName)->getHardDisks(), names,
+                                             tr("Creada a partir de la plantilla %1").arg(templateName), &failed);
+    return templateBatchResult(templateName, created, failed, timer.elapsed());
+}
+
+void KVMManager::createVMsFromTemplateAsync(const QString &templateName, const QString &prefix, int count,
+                                            VMBackend::Callback callback)
+{
+    QElapsedTimer timer;
+    timer.start();
+    
+    QStringList names = templateBatchNames(templateName, prefix, count);
+    if (names.isEmpty()) {
+        callback(VMBackend::failure());
+        return;
+    }
+    
+    createLinkedClonesAsync(templateName, getVirtualMachine(templateName)->getHardDisks(), names,
+                            tr("Creada a partir de la plantilla %1").arg(templateName),
+                            [this, templateName, timer, callback](const QStringList &created, const QJsonArray &failed) {
+        QJsonObject result = templateBatchResult(templateName, created, failed, timer.elapsed());
+        if (result.isEmpty()) {
+            callback(VMBackend::failure(tr("No se pudo crear ninguna VM desde la plantilla %1").arg(templateName)));
+            return;
+        }
+        callback(VMBackend::success(result));
+    });
+}
+
+QStringList KVMManager::templateBatchNames(const QString &templateName, const QString &prefix, int count)
+{
+    VirtualMachine *templateVM = getVirtualMachine(templateName);
+    if (!templateVM || !templateVM->isTemplate()) {
+        emit errorOccurred(tr("'%1' no es una plantilla").arg(templateName));
+        return QStringList();
+    }
+    if (count < 1) {
+        emit errorOccurred(tr("El número de máquinas debe ser al menos 1"));
+        return QStringList();
+    }
+    return freeVMNames(prefix.isEmpty() ? templateName : prefix, count);
+}
+
+QJsonObject KVMManager::templateBatchResult(const QString &templateName, const QStringList &created,
+                                            const QJsonArray &failed, qint64 msecs) const
+{
+    if (created.isEmpty()) {
+        return QJsonObject();
+    }
+    
+    QJsonObject result;
+    result["template"] = templateName;
+    result["created"] = QJsonArray::fromStringList(created);
+    result["failed"] = failed;
+    result["msecs"] = msecs;
+    qDebug() << "KVMManager:" << created.size() << "VMs creadas desde la plantilla" << templateName
+             << "en" << msecs << "ms";
+    return result;
+}
+
+QStringList KVMManager::freeVMNames(const QString &prefix, int count) const
+{
+    // Primeros nombres libres <prefijo>-1, <prefijo>-2...
+    QStringList names;
+    for (int n = 1; names.size() < count; ++n) {
+        QString name = QString("%1-%2").arg(prefix).arg(n);
+        if (!getVirtualMachine(name) && !m_xmlManager->vmExists(name)
+            && !QFileInfo::exists(QemuManager::vmDirectory(name))) {
+            names.append(name);
+        }
+    }
+    return names;
+}
+
+QStringList KVMManager::createLinkedClones(const QString &sourceName, const QStringList &disks,
+                                           const QStringList &names, const QString &description, QJsonArray *failed)
+{
+    // Las capas de todas las VMs se crean a la vez
+    QList<QPair<QString, QString>> overlays;
+    QStringList prepared = prepareLinkedClones(disks, names, &overlays, failed);
+    QStringList failedOverlays = m_qemuManager->createOverlayDisks(overlays, QThread::idealThreadCount());
+    return registerLinkedClones(sourceName, disks.size(), prepared, failedOverlays, description, failed);
+}
+
+void KVMManager::createLinkedClonesAsync(const QString &sourceName, const QStringList &disks, const QStringList &names,
+                                         const QString &description,
+                                         std::function<void(const QStringList &created, const QJsonArray &failed)> callback)
+{
+    QList<QPair<QString, QString>> overlays;
+    QJsonArray failed;
+    QStringList prepared = prepareLinkedClones(disks, names, &overlays, &failed);
+    int diskCount = disks.size();
+    m_qemuManager->createOverlayDisksAsync(overlays, QThread::idealThreadCount(),
+                                           [this, sourceName, diskCount, prepared, description, failed, callback]
+                                           (const QStringList &failedOverlays) {
+        QJsonArray failures = failed;
+        QStringList created = registerLinkedClones(sourceName, diskCount, prepared, failedOverlays, description,
+                                                   &failures);
+        callback(created, failures);
+    });
+}
+
+QStringList KVMManager::prepareLinkedClones(const QStringList &disks, const QStringList &names,
+                                            QList<QPair<QString, QString>> *overlays, QJsonArray *failed)
+{
+    QStringList prepared;
+    for (const QString &name : names) {
+        if (!QDir().mkpath(QemuManager::vmDirectory(name))) {
+            QJsonObject entry;
+            entry["name"] = name;
+            entry["error"] = tr("No se pudo crear el directorio %1").arg(QemuManager::vmDirectory(name));
+            failed->append(entry);
+            continue;
+        }
+        for (int i = 0; i < disks.size(); ++i) {
+            overlays->append(qMakePair(disks.at(i), linkedCloneOverlay(name, i)));
+        }
+        prepared.append(name);
+    }
+    return prepared;
+}
+
+QStringList KVMManager::registerLinkedClones(const QString &sourceName, int diskCount, const QStringList &prepared,
+                                             const QStringList &failedOverlays, const QString &description,
+                                             QJsonArray *failed)
+{
+    QStringList created;
+    for (const QString &name : prepared) {
+        QStringList cloneOverlays;
+        bool complete = true;
+        for (int i = 0; i < diskCount; ++i) {
+            cloneOverlays.append(linkedCloneOverlay(name, i));
+            complete = complete && !failedOverlays.contains(cloneOverlays.last());
+        }
+        
+        // Sin bloquear, otra petición puede haber tomado el nombre mientras
+        // se creaban las capas
+        bool taken = getVirtualMachine(name) || m_xmlManager->vmExists(name);
+        if (complete && !taken && registerLinkedClone(sourceName, name, cloneOverlays, description)) {
+            created.append(name);
+            continue;
+        }
+        if (!complete && !taken) {
+            QDir(QemuManager::vmDirectory(name)).removeRecursively();
+        }
+        QJsonObject entry;
+        entry["name"] = name;
+        entry["error"] = !complete ? tr("No se pudieron crear las capas de sus discos")
+                         : taken   ? tr("Ya existe una máquina virtual con el nombre '%1'").arg(name)
+                                   : tr("Error al clonar la configuración XML");
+        failed->append(entry);
+    }
+    return created;
+}
+
+QSet<QString> KVMManager::backingImages(const QStringList &images)
+{
+    // Cada imagen con todas sus bases, en rutas absolutas
+    QSet<QString> chain;
+    for (const QString &image : images) {
+        for (const QString &path : DiskImageProbe::backingChain(image)) {
+            chain.insert(QFileInfo(path).absoluteFilePath());
+        }
+    }
+    return chain;
+}
+
+QStringList KVMManager::getLinkedClones(const QString &name) const
+{
+    QStringList clones;
+    VirtualMachine *vm = getVirtualMachine(name);
+    if (!vm || vm->getBackend() != "qemu") {
+        return clones;
+    }
+    
+    QSet<QString> baseDisks;
+    for (const QString &disk : vm->getHardDisks()) {
+        baseDisks.insert(QFileInfo(disk).absoluteFilePath());
+    }
+    
+    // Sólo se leen cabeceras (DiskImageProbe las guarda en caché)
+    for (VirtualMachine *other : m_virtualMachines) {
+        if (other == vm || other->getBackend() != "qemu") {
+            continue;
+        }
+        bool linked = false;
+        for (const QString &disk : other->getHardDisks()) {
+            // El primer elemento de la cadena es el propio disco
+            const QStringList chain = DiskImageProbe::backingChain(disk);
+            for (int i = 1; i < chain.size() && !linked; ++i) {
+                linked = baseDisks.contains(QFileInfo(chain.at(i)).absoluteFilePath());
+            }
+        }
+        if (linked) {
+            clones.append(other->getName());
+        }
+    }
+    return clones;
+}
+
+bool KVMManager::startVM(const QString &name)
+{
+    // The start may wait in the admission queue before reaching the backend
+    int timeoutMs = 60000 + AdmissionController::loadPolicy().queueTimeoutSecs * 1000;
+    return waitForResult([this, name](VMBackend::Callback callback) {
+        startVMAsync(name, callback);
+    }, nullptr, timeoutMs);
+}
+
+bool KVMManager::stopVM(const QString &name)
+{
+    return waitForResult([this, name](VMBackend::Callback callback) {
+        stopVMAsync(name, callback);
+    });
+}
+
+bool KVMManager::pauseVM(const QString &name)
+{
+    return waitForResult([this, name](VMBackend::Callback callback) {
+        pauseVMAsync(name, callback);
+    });
+}
+
+bool KVMManager::resumeVM(const QString &name)
+{
+    return waitForResult([this, name](VMBackend::Callback callback) {
+        resumeVMAsync(name, callback);
+    });
+}
+
+bool KVMManager::resetVM(const QString &name)
+{
+    return waitForResult([this, name](VMBackend::Callback callback) {
+        resetVMAsync(name, callback);
+    });
+}
+
+QJsonObject KVMManager::getVMStats(const QString &name)
+{
+    QJsonValue stats;
+    waitForResult([this, name](VMBackend::Callback callback) {
+        queryVMStats(name, callback);
+    }, &stats);
+    return stats.toObject();
+}
+
+bool KVMManager::setBalloonTarget(const QString &name, qint64 targetMB)
+{
+    return waitForResult([this, name, targetMB](VMBackend::Callback callback) {
+        setBalloonTargetAsync(name, targetMB, callback);
+    });
+}
+
+bool KVMManager::saveVMState(const QString &name, QJsonObject *stats)
+{
+    // Writes the whole guest RAM, like a live snapshot
+    QJsonValue value;
+    bool ok = waitForResult([this, name](VMBackend::Callback callback) {
+        saveVMStateAsync(name, callback);
+    }, &value, snapshotTimeoutMs(name));
+    if (stats) {
+        *stats = value.toObject();
+    }
+    return ok;
+}
+
+QJsonObject KVMManager::getSaveStateStats(const QString &name) const
+{
+    VirtualMachine *vm = getVirtualMachine(name);
+    return vm && vm->getBackend() == "qemu" ? QemuManager::saveStateStats(name) : QJsonObject();
+}
+
+void KVMManager::startVMAsync(const QString &name, VMBackend::Callback callback)
+{
+    dispatch(name, [this](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        // A guest writing to a base image would corrupt every linked clone
+        QString vmName = vm->getName();
+        if (vm->isTemplate()) {
+            done(VMBackend::failure(tr("'%1' es una plantilla; cree una máquina a partir de ella para arrancarla")
+                                    .arg(vmName)));
+            return;
+        }
+        QStringList linkedClones = getLinkedClones(vmName);
+        if (!linkedClones.isEmpty()) {
+            done(VMBackend::failure(tr("'%1' es la base de los clones enlazados %2; no se puede arrancar")
+                                    .arg(vmName, linkedClones.join(", "))));
+            return;
+        }
+        
+        // The backend is only reached once the VM's RAM and vCPUs are booked
+        m_admission->requestStart(vmName, [this, backend, vmName, done](const QString &error) {
+            VirtualMachine *admitted = getVirtualMachine(vmName);
+            if (!error.isEmpty() || !admitted) {
+                done(VMBackend::failure(error.isEmpty() ? tr("Máquina virtual '%1' no encontrada").arg(vmName) : error));
+                return;
+            }
+            
+            if (admitted->getBackend() == "qemu") {
+                recordDiskFormats(admitted);
+            }
+            checkChainDepth(admitted);
+            backend->start(admitted, [this, vmName, done](const VMBackend::Result &result) {
+                if (!result.ok) {
+                    m_admission->release(vmName);
+                }
+                done(result);
+            });
+        });
+    }, callback);
+}
+
+void KVMManager::stopVMAsync(const QString &name, VMBackend::Callback callback)
+{
+    dispatch(name, [](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        backend->stop(vm, done);
+    }, callback);
+}
+
+void KVMManager::pauseVMAsync(const QString &name, VMBackend::Callback callback)
+{
+    dispatch(name, [](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        backend->pause(vm, done);
+    }, callback);
+}
+
+void KVMManager::resumeVMAsync(const QString &name, VMBackend::Callback callback)
+{
+    dispatch(name, [](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        backend->resume(vm, done);
+    }, callback);
+}
+
+void KVMManager::resetVMAsync(const QString &name, VMBackend::Callback callback)
+{
+    dispatch(name, [](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        backend->reset(vm, done);
+    }, callback);
+}
+
+void KVMManager::queryVMStats(const QString &name, VMBackend::Callback callback)
+{
+    dispatch(name, [](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        backend->queryStats(vm, done);
+    }, callback);
+}
+
+void KVMManager::setBalloonTargetAsync(const QString &name, qint64 targetMB, VMBackend::Callback callback)
+{
+    dispatch(name, [targetMB](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        // The balloon can only take memory back, never grow past the configured RAM
+        if (targetMB < 1 || targetMB > vm->getMemoryMB()) {
+            done(VMBackend::failure(tr("El objetivo del balón debe estar entre 1 y %1 MB").arg(vm->getMemoryMB())));
+            return;
+        }
+        backend->setBalloonTarget(vm, targetMB, done);
+    }, callback);
+}
+
+void KVMManager::saveVMStateAsync(const QString &name, VMBackend::Callback callback)
+{
+    dispatch(name, [](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        backend->saveState(vm, done);
+    }, callback);
+}
+
+void KVMManager::startVMsAsync(const QStringList &names, const BootScheduler::Options &options,
+                               VMBackend::Callback callback)
+{
+    runBulk(BootScheduler::Start, names, options, callback);
+}
+
+void KVMManager::stopVMsAsync(const QStringList &names, const BootScheduler::Options &options,
+                              VMBackend::Callback callback)
+{
+    runBulk(BootScheduler::Stop, names, options, callback);
+}
+
+QJsonObject KVMManager::startVMs(const QStringList &names, const BootScheduler::Options &options)
+{
+    QJsonValue summary;
+    waitForResult([this, names, options](VMBackend::Callback callback) {
+        startVMsAsync(names, options, callback);
+    }, &summary, bulkTimeoutMs(names, options));
+    return summary.toObject();
+}
+
+QJsonObject KVMManager::stopVMs(const QStringList &names, const BootScheduler::Options &options)
+{
+    QJsonValue summary;
+    waitForResult([this, names, options](VMBackend::Callback callback) {
+        stopVMsAsync(names, options, callback);
+    }, &summary, bulkTimeoutMs(names, options));
+    return summary.toObject();
+}
+
+void KVMManager::acquireWarmVMAsync(const QString &templateName, VMBackend::Callback callback)
+{
+    m_warmPool->acquire(templateName, [this, callback](const VMBackend::Result &result) {
+        if (!result.ok) {
+            emit errorOccurred(result.error);
+        }
+        if (callback) {
+            callback(result);
+        }
+    });
+}
+
+QJsonObject KVMManager::acquireWarmVM(const QString &templateName)
+{
+    // A cold fallback goes through admission and a full boot
+    QJsonValue value;
+    int timeoutMs = 60000 + AdmissionController::loadPolicy().queueTimeoutSecs * 1000;
+    waitForResult([this, templateName](VMBackend::Callback callback) {
+        acquireWarmVMAsync(templateName, callback);
+    }, &value, timeoutMs);
+    return value.toObject();
+}
+
+void KVMManager::runBulk(BootScheduler::Action action, const QStringList &names,
+                         const BootScheduler::Options &options, VMBackend::Callback callback)
+{
+    // The scheduler deletes itself once every VM has a result; individual
+    // failures were already reported through errorOccurred
+    BootScheduler *scheduler = new BootScheduler(this, action, names, options, this);
+    connect(scheduler, &BootScheduler::progress, this, &KVMManager::bulkProgress);
+    scheduler->run(callback);
+}
+
+int KVMManager::bulkTimeoutMs(const QStringList &names, const BootScheduler::Options &options) const
+{
+    // Worst case: every VM waits in the admission queue and then runs out of
+    // readiness time, one slot at a time
+    qint64 perVmMs = 60000LL + options.rampUpMs + options.readyTimeoutSecs * 1000LL
+                     + AdmissionController::loadPolicy().queueTimeoutSecs * 1000LL;
+    qint64 rounds = (names.size() + options.maxParallel - 1) / qMax(1, options.maxParallel);
+    return int(qMin<qint64>(qMax<qint64>(1, rounds) * perVmMs, std::numeric_limits<int>::max()));
+}
+
+VMBackend* KVMManager::getBackend(const QString &id) const
+{
+    return m_backends.value(id, nullptr);
+}
+
+VMBackend* KVMManager::getVMBackend(const QString &name) const
+{
+    VirtualMachine *vm = getVirtualMachine(name);
+    return vm ? getBackend(vm->getBackend()) : nullptr;
+}
+
+QStringList KVMManager::getBackendIds() const
+{
+    return m_backends.keys();
+}
+
+void KVMManager::registerBackend(VMBackend *backend)
+{
+    m_backends.insert(backend->id(), backend);
+    
+    connect(backend, &VMBackend::errorOccurred, this, &KVMManager::errorOccurred);
+    connect(backend, &VMBackend::jobProgress, this, &KVMManager::jobProgress);
+    connect(backend, &VMBackend::vmStateChanged, this, [this](const QString &vmName, const QString &state) {
+        if (VirtualMachine *vm = getVirtualMachine(vmName)) {
+            vm->setState(state);
+        }
+        emit vmStateChanged(vmName, state);
+    });
+}
+
+void KVMManager::dispatch(const QString &name, const BackendOperation &operation, VMBackend::Callback callback)
+{
+    VirtualMachine *vm = getVirtualMachine(name);
+    if (!vm) {
+        QString error = tr("Máquina virtual '%1' no encontrada").arg(name);
+        emit errorOccurred(error);
+        if (callback) {
+            callback(VMBackend::failure(error));
+        }
+        return;
+    }
+    
+    VMBackend *backend = getBackend(vm->getBackend());
+    if (!backend) {
+        QString error = tr("Backend desconocido '%1' para la VM '%2'").arg(vm->getBackend(), name);
+        emit errorOccurred(error);
+        if (callback) {
+            callback(VMBackend::failure(error));
+        }
+        return;
+    }
+    
+    operation(backend, vm, [this, callback](const VMBackend::Result &result) {
+        if (!result.ok && !result.error.isEmpty()) {
+            emit errorOccurred(result.error);
+        }
+        if (callback) {
+            callback(result);
+        }
+    });
+}
+
+void KVMManager::dispatchDiskChange(const QString &name, const BackendOperation &operation, VMBackend::Callback callback)
+{
+    dispatch(name, [this, operation](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        // Linked clones read from the template's disks: a new layer or a
+        // write there would silently change the base of every future clone
+        if (vm->isTemplate()) {
+            done(VMBackend::failure(tr("'%1' es una plantilla; sus discos no se pueden modificar").arg(vm->getName())));
+            return;
+        }
+        operation(backend, vm, done);
+    }, callback);
+}
+
+bool KVMManager::waitForResult(const std::function<void(VMBackend::Callback)> &operation, QJsonValue *value,
+                               int timeoutMs)
+{
+    // Estado compartido con el callback: puede llegar después del timeout
+    struct SyncState {
+        bool finished = false;
+        VMBackend::Result result;
+        QEventLoop loop;
+    };
+    QSharedPointer<SyncState> state(new SyncState);
+    
+    operation([state](const VMBackend::Result &result) {
+        state->result = result;
+        state->finished = true;
+        state->loop.quit();
+    });
+    
+    if (!state->finished) {
+        QTimer::singleShot(timeoutMs, &state->loop, &QEventLoop::quit);
+        state->loop.exec(QEventLoop::ExcludeUserInputEvents);
+    }
+    
+    if (!state->finished) {
+        emit errorOccurred(tr("Tiempo de espera agotado esperando al backend"));
         return false;
     }
+    
+    if (value) {
+        *value = state->result.value;
+    }
+    return state->result.ok;
+}
+
+QStringList KVMManager::getSnapshots(const QString &name)
+{
+    QJsonValue snapshots;
+    bool ok = waitForResult([this, name](VMBackend::Callback callback) {
+        dispatch(name, [](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+            backend->listSnapshots(vm, done);
+        }, callback);
+    }, &snapshots);
+    
+    QStringList tags;
+    if (ok) {
+        for (const QJsonValue &snapshot : snapshots.toArray()) {
+            tags.append(snapshot.toObject().value("name").toString());
+        }
+    }
+    return tags;
+}
+
+QJsonArray KVMManager::getSnapshotTree(const QString &name)
+{
+    QJsonValue tree;
+    waitForResult([this, name](VMBackend::Callback callback) {
+        querySnapshotTree(name, callback);
+    }, &tree);
+    return tree.toArray();
+}
+
+bool KVMManager::createSnapshot(const QString &name, const QString &tag, const QString &description)
+{
+    return waitForResult([this, name, tag, description](VMBackend::Callback callback) {
+        createSnapshotAsync(name, tag, description, callback);
+    }, nullptr, snapshotTimeoutMs(name));
+}
+
+bool KVMManager::deleteSnapshot(const QString &name, const QString &tag)
+{
+    return waitForResult([this, name, tag](VMBackend::Callback callback) {
+        deleteSnapshotAsync(name, tag, callback);
+    }, nullptr, snapshotTimeoutMs(name));
+}
+
+bool KVMManager::revertSnapshot(const QString &name, const QString &tag)
+{
+    return waitForResult([this, name, tag](VMBackend::Callback callback) {
+        revertSnapshotAsync(name, tag, callback);
+    }, nullptr, snapshotTimeoutMs(name));
+}
+
+void KVMManager::querySnapshotTree(const QString &name, VMBackend::Callback callback)
+{
+    dispatch(name, [this](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        QString vmName = vm->getName();
+        backend->listSnapshots(vm, [this, vmName, done](const VMBackend::Result &result) {
+            VirtualMachine *vm = getVirtualMachine(vmName);
+            if (!result.ok || !vm) {
+                done(result.ok ? VMBackend::failure(tr("Máquina virtual '%1' no encontrada").arg(vmName)) : result);
+                return;
+            }
+            done(VMBackend::success(mergeSnapshotTree(vm, result.value.toArray())));
+        });
+    }, callback);
+}
+
+void KVMManager::createSnapshotAsync(const QString &name, const QString &tag, const QString &description,
+                                     VMBackend::Callback callback)
+{
+    dispatchDiskChange(name, [this, tag, description](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        if (tag.trimmed().isEmpty()) {
+            done(VMBackend::failure(tr("El nombre de la instantánea no puede estar vacío")));
+            return;
+        }
+        
+        QString vmName = vm->getName();
+        backend->createSnapshot(vm, tag, [this, vmName, tag, description, done](const VMBackend::Result &result) {
+            VirtualMachine *vm = getVirtualMachine(vmName);
+            if (result.ok && vm) {
+                // The new snapshot hangs from the one the current state descends from
+                QList<VirtualMachine::SnapshotInfo> snapshots = vm->getSnapshots();
+                snapshots.append(VirtualMachine::SnapshotInfo{tag, vm->getCurrentSnapshot(), description, QDateTime::currentDateTime()});
+                vm->setSnapshots(snapshots);
+                vm->setCurrentSnapshot(tag);
+                saveVMConfiguration(vm);
+                qDebug() << "KVMManager: Instantánea creada:" << vmName << tag;
+            }
+            done(result);
+        });
+    }, callback);
+}
+
+void KVMManager::deleteSnapshotAsync(const QString &name, const QString &tag, VMBackend::Callback callback)
+{
+    dispatchDiskChange(name, [this, tag](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        QString vmName = vm->getName();
+        backend->deleteSnapshot(vm, tag, [this, vmName, tag, done](const VMBackend::Result &result) {
+            VirtualMachine *vm = getVirtualMachine(vmName);
+            if (result.ok && vm) {
+                // Children move up to the deleted snapshot's parent
+                QList<VirtualMachine::SnapshotInfo> snapshots = vm->getSnapshots();
+                QString parent;
+                for (int i = 0; i < snapshots.size(); ++i) {
+                    if (snapshots[i].name == tag) {
+                        parent = snapshots.takeAt(i).parent;
+                        break;
+                    }
+                }
+                for (VirtualMachine::SnapshotInfo &info : snapshots) {
+                    if (info.parent == tag) {
+                        info.parent = parent;
+                    }
+                }
+                vm->setSnapshots(snapshots);
+                if (vm->getCurrentSnapshot() == tag) {
+                    vm->setCurrentSnapshot(parent);
+                }
+                saveVMConfiguration(vm);
+                qDebug() << "KVMManager: Instantánea eliminada:" << vmName << tag;
+            }
+            done(result);
+        });
+    }, callback);
+}
+
+void KVMManager::revertSnapshotAsync(const QString &name, const QString &tag, VMBackend::Callback callback)
+{
+    dispatchDiskChange(name, [this, tag](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        QString vmName = vm->getName();
+        backend->revertSnapshot(vm, tag, [this, vmName, tag, done](const VMBackend::Result &result) {
+            VirtualMachine *vm = getVirtualMachine(vmName);
+            if (result.ok && vm) {
+                vm->setCurrentSnapshot(tag);
+                saveVMConfiguration(vm);
+                qDebug() << "KVMManager: Instantánea restaurada:" << vmName << tag;
+            }
+            done(result);
+        });
+    }, callback);
+}
+
+QJsonArray KVMManager::getDiskChains(const QString &name) const
+{
+    QJsonArray chains;
+    VirtualMachine *vm = getVirtualMachine(name);
+    if (!vm) {
+        return chains;
+    }
+    
+    int warningDepth = QemuManager::loadOverlayPolicy().chainWarningDepth;
+    for (const QString &disk : vm->getHardDisks()) {
+        QJsonArray images;
+        for (const QString &path : DiskImageProbe::backingChain(disk)) {
+            DiskImageProbe::Info info = DiskImageProbe::probe(path);
+            QJsonObject image;
+            image["path"] = path;
+            image["format"] = info.format;
+            image["virtualSize"] = info.virtualSize;
+            image["fileSize"] = QFileInfo(path).size();
+            images.append(image);
+        }
+        
+        int depth = qMax(0, int(images.size()) - 1);
+        QJsonObject chain;
+        chain["disk"] = disk;
+        chain["depth"] = depth;
+        chain["warning"] = depth > warningDepth;
+        chain["chain"] = images;
+        chains.append(chain);
+    }
+    return chains;
 }
 
-bool KVMManager::pauseVM(const QString &name)
+bool KVMManager::createExternalSnapshot(const QString &name, const QString &tag)
 {
-    if (!m_libvirtRunning) {
-        emit errorOccurred(tr("Libvirt no está disponible"));
-        return false;
+    return waitForResult([this, name, tag](VMBackend::Callback callback) {
+        createExternalSnapshotAsync(name, tag, callback);
+    });
+}
+
+bool KVMManager::mergeDiskChain(const QString &name, const QString &disk, const QString &mode)
+{
+    // Copies whole images; a generous hour before giving up on the wait
+    return waitForResult([this, name, disk, mode](VMBackend::Callback callback) {
+        mergeDiskChainAsync(name, disk, mode, callback);
+    }, nullptr, 60 * 60 * 1000);
+}
+
+void KVMManager::createExternalSnapshotAsync(const QString &name, const QString &tag, VMBackend::Callback callback)
+{
+    dispatchDiskChange(name, [this, tag](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        if (tag.trimmed().isEmpty()) {
+            done(VMBackend::failure(tr("El nombre de la instantánea no puede estar vacío")));
+            return;
+        }
+        
+        QString vmName = vm->getName();
+        QStringList disks = vm->getHardDisks();
+        backend->createExternalSnapshot(vm, tag, QemuManager::overlayDirectory(vmName),
+                                        [this, vmName, disks, done](const VMBackend::Result &result) {
+            VirtualMachine *vm = getVirtualMachine(vmName);
+            if (result.ok && vm) {
+                // The overlays replace the disks; the old images become read-only bases
+                QJsonArray overlays = result.value.toArray();
+                for (int i = 0; i < disks.size() && i < overlays.size(); ++i) {
+                    vm->replaceHardDisk(disks[i], overlays[i].toString(), "qcow2");
+                }
+                saveVMConfiguration(vm);
+                checkChainDepth(vm);
+                qDebug() << "KVMManager: Capa externa creada:" << vmName << overlays;
+            }
+            done(result);
+        });
+    }, callback);
+}
+
+QString KVMManager::checkExternalSnapshot(const QString &name, const QString &tag)
+{
+    VirtualMachine *vm = getVirtualMachine(name);
+    if (!vm) {
+        return tr("Máquina virtual '%1' no encontrada").arg(name);
+    }
+    VMBackend *backend = getBackend(vm->getBackend());
+    if (!backend) {
+        return tr("Backend desconocido '%1' para la VM '%2'").arg(vm->getBackend(), name);
+    }
+    if (tag.trimmed().isEmpty()) {
+        return tr("El nombre de la instantánea no puede estar vacío");
+    }
+    if (vm->isTemplate()) {
+        return tr("'%1' es una plantilla; sus discos no se pueden modificar").arg(name);
+    }
+    return backend->checkExternalSnapshot(vm, tag, QemuManager::overlayDirectory(name));
+}
+
+void KVMManager::discardExternalSnapshotAsync(const QString &name, const QStringList &disks,
+                                              VMBackend::Callback callback)
+{
+    dispatchDiskChange(name, [this, disks](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        QString vmName = vm->getName();
+        QStringList overlays = vm->getHardDisks();
+        backend->discardExternalSnapshot(vm, disks, [this, vmName, overlays, done](const VMBackend::Result &result) {
+            VirtualMachine *vm = getVirtualMachine(vmName);
+            if (result.ok && vm) {
+                QJsonArray restored = result.value.toArray();
+                for (int i = 0; i < overlays.size() && i < restored.size(); ++i) {
+                    DiskImageProbe::Info info = DiskImageProbe::probe(restored[i].toString());
+                    vm->replaceHardDisk(overlays[i], restored[i].toString(), info.valid ? info.format : "qcow2");
+                }
+                saveVMConfiguration(vm);
+                qDebug() << "KVMManager: Capa externa descartada:" << vmName << restored;
+            }
+            done(result);
+        });
+    }, callback);
+}
+
+void KVMManager::mergeDiskChainAsync(const QString &name, const QString &disk, const QString &mode,
+                                     VMBackend::Callback callback)
+{
+    dispatchDiskChange(name, [this, disk, mode](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        QString vmName = vm->getName();
+        // A commit writes into the base and drops the layers a checkpoint resets to
+        if (mode == "commit") {
+            const QStringList frozen = QemuManager::checkpointImages(vmName);
+            for (const QString &image : DiskImageProbe::backingChain(disk)) {
+                if (frozen.contains(QFileInfo(image).absoluteFilePath())) {
+                    done(VMBackend::failure(tr("La cadena de %1 contiene imágenes de puntos de control; "
+                                               "elimínelos antes de consolidarla").arg(disk)));
+                    return;
+                }
+            }
+            // Instant clones keep the fork checkpoint's images as their base
+            // even after the checkpoint itself is deleted
+            QSet<QString> shared;
+            for (VirtualMachine *other : m_virtualMachines) {
+                if (other == vm || other->getBackend() != "qemu") {
+                    continue;
+                }
+                for (const QString &otherDisk : other->getHardDisks()) {
+                    for (const QString &image : DiskImageProbe::backingChain(otherDisk)) {
+                        shared.insert(QFileInfo(image).absoluteFilePath());
+                    }
+                }
+            }
+            for (const QString &image : DiskImageProbe::backingChain(disk)) {
+                if (shared.contains(QFileInfo(image).absoluteFilePath())) {
+                    done(VMBackend::failure(tr("La imagen %1 de la cadena de %2 es la base de otras máquinas; "
+                                               "no se puede consolidar").arg(image, disk)));
+                    return;
+                }
+            }
+        }
+        
+        backend->mergeDiskChain(vm, disk, mode, [this, vmName, disk, done](const VMBackend::Result &result) {
+            VirtualMachine *vm = getVirtualMachine(vmName);
+            QString remaining = result.value.toString();
+            if (result.ok && vm && !remaining.isEmpty()) {
+                DiskImageProbe::Info info = DiskImageProbe::probe(remaining);
+                vm->replaceHardDisk(disk, remaining, info.valid ? info.format : vm->getDiskFormat(disk));
+                saveVMConfiguration(vm);
+                qDebug() << "KVMManager: Cadena fusionada:" << vmName << disk << "->" << remaining;
+            }
+            done(result);
+        });
+    }, callback);
+}
+
+QJsonArray KVMManager::getCheckpoints(const QString &name) const
+{
+    QJsonArray checkpoints;
+    VirtualMachine *vm = getVirtualMachine(name);
+    if (!vm || vm->getBackend() != "qemu") {
+        return checkpoints;
     }
     
-    QProcess process;
-    process.start("virsh", QStringList() << "suspend" << name);
-    process.waitForFinished();
+    for (const QString &checkpoint : QemuManager::listCheckpoints(name)) {
+        QJsonObject info = QemuManager::checkpointInfo(name, checkpoint);
+        info["name"] = checkpoint;
+        checkpoints.append(info);
+    }
+    return checkpoints;
+}
+
+QJsonObject KVMManager::createCheckpoint(const QString &name, const QString &checkpoint)
+{
+    QJsonValue value;
+    bool ok = waitForResult([this, name, checkpoint](VMBackend::Callback callback) {
+        createCheckpointAsync(name, checkpoint, callback);
+    }, &value, snapshotTimeoutMs(name));
+    return ok ? value.toObject() : QJsonObject();
+}
+
+QJsonObject KVMManager::resetToCheckpoint(const QString &name, const QString &checkpoint)
+{
+    // Loading the RAM back goes through admission like any start
+    QJsonValue value;
+    int timeoutMs = snapshotTimeoutMs(name) + AdmissionController::loadPolicy().queueTimeoutSecs * 1000;
+    bool ok = waitForResult([this, name, checkpoint](VMBackend::Callback callback) {
+        resetToCheckpointAsync(name, checkpoint, callback);
+    }, &value, timeoutMs);
+    return ok ? value.toObject() : QJsonObject();
+}
+
+bool KVMManager::deleteCheckpoint(const QString &name, const QString &checkpoint)
+{
+    return waitForResult([this, name, checkpoint](VMBackend::Callback callback) {
+        deleteCheckpointAsync(name, checkpoint, callback);
+    });
+}
+
+void KVMManager::deleteCheckpointAsync(const QString &name, const QString &checkpoint, VMBackend::Callback callback)
+{
+    dispatch(name, [this, checkpoint](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        // Files of the checkpoint that still back the disks in use, another
+        // checkpoint or an instant clone's disks stay where they are
+        QString vmName = vm->getName();
+        QStringList images = vm->getHardDisks();
+        for (VirtualMachine *other : m_virtualMachines) {
+            if (other != vm && other->getBackend() == "qemu") {
+                images.append(other->getHardDisks());
+            }
+        }
+        for (const QString &other : QemuManager::listCheckpoints(vmName)) {
+            if (other != checkpoint) {
+                for (const QJsonValue &image : QemuManager::checkpointInfo(vmName, other).value("disks").toArray()) {
+                    images.append(image.toString());
+                }
+            }
+        }
+        backend->deleteCheckpoint(vm, checkpoint, backingImages(images).values(), done);
+    }, callback);
+}
+
+void KVMManager::createCheckpointAsync(const QString &name, const QString &checkpoint, VMBackend::Callback callback)
+{
+    dispatchDiskChange(name, [this, checkpoint](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        QString vmName = vm->getName();
+        QStringList disks = vm->getHardDisks();
+        backend->createCheckpoint(vm, checkpoint, [this, vmName, disks, done](const VMBackend::Result &result) {
+            // Even when the RAM couldn't be saved, the guest already writes to the overlays
+            VirtualMachine *vm = getVirtualMachine(vmName);
+            QJsonArray overlays = result.value.toObject().value("overlays").toArray();
+            if (vm && !overlays.isEmpty()) {
+                for (int i = 0; i < disks.size() && i < overlays.size(); ++i) {
+                    vm->replaceHardDisk(disks[i], overlays[i].toString(), "qcow2");
+                }
+                saveVMConfiguration(vm);
+                checkChainDepth(vm);
+            }
+            done(result);
+        });
+    }, callback);
+}
+
+void KVMManager::resetToCheckpointAsync(const QString &name, const QString &checkpoint, VMBackend::Callback callback)
+{
+    dispatchDiskChange(name, [this, checkpoint](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+        // The overlay a reset throws away is the base of any linked clone
+        QString vmName = vm->getName();
+        QStringList linkedClones = getLinkedClones(vmName);
+        if (!linkedClones.isEmpty()) {
+            done(VMBackend::failure(tr("'%1' es la base de los clones enlazados %2; no se puede volver a un punto de control")
+                                    .arg(vmName, linkedClones.join(", "))));
+            return;
+        }
+        
+        QStringList disks = vm->getHardDisks();
+        qint64 startMs = QDateTime::currentMSecsSinceEpoch();
+        backend->resetToCheckpoint(vm, checkpoint, [this, vmName, checkpoint, disks, startMs, done](const VMBackend::Result &result) {
+            VirtualMachine *vm = getVirtualMachine(vmName);
+            QJsonObject value = result.value.toObject();
+            QJsonArray overlays = value.value("overlays").toArray();
+            if (vm && !overlays.isEmpty()) {
+                for (int i = 0; i < disks.size() && i < overlays.size(); ++i) {
+                    vm->replaceHardDisk(disks[i], overlays[i].toString(), "qcow2");
+                }
+                saveVMConfiguration(vm);
+            }
+            if (!result.ok || !vm) {
+                done(result);
+                return;
+            }
+            
+            value["checkpoint"] = checkpoint;
+            if (!value.value("memory").toBool()) {
+                value["msecs"] = QDateTime::currentMSecsSinceEpoch() - startMs;
+                qDebug() << "KVMManager: VM devuelta al punto de control:" << vmName << checkpoint;
+                done(VMBackend::success(value));
+                return;
+            }
+            // Straight back into the checkpoint's RAM; a failed start was already reported
+            startVMAsync(vmName, [this, vmName, value, startMs, done](const VMBackend::Result &started) {
+                if (!started.ok) {
+                    done(VMBackend::failure());
+                    return;
+                }
+                waitForRestore(vmName, value, startMs, done);
+            });
+        });
+    }, callback);
+}
+
+QJsonObject KVMManager::forkVM(const QString &name, int count, const QString &prefix)
+{
+    // One RAM capture plus every clone going through admission
+    QJsonValue value;
+    int timeoutMs = snapshotTimeoutMs(name) * 2 + AdmissionController::loadPolicy().queueTimeoutSecs * 1000;
+    bool ok = waitForResult([this, name, count, prefix](VMBackend::Callback callback) {
+        forkVMAsync(name, count, prefix, callback);
+    }, &value, timeoutMs);
+    return ok ? value.toObject() : QJsonObject();
+}
+
+void KVMManager::forkVMAsync(const QString &name, int count, const QString &prefix, VMBackend::Callback callback)
+{
+    dispatch(name, [this, count, prefix](VMBackend *, VirtualMachine *vm, VMBackend::Callback done) {
+        QString vmName = vm->getName();
+        if (vm->getBackend() != "qemu") {
+            done(VMBackend::failure(tr("La clonación en caliente sólo está disponible con el backend QEMU")));
+            return;
+        }
+        if (count < 1) {
+            done(VMBackend::failure(tr("El número de máquinas debe ser al menos 1")));
+            return;
+        }
+        if (!m_qemuManager->isVMRunning(vmName)) {
+            done(VMBackend::failure(tr("La VM '%1' debe estar en ejecución para clonarla en caliente").arg(vmName)));
+            return;
+        }
+        
+        // The checkpoint freezes the disks and captures the RAM once; the
+        // source keeps running on fresh overlays
+        QElapsedTimer timer;
+        timer.start();
+        QString checkpoint = "fork-" + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss-zzz");
+        createCheckpointAsync(vmName, checkpoint,
+                              [this, vmName, checkpoint, count, prefix, timer, done](const VMBackend::Result &captured) {
+            if (!captured.ok) {
+                done(VMBackend::failure());
+                return;
+            }
+            QJsonObject info = captured.value.toObject();
+            if (!info.value("memory").toBool()) {
+                done(VMBackend::failure(tr("No se pudo capturar la memoria de '%1'").arg(vmName)));
+                return;
+            }
+            qint64 captureMsecs = timer.elapsed();
+            
+            QStringList disks;
+            for (const QJsonValue &disk : info.value("disks").toArray()) {
+                disks.append(disk.toString());
+            }
+            QJsonArray failed;
+            QStringList names = freeVMNames(prefix.isEmpty() ? vmName + "-fork" : prefix, count);
+            QStringList created = createLinkedClones(vmName, disks, names,
+                                                     tr("Clon en caliente de %1 (%2)").arg(vmName, checkpoint), &failed);
+            
+            // Every clone resumes from the same state file, hard-linked
+            QJsonObject saved;
+            saved["checkpoint"] = checkpoint;
+            for (const char *key : {"format", "channels", "ramBytes", "fileBytes"}) {
+                saved[key] = info.value(key);
+            }
+            saved["resume"] = info.value("running").toBool();
+            QString statePath = QemuManager::checkpointStatePath(vmName, checkpoint);
+            QStringList ready;
+            for (const QString &clone : created) {
+                VirtualMachine *cloneVM = getVirtualMachine(clone);
+                if (!cloneVM || !QemuManager::adoptSavedState(clone, statePath, saved)) {
+                    QJsonObject entry;
+                    entry["name"] = clone;
+                    entry["error"] = tr("No se pudo preparar la memoria capturada en %1")
+                                     .arg(QemuManager::savedStatePath(clone));
+                    failed.append(entry);
+                    continue;
+                }
+                // A fork of a pool instance is not part of the pool
+                cloneVM->setWarmPool(QString());
+                cloneVM->setState("saved");
+                saveVMConfiguration(cloneVM);
+                ready.append(clone);
+            }
+            
+            QJsonObject result;
+            result["source"] = vmName;
+            result["checkpoint"] = checkpoint;
+            result["captureMsecs"] = captureMsecs;
+            if (ready.isEmpty()) {
+                releaseForkCapture(vmName, checkpoint);
+                result["created"] = QJsonArray();
+                result["failed"] = failed;
+                result["msecs"] = timer.elapsed();
+                VMBackend::Result reply = VMBackend::failure(tr("No se pudo crear ningún clon de '%1'").arg(vmName));
+                reply.value = result;
+                done(reply);
+                return;
+            }
+            
+            // All clones restore at once; admission decides how many fit
+            auto pending = QSharedPointer<int>::create(ready.size());
+            auto started = QSharedPointer<QJsonArray>::create();
+            auto errors = QSharedPointer<QJsonArray>::create(failed);
+            qint64 startMs = QDateTime::currentMSecsSinceEpoch();
+            for (const QString &clone : ready) {
+                auto finished = [this, clone, pending, started, errors, result, vmName, checkpoint, timer, done]
+                                (const VMBackend::Result &restored) mutable {
+                    if (restored.ok) {
+                        started->append(clone);
+                    } else {
+                        QJsonObject entry;
+                        entry["name"] = clone;
+                        entry["error"] = restored.error.isEmpty() ? tr("No arrancó") : restored.error;
+                        errors->append(entry);
+                    }
+                    if (--*pending > 0) {
+                        return;
+                    }
+                    releaseForkCapture(vmName, checkpoint);
+                    result["created"] = *started;
+                    result["failed"] = *errors;
+                    result["msecs"] = timer.elapsed();
+                    qDebug() << "KVMManager:" << started->size() << "clones en caliente de" << vmName
+                             << "en" << timer.elapsed() << "ms";
+                    if (started->isEmpty()) {
+                        VMBackend::Result reply = VMBackend::failure(tr("No arrancó ningún clon de '%1'").arg(vmName));
+                        reply.value = result;
+                        done(reply);
+                        return;
+                    }
+                    done(VMBackend::success(result));
+                };
+                startVMAsync(clone, [this, clone, startMs, finished](const VMBackend::Result &result) mutable {
+                    if (!result.ok) {
+                        finished(result);
+                        return;
+                    }
+                    waitForRestore(clone, QJsonObject(), startMs, finished);
+                });
+            }
+        });
+    }, callback);
+}
+
+void KVMManager::releaseForkCapture(const QString &name, const QString &checkpoint)
+{
+    // Every clone has loaded (or given up on) its hard link to the captured
+    // RAM. Dropping checkpoint.json turns the capture into plain images:
+    // they stay, as the base of the clones' disks and of the source's
+    QFile::remove(QemuManager::checkpointStatePath(name, checkpoint));
+    QFile::remove(QemuManager::checkpointDirectory(name, checkpoint) + "/checkpoint.json");
+    qDebug() << "KVMManager: Captura de la clonación en caliente liberada:" << name << checkpoint;
+}
+
+void KVMManager::waitForRestore(const QString &name, QJsonObject result, qint64 startMs, VMBackend::Callback callback)
+{
+    // QEMU loads the state in the background; the reset is done once the guest is live again
+    if (m_qemuManager->isRestoring(name)) {
+        QTimer::singleShot(50, this, [this, name, result, startMs, callback]() {
+            waitForRestore(name, result, startMs, callback);
+        });
+        return;
+    }
+    if (!m_qemuManager->isVMRunning(name)) {
+        callback(VMBackend::failure(tr("La VM '%1' no pudo cargar su memoria guardada").arg(name)));
+        return;
+    }
     
-    if (process.exitCode() == 0) {
-        emit vmStateChanged(name, "paused");
-        return true;
-    } else {
-        QString error = process.readAllStandardError();
-        emit errorOccurred(tr("Error al pausar VM '%1': %2").arg(name, error));
-        return false;
+    result["msecs"] = QDateTime::currentMSecsSinceEpoch() - startMs;
+    qDebug() << "KVMManager: Memoria restaurada:" << name << result.value("checkpoint").toString()
+             << result.value("msecs").toInteger() << "ms";
+    callback(VMBackend::success(result));
+}
+
+void KVMManager::checkChainDepth(VirtualMachine *vm)
+{
+    // Every overlay adds a lookup for data the top image doesn't hold yet
+    for (const QJsonValue &value : getDiskChains(vm->getName())) {
+        QJsonObject chain = value.toObject();
+        if (chain.value("warning").toBool()) {
+            emit chainDepthWarning(vm->getName(), chain.value("disk").toString(), chain.value("depth").toInt());
+        }
     }
 }
 
-bool KVMManager::resumeVM(const QString &name)
+int KVMManager::snapshotTimeoutMs(const QString &name) const
 {
-    if (!m_libvirtRunning) {
-        emit errorOccurred(tr("Libvirt no está disponible"));
-        return false;
+    // A live snapshot writes the whole guest RAM; allow for a slow disk (~50 MB/s)
+    VirtualMachine *vm = getVirtualMachine(name);
+    return 60000 + (vm ? vm->getMemoryMB() * 20 : 0);
+}
+
+QJsonArray KVMManager::mergeSnapshotTree(VirtualMachine *vm, const QJsonArray &snapshots)
+{
+    // The images are the source of truth: metadata for snapshots that no
+    // longer exist is dropped, and snapshots taken outside the manager
+    // (qemu-img, virsh) show up as roots
+    QHash<QString, QJsonObject> images;
+    QStringList order;
+    for (const QJsonValue &value : snapshots) {
+        QJsonObject snapshot = value.toObject();
+        QString name = snapshot.value("name").toString();
+        if (!name.isEmpty() && !images.contains(name)) {
+            images.insert(name, snapshot);
+            order.append(name);
+        }
     }
     
-    QProcess process;
-    process.start("virsh", QStringList() << "resume" << name);
-    process.waitForFinished();
+    const QList<VirtualMachine::SnapshotInfo> known = vm->getSnapshots();
+    QHash<QString, QString> knownParents;
+    QList<VirtualMachine::SnapshotInfo> merged;
+    QSet<QString> names;
+    for (const VirtualMachine::SnapshotInfo &info : known) {
+        knownParents.insert(info.name, info.parent);
+        if (images.contains(info.name) && !names.contains(info.name)) {
+            merged.append(info);
+            names.insert(info.name);
+        }
+    }
+    for (const QString &name : order) {
+        if (!names.contains(name)) {
+            QDateTime created = QDateTime::fromString(images[name].value("created").toString(), Qt::ISODate);
+            merged.append(VirtualMachine::SnapshotInfo{name, QString(), QString(), created});
+            names.insert(name);
+        }
+    }
     
-    if (process.exitCode() == 0) {
-        emit vmStateChanged(name, "running");
-        return true;
-    } else {
-        QString error = process.readAllStandardError();
-        emit errorOccurred(tr("Error al reanudar VM '%1': %2").arg(name, error));
-        return false;
+    // A snapshot whose parent is gone hangs from the nearest ancestor left
+    auto survivingAncestor = [&knownParents, &names](QString name) {
+        for (int depth = 0; !name.isEmpty() && !names.contains(name) && depth <= knownParents.size(); ++depth) {
+            name = knownParents.value(name);
+        }
+        return names.contains(name) ? name : QString();
+    };
+    for (VirtualMachine::SnapshotInfo &info : merged) {
+        info.parent = info.parent == info.name ? QString() : survivingAncestor(info.parent);
+    }
+    QString current = survivingAncestor(vm->getCurrentSnapshot());
+    
+    bool changed = merged.size() != known.size() || current != vm->getCurrentSnapshot();
+    for (int i = 0; !changed && i < merged.size(); ++i) {
+        changed = merged[i].name != known[i].name || merged[i].parent != known[i].parent;
     }
+    if (changed) {
+        vm->setSnapshots(merged);
+        vm->setCurrentSnapshot(current);
+        saveVMConfiguration(vm);
+    }
+    
+    QJsonArray tree;
+    for (const VirtualMachine::SnapshotInfo &info : merged) {
+        QJsonObject snapshot = images.value(info.name);
+        snapshot["parent"] = info.parent;
+        snapshot["description"] = info.description;
+        if (info.created.isValid()) {
+            snapshot["created"] = info.created.toString(Qt::ISODate);
+        }
+        snapshot["current"] = info.name == current;
+        tree.append(snapshot);
+    }
+    return tree;
 }
 
-bool KVMManager::resetVM(const QString &name)
+QStringList KVMManager::getGroups() const
 {
-    if (!m_libvirtRunning) {
-        emit errorOccurred(tr("Libvirt no está disponible"));
+    QStringList groups;
+    for (VirtualMachine *vm : m_virtualMachines) {
+        if (!vm->getGroup().isEmpty() && !groups.contains(vm->getGroup())) {
+            groups.append(vm->getGroup());
+        }
+    }
+    groups.sort();
+    return groups;
+}
+
+QStringList KVMManager::getGroupMembers(const QString &group) const
+{
+    QStringList members;
+    for (VirtualMachine *vm : m_virtualMachines) {
+        if (!group.isEmpty() && vm->getGroup() == group) {
+            members.append(vm->getName());
+        }
+    }
+    return members;
+}
+
+bool KVMManager::setVMGroup(const QString &name, const QString &group)
+{
+    VirtualMachine *vm = getVirtualMachine(name);
+    if (!vm) {
+        emit errorOccurred(tr("Máquina virtual '%1' no encontrada").arg(name));
         return false;
     }
     
-    QProcess process;
-    process.start("virsh", QStringList() << "reset" << name);
-    process.waitForFinished();
-    
-    if (process.exitCode() == 0) {
-        return true;
-    } else {
-        QString error = process.readAllStandardError();
-        emit errorOccurred(tr("Error al resetear VM '%1': %2").arg(name, error));
+    vm->setGroup(group.trimmed());
+    if (!saveVMConfiguration(vm)) {
         return false;
     }
+    emit vmListChanged();
+    return true;
+}
+
+QJsonObject KVMManager::createGroupSnapshot(const QString &group, const QString &tag)
+{
+    // Members snapshot in parallel: the slowest one plus the freeze and thaw
+    QJsonValue value;
+    int timeoutMs = 0;
+    for (const QString &name : getGroupMembers(group)) {
+        timeoutMs = qMax(timeoutMs, snapshotTimeoutMs(name));
+    }
+    timeoutMs += 2 * GroupSnapshot::FreezeTimeoutMs;
+    bool ok = waitForResult([this, group, tag](VMBackend::Callback callback) {
+        createGroupSnapshotAsync(group, tag, callback);
+    }, &value, timeoutMs);
+    return ok ? value.toObject() : QJsonObject();
+}
+
+void KVMManager::createGroupSnapshotAsync(const QString &group, const QString &tag, VMBackend::Callback callback)
+{
+    // The operation deletes itself; failures of single members were already
+    // reported through errorOccurred
+    GroupSnapshot *operation = new GroupSnapshot(this, group, tag, this);
+    operation->run([this, callback](const VMBackend::Result &result) {
+        if (!result.ok && !result.error.isEmpty()) {
+            emit errorOccurred(result.error);
+        }
+        if (callback) {
+            callback(result);
+        }
+    });
 }
 
 QString KVMManager::getVMState(const QString &name) const
@@ -474,6 +2514,69 @@ QString KVMManager::getLibvirtVersion() const
     return tr("Desconocido");
 }
 
+QJsonObject KVMManager::getKsmStatus() const
+{
+    HostInfo::KsmStatus ksm = HostInfo::ksmStatus();
+    QJsonObject status;
+    status["supported"] = ksm.supported;
+    if (!ksm.supported) {
+        return status;
+    }
+    
+    status["run"] = ksm.run;
+    status["pagesToScan"] = ksm.pagesToScan;
+    status["sleepMillisecs"] = ksm.sleepMillisecs;
+    status["pagesShared"] = ksm.pagesShared;
+    status["pagesSharing"] = ksm.pagesSharing;
+    status["pagesUnshared"] = ksm.pagesUnshared;
+    status["pagesVolatile"] = ksm.pagesVolatile;
+    status["zeroPages"] = ksm.zeroPages;
+    status["fullScans"] = ksm.fullScans;
+    status["savedKB"] = ksm.savedKB();
+    status["pageSizeKB"] = ksm.pageSizeKB;
+    if (ksm.hasGeneralProfit) {
+        status["generalProfitKB"] = ksm.generalProfit / 1024;
+    }
+    if (ksm.ksmdCpuTimeMs >= 0) {
+        status["ksmdCpuTimeMs"] = ksm.ksmdCpuTimeMs;
+    }
+    
+    QJsonArray vms;
+    for (VirtualMachine *vm : m_virtualMachines) {
+        qint64 pid = vm->getBackend() == "qemu" ? m_qemuManager->getVMPid(vm->getName()) : 0;
+        if (pid <= 0) {
+            continue;
+        }
+        
+        QJsonObject entry;
+        entry["name"] = vm->getName();
+        entry["mergeable"] = vm->isMemoryMergeable() && vm->getMemoryBacking() != "hugepages";
+        entry["memoryMB"] = vm->getMemoryMB();
+        qint64 merged = HostInfo::ksmMergingPages(pid);
+        if (merged >= 0) {
+            entry["mergedKB"] = merged * ksm.pageSizeKB;
+        }
+        vms.append(entry);
+    }
+    status["vms"] = vms;
+    return status;
+}
+
+bool KVMManager::setKsm(int run, int pagesToScan, int sleepMillisecs)
+{
+    if (run > 2) {
+        emit errorOccurred(tr("Valor de run no válido: %1 (0 parado, 1 en marcha, 2 deshacer fusiones)").arg(run));
+        return false;
+    }
+    
+    QString error;
+    if (!HostInfo::setKsm(run, pagesToScan, sleepMillisecs, &error)) {
+        emit errorOccurred(error);
+        return false;
+    }
+    return true;
+}
+
 QString KVMManager::getDefaultVMPath() const
 {
     return m_defaultVMPath;
@@ -500,6 +2603,179 @@ bool KVMManager::saveVMConfiguration(VirtualMachine *vm)
     return m_xmlManager->saveVM(vm);
 }
 
+static bool applyDiskTuningOption(VirtualMachine::DiskTuning &tuning, const QString &key, const QString &value)
+{
+    static const QStringList booleans = {"true", "false", "on", "off"};
+    
+    if (key == "cache" && QemuManager::diskCacheModes().contains(value)) {
+        tuning.cache = value;
+    } else if (key == "aio" && QemuManager::diskAioModes().contains(value)) {
+        tuning.aio = value;
+    } else if (key == "discard" && booleans.contains(value)) {
+        tuning.discard = value == "true" || value == "on";
+    } else if (key == "detect-zeroes" && (value == "off" || value == "on" || value == "unmap")) {
+        tuning.detectZeroes = value;
+    } else if (key == "iothread" && booleans.contains(value)) {
+        tuning.iothread = value == "true" || value == "on";
+    } else if (key == "queues") {
+        bool ok = false;
+        int queues = value.toInt(&ok);
+        if (!ok || queues < 0) {
+            return false;
+        }
+        tuning.queues = queues;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool KVMManager::setVMOption(const QString &name, const QString &key, const QString &value)
+{
+    VirtualMachine *vm = getVirtualMachine(name);
+    if (!vm) {
+        emit errorOccurred(tr("Máquina virtual '%1' no encontrada").arg(name));
+        return false;
+    }
+    
+    static const QStringList storageKeys = {"cache", "aio", "discard", "detect-zeroes", "iothread", "queues"};
+    
+    // Changes take effect the next time the VM is started
+    bool valid = false;
+    if (key == "memory") {
+        int memoryMB = value.toInt(&valid);
+        valid = valid && memoryMB > 0;
+        if (valid) vm->setMemoryMB(memoryMB);
+    } else if (key == "memory-backing") {
+        valid = QemuManager::memoryBackings().contains(value);
+        if (valid) vm->setMemoryBacking(value);
+    } else if (key == "hugepage-size") {
+        int sizeKB = value == "2M" ? 2048 : value == "1G" ? 1024 * 1024 : 0;
+        valid = sizeKB > 0;
+        if (valid) vm->setHugePageSizeKB(sizeKB);
+    } else if (key == "prealloc" || key == "memory-share" || key == "mem-merge") {
+        valid = value == "on" || value == "off" || value == "true" || value == "false";
+        bool enabled = value == "on" || value == "true";
+        if (valid && key == "prealloc") vm->setMemoryPrealloc(enabled);
+        if (valid && key == "memory-share") vm->setMemoryShared(enabled);
+        if (valid && key == "mem-merge") vm->setMemoryMergeable(enabled);
+    } else if (key == "balloon") {
+        valid = value == "on" || value == "off" || value == "true" || value == "false";
+        if (valid) vm->setMemoryBalloonEnabled(value == "on" || value == "true");
+    } else if (key == "ephemeral") {
+        // Takes effect on the next start; a running VM keeps its current mode
+        valid = value == "on" || value == "off" || value == "true" || value == "false";
+        if (valid) vm->setEphemeral(value == "on" || value == "true");
+    } else if (key == "group") {
+        // "none" takes the VM out of its group
+        valid = !value.trimmed().isEmpty();
+        if (valid) vm->setGroup(value == "none" ? QString() : value.trimmed());
+    } else if (key == "priority") {
+        valid = MemoryPressureController::priorities().contains(value);
+        if (valid) vm->setPriority(value);
+    } else if (key == "start-after") {
+        // Comma-separated VM names, or "none" to clear the list
+        QStringList vmNames;
+        valid = true;
+        if (value != "none") {
+            for (const QString &part : value.split(',', Qt::SkipEmptyParts)) {
+                QString dependency = part.trimmed();
+                valid = valid && dependency != name && getVirtualMachine(dependency);
+                vmNames.append(dependency);
+            }
+        }
+        if (valid) vm->setStartAfter(vmNames);
+    } else if (key == "cpus") {
+        int cpuCount = value.toInt(&valid);
+        valid = valid && cpuCount > 0;
+        if (valid) {
+            // A plain count replaces any explicit topology
+            vm->clearCPUTopology();
+            vm->setCPUCount(cpuCount);
+        }
+    } else if (key == "cpu-model") {
+        valid = value == "host-passthrough" || value == "host-model"
+                || m_qemuManager->getCpuModels().contains(value);
+        if (valid) vm->setCPUModel(value);
+    } else if (key == "pinning") {
+        valid = QemuManager::cpuPinningPolicies().contains(value) && value != "manual";
+        if (valid) vm->setCPUPinning(value);
+    } else if (key == "cpuset") {
+        // Explicit host CPU list, e.g. "2-5,8"; implies the manual policy
+        QList<int> cpus = HostInfo::parseCpuList(value);
+        valid = !cpus.isEmpty();
+        QList<int> hostCpus;
+        for (const HostInfo::LogicalCpu &cpu : HostInfo::cpuTopology().cpus) {
+            hostCpus.append(cpu.id);
+        }
+        for (int cpu : cpus) {
+            valid = valid && hostCpus.contains(cpu);
+        }
+        if (valid) {
+            vm->setCPUPinning("manual");
+            vm->setCPUSet(value);
+        }
+    } else if (key == "topology") {
+        // "auto" or "sockets=1,dies=1,cores=4,threads=2" (omitted fields = 1)
+        if (value == "auto") {
+            vm->clearCPUTopology();
+            valid = true;
+        } else {
+            QMap<QString, int> topology{{"sockets", 1}, {"dies", 1}, {"cores", 1}, {"threads", 1}};
+            valid = true;
+            for (const QString &part : value.split(',', Qt::SkipEmptyParts)) {
+                QString field = part.section('=', 0, 0).trimmed();
+                bool ok = false;
+                int count = part.section('=', 1).toInt(&ok);
+                valid = valid && ok && topology.contains(field);
+                topology[field] = count;
+            }
+            
+            QString error;
+            QStringList warnings;
+            int vcpus = topology["sockets"] * topology["dies"] * topology["cores"] * topology["threads"];
+            if (valid && !HostInfo::validateCpuTopology(vcpus, topology["sockets"], topology["dies"],
+                                                         topology["cores"], topology["threads"], &error, &warnings)) {
+                emit errorOccurred(error);
+                return false;
+            }
+            for (const QString &warning : warnings) {
+                qWarning() << "KVMManager:" << name << warning;
+            }
+            if (valid) {
+                vm->setCPUTopology(topology["sockets"], topology["dies"], topology["cores"], topology["threads"]);
+            }
+        }
+    } else if (key == "profile") {
+        valid = QemuManager::deviceProfiles().contains(value);
+        if (valid) vm->setDeviceProfile(value);
+    } else if (key == "disk-controller") {
+        valid = QemuManager::diskControllers().contains(value);
+        if (valid) vm->setDiskController(value);
+    } else if (storageKeys.contains(key)) {
+        // Storage tuning applies to every disk of the VM
+        VirtualMachine::DiskTuning probe;
+        valid = applyDiskTuningOption(probe, key, value);
+        const QStringList disks = valid ? vm->getHardDisks() : QStringList();
+        for (const QString &disk : disks) {
+            VirtualMachine::DiskTuning tuning = vm->hasDiskTuning(disk)
+                ? vm->getDiskTuning(disk) : QemuManager::defaultDiskTuning(disk, vm->getDeviceProfile());
+            applyDiskTuningOption(tuning, key, value);
+            vm->setDiskTuning(disk, tuning);
+        }
+    } else {
+        emit errorOccurred(tr("Opción de configuración desconocida: %1").arg(key));
+        return false;
+    }
+    
+    if (!valid) {
+        emit errorOccurred(tr("Valor no válido para '%1': %2").arg(key, value));
+        return false;
+    }
+    
+    return m_xmlManager->saveVM(vm);
+}
+
 void KVMManager::checkVMStates()
 {
     if (!m_libvirtRunning) {
@@ -6,10 +6,21 @@
 #include <QStringList>
 #include <QProcess>
 #include <QTimer>
+#include <QHash>
+#include <QSet>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QSharedPointer>
+#include <functional>
+
+#include "VMBackend.h"
+#include "BootScheduler.h"
 
 class VirtualMachine;
 class VMXmlManager;
 class QemuManager;
+class AdmissionController;
+class WarmPool;
 
 class KVMManager : public QObject
 {
@@ -24,15 +35,155 @@ public:
     VirtualMachine* getVirtualMachine(const QString &name) const;
     bool createVirtualMachine(const QString &name, const QString &osType, 
                              int memoryMB, int diskSizeGB);
+    // The disk is created in the background; result.value is the VM's name
+    void createVirtualMachineAsync(const QString &name, const QString &osType,
+                                   int memoryMB, int diskSizeGB, VMBackend::Callback callback);
     bool deleteVirtualMachine(const QString &name);
-    bool cloneVirtualMachine(const QString &sourceName, const QString &cloneName);
+    // With a snapshot tag the clone's disks are copied from that snapshot
+    bool cloneVirtualMachine(const QString &sourceName, const QString &cloneName,
+                             const QString &snapshot = QString());
+    // The disks are copied in the background; result.value is the clone's name
+    void cloneVirtualMachineAsync(const QString &sourceName, const QString &cloneName, const QString &snapshot,
+                                  VMBackend::Callback callback);
+    // Clone whose disks are thin qcow2 overlays on the source's disks. The
+    // source then becomes a base image: it cannot start or be deleted while
+    // getLinkedClones() lists VMs built on it
+    bool createLinkedClone(const QString &sourceName, const QString &cloneName);
+    QStringList getLinkedClones(const QString &name) const;
+    
+    // Golden templates: a shut-off QEMU VM whose disks are made read-only and
+    // serve as the base of new VMs, each a linked clone with its own UUID and
+    // MAC. The batch variant creates <prefix>-1, -2... (skipping taken names)
+    // building all the overlays in parallel; its result is
+    // {template, created, failed, msecs}, or an empty object if none was made
+    QStringList getTemplates() const;
+    bool setVMTemplate(const QString &name, bool isTemplate);
+    bool createVMFromTemplate(const QString &templateName, const QString &name);
+    QJsonObject createVMsFromTemplate(const QString &templateName, const QString &prefix, int count);
+    // Same without blocking on qemu-img; the batch result is the value
+    void createVMFromTemplateAsync(const QString &templateName, const QString &name, VMBackend::Callback callback);
+    void createVMsFromTemplateAsync(const QString &templateName, const QString &prefix, int count,
+                                    VMBackend::Callback callback);
     
-    // VM Control
+    // VM Control (blocking: waits for the VM's backend in a nested event
+    // loop, for kvmctl's one-shot commands; the GUI must use the *Async
+    // variants so that no slot re-enters while it waits)
     bool startVM(const QString &name);
     bool stopVM(const QString &name);
     bool pauseVM(const QString &name);
     bool resumeVM(const QString &name);
     bool resetVM(const QString &name);
+    QJsonObject getVMStats(const QString &name);
+    bool setBalloonTarget(const QString &name, qint64 targetMB);
+    bool saveVMState(const QString &name, QJsonObject *stats = nullptr);
+    // Last suspend/restore of a QEMU VM: {"save": {...}, "restore": {...}}
+    // with format, channels, ramBytes, fileBytes, msecs and mbps
+    QJsonObject getSaveStateStats(const QString &name) const;
+    
+    // Asynchronous VM control through the VM's backend
+    void startVMAsync(const QString &name, VMBackend::Callback callback = nullptr);
+    void stopVMAsync(const QString &name, VMBackend::Callback callback = nullptr);
+    void pauseVMAsync(const QString &name, VMBackend::Callback callback = nullptr);
+    void resumeVMAsync(const QString &name, VMBackend::Callback callback = nullptr);
+    void resetVMAsync(const QString &name, VMBackend::Callback callback = nullptr);
+    void queryVMStats(const QString &name, VMBackend::Callback callback);
+    void setBalloonTargetAsync(const QString &name, qint64 targetMB, VMBackend::Callback callback = nullptr);
+    // Suspend to disk; the next start restores the guest where it was
+    void saveVMStateAsync(const QString &name, VMBackend::Callback callback = nullptr);
+    // After starting a VM from saved RAM: calls back once QEMU has loaded it
+    // and the guest runs, with result["msecs"] counted from startMs
+    void waitForRestore(const QString &name, QJsonObject result, qint64 startMs, VMBackend::Callback callback);
+    
+    // Bulk start/stop paced by a BootScheduler (parallelism, ramp-up,
+    // dependencies, readiness). The result value is the per-VM summary,
+    // also returned by the blocking variants
+    void startVMsAsync(const QStringList &names, const BootScheduler::Options &options,
+                       VMBackend::Callback callback = nullptr);
+    void stopVMsAsync(const QStringList &names, const BootScheduler::Options &options,
+                      VMBackend::Callback callback = nullptr);
+    QJsonObject startVMs(const QStringList &names, const BootScheduler::Options &options);
+    QJsonObject stopVMs(const QStringList &names, const BootScheduler::Options &options);
+    
+    // Hands out a pre-booted standby instance of a template (see WarmPool);
+    // the result value is {name, warm, from, msecs}
+    void acquireWarmVMAsync(const QString &templateName, VMBackend::Callback callback);
+    QJsonObject acquireWarmVM(const QString &templateName);
+    
+    // Backends ("qemu" for direct QEMU, "libvirt" for libvirt domains)
+    VMBackend* getBackend(const QString &id) const;
+    VMBackend* getVMBackend(const QString &name) const;
+    QStringList getBackendIds() const;
+    
+    // Snapshots (handled by the VM's backend). The tree merges the snapshots
+    // found in the disk images with the parent/description metadata kept in
+    // the VM's XML: one object per snapshot with name, parent, description,
+    // created, current and the image details (vmStateSize, diskSize...)
+    QStringList getSnapshots(const QString &name);
+    QJsonArray getSnapshotTree(const QString &name);
+    bool createSnapshot(const QString &name, const QString &tag, const QString &description = QString());
+    bool deleteSnapshot(const QString &name, const QString &tag);
+    bool revertSnapshot(const QString &name, const QString &tag);
+    void querySnapshotTree(const QString &name, VMBackend::Callback callback);
+    void createSnapshotAsync(const QString &name, const QString &tag, const QString &description = QString(),
+                             VMBackend::Callback callback = nullptr);
+    void deleteSnapshotAsync(const QString &name, const QString &tag, VMBackend::Callback callback = nullptr);
+    void revertSnapshotAsync(const QString &name, const QString &tag, VMBackend::Callback callback = nullptr);
+    
+    // External snapshots: a qcow2 overlay on every disk, then commit (into
+    // the base) or stream (into the top) to shorten a disk's chain again.
+    // getDiskChains lists, per disk, its images from the top down plus the
+    // overlay depth and whether it exceeds the configured warning depth
+    QJsonArray getDiskChains(const QString &name) const;
+    bool createExternalSnapshot(const QString &name, const QString &tag);
+    bool mergeDiskChain(const QString &name, const QString &disk, const QString &mode);
+    void createExternalSnapshotAsync(const QString &name, const QString &tag, VMBackend::Callback callback = nullptr);
+    // For group snapshots: checkExternalSnapshot runs the backend's checks
+    // without creating anything (empty when the overlay can be added now);
+    // discardExternalSnapshotAsync drops a fresh overlay and puts "disks"
+    // (the ones in use before it) back in the VM
+    QString checkExternalSnapshot(const QString &name, const QString &tag);
+    void discardExternalSnapshotAsync(const QString &name, const QStringList &disks,
+                                      VMBackend::Callback callback = nullptr);
+    void mergeDiskChainAsync(const QString &name, const QString &disk, const QString &mode,
+                             VMBackend::Callback callback = nullptr);
+    
+    // Checkpoints to reset test VMs in seconds (QEMU backend). Creating one
+    // freezes the disks under fresh overlays and, if the VM is running, keeps
+    // its RAM; a reset drops everything written since and, with RAM, starts
+    // the VM straight into the checkpoint. The result values are the
+    // checkpoint ({name, created, memory, disks, overlays...}) and
+    // {checkpoint, memory, overlays, msecs}; the blocking variants return
+    // an empty object on failure
+    QJsonArray getCheckpoints(const QString &name) const;
+    QJsonObject createCheckpoint(const QString &name, const QString &checkpoint);
+    QJsonObject resetToCheckpoint(const QString &name, const QString &checkpoint);
+    bool deleteCheckpoint(const QString &name, const QString &checkpoint);
+    void createCheckpointAsync(const QString &name, const QString &checkpoint, VMBackend::Callback callback = nullptr);
+    void resetToCheckpointAsync(const QString &name, const QString &checkpoint, VMBackend::Callback callback = nullptr);
+    void deleteCheckpointAsync(const QString &name, const QString &checkpoint, VMBackend::Callback callback = nullptr);
+    
+    // Instant clones of a running VM: a "fork-*" checkpoint captures its RAM
+    // once and freezes its disks, then each clone gets thin overlays on the
+    // frozen disks and a hard link to the state file, and all of them start
+    // straight into that memory. The source keeps running. Once every clone
+    // has restored, the captured RAM and checkpoint.json are removed; only
+    // the frozen images stay. The result is {source, checkpoint, created,
+    // failed, captureMsecs, msecs}
+    QJsonObject forkVM(const QString &name, int count, const QString &prefix = QString());
+    void forkVMAsync(const QString &name, int count, const QString &prefix = QString(),
+                     VMBackend::Callback callback = nullptr);
+    
+    // VM groups: the VMs of one multi-VM application. A group snapshot adds
+    // an external overlay to every member's disks at the same instant (see
+    // GroupSnapshot); its result value is {group, tag, members, quiesced,
+    // rolledBack, pauseMsecs, pauseSpreadMsecs, msecs}, which the async
+    // variant also passes on partial failure
+    QStringList getGroups() const;
+    QStringList getGroupMembers(const QString &group) const;
+    // An empty group takes the VM out of its group
+    bool setVMGroup(const QString &name, const QString &group);
+    QJsonObject createGroupSnapshot(const QString &group, const QString &tag);
+    void createGroupSnapshotAsync(const QString &group, const QString &tag, VMBackend::Callback callback = nullptr);
     
     // VM Status
     QString getVMState(const QString &name) const;
@@ -40,6 +191,12 @@ public:
     
     // VM Configuration
     bool saveVMConfiguration(VirtualMachine *vm);
+    bool setVMOption(const QString &name, const QString &key, const QString &value);
+    
+    // Import/sync libvirt domains (incremental by domain UUID). The summary
+    // is {domains, imported, updated, removed, skipped, elapsedMs}
+    QJsonObject syncLibvirtDomains(bool fullRefresh = false);
+    void syncLibvirtDomainsAsync(bool fullRefresh, VMBackend::Callback callback = nullptr);
     
     // System Information
     bool isKVMAvailable() const;
@@ -47,7 +204,17 @@ public:
     QString getKVMVersion() const;
     QString getLibvirtVersion() const;
     
+    // Kernel samepage merging: host counters plus the pages merged in each
+    // running QEMU guest. Negative values leave a setting unchanged
+    QJsonObject getKsmStatus() const;
+    bool setKsm(int run, int pagesToScan = -1, int sleepMillisecs = -1);
+    
     // Configuration
+    QemuManager* getQemuManager() const { return m_qemuManager; }
+    // Books RAM and vCPUs before every start (queue, warn or refuse)
+    AdmissionController* getAdmissionController() const { return m_admission; }
+    // Standby instances per template; idle until WarmPool::start()
+    WarmPool* getWarmPool() const { return m_warmPool; }
     QString getDefaultVMPath() const;
     void setDefaultVMPath(const QString &path);
 
@@ -57,16 +224,72 @@ signals:
     void vmCreated(const QString &name);
     void vmDeleted(const QString &name);
     void errorOccurred(const QString &error);
+    // Stage of each VM in a bulk start/stop (see BootScheduler::progress)
+    void bulkProgress(const QString &name, const QString &stage, const QString &detail);
+    // Progress (0-100) of a long backend job such as a snapshot
+    void jobProgress(const QString &name, const QString &job, int percent);
+    // A disk's backing chain is deeper than the configured warning depth
+    void chainDepthWarning(const QString &name, const QString &disk, int depth);
 
 private slots:
     void checkVMStates();
     void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
 
 private:
+    using BackendOperation = std::function<void(VMBackend *backend, VirtualMachine *vm, VMBackend::Callback callback)>;
+    
+    void registerBackend(VMBackend *backend);
+    void dispatch(const QString &name, const BackendOperation &operation, VMBackend::Callback callback);
+    // dispatch() for operations that write to or swap the VM's disks; refused on templates
+    void dispatchDiskChange(const QString &name, const BackendOperation &operation, VMBackend::Callback callback);
+    bool waitForResult(const std::function<void(VMBackend::Callback)> &operation, QJsonValue *value = nullptr,
+                       int timeoutMs = 60000);
     void initializeKVM();
     void loadVirtualMachines();
     bool executeLibvirtCommand(const QString &command, QStringList &output);
     VirtualMachine* parseVMInfo(const QString &vmXML);
+    void removeVMEntry(VirtualMachine *vm);
+    VirtualMachine* prepareVirtualMachine(const QString &name, const QString &osType, int memoryMB,
+                                          QString *diskPath);
+    bool registerVirtualMachine(VirtualMachine *vm, const QString &diskPath);
+    QString prepareClone(const QString &sourceName, const QString &cloneName);
+    bool registerClone(const QString &sourceName, const QString &cloneName);
+    void copyCloneDisks(const QString &sourceName, const QString &cloneName, const QString &snapshot,
+                        const QList<QPair<QString, QString>> &copies, int index, VMBackend::Callback callback);
+    static QString linkedCloneOverlay(const QString &cloneName, int index);
+    bool registerLinkedClone(const QString &sourceName, const QString &cloneName,
+                             const QStringList &overlays, const QString &description);
+    // Linked clones of sourceName's configuration on the given disks, their
+    // overlays built in parallel; returns the names created
+    QStringList createLinkedClones(const QString &sourceName, const QStringList &disks, const QStringList &names,
+                                   const QString &description, QJsonArray *failed);
+    void createLinkedClonesAsync(const QString &sourceName, const QStringList &disks, const QStringList &names,
+                                 const QString &description,
+                                 std::function<void(const QStringList &created, const QJsonArray &failed)> callback);
+    QStringList prepareLinkedClones(const QStringList &disks, const QStringList &names,
+                                    QList<QPair<QString, QString>> *overlays, QJsonArray *failed);
+    QStringList registerLinkedClones(const QString &sourceName, int diskCount, const QStringList &prepared,
+                                     const QStringList &failedOverlays, const QString &description,
+                                     QJsonArray *failed);
+    QStringList templateBatchNames(const QString &templateName, const QString &prefix, int count);
+    QJsonObject templateBatchResult(const QString &templateName, const QStringList &created,
+                                    const QJsonArray &failed, qint64 msecs) const;
+    QStringList freeVMNames(const QString &prefix, int count) const;
+    static QSet<QString> backingImages(const QStringList &images);
+    void recordDiskFormats(VirtualMachine *vm);
+    void runBulk(BootScheduler::Action action, const QStringList &names,
+                 const BootScheduler::Options &options, VMBackend::Callback callback);
+    int bulkTimeoutMs(const QStringList &names, const BootScheduler::Options &options) const;
+    int snapshotTimeoutMs(const QString &name) const;
+    void checkChainDepth(VirtualMachine *vm);
+    void releaseForkCapture(const QString &name, const QString &checkpoint);
+    QJsonArray mergeSnapshotTree(VirtualMachine *vm, const QJsonArray &snapshots);
+    struct LibvirtSync;
+    void planLibvirtSync(const QSharedPointer<LibvirtSync> &sync, const QString &uuidListing,
+                         const QString &stateListing);
+    void fetchLibvirtDomains(const QSharedPointer<LibvirtSync> &sync, int offset, VMBackend::Callback done);
+    void finishLibvirtSync(const QSharedPointer<LibvirtSync> &sync, VMBackend::Callback done);
+    VirtualMachine* libvirtVM(const QString &name, const QString &uuid) const;
     
     QList<VirtualMachine*> m_virtualMachines;
     QTimer *m_stateCheckTimer;
@@ -74,8 +297,12 @@ private:
     bool m_kvmAvailable;
     VMXmlManager *m_xmlManager;
     QemuManager *m_qemuManager;
+    AdmissionController *m_admission;
+    WarmPool *m_warmPool;
+    QHash<QString, VMBackend*> m_backends;
     bool m_libvirtRunning;
     bool m_loadingVMs;
+    bool m_libvirtSyncing;
 };
 
 #endif // KVMMANAGER_H
\ No newline at end of file
@@ -0,0 +1,252 @@
+#include "LibvirtBackend.h"
+#include "VirshSession.h"
+#include "VirtualMachine.h"
+
+#include <QJsonObject>
+#include <QJsonArray>
+
+LibvirtBackend::LibvirtBackend(QObject *parent)
+    : VMBackend(parent)
+    , m_session(new VirshSession(this))
+{
+    connect(m_session, &VirshSession::errorOccurred, this, &LibvirtBackend::errorOccurred);
+}
+
+bool LibvirtBackend::isAvailable()
+{
+    return m_session->isAvailable();
+}
+
+void LibvirtBackend::start(VirtualMachine *vm, Callback callback)
+{
+    runControl(vm, QStringList() << "start" << vm->getName(), "running",
+               tr("Error al iniciar VM '%1'").arg(vm->getName()), callback);
+}
+
+void LibvirtBackend::stop(VirtualMachine *vm, Callback callback)
+{
+    runControl(vm, QStringList() << "shutdown" << vm->getName(), "shut off",
+               tr("Error al detener VM '%1'").arg(vm->getName()), callback);
+}
+
+void LibvirtBackend::pause(VirtualMachine *vm, Callback callback)
+{
+    runControl(vm, QStringList() << "suspend" << vm->getName(), "paused",
+               tr("Error al pausar VM '%1'").arg(vm->getName()), callback);
+}
+
+void LibvirtBackend::resume(VirtualMachine *vm, Callback callback)
+{
+    runControl(vm, QStringList() << "resume" << vm->getName(), "running",
+               tr("Error al reanudar VM '%1'").arg(vm->getName()), callback);
+}
+
+void LibvirtBackend::reset(VirtualMachine *vm, Callback callback)
+{
+    runControl(vm, QStringList() << "reset" << vm->getName(), QString(),
+               tr("Error al resetear VM '%1'").arg(vm->getName()), callback);
+}
+
+void LibvirtBackend::queryState(VirtualMachine *vm, Callback callback)
+{
+    m_session->execute(QStringList() << "domstate" << vm->getName(),
+                       [callback](const VirshSession::Result &result) {
+        if (!result.ok) {
+            callback(failure(result.error));
+            return;
+        }
+        callback(success(result.output.trimmed()));
+    });
+}
+
+void LibvirtBackend::queryStats(VirtualMachine *vm, Callback callback)
+{
+    m_session->execute(QStringList() << "domstats" << vm->getName(),
+                       [callback](const VirshSession::Result &result) {
+        if (!result.ok) {
+            callback(failure(result.error));
+            return;
+        }
+        
+        // Formato: "Domain: 'nombre'" seguido de líneas "  clave=valor"
+        QJsonObject stats;
+        for (const QString &line : result.output.split('\n', Qt::SkipEmptyParts)) {
+            int separator = line.indexOf('=');
+            if (separator <= 0) {
+                continue;
+            }
+            QString key = line.left(separator).trimmed();
+            QString value = line.mid(separator + 1).trimmed();
+            bool isNumber = false;
+            qlonglong number = value.toLongLong(&isNumber);
+            stats[key] = isNumber ? QJsonValue(number) : QJsonValue(value);
+        }
+        
+        // Mismo formato que el backend QEMU (domstats da los valores en KiB)
+        const QList<QPair<QString, QString>> balloonSizes = {
+            {"balloon.current", "actualMB"}, {"balloon.unused", "freeMB"},
+            {"balloon.disk_caches", "cachedMB"}, {"balloon.usable", "availableMB"},
+            {"balloon.available", "totalMB"}
+        };
+        QJsonObject balloon;
+        for (const auto &entry : balloonSizes) {
+            if (stats.contains(entry.first)) {
+                balloon[entry.second] = stats.value(entry.first).toInteger() / 1024;
+            }
+        }
+        if (stats.contains("balloon.major_fault")) {
+            balloon["majorFaults"] = stats.value("balloon.major_fault");
+            balloon["minorFaults"] = stats.value("balloon.minor_fault");
+        }
+        if (stats.contains("balloon.last-update")) {
+            balloon["lastUpdate"] = stats.value("balloon.last-update");
+        }
+        if (!balloon.isEmpty()) {
+            // libvirt mueve el balón hasta el valor de setmem: actual == objetivo
+            balloon["targetMB"] = balloon.value("actualMB");
+            stats["balloon"] = balloon;
+        }
+        callback(success(stats));
+    });
+}
+
+void LibvirtBackend::setBalloonTarget(VirtualMachine *vm, qint64 targetMB, Callback callback)
+{
+    m_session->execute(QStringList() << "setmem" << vm->getName() << QString("%1M").arg(targetMB) << "--live",
+                       [callback, targetMB](const VirshSession::Result &result) {
+        callback(result.ok ? success(targetMB) : failure(result.error));
+    });
+}
+
+void LibvirtBackend::saveState(VirtualMachine *vm, Callback callback)
+{
+    // libvirt restaura el estado guardado con managedsave en el siguiente "start"
+    runControl(vm, QStringList() << "managedsave" << vm->getName(), "saved",
+               tr("Error al guardar el estado de la VM '%1'").arg(vm->getName()), callback);
+}
+
+void LibvirtBackend::listSnapshots(VirtualMachine *vm, Callback callback)
+{
+    m_session->execute(QStringList() << "snapshot-list" << vm->getName() << "--name",
+                       [callback](const VirshSession::Result &result) {
+        if (!result.ok) {
+            callback(failure(result.error));
+            return;
+        }
+        
+        QJsonArray snapshots;
+        for (const QString &line : result.output.split('\n', Qt::SkipEmptyParts)) {
+            if (!line.trimmed().isEmpty()) {
+                QJsonObject snapshot;
+                snapshot["name"] = line.trimmed();
+                snapshots.append(snapshot);
+            }
+        }
+        callback(success(snapshots));
+    });
+}
+
+void LibvirtBackend::createSnapshot(VirtualMachine *vm, const QString &tag, Callback callback)
+{
+    runControl(vm, QStringList() << "snapshot-create-as" << "--domain" << vm->getName() << "--name" << tag,
+               QString(), tr("Error creando instantánea '%1'").arg(tag), callback);
+}
+
+void LibvirtBackend::deleteSnapshot(VirtualMachine *vm, const QString &tag, Callback callback)
+{
+    runControl(vm, QStringList() << "snapshot-delete" << vm->getName() << tag,
+               QString(), tr("Error eliminando instantánea '%1'").arg(tag), callback);
+}
+
+void LibvirtBackend::revertSnapshot(VirtualMachine *vm, const QString &tag, Callback callback)
+{
+    runControl(vm, QStringList() << "snapshot-revert" << vm->getName() << tag,
+               QString(), tr("Error restaurando instantánea '%1'").arg(tag), callback);
+}
+
+void LibvirtBackend::createExternalSnapshot(VirtualMachine *vm, const QString &tag, const QString &directory,
+                                            Callback callback)
+{
+    // libvirt elige el nombre de cada capa y actualiza el dominio; la nueva
+    // ruta de los discos llega con la siguiente sincronización
+    Q_UNUSED(directory)
+    runControl(vm, QStringList() << "snapshot-create-as" << "--domain" << vm->getName() << "--name" << tag
+                                 << "--disk-only" << "--atomic",
+               QString(), tr("Error creando instantánea externa '%1'").arg(tag),
+               [callback](const Result &result) {
+        callback(result.ok ? success(QJsonArray()) : result);
+    });
+}
+
+QString LibvirtBackend::checkExternalSnapshot(VirtualMachine *vm, const QString &tag, const QString &directory)
+{
+    // snapshot-create-as comprueba el dominio al crear la capa (--atomic)
+    Q_UNUSED(vm)
+    Q_UNUSED(directory)
+    return tag.trimmed().isEmpty() ? tr("El nombre de la instantánea no puede estar vacío") : QString();
+}
+
+void LibvirtBackend::discardExternalSnapshot(VirtualMachine *vm, const QStringList &disks, Callback callback)
+{
+    // libvirt no sabe quitar una capa externa (snapshot-revert no admite --disk-only)
+    Q_UNUSED(disks)
+    callback(failure(tr("No se puede deshacer una instantánea externa del dominio libvirt '%1'").arg(vm->getName())));
+}
+
+void LibvirtBackend::mergeDiskChain(VirtualMachine *vm, const QString &diskPath, const QString &mode,
+                                    Callback callback)
+{
+    // blockcommit y blockpull sólo funcionan con el dominio en marcha; como
+    // en las capas nuevas, las rutas se actualizan al sincronizar
+    QStringList arguments;
+    if (mode == "commit") {
+        arguments << "blockcommit" << vm->getName() << diskPath << "--active" << "--pivot" << "--wait";
+    } else if (mode == "stream") {
+        arguments << "blockpull" << vm->getName() << diskPath << "--wait";
+    } else {
+        callback(failure(tr("Modo de fusión desconocido '%1' (commit o stream)").arg(mode)));
+        return;
+    }
+    runControl(vm, arguments, QString(), tr("Error fusionando la cadena del disco %1").arg(diskPath),
+               [callback](const Result &result) {
+        callback(result.ok ? success() : result);
+    });
+}
+
+void LibvirtBackend::createCheckpoint(VirtualMachine *vm, const QString &name, Callback callback)
+{
+    // Las capas y la RAM de un dominio las gestiona libvirt; el equivalente
+    // es una instantánea interna con memoria y snapshot-revert
+    Q_UNUSED(name)
+    callback(failure(tr("Los puntos de control requieren el backend QEMU; para el dominio libvirt '%1' "
+                        "use una instantánea con memoria").arg(vm->getName())));
+}
+
+void LibvirtBackend::resetToCheckpoint(VirtualMachine *vm, const QString &name, Callback callback)
+{
+    createCheckpoint(vm, name, callback);
+}
+
+void LibvirtBackend::deleteCheckpoint(VirtualMachine *vm, const QString &name, const QStringList &keep,
+                                      Callback callback)
+{
+    Q_UNUSED(keep)
+    createCheckpoint(vm, name, callback);
+}
+
+void LibvirtBackend::runControl(VirtualMachine *vm, const QStringList &arguments, const QString &newState,
+                                const QString &errorMessage, Callback callback)
+{
+    QString vmName = vm->getName();
+    m_session->execute(arguments, [this, vmName, newState, errorMessage, callback](const VirshSession::Result &result) {
+        if (!result.ok) {
+            callback(failure(QString("%1: %2").arg(errorMessage, result.error)));
+            return;
+        }
+        
+        if (!newState.isEmpty()) {
+            emit vmStateChanged(vmName, newState);
+        }
+        callback(success(result.output.trimmed()));
+    });
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef LIBVIRTBACKEND_H
+#define LIBVIRTBACKEND_H
+
+#include "VMBackend.h"
+
+#include <QStringList>
+
+class VirshSession;
+
+/**
+ * @brief Backend para dominios gestionados por libvirt
+ * Todas las órdenes pasan por una única sesión persistente de virsh.
+ */
+class LibvirtBackend : public VMBackend
+{
+    Q_OBJECT
+
+public:
+    explicit LibvirtBackend(QObject *parent = nullptr);
+    
+    QString id() const override { return "libvirt"; }
+    bool isAvailable() override;
+    VirshSession* session() const { return m_session; }
+    
+    void start(VirtualMachine *vm, Callback callback) override;
+    void stop(VirtualMachine *vm, Callback callback) override;
+    void pause(VirtualMachine *vm, Callback callback) override;
+    void resume(VirtualMachine *vm, Callback callback) override;
+    void reset(VirtualMachine *vm, Callback callback) override;
+    
+    void queryState(VirtualMachine *vm, Callback callback) override;
+    void queryStats(VirtualMachine *vm, Callback callback) override;
+    void setBalloonTarget(VirtualMachine *vm, qint64 targetMB, Callback callback) override;
+    void saveState(VirtualMachine *vm, Callback callback) override;
+    
+    void listSnapshots(VirtualMachine *vm, Callback callback) override;
+    void createSnapshot(VirtualMachine *vm, const QString &tag, Callback callback) override;
+    void deleteSnapshot(VirtualMachine *vm, const QString &tag, Callback callback) override;
+    void revertSnapshot(VirtualMachine *vm, const QString &tag, Callback callback) override;
+    void createExternalSnapshot(VirtualMachine *vm, const QString &tag, const QString &directory,
+                                Callback callback) override;
+    QString checkExternalSnapshot(VirtualMachine *vm, const QString &tag, const QString &directory) override;
+    void discardExternalSnapshot(VirtualMachine *vm, const QStringList &disks, Callback callback) override;
+    void mergeDiskChain(VirtualMachine *vm, const QString &diskPath, const QString &mode,
+                        Callback callback) override;
+    void createCheckpoint(VirtualMachine *vm, const QString &name, Callback callback) override;
+    void resetToCheckpoint(VirtualMachine *vm, const QString &name, Callback callback) override;
+    void deleteCheckpoint(VirtualMachine *vm, const QString &name, const QStringList &keep,
+                          Callback callback) override;
+
+private:
+    // Ejecuta la orden y, si tiene éxito, notifica el nuevo estado
+    void runControl(VirtualMachine *vm, const QStringList &arguments, const QString &newState,
+                    const QString &errorMessage, Callback callback);
+    
+    VirshSession *m_session;
+};
+
+#endif // LIBVIRTBACKEND_H
\ No newline at end of file
@@ -0,0 +1,497 @@
+#include "MemoryPressureController.h"
+#include "KVMManager.h"
+#include "QemuManager.h"
+#include "VirtualMachine.h"
+
+#include <QTimer>
+#include <QLockFile>
+#include <QSettings>
+#include <QFile>
+#include <QDir>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QDebug>
+
+#include <algorithm>
+
+MemoryPressureController::MemoryPressureController(KVMManager *kvmManager, QObject *parent)
+    : QObject(parent)
+    , m_kvmManager(kvmManager)
+    , m_timer(new QTimer(this))
+    , m_lock(new QLockFile(QDir::homePath() + "/.VM/memory-pressure.lock"))
+    , m_policy(loadPolicy())
+    , m_level(Normal)
+    , m_exhausted(false)
+{
+    // El bloqueo dura lo que la instancia: sólo es obsoleto si su proceso murió
+    m_lock->setStaleLockTime(0);
+    
+    // El kernel actualiza PSI cada 2 s: con un segundo se reacciona a tiempo
+    m_timer->setInterval(1000);
+    connect(m_timer, &QTimer::timeout, this, &MemoryPressureController::evaluate);
+}
+
+MemoryPressureController::~MemoryPressureController()
+{
+    stop();
+    delete m_lock;
+}
+
+void MemoryPressureController::start()
+{
+    if (!m_policy.enabled || m_timer->isActive()) {
+        return;
+    }
+    
+    QDir().mkpath(QDir::homePath() + "/.VM");
+    m_timer->start();
+    evaluate();
+}
+
+void MemoryPressureController::stop()
+{
+    m_timer->stop();
+    if (m_lock->isLocked()) {
+        m_lock->unlock();
+    }
+}
+
+bool MemoryPressureController::isActive() const
+{
+    return m_timer->isActive() && m_lock->isLocked();
+}
+
+void MemoryPressureController::reloadPolicy()
+{
+    bool wasEnabled = m_policy.enabled;
+    m_policy = loadPolicy();
+    
+    if (m_policy.enabled && !wasEnabled) {
+        logDecision(tr("Controlador de presión de memoria activado"));
+        start();
+    } else if (!m_policy.enabled && wasEnabled) {
+        logDecision(tr("Controlador de presión de memoria desactivado"));
+        stop();
+    }
+}
+
+MemoryPressureController::Policy MemoryPressureController::loadPolicy()
+{
+    QSettings settings;
+    Policy policy;
+    
+    policy.enabled = settings.value("memoryPressure/enabled", policy.enabled).toBool();
+    policy.someThreshold = qBound(1.0, settings.value("memoryPressure/someThreshold", policy.someThreshold).toDouble(), 100.0);
+    policy.fullThreshold = qBound(1.0, settings.value("memoryPressure/fullThreshold", policy.fullThreshold).toDouble(), 100.0);
+    policy.minAvailablePercent = qBound(1, settings.value("memoryPressure/minAvailablePercent", policy.minAvailablePercent).toInt(), 90);
+    policy.recoveryPercent = qBound(policy.minAvailablePercent + 1,
+                                    settings.value("memoryPressure/recoveryPercent", policy.recoveryPercent).toInt(), 95);
+    policy.balloonStepPercent = qBound(5, settings.value("memoryPressure/balloonStepPercent", policy.balloonStepPercent).toInt(), 50);
+    policy.balloonFloorPercent = qBound(10, settings.value("memoryPressure/balloonFloorPercent", policy.balloonFloorPercent).toInt(), 95);
+    policy.cooldownSecs = qBound(1, settings.value("memoryPressure/cooldownSecs", policy.cooldownSecs).toInt(), 300);
+    policy.allowBalloon = settings.value("memoryPressure/allowBalloon", policy.allowBalloon).toBool();
+    policy.allowPause = settings.value("memoryPressure/allowPause", policy.allowPause).toBool();
+    policy.allowSave = settings.value("memoryPressure/allowSave", policy.allowSave).toBool();
+    policy.restoreSaved = settings.value("memoryPressure/restoreSaved", policy.restoreSaved).toBool();
+    
+    return policy;
+}
+
+void MemoryPressureController::savePolicy(const Policy &policy)
+{
+    QSettings settings;
+    settings.setValue("memoryPressure/enabled", policy.enabled);
+    settings.setValue("memoryPressure/someThreshold", policy.someThreshold);
+    settings.setValue("memoryPressure/fullThreshold", policy.fullThreshold);
+    settings.setValue("memoryPressure/minAvailablePercent", policy.minAvailablePercent);
+    settings.setValue("memoryPressure/recoveryPercent", policy.recoveryPercent);
+    settings.setValue("memoryPressure/balloonStepPercent", policy.balloonStepPercent);
+    settings.setValue("memoryPressure/balloonFloorPercent", policy.balloonFloorPercent);
+    settings.setValue("memoryPressure/cooldownSecs", policy.cooldownSecs);
+    settings.setValue("memoryPressure/allowBalloon", policy.allowBalloon);
+    settings.setValue("memoryPressure/allowPause", policy.allowPause);
+    settings.setValue("memoryPressure/allowSave", policy.allowSave);
+    settings.setValue("memoryPressure/restoreSaved", policy.restoreSaved);
+}
+
+QJsonObject MemoryPressureController::status() const
+{
+    QJsonObject status;
+    status["enabled"] = m_policy.enabled;
+    status["active"] = isActive();
+    status["level"] = levelName(m_level);
+    
+    QJsonObject host;
+    host["memTotalMB"] = m_memory.totalKB / 1024;
+    host["memAvailableMB"] = m_memory.availableKB / 1024;
+    host["psiSupported"] = m_pressure.supported;
+    host["someAvg10"] = m_pressure.someAvg10;
+    host["someAvg60"] = m_pressure.someAvg60;
+    host["fullAvg10"] = m_pressure.fullAvg10;
+    host["fullAvg60"] = m_pressure.fullAvg60;
+    status["host"] = host;
+    
+    QJsonObject managed;
+    for (auto it = m_managed.constBegin(); it != m_managed.constEnd(); ++it) {
+        QJsonObject entry;
+        if (it.value().balloonMB) {
+            entry["balloonMB"] = it.value().balloonMB;
+        }
+        entry["paused"] = it.value().paused;
+        entry["saved"] = it.value().saved;
+        entry["busy"] = it.value().busy;
+        managed[it.key()] = entry;
+    }
+    status["managed"] = managed;
+    status["decisions"] = QJsonArray::fromStringList(m_decisions.mid(qMax(0, m_decisions.size() - 20)));
+    return status;
+}
+
+QStringList MemoryPressureController::priorities()
+{
+    return {"low", "normal", "high"};
+}
+
+QString MemoryPressureController::logPath()
+{
+    return QDir::homePath() + "/.VM/memory-pressure.log";
+}
+
+QString MemoryPressureController::levelName(Level level)
+{
+    switch (level) {
+    case Pressure:
+        return "pressure";
+    case Critical:
+        return "critical";
+    default:
+        return "normal";
+    }
+}
+
+void MemoryPressureController::evaluate()
+{
+    m_memory = HostInfo::hostMemory();
+    m_pressure = HostInfo::memoryPressure();
+    
+    // Sólo actúa una instancia; si la que tenía el bloqueo termina, ésta la releva
+    if (!m_lock->isLocked() && !m_lock->tryLock(0)) {
+        return;
+    }
+    
+    reconcile();
+    
+    Level level = classify();
+    if (level != m_level) {
+        logDecision(tr("Nivel de presión: %1 → %2 (%3)").arg(levelName(m_level), levelName(level), pressureSummary()));
+        m_level = level;
+        m_exhausted = false;
+        emit levelChanged(level);
+    }
+    
+    // Cada paso tarda unos segundos en notarse en PSI y MemAvailable; con
+    // presión crítica el OOM killer está cerca y no se espera
+    bool coolingDown = m_lastAction.isValid() && m_lastAction.elapsed() < m_policy.cooldownSecs * 1000;
+    if (coolingDown && level != Critical) {
+        return;
+    }
+    
+    bool acted = false;
+    if (level != Normal) {
+        acted = reclaimStep();
+    } else if (availablePercent() >= m_policy.recoveryPercent
+               && m_pressure.someAvg10 < m_policy.someThreshold / 2) {
+        acted = recoverStep();
+    }
+    
+    if (acted) {
+        m_lastAction.start();
+    }
+}
+
+MemoryPressureController::Level MemoryPressureController::classify() const
+{
+    double available = availablePercent();
+    if (available < m_policy.minAvailablePercent / 2.0) {
+        return Critical;
+    }
+    
+    if (available < m_policy.minAvailablePercent
+        || (m_pressure.supported && (m_pressure.someAvg10 >= m_policy.someThreshold
+                                     || m_pressure.fullAvg10 >= m_policy.fullThreshold))) {
+        return Pressure;
+    }
+    return Normal;
+}
+
+double MemoryPressureController::availablePercent() const
+{
+    if (m_memory.totalKB <= 0) {
+        return 100.0;
+    }
+    return 100.0 * m_memory.availableKB / m_memory.totalKB;
+}
+
+bool MemoryPressureController::reclaimStep()
+{
+    // Se agotan todos los pasos en las VMs de prioridad baja antes de tocar
+    // las normales; las de prioridad alta nunca son candidatas
+    for (const QString &priority : {QString("low"), QString("normal")}) {
+        const QList<VirtualMachine*> vms = candidates(priority);
+        
+        if (m_policy.allowBalloon) {
+            for (VirtualMachine *vm : vms) {
+                if (!canShrinkBalloon(vm)) {
+                    continue;
+                }
+                
+                qint64 memoryMB = vm->getMemoryMB();
+                qint64 currentMB = m_managed.value(vm->getName()).balloonMB;
+                if (!currentMB) {
+                    currentMB = memoryMB;
+                }
+                qint64 stepMB = qMax<qint64>(1, memoryMB * m_policy.balloonStepPercent / 100);
+                qint64 targetMB = qMax(memoryMB * m_policy.balloonFloorPercent / 100, currentMB - stepMB);
+                
+                return runAction(vm, tr("Encoger el balón de '%1' de %2 a %3 MB (prioridad %4; %5)")
+                                     .arg(vm->getName()).arg(currentMB).arg(targetMB).arg(priority, pressureSummary()),
+                                 [this, targetMB](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+                    QString vmName = vm->getName();
+                    backend->setBalloonTarget(vm, targetMB, [this, vmName, done](const VMBackend::Result &result) {
+                        if (!result.ok) {
+                            m_managed[vmName].noBalloon = true;
+                        }
+                        done(result);
+                    });
+                }, [targetMB](Managed &entry) {
+                    entry.balloonMB = targetMB;
+                });
+            }
+        }
+        
+        // Pausar no libera memoria, pero impide que el invitado pida más
+        if (m_policy.allowPause) {
+            for (VirtualMachine *vm : vms) {
+                if (!vm->isRunning()) {
+                    continue;
+                }
+                return runAction(vm, tr("Pausar '%1' (prioridad %2; %3)").arg(vm->getName(), priority, pressureSummary()),
+                                 [](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+                    backend->pause(vm, done);
+                }, [](Managed &entry) {
+                    entry.paused = true;
+                });
+            }
+        }
+        
+        // Suspender a disco es lo único que devuelve toda la RAM del invitado
+        if (m_policy.allowSave && !vms.isEmpty()) {
+            VirtualMachine *vm = vms.first();
+            return runAction(vm, tr("Suspender '%1' a disco (%2 MB, prioridad %3; %4)")
+                                 .arg(vm->getName()).arg(vm->getMemoryMB()).arg(priority, pressureSummary()),
+                             [](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+                backend->saveState(vm, done);
+            }, [](Managed &entry) {
+                entry.paused = false;
+                entry.saved = true;
+            });
+        }
+    }
+    
+    if (!m_exhausted) {
+        m_exhausted = true;
+        logDecision(tr("No queda memoria que recuperar: las VMs restantes tienen prioridad alta, "
+                       "ya están suspendidas o tienen una operación en curso (%1)").arg(pressureSummary()));
+    }
+    return false;
+}
+
+bool MemoryPressureController::recoverStep()
+{
+    // Se deshacen primero los pasos de las VMs de más prioridad
+    QStringList names = m_managed.keys();
+    std::sort(names.begin(), names.end(), [this](const QString &a, const QString &b) {
+        VirtualMachine *vmA = m_kvmManager->getVirtualMachine(a);
+        VirtualMachine *vmB = m_kvmManager->getVirtualMachine(b);
+        int rankA = vmA ? priorities().indexOf(vmA->getPriority()) : 0;
+        int rankB = vmB ? priorities().indexOf(vmB->getPriority()) : 0;
+        return rankA > rankB;
+    });
+    
+    QList<VirtualMachine*> vms;
+    for (const QString &name : names) {
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(name);
+        if (vm && !m_managed.value(name).busy) {
+            vms.append(vm);
+        }
+    }
+    
+    for (VirtualMachine *vm : vms) {
+        if (m_managed.value(vm->getName()).paused && vm->isPaused()) {
+            return runAction(vm, tr("Reanudar '%1' (%2)").arg(vm->getName(), pressureSummary()),
+                             [](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+                backend->resume(vm, done);
+            }, [](Managed &entry) {
+                entry.paused = false;
+            });
+        }
+    }
+    
+    if (m_policy.restoreSaved) {
+        for (VirtualMachine *vm : vms) {
+            if (!m_managed.value(vm->getName()).saved || vm->getState() != "saved") {
+                continue;
+            }
+            
+            // Sólo si después de restaurarla sigue habiendo margen
+            qint64 remainingKB = m_memory.availableKB - qint64(vm->getMemoryMB()) * 1024;
+            if (m_memory.totalKB <= 0 || 100.0 * remainingKB / m_memory.totalKB < m_policy.recoveryPercent) {
+                continue;
+            }
+            // Como cualquier arranque: pasa por la admisión y las negativas de
+            // plantillas y bases de clones enlazados
+            return runAction(vm, tr("Restaurar '%1' desde disco (%2)").arg(vm->getName(), pressureSummary()),
+                             [this](VMBackend *, VirtualMachine *vm, VMBackend::Callback done) {
+                m_kvmManager->startVMAsync(vm->getName(), done);
+            }, [](Managed &entry) {
+                entry.saved = false;
+            });
+        }
+    }
+    
+    for (VirtualMachine *vm : vms) {
+        qint64 currentMB = m_managed.value(vm->getName()).balloonMB;
+        if (!currentMB || !vm->isRunning()) {
+            continue;
+        }
+        
+        qint64 memoryMB = vm->getMemoryMB();
+        qint64 targetMB = qMin(memoryMB, currentMB + qMax<qint64>(1, memoryMB * m_policy.balloonStepPercent / 100));
+        return runAction(vm, tr("Devolver memoria a '%1': balón de %2 a %3 MB (%4)")
+                             .arg(vm->getName()).arg(currentMB).arg(targetMB).arg(pressureSummary()),
+                         [targetMB](VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done) {
+            backend->setBalloonTarget(vm, targetMB, done);
+        }, [targetMB, memoryMB](Managed &entry) {
+            entry.balloonMB = targetMB < memoryMB ? targetMB : 0;
+        });
+    }
+    
+    return false;
+}
+
+bool MemoryPressureController::canShrinkBalloon(VirtualMachine *vm) const
+{
+    if (!vm->isRunning()) {
+        return false;
+    }
+    
+    // En QEMU directo el balón sólo existe con perfiles paravirtualizados
+    if (vm->getBackend() == "qemu" && !QemuManager::hasMemoryBalloon(vm)) {
+        return false;
+    }
+    
+    Managed entry = m_managed.value(vm->getName());
+    if (entry.noBalloon) {
+        return false;
+    }
+    
+    qint64 currentMB = entry.balloonMB ? entry.balloonMB : vm->getMemoryMB();
+    return currentMB > qint64(vm->getMemoryMB()) * m_policy.balloonFloorPercent / 100;
+}
+
+QList<VirtualMachine*> MemoryPressureController::candidates(const QString &priority) const
+{
+    QList<VirtualMachine*> vms;
+    for (const QString &name : m_kvmManager->getVirtualMachines()) {
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(name);
+        if (vm && vm->getPriority() == priority && (vm->isRunning() || vm->isPaused())
+            && !m_managed.value(name).busy) {
+            vms.append(vm);
+        }
+    }
+    
+    // Dentro de un mismo nivel, primero las que más memoria pueden devolver
+    std::stable_sort(vms.begin(), vms.end(), [](VirtualMachine *a, VirtualMachine *b) {
+        return a->getMemoryMB() > b->getMemoryMB();
+    });
+    return vms;
+}
+
+void MemoryPressureController::reconcile()
+{
+    for (auto it = m_managed.begin(); it != m_managed.end();) {
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(it.key());
+        Managed &entry = it.value();
+        
+        // La VM cambió por otra vía (usuario, scripts): olvidar ese paso
+        if (vm && !entry.busy) {
+            if (entry.paused && !vm->isPaused()) {
+                entry.paused = false;
+            }
+            if (entry.saved && vm->getState() != "saved") {
+                entry.saved = false;
+            }
+            if (vm->isStopped()) {
+                entry.balloonMB = 0;
+                entry.noBalloon = false;
+            }
+        }
+        
+        if (!vm || entry.isIdle()) {
+            it = m_managed.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool MemoryPressureController::runAction(VirtualMachine *vm, const QString &description, const Action &action,
+                                         const std::function<void(Managed &entry)> &applied)
+{
+    VMBackend *backend = m_kvmManager->getBackend(vm->getBackend());
+    if (!backend) {
+        return false;
+    }
+    
+    QString vmName = vm->getName();
+    m_managed[vmName].busy = true;
+    logDecision(description);
+    
+    action(backend, vm, [this, vmName, description, applied](const VMBackend::Result &result) {
+        Managed &entry = m_managed[vmName];
+        entry.busy = false;
+        if (!result.ok) {
+            logDecision(tr("Falló: %1: %2").arg(description, result.error.isEmpty() ? tr("error del backend") : result.error));
+            return;
+        }
+        applied(entry);
+    });
+    return true;
+}
+
+QString MemoryPressureController::pressureSummary() const
+{
+    QString memory = tr("disponible %1% de %2 MB").arg(availablePercent(), 0, 'f', 1).arg(m_memory.totalKB / 1024);
+    if (!m_pressure.supported) {
+        return tr("PSI no disponible, %1").arg(memory);
+    }
+    return tr("some %1%, full %2%, %3").arg(m_pressure.someAvg10, 0, 'f', 1).arg(m_pressure.fullAvg10, 0, 'f', 1).arg(memory);
+}
+
+void MemoryPressureController::logDecision(const QString &message)
+{
+    QString line = QDateTime::currentDateTime().toString(Qt::ISODate) + " " + message;
+    qInfo().noquote() << "MemoryPressureController:" << message;
+    
+    m_decisions.append(line);
+    while (m_decisions.size() > MaxDecisions) {
+        m_decisions.removeFirst();
+    }
+    
+    QFile log(logPath());
+    if (log.open(QIODevice::Append | QIODevice::Text)) {
+        log.write(line.toUtf8() + '\n');
+    }
+    
+    emit decisionMade(message);
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#ifndef MEMORYPRESSURECONTROLLER_H
+#define MEMORYPRESSURECONTROLLER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QJsonObject>
+#include <QElapsedTimer>
+#include <functional>
+
+#include "HostInfo.h"
+#include "VMBackend.h"
+
+class QTimer;
+class QLockFile;
+class KVMManager;
+class VirtualMachine;
+
+/**
+ * @brief Controlador de presión de memoria del anfitrión
+ * Cada segundo lee /proc/pressure/memory y /proc/meminfo y, mientras haya
+ * presión, recupera memoria de las VMs en marcha por orden de prioridad:
+ * primero encoge su balón, después las pausa y por último las suspende a
+ * disco. Las VMs de prioridad alta nunca se tocan. Cuando la presión
+ * desaparece deshace los pasos en orden inverso. Cada decisión queda en
+ * logPath(); sólo actúa una instancia (interfaz o kvmctl serve) a la vez.
+ */
+class MemoryPressureController : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Política configurable (grupo "memoryPressure" de QSettings)
+    struct Policy {
+        bool enabled = true;
+        double someThreshold = 20.0;    // % de tiempo con alguna tarea esperando memoria (avg10)
+        double fullThreshold = 5.0;     // % de tiempo con todas las tareas esperando (avg10)
+        int minAvailablePercent = 10;   // MemAvailable mínimo; por debajo de la mitad es crítico
+        int recoveryPercent = 25;       // MemAvailable a partir del cual se deshacen pasos
+        int balloonStepPercent = 20;    // RAM de la VM recuperada en cada paso del balón
+        int balloonFloorPercent = 40;   // el balón nunca deja menos que esto al invitado
+        int cooldownSecs = 10;          // espera entre acciones (la ventana de avg10)
+        bool allowBalloon = true;
+        bool allowPause = true;
+        bool allowSave = true;
+        bool restoreSaved = false;      // restaurar solas las VMs que suspendió el controlador
+    };
+    
+    enum Level {
+        Normal,
+        Pressure,
+        Critical
+    };
+    
+    explicit MemoryPressureController(KVMManager *kvmManager, QObject *parent = nullptr);
+    ~MemoryPressureController();
+    
+    void start();
+    void stop();
+    // Tiene el bloqueo y es la instancia que actúa
+    bool isActive() const;
+    
+    Policy policy() const { return m_policy; }
+    void reloadPolicy();
+    static Policy loadPolicy();
+    static void savePolicy(const Policy &policy);
+    
+    Level level() const { return m_level; }
+    QJsonObject status() const;
+    QStringList recentDecisions() const { return m_decisions; }
+    
+    // Valores aceptados por VirtualMachine::setPriority()
+    static QStringList priorities();
+    static QString logPath();
+    static QString levelName(Level level);
+
+signals:
+    void levelChanged(int level);
+    void decisionMade(const QString &message);
+
+private slots:
+    void evaluate();
+
+private:
+    using Action = std::function<void(VMBackend *backend, VirtualMachine *vm, VMBackend::Callback done)>;
+    
+    // Pasos que el controlador ha aplicado a cada VM
+    struct Managed {
+        qint64 balloonMB = 0;       // objetivo fijado (0 = balón sin tocar)
+        bool paused = false;
+        bool saved = false;
+        bool busy = false;          // operación en curso
+        bool noBalloon = false;     // el backend rechazó el balón
+        
+        bool isIdle() const { return !balloonMB && !paused && !saved && !busy && !noBalloon; }
+    };
+    
+    Level classify() const;
+    double availablePercent() const;
+    bool reclaimStep();
+    bool recoverStep();
+    bool canShrinkBalloon(VirtualMachine *vm) const;
+    QList<VirtualMachine*> candidates(const QString &priority) const;
+    void reconcile();
+    bool runAction(VirtualMachine *vm, const QString &description, const Action &action,
+                   const std::function<void(Managed &entry)> &applied);
+    QString pressureSummary() const;
+    void logDecision(const QString &message);
+    
+    KVMManager *m_kvmManager;
+    QTimer *m_timer;
+    QLockFile *m_lock;
+    Policy m_policy;
+    HostInfo::HostMemory m_memory;
+    HostInfo::Pressure m_pressure;
+    Level m_level;
+    QElapsedTimer m_lastAction;
+    bool m_exhausted;
+    QHash<QString, Managed> m_managed;
+    QStringList m_decisions;
+    
+    static const int MaxDecisions = 200;
+};
+
+#endif // MEMORYPRESSURECONTROLLER_H
\ No newline at end of file
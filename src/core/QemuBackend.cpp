@@ -0,0 +1,1377 @@
+#include "QemuBackend.h"
+#include "QemuManager.h"
+#include "QmpClient.h"
+#include "VirtualMachine.h"
+#include "HostInfo.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QProcess>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QDir>
+#include <QRegularExpression>
+#include <QTimer>
+#include <QDebug>
+
+#include <unistd.h>
+
+QemuBackend::QemuBackend(QemuManager *qemuManager, QObject *parent)
+    : VMBackend(parent)
+    , m_qemuManager(qemuManager)
+{
+    connect(m_qemuManager, &QemuManager::processStarted, this, [this](const QString &vmName) {
+        emit vmStateChanged(vmName, "running");
+    });
+    connect(m_qemuManager, &QemuManager::vmStateChanged, this, &QemuBackend::vmStateChanged);
+    connect(m_qemuManager, &QemuManager::processFinished, this, [this](const QString &vmName, int exitCode) {
+        // Tras una suspensión a disco QEMU sale con el estado ya escrito
+        Callback saved = m_pendingSaves.take(vmName);
+        emit vmStateChanged(vmName, saved ? "saved" : "shut off");
+        m_balloonTargets.remove(vmName);
+        if (saved) {
+            saved(success());
+        }
+        if (exitCode != 0) {
+            emit errorOccurred(tr("La VM '%1' terminó con código de error %2").arg(vmName).arg(exitCode));
+        }
+        
+        // Las peticiones de parada terminan cuando el proceso ha salido
+        const QList<Callback> callbacks = m_pendingStops.take(vmName);
+        for (const Callback &callback : callbacks) {
+            callback(success());
+        }
+    });
+}
+
+bool QemuBackend::isAvailable()
+{
+    return m_qemuManager->isQemuAvailable();
+}
+
+void QemuBackend::start(VirtualMachine *vm, Callback callback)
+{
+    if (m_snapshotVMs.contains(vm->getName())) {
+        callback(failure(tr("La VM '%1' tiene una operación de instantánea en curso").arg(vm->getName())));
+        return;
+    }
+    
+    // El lanzamiento desacoplado es inmediato; el error ya lo emite QemuManager
+    if (m_qemuManager->startVM(vm)) {
+        callback(success());
+    } else {
+        callback(failure());
+    }
+}
+
+void QemuBackend::stop(VirtualMachine *vm, Callback callback)
+{
+    QString vmName = vm->getName();
+    if (!m_qemuManager->isVMRunning(vmName)) {
+        // Detener una VM suspendida descarta su estado guardado
+        if (QemuManager::hasSavedState(vmName) && QFile::remove(QemuManager::savedStatePath(vmName))) {
+            QemuManager::removeSavedState(vmName);
+            emit vmStateChanged(vmName, "shut off");
+            callback(success());
+            return;
+        }
+        callback(failure(tr("La máquina virtual '%1' no está ejecutándose").arg(vmName)));
+        return;
+    }
+    
+    m_pendingStops[vmName].append(callback);
+    m_qemuManager->requestStop(vmName);
+}
+
+void QemuBackend::pause(VirtualMachine *vm, Callback callback)
+{
+    executeQmp(vm, "stop", QJsonObject(), callback);
+}
+
+void QemuBackend::resume(VirtualMachine *vm, Callback callback)
+{
+    executeQmp(vm, "cont", QJsonObject(), callback);
+}
+
+void QemuBackend::reset(VirtualMachine *vm, Callback callback)
+{
+    executeQmp(vm, "system_reset", QJsonObject(), callback);
+}
+
+void QemuBackend::queryState(VirtualMachine *vm, Callback callback)
+{
+    if (!m_qemuManager->isVMRunning(vm->getName())) {
+        callback(success(QString(QemuManager::hasSavedState(vm->getName()) ? "saved" : "shut off")));
+        return;
+    }
+    
+    executeQmp(vm, "query-status", QJsonObject(), [callback](const Result &result) {
+        if (!result.ok) {
+            callback(result);
+            return;
+        }
+        QString status = result.value.toObject().value("status").toString();
+        callback(success(QemuManager::stateFromQmpStatus(status)));
+    });
+}
+
+void QemuBackend::queryStats(VirtualMachine *vm, Callback callback)
+{
+    QString vmName = vm->getName();
+    if (!m_qemuManager->isVMRunning(vmName)) {
+        callback(failure(tr("La máquina virtual '%1' no está ejecutándose").arg(vmName)));
+        return;
+    }
+    
+    QJsonObject stats = readProcessStats(m_qemuManager->getVMPid(vmName));
+    stats["state"] = vm->getState();
+    
+    // Lo que hace falta de la configuración se lee ya: la VM puede
+    // desaparecer (borrada, recargada) antes de que QEMU conteste
+    bool balloon = QemuManager::hasMemoryBalloon(vm);
+    qint64 target = m_balloonTargets.value(vmName, vm->getMemoryMB());
+    
+    // Contadores de E/S por disco desde QEMU
+    executeQmp(vmName, "query-blockstats", QJsonObject(),
+               [this, vmName, balloon, target, callback, stats](const Result &result) mutable {
+        if (result.ok) {
+            QJsonArray disks;
+            for (const QJsonValue &entry : result.value.toArray()) {
+                QJsonObject device = entry.toObject();
+                QJsonObject counters = device.value("stats").toObject();
+                QJsonObject disk;
+                disk["device"] = device.value("qdev").toString(device.value("device").toString());
+                disk["readBytes"] = counters.value("rd_bytes");
+                disk["writeBytes"] = counters.value("wr_bytes");
+                disk["readOps"] = counters.value("rd_operations");
+                disk["writeOps"] = counters.value("wr_operations");
+                disks.append(disk);
+            }
+            stats["disks"] = disks;
+        }
+        queryBalloonStats(vmName, balloon, target, stats, callback);
+    });
+}
+
+void QemuBackend::setBalloonTarget(VirtualMachine *vm, qint64 targetMB, Callback callback)
+{
+    if (!QemuManager::hasMemoryBalloon(vm)) {
+        callback(failure(tr("La VM '%1' no tiene balón de memoria (requiere un perfil virtio)").arg(vm->getName())));
+        return;
+    }
+    
+    QJsonObject arguments;
+    arguments["value"] = targetMB * 1024 * 1024;
+    QString vmName = vm->getName();
+    executeQmp(vm, "balloon", arguments, [this, vmName, targetMB, callback](const Result &result) {
+        if (result.ok) {
+            m_balloonTargets[vmName] = targetMB;
+        }
+        callback(result.ok ? success(targetMB) : result);
+    });
+}
+
+void QemuBackend::saveState(VirtualMachine *vm, Callback callback)
+{
+    QString vmName = vm->getName();
+    if (!m_qemuManager->isVMRunning(vmName)) {
+        callback(failure(tr("La máquina virtual '%1' no está ejecutándose").arg(vmName)));
+        return;
+    }
+    if (m_savingVMs.contains(vmName) || m_pendingSaves.contains(vmName)) {
+        callback(failure(tr("Ya se está guardando el estado de la VM '%1'").arg(vmName)));
+        return;
+    }
+    if (m_snapshotVMs.contains(vmName)) {
+        callback(failure(tr("La VM '%1' ya tiene una operación en curso").arg(vmName)));
+        return;
+    }
+    if (m_qemuManager->isEphemeralRun(vmName)) {
+        // Al restaurar faltarían las capas temporales a las que apunta el estado
+        callback(failure(tr("La VM '%1' se ejecuta en modo efímero: su estado no se puede guardar").arg(vmName)));
+        return;
+    }
+    
+    m_savingVMs.insert(vmName, SaveJob());
+    chooseSaveJob(vmName, [this, vmName, callback](SaveJob job) {
+        job.path = QemuManager::savedStatePath(vmName);
+        if (job.format != "mapped-ram") {
+            beginSave(vmName, job, callback);
+            return;
+        }
+        
+        // Con el invitado parado cada página se escribe una sola vez
+        executeQmp(vmName, "query-status", QJsonObject(), [this, vmName, job, callback](const Result &result) mutable {
+            job.resume = result.value.toObject().value("running").toBool();
+            executeQmp(vmName, "stop", QJsonObject(), nullptr);
+            beginSave(vmName, job, callback);
+        });
+    });
+}
+
+void QemuBackend::chooseSaveJob(const QString &vmName, const std::function<void(SaveJob)> &next)
+{
+    // mapped-ram (QEMU 9.0+) escribe la RAM con varios canales multifd a la
+    // vez, cada página en su posición del archivo; si no, un flujo por cat o
+    // comprimido con zstd, según lo que haya resultado más rápido aquí
+    executeQmp(vmName, "query-migrate-capabilities", QJsonObject(), [next](const Result &result) {
+        bool mappedRam = false;
+        for (const QJsonValue &capability : result.value.toArray()) {
+            if (capability.toObject().value("capability").toString() == "mapped-ram") {
+                mappedRam = true;
+            }
+        }
+        
+        QemuManager::SaveStatePolicy policy = QemuManager::loadSaveStatePolicy();
+        SaveJob job;
+        job.format = QemuManager::chooseSaveFormat(policy, mappedRam, QemuManager::isZstdAvailable());
+        job.channels = QemuManager::saveStateChannels(policy);
+        next(job);
+    });
+}
+
+void QemuBackend::beginSave(const QString &vmName, const SaveJob &job, Callback callback)
+{
+    // El destino es un fichero local: sin el límite de ancho de banda de una
+    // migración por red. Se escribe aparte y se renombra al terminar para no
+    // restaurar nunca un estado a medias
+    m_savingVMs[vmName] = job;
+    QJsonObject parameters;
+    parameters["max-bandwidth"] = qint64(8) * 1024 * 1024 * 1024;
+    if (job.format == "mapped-ram") {
+        QJsonObject capabilities;
+        capabilities["capabilities"] = QemuManager::mappedRamCapabilities(true);
+        executeQmp(vmName, "migrate-set-capabilities", capabilities, nullptr);
+        parameters["multifd-channels"] = job.channels;
+    }
+    executeQmp(vmName, "migrate-set-parameters", parameters, nullptr);
+    
+    QString partialPath = job.path + ".part";
+    QJsonObject arguments;
+    arguments["uri"] = QemuManager::stateSaveUri(partialPath, job.format, job.channels);
+    qDebug() << "QemuBackend: Guardando el estado de" << vmName << "en" << partialPath
+             << "formato" << job.format << "canales" << job.channels;
+    executeQmp(vmName, "migrate", arguments, [this, vmName, job, callback](const Result &result) {
+        if (!result.ok) {
+            m_savingVMs.remove(vmName);
+            resumeAfterSave(vmName, job, false);
+            callback(result);
+            return;
+        }
+        pollSave(vmName, callback);
+    });
+}
+
+void QemuBackend::pollSave(const QString &vmName, Callback callback)
+{
+    executeQmp(vmName, "query-migrate", QJsonObject(), [this, vmName, callback](const Result &result) {
+        QString partialPath = m_savingVMs.value(vmName).path + ".part";
+        QJsonObject info = result.value.toObject();
+        QString status = info.value("status").toString();
+        
+        if (result.ok && status != "completed" && status != "failed" && status != "cancelled") {
+            QTimer::singleShot(200, this, [this, vmName, callback]() {
+                pollSave(vmName, callback);
+            });
+            return;
+        }
+        
+        SaveJob job = m_savingVMs.take(vmName);
+        if (status != "completed") {
+            QFile::remove(partialPath);
+            resumeAfterSave(vmName, job, false);
+            QString error = result.ok ? info.value("error-desc").toString(status) : result.error;
+            callback(failure(tr("Error guardando el estado de la VM '%1': %2").arg(vmName, error)));
+            return;
+        }
+        
+        if (!job.keep) {
+            QemuManager::removeSavedState(vmName);
+        }
+        if (!QFile::rename(partialPath, job.path)) {
+            QFile::remove(partialPath);
+            resumeAfterSave(vmName, job, true);
+            if (job.format != "mapped-ram" && !job.keep) {
+                executeQmp(vmName, "cont", QJsonObject(), nullptr);
+            }
+            callback(failure(tr("No se pudo escribir el estado de la VM '%1' en %2").arg(vmName, job.path)));
+            return;
+        }
+        
+        // Rendimiento en RAM del invitado por segundo, comparable entre formatos
+        qint64 ramBytes = info.value("ram").toObject().value("total").toInteger();
+        qint64 msecs = qMax<qint64>(1, info.value("total-time").toInteger());
+        QJsonObject stats;
+        stats["path"] = job.path;
+        stats["format"] = job.format;
+        stats["channels"] = job.channels;
+        stats["resume"] = job.resume;
+        stats["ramBytes"] = ramBytes;
+        stats["fileBytes"] = QFileInfo(job.path).size();
+        stats["msecs"] = msecs;
+        stats["mbps"] = ramBytes / (1024.0 * 1024.0) / (msecs / 1000.0);
+        stats["finished"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+        QemuManager::recordSaveThroughput(job.format, stats.value("mbps").toDouble());
+        qDebug() << "QemuBackend: Estado guardado:" << vmName << job.format << ramBytes / (1024 * 1024) << "MB en"
+                 << msecs << "ms," << stats.value("mbps").toDouble() << "MB/s";
+        
+        // Punto de control: el invitado sigue donde estaba
+        if (job.keep) {
+            resumeAfterSave(vmName, job, true);
+            callback(success(stats));
+            return;
+        }
+        QemuManager::writeSavedStateInfo(vmName, stats);
+        QemuManager::recordSaveStateStats(vmName, "save", stats);
+        
+        // El invitado queda detenido con el estado completo en disco: ya puede salir
+        m_pendingSaves.insert(vmName, [callback, stats](const Result &result) {
+            callback(result.ok ? success(stats) : result);
+        });
+        m_qemuManager->requestStop(vmName);
+    });
+}
+
+void QemuBackend::resumeAfterSave(const QString &vmName, const SaveJob &job, bool migrated)
+{
+    // Tras un fallo o un punto de control. Con exec: QEMU reanuda por sí
+    // mismo un invitado que estaba en marcha si la migración falla; mapped-ram
+    // deja además activas unas capacidades que impiden savevm. Un invitado
+    // que se paró aquí (resume) se reanuda siempre
+    if (job.format == "mapped-ram") {
+        QJsonObject capabilities;
+        capabilities["capabilities"] = QemuManager::mappedRamCapabilities(false);
+        executeQmp(vmName, "migrate-set-capabilities", capabilities, nullptr);
+    }
+    if (job.resume) {
+        executeQmp(vmName, "cont", QJsonObject(), nullptr);
+    } else if (migrated && job.keep) {
+        // Ya estaba en pausa: tras la migración QEMU queda en postmigrate con
+        // los discos inactivos y ninguna capa, instantánea o commit posterior
+        // funcionaría. cont los reactiva y stop lo devuelve a la pausa
+        executeQmp(vmName, "cont", QJsonObject(), nullptr);
+        executeQmp(vmName, "stop", QJsonObject(), nullptr);
+    }
+}
+
+void QemuBackend::queryBalloonStats(const QString &vmName, bool balloonPresent, qint64 target,
+                                    const QJsonObject &stats, Callback callback)
+{
+    if (!balloonPresent) {
+        callback(success(stats));
+        return;
+    }
+    
+    // Tamaño actual del balón y, después, las estadísticas que publica el invitado
+    executeQmp(vmName, "query-balloon", QJsonObject(), [this, vmName, callback, stats, target](const Result &result) mutable {
+        if (!result.ok) {
+            callback(success(stats));
+            return;
+        }
+        
+        QJsonObject balloon;
+        balloon["actualMB"] = result.value.toObject().value("actual").toDouble() / (1024 * 1024);
+        balloon["targetMB"] = target;
+        
+        QJsonObject arguments;
+        arguments["path"] = QemuManager::balloonPath();
+        arguments["property"] = "guest-stats";
+        executeQmp(vmName, "qom-get", arguments, [callback, stats, balloon](const Result &result) mutable {
+            // -1 indica que el invitado (o su driver) no publica ese valor
+            const QJsonObject guest = result.value.toObject().value("stats").toObject();
+            const QList<QPair<QString, QString>> sizes = {
+                {"stat-free-memory", "freeMB"}, {"stat-disk-caches", "cachedMB"},
+                {"stat-available-memory", "availableMB"}, {"stat-total-memory", "totalMB"}
+            };
+            for (const auto &entry : sizes) {
+                double bytes = guest.value(entry.first).toDouble(-1);
+                if (bytes >= 0) {
+                    balloon[entry.second] = qint64(bytes / (1024 * 1024));
+                }
+            }
+            const QList<QPair<QString, QString>> counters = {
+                {"stat-major-faults", "majorFaults"}, {"stat-minor-faults", "minorFaults"}
+            };
+            for (const auto &entry : counters) {
+                double count = guest.value(entry.first).toDouble(-1);
+                if (count >= 0) {
+                    balloon[entry.second] = qint64(count);
+                }
+            }
+            if (result.ok) {
+                balloon["lastUpdate"] = result.value.toObject().value("last-update");
+            }
+            
+            stats["balloon"] = balloon;
+            callback(success(stats));
+        });
+    });
+}
+
+void QemuBackend::listSnapshots(VirtualMachine *vm, Callback callback)
+{
+    // Todas las instantáneas se toman sobre todos los discos a la vez,
+    // por lo que basta con leer la tabla del primero
+    QStringList disks = vm->getHardDisks();
+    QJsonArray snapshots;
+    if (!disks.isEmpty()) {
+        const QList<DiskImageProbe::Qcow2Snapshot> table = DiskImageProbe::qcow2Snapshots(disks.first());
+        for (const DiskImageProbe::Qcow2Snapshot &entry : table) {
+            QJsonObject snapshot;
+            snapshot["name"] = entry.name;
+            snapshot["id"] = entry.id;
+            snapshot["created"] = entry.created.toString(Qt::ISODate);
+            snapshot["vmClockNsec"] = entry.vmClockNsec;
+            snapshot["vmStateSize"] = entry.vmStateSize;
+            snapshot["diskSize"] = entry.diskSize;
+            snapshots.append(snapshot);
+        }
+    }
+    callback(success(snapshots));
+}
+
+void QemuBackend::createSnapshot(VirtualMachine *vm, const QString &tag, Callback callback)
+{
+    if (!ensureSnapshotCapable(vm, callback)) {
+        return;
+    }
+    // qemu-img admite nombres repetidos, pero luego no se podrían distinguir
+    if (findSnapshot(vm, tag)) {
+        callback(failure(tr("La VM '%1' ya tiene una instantánea '%2'").arg(vm->getName(), tag)));
+        return;
+    }
+    runSnapshot(vm, "snapshot-save", tag, callback);
+}
+
+void QemuBackend::deleteSnapshot(VirtualMachine *vm, const QString &tag, Callback callback)
+{
+    if (!ensureSnapshotCapable(vm, callback)) {
+        return;
+    }
+    if (!findSnapshot(vm, tag)) {
+        callback(failure(tr("La instantánea '%1' no existe en la VM '%2'").arg(tag, vm->getName())));
+        return;
+    }
+    runSnapshot(vm, "snapshot-delete", tag, callback);
+}
+
+void QemuBackend::revertSnapshot(VirtualMachine *vm, const QString &tag, Callback callback)
+{
+    if (!ensureSnapshotCapable(vm, callback)) {
+        return;
+    }
+    DiskImageProbe::Qcow2Snapshot snapshot;
+    if (!findSnapshot(vm, tag, &snapshot)) {
+        callback(failure(tr("La instantánea '%1' no existe en la VM '%2'").arg(tag, vm->getName())));
+        return;
+    }
+    // Sin estado de memoria el invitado en marcha vería cambiar su disco por debajo
+    if (m_qemuManager->isVMRunning(vm->getName()) && snapshot.vmStateSize == 0) {
+        callback(failure(tr("La instantánea '%1' sólo contiene los discos: apague la VM '%2' para restaurarla")
+                         .arg(tag, vm->getName())));
+        return;
+    }
+    runSnapshot(vm, "snapshot-load", tag, callback);
+}
+
+void QemuBackend::runSnapshot(VirtualMachine *vm, const QString &job, const QString &tag, Callback callback)
+{
+    QString vmName = vm->getName();
+    Callback done = trackOperation(vmName, callback);
+    
+    if (m_qemuManager->isVMRunning(vmName)) {
+        runSnapshotJob(vm, job, tag, done);
+        return;
+    }
+    
+    if (!vm->isStopped()) {
+        done(failure(tr("La VM '%1' debe estar en marcha o apagada (no suspendida) para usar instantáneas").arg(vmName)));
+        return;
+    }
+    
+    const QHash<QString, QString> flags = {
+        {"snapshot-save", "-c"}, {"snapshot-delete", "-d"}, {"snapshot-load", "-a"}
+    };
+    QList<QStringList> commands;
+    for (const QString &disk : vm->getHardDisks()) {
+        commands.append(QStringList() << "snapshot" << flags.value(job) << tag << disk);
+    }
+    if (job != "snapshot-save") {
+        runImgCommands(vmName, job, commands, 0, done);
+        return;
+    }
+    
+    // Si falla un disco, los anteriores ya tienen la instantánea: se borra de
+    // ellos para que la etiqueta no quede sólo en parte de los discos
+    runImgCommands(vmName, job, commands, 0, [this, vmName, tag, commands, done](const Result &result) {
+        int failed = result.ok ? 0 : result.value.toInt();
+        if (failed <= 0) {
+            done(result);
+            return;
+        }
+        QList<QStringList> undo;
+        for (int i = 0; i < failed; ++i) {
+            undo.append(QStringList() << "snapshot" << "-d" << tag << commands[i].last());
+        }
+        runImgCommands(vmName, "snapshot-delete", undo, 0, [vmName, tag, result, done](const Result &undone) {
+            if (!undone.ok) {
+                qWarning() << "QemuBackend: no se pudo quitar la instantánea" << tag << "de" << vmName << "-" << undone.error;
+            }
+            done(result);
+        });
+    });
+}
+
+QString QemuBackend::checkExternalSnapshot(VirtualMachine *vm, const QString &tag, const QString &directory)
+{
+    return externalSnapshotError(vm, tag, directory);
+}
+
+QString QemuBackend::externalSnapshotError(VirtualMachine *vm, const QString &tag, const QString &directory,
+                                           QStringList *overlayPaths) const
+{
+    QString vmName = vm->getName();
+    QString error = idleError(vm);
+    if (!error.isEmpty()) {
+        return error;
+    }
+    
+    QStringList disks;
+    for (const QString &disk : vm->getHardDisks()) {
+        disks.append(QFileInfo(disk).absoluteFilePath());
+    }
+    if (disks.isEmpty() || tag.trimmed().isEmpty()) {
+        return tr("La VM '%1' no tiene discos o falta el nombre de la instantánea").arg(vmName);
+    }
+    if (!m_qemuManager->isVMRunning(vmName) && !vm->isStopped()) {
+        return tr("La VM '%1' debe estar en marcha o apagada (no suspendida) para usar instantáneas").arg(vmName);
+    }
+    
+    QStringList overlays;
+    for (const QString &disk : disks) {
+        // Encima de la capa, sus instantáneas internas dejarían de verse
+        if (!DiskImageProbe::qcow2Snapshots(disk).isEmpty()) {
+            return tr("El disco %1 tiene instantáneas internas; elimínelas antes de añadir una capa externa").arg(disk);
+        }
+        QString overlay = QemuManager::overlayPath(disk, tag, directory);
+        if (QFileInfo::exists(overlay) || overlays.contains(overlay) || !QDir().mkpath(QFileInfo(overlay).absolutePath())) {
+            return tr("No se puede crear la capa %1: ya existe o la carpeta no es accesible").arg(overlay);
+        }
+        overlays.append(overlay);
+    }
+    if (overlayPaths) {
+        *overlayPaths = overlays;
+    }
+    return QString();
+}
+
+void QemuBackend::createExternalSnapshot(VirtualMachine *vm, const QString &tag, const QString &directory,
+                                         Callback callback)
+{
+    QStringList overlays;
+    QString error = externalSnapshotError(vm, tag, directory, &overlays);
+    if (!error.isEmpty()) {
+        callback(failure(error));
+        return;
+    }
+    
+    QString vmName = vm->getName();
+    QStringList disks;
+    for (const QString &disk : vm->getHardDisks()) {
+        disks.append(QFileInfo(disk).absoluteFilePath());
+    }
+    
+    // Ninguna capa existía antes: si algo falla se borran las que se llegaron a crear
+    Callback done = trackOperation(vmName, [overlays, callback](const Result &result) {
+        if (!result.ok) {
+            for (const QString &overlay : overlays) {
+                QFile::remove(overlay);
+            }
+            callback(result);
+            return;
+        }
+        callback(success(QJsonArray::fromStringList(overlays)));
+    });
+    
+    if (m_qemuManager->isVMRunning(vmName)) {
+        switchOverlays(vmName, vm->getHardDisks(), overlays, [this, vmName, done](const Result &result) {
+            if (result.ok) {
+                emit jobProgress(vmName, "snapshot-external", 100);
+            }
+            done(result);
+        });
+        return;
+    }
+    
+    QList<QStringList> commands;
+    for (int i = 0; i < disks.size(); ++i) {
+        commands.append(QStringList() << "create" << "-f" << "qcow2" << "-b" << disks[i]
+                                      << "-F" << DiskImageProbe::probe(disks[i]).format << overlays[i]);
+    }
+    runImgCommands(vmName, "snapshot-external", commands, 0, done);
+}
+
+void QemuBackend::switchOverlays(const QString &vmName, const QStringList &disks, const QStringList &overlays,
+                                 Callback callback)
+{
+    // Una transacción: todos los discos cambian de capa en el mismo instante
+    queryDiskNodes(vmName, disks, [this, vmName, overlays, callback](const Result &result) {
+        if (!result.ok) {
+            callback(result);
+            return;
+        }
+        QJsonArray nodes = result.value.toArray();
+        QJsonArray actions;
+        for (int i = 0; i < overlays.size(); ++i) {
+            QJsonObject data;
+            data["node-name"] = nodes[i];
+            data["snapshot-file"] = overlays[i];
+            data["format"] = "qcow2";
+            data["mode"] = "absolute-paths";
+            QJsonObject action;
+            action["type"] = "blockdev-snapshot-sync";
+            action["data"] = data;
+            actions.append(action);
+        }
+        QJsonObject arguments;
+        arguments["actions"] = actions;
+        executeQmp(vmName, "transaction", arguments, callback);
+    });
+}
+
+void QemuBackend::discardExternalSnapshot(VirtualMachine *vm, const QStringList &disks, Callback callback)
+{
+    if (!ensureIdle(vm, callback)) {
+        return;
+    }
+    
+    QString vmName = vm->getName();
+    QStringList overlays = vm->getHardDisks();
+    QStringList bases;
+    for (const QString &disk : disks) {
+        bases.append(QFileInfo(disk).absoluteFilePath());
+    }
+    // Sólo se deshace una capa puesta justo encima de cada disco anterior
+    bool matches = overlays.size() == bases.size();
+    for (int i = 0; matches && i < overlays.size(); ++i) {
+        matches = DiskImageProbe::backingChain(overlays[i]).value(1) == bases[i];
+    }
+    if (!matches) {
+        callback(failure(tr("Los discos de la VM '%1' no están justo encima de los indicados; no se puede deshacer la capa").arg(vmName)));
+        return;
+    }
+    
+    Callback done = trackOperation(vmName, [overlays, disks, callback](const Result &result) {
+        if (!result.ok) {
+            callback(result);
+            return;
+        }
+        for (const QString &overlay : overlays) {
+            QFile::remove(overlay);
+        }
+        callback(success(QJsonArray::fromStringList(disks)));
+    });
+    
+    if (!m_qemuManager->isVMRunning(vmName)) {
+        // Apagada, QEMU no tiene nada abierto: basta con volver a los discos de antes
+        if (!vm->isStopped()) {
+            done(failure(tr("La VM '%1' debe estar en marcha o apagada (no suspendida) para deshacer la capa").arg(vmName)));
+            return;
+        }
+        done(success());
+        return;
+    }
+    
+    // En marcha, cada capa se vuelca en su base (apenas hay nada escrito en
+    // ella) y QEMU pasa a usar otra vez la base como disco activo
+    QJsonObject arguments;
+    arguments["flat"] = true;
+    executeQmp(vmName, "query-named-block-nodes", arguments, [this, vmName, overlays, bases, done](const Result &result) {
+        if (!result.ok) {
+            done(result);
+            return;
+        }
+        
+        QHash<QString, QString> nodes;
+        for (const QJsonValue &entry : result.value.toArray()) {
+            QJsonObject node = entry.toObject();
+            QString driver = node.value("drv").toString();
+            if (driver != "file" && driver != "host_device" && driver != "host_cdrom") {
+                nodes.insert(node.value("file").toString(), node.value("node-name").toString());
+            }
+        }
+        QStringList tops;
+        QStringList baseNodes;
+        for (int i = 0; i < overlays.size(); ++i) {
+            if (nodes.value(overlays[i]).isEmpty() || nodes.value(bases[i]).isEmpty()) {
+                done(failure(tr("QEMU no tiene abierta la cadena del disco %1 de la VM '%2'").arg(overlays[i], vmName)));
+                return;
+            }
+            tops.append(nodes.value(overlays[i]));
+            baseNodes.append(nodes.value(bases[i]));
+        }
+        commitOverlays(vmName, tops, baseNodes, 0, done);
+    });
+}
+
+void QemuBackend::commitOverlays(const QString &vmName, const QStringList &tops, const QStringList &bases,
+                                 int index, Callback callback)
+{
+    if (index >= tops.size()) {
+        callback(success());
+        return;
+    }
+    
+    // Commit de la capa activa: pollJob pide el cambio a la base al quedar listo
+    QString jobId = QString("block-commit-%1-%2").arg(QDateTime::currentMSecsSinceEpoch()).arg(index);
+    QJsonObject arguments;
+    arguments["job-id"] = jobId;
+    arguments["device"] = tops[index];
+    arguments["base-node"] = bases[index];
+    arguments["auto-dismiss"] = false;
+    startJob(vmName, "block-commit", jobId, arguments, [this, vmName, tops, bases, index, callback](const Result &result) {
+        if (!result.ok) {
+            callback(result);
+            return;
+        }
+        commitOverlays(vmName, tops, bases, index + 1, callback);
+    });
+}
+
+void QemuBackend::createCheckpoint(VirtualMachine *vm, const QString &name, Callback callback)
+{
+    if (!ensureIdle(vm, callback)) {
+        return;
+    }
+    
+    QString vmName = vm->getName();
+    if (!QemuManager::isValidCheckpointName(name)) {
+        callback(failure(tr("Nombre de punto de control no válido '%1': use letras, números, '.', '_' o '-'").arg(name)));
+        return;
+    }
+    if (QemuManager::listCheckpoints(vmName).contains(name)) {
+        callback(failure(tr("La VM '%1' ya tiene un punto de control '%2'").arg(vmName, name)));
+        return;
+    }
+    bool running = m_qemuManager->isVMRunning(vmName);
+    if (!running && !vm->isStopped()) {
+        callback(failure(tr("La VM '%1' debe estar en marcha o apagada (no suspendida) para crear un punto de control").arg(vmName)));
+        return;
+    }
+    
+    QStringList disks;
+    QStringList overlays;
+    for (const QString &disk : vm->getHardDisks()) {
+        disks.append(QFileInfo(disk).absoluteFilePath());
+        overlays.append(QemuManager::checkpointOverlayPath(vmName, name, overlays.size()));
+    }
+    if (disks.isEmpty() || !QDir().mkpath(QemuManager::checkpointDirectory(vmName, name))) {
+        callback(failure(tr("La VM '%1' no tiene discos o no se pudo crear la carpeta del punto de control").arg(vmName)));
+        return;
+    }
+    
+    // Los discos actuales quedan congelados; la VM sigue en las capas nuevas
+    QJsonObject info;
+    info["name"] = name;
+    info["created"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    info["disks"] = QJsonArray::fromStringList(disks);
+    info["memory"] = false;
+    Callback done = trackOperation(vmName, [vmName, name, overlays, callback](const Result &result) {
+        Result reply = result;
+        QJsonObject value = result.value.toObject();
+        if (result.ok && !QemuManager::writeCheckpointInfo(vmName, name, value)) {
+            reply = failure(tr("No se pudo escribir la información del punto de control '%1'").arg(name));
+            reply.value = value;
+        }
+        // Una vez cambiadas las capas, los discos en uso son las capas aunque falle la RAM
+        if (!value.contains("overlays")) {
+            for (const QString &overlay : overlays) {
+                QFile::remove(overlay);
+            }
+            QDir().rmdir(QemuManager::checkpointDirectory(vmName, name));
+        }
+        if (reply.ok) {
+            qDebug() << "QemuBackend: Punto de control creado:" << vmName << name
+                     << (value.value("memory").toBool() ? "con memoria" : "sólo discos");
+        }
+        callback(reply);
+    });
+    
+    if (!running) {
+        QList<QStringList> commands;
+        for (int i = 0; i < disks.size(); ++i) {
+            commands.append(QStringList() << "create" << "-f" << "qcow2" << "-b" << disks[i]
+                                          << "-F" << DiskImageProbe::probe(disks[i]).format << overlays[i]);
+        }
+        runImgCommands(vmName, "checkpoint", commands, 0, [info, overlays, done](const Result &result) mutable {
+            if (result.ok) {
+                info["overlays"] = QJsonArray::fromStringList(overlays);
+            }
+            done(result.ok ? success(info) : result);
+        });
+        return;
+    }
+    
+    // Con el invitado parado, los discos y la RAM quedan del mismo instante
+    QStringList configured = vm->getHardDisks();
+    executeQmp(vmName, "query-status", QJsonObject(), [this, vmName, name, configured, overlays, info, done](const Result &result) {
+        if (!result.ok) {
+            done(result);
+            return;
+        }
+        bool wasRunning = result.value.toObject().value("running").toBool();
+        if (wasRunning) {
+            executeQmp(vmName, "stop", QJsonObject(), nullptr);
+        }
+        
+        switchOverlays(vmName, configured, overlays, [this, vmName, name, overlays, info, wasRunning, done](const Result &result) mutable {
+            if (!result.ok) {
+                if (wasRunning) {
+                    executeQmp(vmName, "cont", QJsonObject(), nullptr);
+                }
+                done(result);
+                return;
+            }
+            info["overlays"] = QJsonArray::fromStringList(overlays);
+            emit jobProgress(vmName, "checkpoint", 50);
+            
+            // Las capas van antes que la RAM: al terminar la migración QEMU
+            // suelta los discos hasta que el invitado vuelve a correr
+            chooseSaveJob(vmName, [this, vmName, name, info, wasRunning, done](SaveJob job) mutable {
+                job.path = QemuManager::checkpointStatePath(vmName, name);
+                job.resume = wasRunning;
+                job.keep = true;
+                beginSave(vmName, job, [this, vmName, info, wasRunning, done](const Result &result) mutable {
+                    if (!result.ok) {
+                        Result reply = failure(tr("No se pudo guardar la memoria del punto de control de la VM '%1': %2")
+                                               .arg(vmName, result.error));
+                        reply.value = info;
+                        done(reply);
+                        return;
+                    }
+                    QJsonObject stats = result.value.toObject();
+                    for (const char *key : {"format", "channels", "ramBytes", "fileBytes", "msecs"}) {
+                        info[key] = stats.value(key);
+                    }
+                    info["memory"] = true;
+                    info["running"] = wasRunning;
+                    emit jobProgress(vmName, "checkpoint", 100);
+                    done(success(info));
+                });
+            });
+        });
+    });
+}
+
+void QemuBackend::resetToCheckpoint(VirtualMachine *vm, const QString &name, Callback callback)
+{
+    if (!ensureIdle(vm, callback)) {
+        return;
+    }
+    
+    QString vmName = vm->getName();
+    QJsonObject info = QemuManager::checkpointInfo(vmName, name);
+    QJsonArray frozen = info.value("disks").toArray();
+    if (info.isEmpty()) {
+        callback(failure(tr("La VM '%1' no tiene el punto de control '%2'").arg(vmName, name)));
+        return;
+    }
+    if (frozen.size() != vm->getHardDisks().size()) {
+        callback(failure(tr("Los discos de la VM '%1' han cambiado desde el punto de control '%2'").arg(vmName, name)));
+        return;
+    }
+    for (const QJsonValue &image : frozen) {
+        if (!QFileInfo::exists(image.toString())) {
+            callback(failure(tr("Falta la imagen %1 del punto de control '%2'").arg(image.toString(), name)));
+            return;
+        }
+    }
+    if (info.value("memory").toBool() && !QFileInfo::exists(QemuManager::checkpointStatePath(vmName, name))) {
+        callback(failure(tr("Falta la memoria del punto de control '%1' de la VM '%2'").arg(name, vmName)));
+        return;
+    }
+    
+    QStringList current;
+    for (const QString &disk : vm->getHardDisks()) {
+        current.append(QFileInfo(disk).absoluteFilePath());
+    }
+    Callback done = trackOperation(vmName, callback);
+    
+    // Lo que el invitado hizo desde el punto de control se descarta: QEMU
+    // sale sin apagar el sistema y un estado suspendido se borra sin cargarlo
+    if (m_qemuManager->isVMRunning(vmName)) {
+        m_pendingStops[vmName].append([this, vmName, name, current, done](const Result &) {
+            resetDisks(vmName, name, current, done);
+        });
+        m_qemuManager->requestStop(vmName);
+        return;
+    }
+    if (QemuManager::hasSavedState(vmName)) {
+        QemuManager::removeSavedState(vmName);
+        emit vmStateChanged(vmName, "shut off");
+    }
+    resetDisks(vmName, name, current, done);
+}
+
+void QemuBackend::resetDisks(const QString &vmName, const QString &name, const QStringList &current, Callback callback)
+{
+    QJsonObject info = QemuManager::checkpointInfo(vmName, name);
+    QStringList frozen;
+    QStringList overlays;
+    QList<QStringList> commands;
+    for (const QJsonValue &image : info.value("disks").toArray()) {
+        frozen.append(image.toString());
+        overlays.append(QemuManager::checkpointOverlayPath(vmName, name, overlays.size()));
+        commands.append(QStringList() << "create" << "-f" << "qcow2" << "-b" << frozen.last()
+                                      << "-F" << DiskImageProbe::probe(frozen.last()).format << overlays.last());
+    }
+    
+    runImgCommands(vmName, "checkpoint-reset", commands, 0, [this, vmName, name, info, current, overlays, callback](const Result &result) {
+        if (!result.ok) {
+            for (const QString &overlay : overlays) {
+                QFile::remove(overlay);
+            }
+            callback(result);
+            return;
+        }
+        
+        // Las capas que se abandonan son de un punto de control y nadie más las usa
+        QString root = QDir(QemuManager::checkpointsRoot(vmName)).absolutePath() + "/";
+        QStringList kept = QemuManager::checkpointImages(vmName);
+        for (const QString &disk : current) {
+            if (disk.startsWith(root) && !kept.contains(disk) && !overlays.contains(disk)) {
+                QFile::remove(disk);
+            }
+        }
+        
+        QJsonObject value;
+        value["overlays"] = QJsonArray::fromStringList(overlays);
+        value["memory"] = info.value("memory").toBool();
+        if (!value.value("memory").toBool()) {
+            callback(success(value));
+            return;
+        }
+        
+        // La RAM pasa a ser el estado guardado: un enlace, sin copiar nada
+        QJsonObject saved;
+        saved["checkpoint"] = name;
+        for (const char *key : {"format", "channels", "ramBytes", "fileBytes"}) {
+            saved[key] = info.value(key);
+        }
+        saved["resume"] = info.value("running").toBool();
+        if (!QemuManager::adoptSavedState(vmName, QemuManager::checkpointStatePath(vmName, name), saved)) {
+            Result reply = failure(tr("No se pudo preparar la memoria del punto de control '%1' en %2")
+                                   .arg(name, QemuManager::savedStatePath(vmName)));
+            value["memory"] = false;
+            reply.value = value;
+            callback(reply);
+            return;
+        }
+        emit vmStateChanged(vmName, "saved");
+        callback(success(value));
+    });
+}
+
+void QemuBackend::deleteCheckpoint(VirtualMachine *vm, const QString &name, const QStringList &keep,
+                                   Callback callback)
+{
+    // Un reinicio o una bifurcación en curso aún leen sus ficheros
+    if (!ensureIdle(vm, callback)) {
+        return;
+    }
+    
+    QString vmName = vm->getName();
+    if (!QemuManager::listCheckpoints(vmName).contains(name)) {
+        callback(failure(tr("La VM '%1' no tiene el punto de control '%2'").arg(vmName, name)));
+        return;
+    }
+    
+    QDir folder(QemuManager::checkpointDirectory(vmName, name));
+    const QFileInfoList files = folder.entryInfoList(QDir::Files);
+    for (const QFileInfo &file : files) {
+        if (!keep.contains(file.absoluteFilePath())) {
+            QFile::remove(file.absoluteFilePath());
+        }
+    }
+    QDir().rmdir(folder.absolutePath());
+    qDebug() << "QemuBackend: Punto de control eliminado:" << vmName << name;
+    callback(success(name));
+}
+
+void QemuBackend::mergeDiskChain(VirtualMachine *vm, const QString &diskPath, const QString &mode,
+                                 Callback callback)
+{
+    if (!ensureIdle(vm, callback)) {
+        return;
+    }
+    
+    QString vmName = vm->getName();
+    if (mode != "commit" && mode != "stream") {
+        callback(failure(tr("Modo de fusión desconocido '%1' (commit o stream)").arg(mode)));
+        return;
+    }
+    if (!vm->getHardDisks().contains(diskPath)) {
+        callback(failure(tr("El disco %1 no pertenece a la VM '%2'").arg(diskPath, vmName)));
+        return;
+    }
+    
+    QStringList chain = DiskImageProbe::backingChain(diskPath);
+    if (chain.size() < 2) {
+        callback(failure(tr("El disco %1 no tiene imagen base: no hay nada que fusionar").arg(diskPath)));
+        return;
+    }
+    // Las instantáneas internas de una capa apuntan a datos que la fusión mueve
+    for (int i = 0; i < chain.size() - 1; ++i) {
+        if (!DiskImageProbe::qcow2Snapshots(chain[i]).isEmpty()) {
+            callback(failure(tr("La capa %1 tiene instantáneas internas; elimínelas antes de fusionar la cadena").arg(chain[i])));
+            return;
+        }
+    }
+    
+    // commit: el disco pasa a ser la base y las capas sobran; stream: la capa
+    // superior queda independiente y las bases se conservan (pueden ser compartidas)
+    bool commit = mode == "commit";
+    QString job = commit ? "block-commit" : "block-stream";
+    QString remaining = commit ? chain.last() : diskPath;
+    QStringList discarded = commit ? chain.mid(0, chain.size() - 1) : QStringList();
+    Callback done = trackOperation(vmName, [remaining, discarded, callback](const Result &result) {
+        if (!result.ok) {
+            callback(result);
+            return;
+        }
+        for (const QString &layer : discarded) {
+            QFile::remove(layer);
+        }
+        callback(success(remaining));
+    });
+    
+    if (m_qemuManager->isVMRunning(vmName)) {
+        queryDiskNodes(vmName, QStringList() << diskPath, [this, vmName, job, done](const Result &result) {
+            if (!result.ok) {
+                done(result);
+                return;
+            }
+            // Sin base ni top: toda la cadena, hasta la imagen de más abajo
+            QString jobId = QString("%1-%2").arg(job).arg(QDateTime::currentMSecsSinceEpoch());
+            QJsonObject arguments;
+            arguments["job-id"] = jobId;
+            arguments["device"] = result.value.toArray().first();
+            arguments["auto-dismiss"] = false;
+            qDebug() << "QemuBackend:" << job << vmName;
+            startJob(vmName, job, jobId, arguments, done);
+        });
+        return;
+    }
+    
+    if (!vm->isStopped()) {
+        done(failure(tr("La VM '%1' debe estar en marcha o apagada (no suspendida) para fusionar discos").arg(vmName)));
+        return;
+    }
+    
+    // -d: las capas se borran después, no hace falta vaciarlas
+    QStringList command = commit ? QStringList() << "commit" << "-p" << "-d" << "-b" << chain.last() << diskPath
+                                 : QStringList() << "rebase" << "-p" << "-b" << "" << diskPath;
+    runImgCommands(vmName, job, QList<QStringList>() << command, 0, done);
+}
+
+void QemuBackend::runSnapshotJob(VirtualMachine *vm, const QString &job, const QString &tag, Callback callback)
+{
+    QString vmName = vm->getName();
+    queryDiskNodes(vmName, vm->getHardDisks(), [this, vmName, job, tag, callback](const Result &result) {
+        if (!result.ok) {
+            callback(result);
+            return;
+        }
+        
+        // El estado de la memoria va en el primer disco, como hace savevm
+        QJsonArray devices = result.value.toArray();
+        QString jobId = QString("%1-%2").arg(job).arg(QDateTime::currentMSecsSinceEpoch());
+        QJsonObject arguments;
+        arguments["job-id"] = jobId;
+        arguments["tag"] = tag;
+        arguments["devices"] = devices;
+        if (job != "snapshot-delete") {
+            arguments["vmstate"] = devices.first();
+        }
+        qDebug() << "QemuBackend:" << job << vmName << tag;
+        startJob(vmName, job, jobId, arguments, callback);
+    });
+}
+
+void QemuBackend::queryDiskNodes(const QString &vmName, const QStringList &disks, Callback callback)
+{
+    // Los trabajos de QMP identifican los discos por el nodo de formato de la capa activa
+    executeQmp(vmName, "query-block", QJsonObject(), [vmName, disks, callback](const Result &result) {
+        if (!result.ok) {
+            callback(result);
+            return;
+        }
+        
+        QHash<QString, QString> nodes;
+        for (const QJsonValue &entry : result.value.toArray()) {
+            QJsonObject inserted = entry.toObject().value("inserted").toObject();
+            nodes.insert(inserted.value("file").toString(), inserted.value("node-name").toString());
+        }
+        QJsonArray devices;
+        for (const QString &disk : disks) {
+            if (nodes.value(disk).isEmpty()) {
+                callback(failure(tr("QEMU no tiene abierto el disco %1 de la VM '%2'").arg(disk, vmName)));
+                return;
+            }
+            devices.append(nodes.value(disk));
+        }
+        callback(success(devices));
+    });
+}
+
+void QemuBackend::startJob(const QString &vmName, const QString &job, const QString &jobId,
+                           const QJsonObject &arguments, Callback callback)
+{
+    executeQmp(vmName, job, arguments, [this, vmName, job, jobId, callback](const Result &result) {
+        if (!result.ok) {
+            callback(result);
+            return;
+        }
+        emit jobProgress(vmName, job, 0);
+        pollJob(vmName, job, jobId, callback);
+    });
+}
+
+void QemuBackend::pollJob(const QString &vmName, const QString &job, const QString &jobId, Callback callback)
+{
+    executeQmp(vmName, "query-jobs", QJsonObject(), [this, vmName, job, jobId, callback](const Result &result) {
+        if (!result.ok) {
+            callback(result);
+            return;
+        }
+        
+        QJsonObject info;
+        for (const QJsonValue &entry : result.value.toArray()) {
+            if (entry.toObject().value("id").toString() == jobId) {
+                info = entry.toObject();
+                break;
+            }
+        }
+        if (info.isEmpty()) {
+            callback(failure(tr("El trabajo '%1' ya no existe en la VM '%2'").arg(jobId, vmName)));
+            return;
+        }
+        
+        QString status = info.value("status").toString();
+        if (status == "ready" && !m_completingJobs.contains(jobId)) {
+            // Un commit de la capa activa espera a que se le pida el cambio a la base
+            m_completingJobs.insert(jobId);
+            QJsonObject arguments;
+            arguments["id"] = jobId;
+            executeQmp(vmName, "job-complete", arguments, nullptr);
+        }
+        if (status != "concluded") {
+            double total = info.value("total-progress").toDouble();
+            if (total > 0) {
+                emit jobProgress(vmName, job, qBound(0, int(info.value("current-progress").toDouble() * 100 / total), 99));
+            }
+            QTimer::singleShot(500, this, [this, vmName, job, jobId, callback]() {
+                pollJob(vmName, job, jobId, callback);
+            });
+            return;
+        }
+        
+        // Los trabajos se lanzan sin auto-dismiss: siguen en la lista hasta descartarlos
+        m_completingJobs.remove(jobId);
+        QJsonObject arguments;
+        arguments["id"] = jobId;
+        executeQmp(vmName, "job-dismiss", arguments, nullptr);
+        
+        QString error = info.value("error").toString();
+        if (!error.isEmpty()) {
+            callback(failure(tr("Error en %1 de la VM '%2': %3").arg(job, vmName, error)));
+            return;
+        }
+        emit jobProgress(vmName, job, 100);
+        callback(success());
+    });
+}
+
+void QemuBackend::runImgCommands(const QString &vmName, const QString &job, const QList<QStringList> &commands,
+                                 int index, Callback callback)
+{
+    // Una orden detrás de otra (normalmente una por disco); con -p, qemu-img
+    // informa del avance de cada una
+    int count = qMax(1, int(commands.size()));
+    emit jobProgress(vmName, job, index * 100 / count);
+    if (index >= commands.size()) {
+        callback(success());
+        return;
+    }
+    
+    QProcess *process = new QProcess(this);
+    connect(process, &QProcess::readyReadStandardOutput, this, [this, process, vmName, job, index, count]() {
+        static const QRegularExpression progressPattern("\\((\\d+(?:\\.\\d+)?)/100%\\)");
+        QRegularExpressionMatchIterator matches = progressPattern.globalMatch(QString::fromLocal8Bit(process->readAllStandardOutput()));
+        double percent = -1;
+        while (matches.hasNext()) {
+            percent = matches.next().captured(1).toDouble();
+        }
+        if (percent >= 0) {
+            emit jobProgress(vmName, job, qMin(99, int((index * 100 + percent) / count)));
+        }
+    });
+    connect(process, &QProcess::finished, this,
+            [this, process, vmName, job, commands, index, callback](int exitCode, QProcess::ExitStatus status) {
+        process->deleteLater();
+        if (status != QProcess::NormalExit || exitCode != 0) {
+            QString error = QString::fromLocal8Bit(process->readAllStandardError()).trimmed();
+            Result result = failure(tr("Error en %1 de %2: %3").arg(job, commands[index].last(), error));
+            result.value = index;
+            callback(result);
+            return;
+        }
+        runImgCommands(vmName, job, commands, index + 1, callback);
+    });
+    connect(process, &QProcess::errorOccurred, this, [process, index, callback](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart) {
+            process->deleteLater();
+            Result result = failure(tr("No se pudo iniciar qemu-img"));
+            result.value = index;
+            callback(result);
+        }
+    });
+    process->start("qemu-img", commands[index]);
+}
+
+void QemuBackend::executeQmp(VirtualMachine *vm, const QString &command, const QJsonObject &arguments,
+                             Callback callback)
+{
+    executeQmp(vm->getName(), command, arguments, callback);
+}
+
+void QemuBackend::executeQmp(const QString &vmName, const QString &command, const QJsonObject &arguments,
+                             Callback callback)
+{
+    QmpClient *qmp = m_qemuManager->getQmpClient(vmName);
+    if (!qmp) {
+        if (callback) {
+            callback(failure(tr("La máquina virtual '%1' no está ejecutándose").arg(vmName)));
+        }
+        return;
+    }
+    
+    if (!callback) {
+        qmp->execute(command, arguments, nullptr);
+        return;
+    }
+    
+    qmp->execute(command, arguments, [callback, command, vmName](const QJsonObject &reply) {
+        if (reply.contains("error")) {
+            callback(failure(tr("Error QMP '%1' en la VM '%2': %3")
+                             .arg(command, vmName, QmpClient::errorString(reply))));
+        } else {
+            callback(success(reply.value("return")));
+        }
+    });
+}
+
+bool QemuBackend::ensureIdle(VirtualMachine *vm, const Callback &callback)
+{
+    QString error = idleError(vm);
+    if (!error.isEmpty()) {
+        callback(failure(error));
+        return false;
+    }
+    return true;
+}
+
+QString QemuBackend::idleError(VirtualMachine *vm) const
+{
+    QString vmName = vm->getName();
+    if (m_snapshotVMs.contains(vmName) || m_savingVMs.contains(vmName) || m_pendingSaves.contains(vmName)) {
+        return tr("La VM '%1' ya tiene una operación en curso").arg(vmName);
+    }
+    // Lo escrito está en capas temporales de QEMU que desaparecen al apagar
+    if (m_qemuManager->isEphemeralRun(vmName)) {
+        return tr("La VM '%1' se ejecuta en modo efímero: sus discos no admiten instantáneas ni puntos de control").arg(vmName);
+    }
+    return QString();
+}
+
+bool QemuBackend::ensureSnapshotCapable(VirtualMachine *vm, const Callback &callback)
+{
+    if (!ensureIdle(vm, callback)) {
+        return false;
+    }
+    
+    QString vmName = vm->getName();
+    QStringList disks = vm->getHardDisks();
+    if (disks.isEmpty()) {
+        callback(failure(tr("La VM '%1' no tiene discos para la instantánea").arg(vmName)));
+        return false;
+    }
+    for (const QString &disk : disks) {
+        if (DiskImageProbe::probe(disk).format != "qcow2") {
+            callback(failure(tr("Las instantáneas requieren discos qcow2: %1").arg(disk)));
+            return false;
+        }
+    }
+    return true;
+}
+
+QemuBackend::Callback QemuBackend::trackOperation(const QString &vmName, Callback callback)
+{
+    // Mientras dura, la VM no acepta otra operación de disco ni arranca
+    m_snapshotVMs.insert(vmName);
+    return [this, vmName, callback](const Result &result) {
+        m_snapshotVMs.remove(vmName);
+        callback(result);
+    };
+}
+
+bool QemuBackend::findSnapshot(VirtualMachine *vm, const QString &tag, DiskImageProbe::Qcow2Snapshot *snapshot) const
+{
+    const QList<DiskImageProbe::Qcow2Snapshot> table = DiskImageProbe::qcow2Snapshots(vm->getHardDisks().value(0));
+    for (const DiskImageProbe::Qcow2Snapshot &entry : table) {
+        if (entry.name == tag) {
+            if (snapshot) {
+                *snapshot = entry;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+QJsonObject QemuBackend::readProcessStats(qint64 pid)
+{
+    QJsonObject stats;
+    stats["pid"] = pid;
+    
+    // Memoria residente del proceso QEMU
+    QFile status(QString("/proc/%1/status").arg(pid));
+    if (status.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> lines = status.readAll().split('\n');
+        for (const QByteArray &line : lines) {
+            if (line.startsWith("VmRSS:")) {
+                stats["rssKB"] = line.mid(6).trimmed().split(' ').first().toLongLong();
+                break;
+            }
+        }
+    }
+    
+    // Tiempo de CPU acumulado (utime + stime, campos 14 y 15 de /proc/<pid>/stat)
+    QFile stat(QString("/proc/%1/stat").arg(pid));
+    if (stat.open(QIODevice::ReadOnly)) {
+        QByteArray content = stat.readAll();
+        QList<QByteArray> fields = content.mid(content.lastIndexOf(')') + 2).split(' ');
+        if (fields.size() > 12) {
+            qint64 ticks = fields[11].toLongLong() + fields[12].toLongLong();
+            stats["cpuTimeMs"] = ticks * 1000 / sysconf(_SC_CLK_TCK);
+        }
+    }
+    
+    // RAM del invitado que KSM ha fusionado con la de otros procesos
+    qint64 mergedPages = HostInfo::ksmMergingPages(pid);
+    if (mergedPages >= 0) {
+        stats["ksmMergedKB"] = mergedPages * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+    
+    return stats;
+}
\ No newline at end of file
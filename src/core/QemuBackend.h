@@ -0,0 +1,114 @@
+#ifndef QEMUBACKEND_H
+#define QEMUBACKEND_H
+
+#include "VMBackend.h"
+
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QJsonObject>
+
+#include "DiskImageProbe.h"
+
+class QemuManager;
+
+/**
+ * @brief Backend que ejecuta QEMU directamente
+ * Los procesos los supervisa QemuManager; el control en caliente se hace
+ * por QMP. Las instantáneas internas qcow2 se toman con los trabajos
+ * snapshot-save/snapshot-load de QMP si la VM está en marcha y con qemu-img
+ * si está apagada; la lista se lee directamente de la tabla de la imagen.
+ * Las capas externas y la fusión de cadenas usan blockdev-snapshot-sync,
+ * block-commit y block-stream en caliente, y qemu-img en frío. Los puntos
+ * de control combinan una capa nueva por disco con la RAM guardada aparte
+ * (la misma migración a fichero que la suspensión, sin que QEMU salga).
+ */
+class QemuBackend : public VMBackend
+{
+    Q_OBJECT
+
+public:
+    explicit QemuBackend(QemuManager *qemuManager, QObject *parent = nullptr);
+    
+    QString id() const override { return "qemu"; }
+    bool isAvailable() override;
+    
+    void start(VirtualMachine *vm, Callback callback) override;
+    void stop(VirtualMachine *vm, Callback callback) override;
+    void pause(VirtualMachine *vm, Callback callback) override;
+    void resume(VirtualMachine *vm, Callback callback) override;
+    void reset(VirtualMachine *vm, Callback callback) override;
+    
+    void queryState(VirtualMachine *vm, Callback callback) override;
+    void queryStats(VirtualMachine *vm, Callback callback) override;
+    void setBalloonTarget(VirtualMachine *vm, qint64 targetMB, Callback callback) override;
+    void saveState(VirtualMachine *vm, Callback callback) override;
+    
+    void listSnapshots(VirtualMachine *vm, Callback callback) override;
+    void createSnapshot(VirtualMachine *vm, const QString &tag, Callback callback) override;
+    void deleteSnapshot(VirtualMachine *vm, const QString &tag, Callback callback) override;
+    void revertSnapshot(VirtualMachine *vm, const QString &tag, Callback callback) override;
+    void createExternalSnapshot(VirtualMachine *vm, const QString &tag, const QString &directory,
+                                Callback callback) override;
+    QString checkExternalSnapshot(VirtualMachine *vm, const QString &tag, const QString &directory) override;
+    void discardExternalSnapshot(VirtualMachine *vm, const QStringList &disks, Callback callback) override;
+    void mergeDiskChain(VirtualMachine *vm, const QString &diskPath, const QString &mode,
+                        Callback callback) override;
+    void createCheckpoint(VirtualMachine *vm, const QString &name, Callback callback) override;
+    void resetToCheckpoint(VirtualMachine *vm, const QString &name, Callback callback) override;
+    void deleteCheckpoint(VirtualMachine *vm, const QString &name, const QStringList &keep,
+                          Callback callback) override;
+
+private:
+    // Suspensión a disco en curso
+    struct SaveJob {
+        QString format;             // stream, zstd o mapped-ram
+        int channels = 1;
+        bool resume = false;        // el invitado se paró aquí: reanudarlo si falla
+        QString path;               // destino; se escribe en path + ".part"
+        bool keep = false;          // punto de control: QEMU sigue, sin estado "saved"
+    };
+    
+    void executeQmp(VirtualMachine *vm, const QString &command, const QJsonObject &arguments,
+                    Callback callback);
+    void executeQmp(const QString &vmName, const QString &command, const QJsonObject &arguments,
+                    Callback callback);
+    void chooseSaveJob(const QString &vmName, const std::function<void(SaveJob)> &next);
+    void beginSave(const QString &vmName, const SaveJob &job, Callback callback);
+    void pollSave(const QString &vmName, Callback callback);
+    void resumeAfterSave(const QString &vmName, const SaveJob &job, bool migrated);
+    void switchOverlays(const QString &vmName, const QStringList &disks, const QStringList &overlays,
+                        Callback callback);
+    void commitOverlays(const QString &vmName, const QStringList &tops, const QStringList &bases,
+                        int index, Callback callback);
+    void resetDisks(const QString &vmName, const QString &name, const QStringList &current, Callback callback);
+    bool ensureIdle(VirtualMachine *vm, const Callback &callback);
+    QString idleError(VirtualMachine *vm) const;
+    QString externalSnapshotError(VirtualMachine *vm, const QString &tag, const QString &directory,
+                                  QStringList *overlayPaths = nullptr) const;
+    bool ensureSnapshotCapable(VirtualMachine *vm, const Callback &callback);
+    bool findSnapshot(VirtualMachine *vm, const QString &tag, DiskImageProbe::Qcow2Snapshot *snapshot = nullptr) const;
+    void runSnapshot(VirtualMachine *vm, const QString &job, const QString &tag, Callback callback);
+    void runSnapshotJob(VirtualMachine *vm, const QString &job, const QString &tag, Callback callback);
+    void queryDiskNodes(const QString &vmName, const QStringList &disks, Callback callback);
+    void startJob(const QString &vmName, const QString &job, const QString &jobId,
+                  const QJsonObject &arguments, Callback callback);
+    void pollJob(const QString &vmName, const QString &job, const QString &jobId, Callback callback);
+    // Si una orden falla, result.value es su índice; las anteriores ya se aplicaron
+    void runImgCommands(const QString &vmName, const QString &job, const QList<QStringList> &commands,
+                        int index, Callback callback);
+    Callback trackOperation(const QString &vmName, Callback callback);
+    void queryBalloonStats(const QString &vmName, bool balloonPresent, qint64 target,
+                           const QJsonObject &stats, Callback callback);
+    static QJsonObject readProcessStats(qint64 pid);
+    
+    QemuManager *m_qemuManager;
+    QHash<QString, QList<Callback>> m_pendingStops;
+    QHash<QString, Callback> m_pendingSaves;        // estado escrito, esperando la salida de QEMU
+    QHash<QString, SaveJob> m_savingVMs;
+    QSet<QString> m_snapshotVMs;                    // con una instantánea o fusión en curso
+    QSet<QString> m_completingJobs;                 // job-complete ya enviado
+    QHash<QString, qint64> m_balloonTargets;        // MB, último objetivo pedido
+};
+
+#endif // QEMUBACKEND_H
\ No newline at end of file
@@ -1,20 +1,139 @@
 #include "QemuManager.h"
+#include "QmpClient.h"
 #include "VirtualMachine.h"
+#include "DiskImageProbe.h"
+#include "HostInfo.h"
 
-#include <QApplication>
+#include <QCoreApplication>
 #include <QDebug>
+#include <QFile>
+#include <QHash>
+#include <QJsonDocument>
+#include <QLocalSocket>
+#include <QRandomGenerator>
+#include <QSharedPointer>
 #include <QStandardPaths>
-#include <QThread>
 #include <QTimer>
+#include <QDateTime>
 #include <QRegularExpression>
+#include <QSettings>
+#include <QStorageInfo>
+
+#include <algorithm>
+#include <signal.h>
+#include <sched.h>
+#include <unistd.h>
 
 QemuManager::QemuManager(QObject *parent)
     : QObject(parent)
+    , m_watchTimer(new QTimer(this))
 {
     m_qemuPath = findQemuExecutable();
+    
+    // Los procesos QEMU no son hijos nuestros: comprobar periódicamente
+    // que siguen vivos y reintentar la conexión QMP mientras arrancan
+    m_watchTimer->setInterval(500);
+    connect(m_watchTimer, &QTimer::timeout, this, &QemuManager::checkRunningVMs);
+}
+
+QemuManager::~QemuManager()
+{
+    // Las VMs siguen ejecutándose: sólo se cierran las conexiones QMP
 }
 
 bool QemuManager::createDisk(const QString &path, const QString &format, qint64 sizeGB, bool preallocated)
+{
+    QStringList arguments;
+    if (!prepareDiskCreation(path, format, sizeGB, preallocated, &arguments)) {
+        return false;
+    }
+    
+    QProcess process;
+    process.setProgram("qemu-img");
+    process.setArguments(arguments);
+    
+    qDebug() << "Ejecutando:" << "qemu-img" << arguments.join(" ");
+    
+    process.start();
+    if (!process.waitForStarted(5000)) {
+        emit errorOccurred(tr("No se pudo iniciar qemu-img"));
+        return false;
+    }
+    
+    if (!process.waitForFinished(30000)) {
+        emit errorOccurred(tr("Timeout creando disco virtual"));
+        process.kill();
+        return false;
+    }
+    
+    if (process.exitCode() != 0) {
+        QString error = process.readAllStandardError();
+        emit errorOccurred(tr("Error creando disco: %1").arg(error));
+        return false;
+    }
+    
+    qDebug() << "Disco creado exitosamente:" << path;
+    return true;
+}
+
+void QemuManager::createDiskAsync(const QString &path, const QString &format, qint64 sizeGB, bool preallocated,
+                                  std::function<void(bool ok)> callback)
+{
+    QStringList arguments;
+    if (!prepareDiskCreation(path, format, sizeGB, preallocated, &arguments)) {
+        callback(false);
+        return;
+    }
+    
+    qDebug() << "Ejecutando:" << "qemu-img" << arguments.join(" ");
+    runImgAsync(arguments, 30000, [this, path, callback](const QString &error) {
+        if (!error.isEmpty()) {
+            emit errorOccurred(tr("Error creando disco: %1").arg(error));
+            callback(false);
+            return;
+        }
+        qDebug() << "Disco creado exitosamente:" << path;
+        callback(true);
+    });
+}
+
+void QemuManager::runImgAsync(const QStringList &arguments, int timeoutMs, std::function<void(const QString &error)> done)
+{
+    // finished y errorOccurred pueden llegar los dos: sólo cuenta el primero
+    QProcess *process = new QProcess(this);
+    auto reported = QSharedPointer<bool>::create(false);
+    auto report = [process, done, reported](const QString &error) {
+        if (*reported) {
+            return;
+        }
+        *reported = true;
+        process->deleteLater();
+        done(error);
+    };
+    connect(process, &QProcess::finished, this, [process, report](int exitCode, QProcess::ExitStatus status) {
+        if (status != QProcess::NormalExit || exitCode != 0) {
+            QString error = QString::fromLocal8Bit(process->readAllStandardError()).trimmed();
+            report(error.isEmpty() ? tr("qemu-img terminó con código %1").arg(exitCode) : error);
+            return;
+        }
+        report(QString());
+    });
+    connect(process, &QProcess::errorOccurred, this, [report](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart) {
+            report(tr("No se pudo iniciar qemu-img"));
+        }
+    });
+    if (timeoutMs > 0) {
+        QTimer::singleShot(timeoutMs, process, [process, report, timeoutMs]() {
+            process->kill();
+            report(tr("qemu-img no terminó en %1 s").arg(timeoutMs / 1000));
+        });
+    }
+    process->start("qemu-img", arguments);
+}
+
+bool QemuManager::prepareDiskCreation(const QString &path, const QString &format, qint64 sizeGB, bool preallocated,
+                                      QStringList *argumentsOut)
 {
     if (!isQemuAvailable()) {
         emit errorOccurred(tr("QEMU no está disponible en el sistema"));
@@ -33,7 +152,7 @@ bool QemuManager::createDisk(const QString &path, const QString &format, qint64
         return false;
     }
     
-    QStringList arguments;
+    QStringList &arguments = *argumentsOut;
     arguments << "create";
     arguments << "-f" << format.toLower();
     
@@ -51,32 +170,6 @@ bool QemuManager::createDisk(const QString &path, const QString &format, qint64
     
     arguments << path;
     arguments << formatSizeString(sizeGB);
-    
-    QProcess process;
-    process.setProgram("qemu-img");
-    process.setArguments(arguments);
-    
-    qDebug() << "Ejecutando:" << "qemu-img" << arguments.join(" ");
-    
-    process.start();
-    if (!process.waitForStarted(5000)) {
-        emit errorOccurred(tr("No se pudo iniciar qemu-img"));
-        return false;
-    }
-    
-    if (!process.waitForFinished(30000)) {
-        emit errorOccurred(tr("Timeout creando disco virtual"));
-        process.kill();
-        return false;
-    }
-    
-    if (process.exitCode() != 0) {
-        QString error = process.readAllStandardError();
-        emit errorOccurred(tr("Error creando disco: %1").arg(error));
-        return false;
-    }
-    
-    qDebug() << "Disco creado exitosamente:" << path;
     return true;
 }
 
@@ -105,21 +198,53 @@ bool QemuManager::resizeDisk(const QString &path, qint64 newSizeGB)
     return true;
 }
 
-bool QemuManager::convertDisk(const QString &sourcePath, const QString &destPath, const QString &destFormat)
+// Espera a que qemu-img termine; devuelve el error o vacío si fue bien. Un
+// proceso que no llegó a arrancar informa NormalExit con código 0, así que
+// el fallo se mira en error(); si se agota el tiempo se mata antes de volver
+static QString waitForImgProcess(QProcess &process, int timeoutMs)
+{
+    if (!process.waitForFinished(timeoutMs)) {
+        if (process.error() == QProcess::FailedToStart) {
+            return QemuManager::tr("No se pudo iniciar qemu-img");
+        }
+        process.kill();
+        process.waitForFinished();
+        return QemuManager::tr("qemu-img no terminó en %1 s").arg(timeoutMs / 1000);
+    }
+    if (process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0) {
+        QString error = QString::fromLocal8Bit(process.readAllStandardError()).trimmed();
+        return error.isEmpty() ? QemuManager::tr("qemu-img terminó con código %1").arg(process.exitCode()) : error;
+    }
+    return QString();
+}
+
+QStringList QemuManager::convertArguments(const QString &sourcePath, const QString &destPath,
+                                          const QString &destFormat, const QString &snapshot)
 {
     QStringList arguments;
     arguments << "convert";
+    if (!snapshot.isEmpty()) {
+        // Una instantánea interna no cambia: se puede leer sin el bloqueo de QEMU
+        arguments << "-U" << "-l" << "snapshot.name=" + snapshot;
+    }
     arguments << "-f" << getDiskFormat(sourcePath);
     arguments << "-O" << destFormat.toLower();
     arguments << sourcePath;
     arguments << destPath;
+    return arguments;
+}
+
+bool QemuManager::convertDisk(const QString &sourcePath, const QString &destPath, const QString &destFormat,
+                              const QString &snapshot)
+{
+    QStringList arguments = convertArguments(sourcePath, destPath, destFormat, snapshot);
     
+    // Copia el disco entero: sin límite de tiempo, un corte lo dejaría a medias
     QProcess process;
     process.start("qemu-img", arguments);
-    process.waitForFinished(60000); // 1 minuto timeout para conversiones
+    QString error = waitForImgProcess(process, -1);
     
-    if (process.exitCode() != 0) {
-        QString error = process.readAllStandardError();
+    if (!error.isEmpty()) {
         emit errorOccurred(tr("Error convirtiendo disco: %1").arg(error));
         return false;
     }
@@ -127,14 +252,150 @@ bool QemuManager::convertDisk(const QString &sourcePath, const QString &destPath
     return true;
 }
 
-bool QemuManager::copyDisk(const QString &sourcePath, const QString &destPath)
+bool QemuManager::copyDisk(const QString &sourcePath, const QString &destPath, const QString &snapshot)
 {
     QString sourceFormat = getDiskFormat(sourcePath);
-    return convertDisk(sourcePath, destPath, sourceFormat);
+    return convertDisk(sourcePath, destPath, sourceFormat, snapshot);
+}
+
+void QemuManager::copyDiskAsync(const QString &sourcePath, const QString &destPath, const QString &snapshot,
+                                std::function<void(bool ok)> callback)
+{
+    QStringList arguments = convertArguments(sourcePath, destPath, getDiskFormat(sourcePath), snapshot);
+    runImgAsync(arguments, 0, [this, callback](const QString &error) {
+        if (!error.isEmpty()) {
+            emit errorOccurred(tr("Error convirtiendo disco: %1").arg(error));
+        }
+        callback(error.isEmpty());
+    });
+}
+
+bool QemuManager::createOverlayDisk(const QString &basePath, const QString &overlayPath)
+{
+    // Ruta absoluta del disco base: la capa puede vivir en otro directorio
+    QStringList arguments;
+    arguments << "create" << "-f" << "qcow2";
+    arguments << "-b" << QFileInfo(basePath).absoluteFilePath();
+    arguments << "-F" << getDiskFormat(basePath);
+    arguments << overlayPath;
+    
+    QProcess process;
+    process.start("qemu-img", arguments);
+    QString error = waitForImgProcess(process, 30000);
+    
+    if (!error.isEmpty()) {
+        emit errorOccurred(tr("Error creando la capa sobre %1: %2").arg(basePath, error));
+        return false;
+    }
+    
+    return true;
+}
+
+QStringList QemuManager::createOverlayDisks(const QList<QPair<QString, QString>> &overlays, int parallel)
+{
+    // Cada qemu-img tarda casi todo en arrancar: se lanzan por tandas y se
+    // espera a la tanda entera. El formato de cada base se lee una sola vez
+    QHash<QString, QString> formats;
+    QStringList failed;
+    for (int first = 0; first < overlays.size(); first += qMax(1, parallel)) {
+        QList<QProcess*> processes;
+        for (int i = first; i < overlays.size() && i < first + qMax(1, parallel); ++i) {
+            const QString &basePath = overlays.at(i).first;
+            if (!formats.contains(basePath)) {
+                formats.insert(basePath, getDiskFormat(basePath));
+            }
+            
+            QStringList arguments;
+            arguments << "create" << "-f" << "qcow2";
+            arguments << "-b" << QFileInfo(basePath).absoluteFilePath();
+            arguments << "-F" << formats.value(basePath);
+            arguments << overlays.at(i).second;
+            
+            QProcess *process = new QProcess;
+            process->start("qemu-img", arguments);
+            processes.append(process);
+        }
+        
+        for (int j = 0; j < processes.size(); ++j) {
+            QProcess *process = processes.at(j);
+            const QPair<QString, QString> &overlay = overlays.at(first + j);
+            QString error = waitForImgProcess(*process, 30000);
+            if (!error.isEmpty()) {
+                emit errorOccurred(tr("Error creando la capa sobre %1: %2").arg(overlay.first, error));
+                failed.append(overlay.second);
+            }
+            delete process;
+        }
+    }
+    return failed;
+}
+
+struct QemuManager::OverlayBatch {
+    QList<QPair<QString, QString>> overlays;
+    QHash<QString, QString> formats;
+    QStringList failed;
+    int next = 0;
+    int running = 0;
+    std::function<void(const QStringList &failed)> callback;
+};
+
+void QemuManager::createOverlayDisksAsync(const QList<QPair<QString, QString>> &overlays, int parallel,
+                                          std::function<void(const QStringList &failed)> callback)
+{
+    if (overlays.isEmpty()) {
+        callback(QStringList());
+        return;
+    }
+    
+    // Sin tandas: en cuanto termina un qemu-img arranca el siguiente, con
+    // `parallel` en marcha como mucho
+    auto batch = QSharedPointer<OverlayBatch>::create();
+    batch->overlays = overlays;
+    batch->callback = callback;
+    for (int i = 0; i < qMax(1, parallel) && i < overlays.size(); ++i) {
+        launchOverlay(batch);
+    }
+}
+
+void QemuManager::launchOverlay(const QSharedPointer<OverlayBatch> &batch)
+{
+    if (batch->next >= batch->overlays.size()) {
+        if (batch->running == 0) {
+            batch->callback(batch->failed);
+        }
+        return;
+    }
+    
+    const QPair<QString, QString> overlay = batch->overlays.at(batch->next++);
+    if (!batch->formats.contains(overlay.first)) {
+        batch->formats.insert(overlay.first, getDiskFormat(overlay.first));
+    }
+    
+    QStringList arguments;
+    arguments << "create" << "-f" << "qcow2";
+    arguments << "-b" << QFileInfo(overlay.first).absoluteFilePath();
+    arguments << "-F" << batch->formats.value(overlay.first);
+    arguments << overlay.second;
+    
+    ++batch->running;
+    runImgAsync(arguments, 30000, [this, batch, overlay](const QString &error) {
+        --batch->running;
+        if (!error.isEmpty()) {
+            emit errorOccurred(tr("Error creando la capa sobre %1: %2").arg(overlay.first, error));
+            batch->failed.append(overlay.second);
+        }
+        launchOverlay(batch);
+    });
 }
 
 qint64 QemuManager::getDiskSize(const QString &path)
 {
+    // La cabecera basta para la mayoría de formatos y no choca con el bloqueo de QEMU
+    DiskImageProbe::Info info = DiskImageProbe::probe(path);
+    if (info.valid && info.virtualSize > 0) {
+        return info.virtualSize;
+    }
+    
     QStringList arguments;
     arguments << "info" << path;
     
@@ -160,6 +421,11 @@ qint64 QemuManager::getDiskSize(const QString &path)
 
 QString QemuManager::getDiskFormat(const QString &path)
 {
+    DiskImageProbe::Info info = DiskImageProbe::probe(path);
+    if (info.valid) {
+        return info.format;
+    }
+    
     QStringList arguments;
     arguments << "info" << path;
     
@@ -190,6 +456,104 @@ QString QemuManager::getDiskFormat(const QString &path)
     return "raw";
 }
 
+bool QemuManager::createDiskSnapshot(const QString &path, const QString &tag)
+{
+    return runSnapshotCommand(QStringList() << "snapshot" << "-c" << tag << path,
+                              tr("Error creando instantánea '%1'").arg(tag));
+}
+
+bool QemuManager::deleteDiskSnapshot(const QString &path, const QString &tag)
+{
+    return runSnapshotCommand(QStringList() << "snapshot" << "-d" << tag << path,
+                              tr("Error eliminando instantánea '%1'").arg(tag));
+}
+
+bool QemuManager::applyDiskSnapshot(const QString &path, const QString &tag)
+{
+    return runSnapshotCommand(QStringList() << "snapshot" << "-a" << tag << path,
+                              tr("Error restaurando instantánea '%1'").arg(tag));
+}
+
+QStringList QemuManager::listDiskSnapshots(const QString &path)
+{
+    // La tabla se lee directamente del archivo: no hace falta qemu-img y
+    // funciona aunque QEMU tenga la imagen abierta
+    QStringList tags;
+    const QList<DiskImageProbe::Qcow2Snapshot> snapshots = DiskImageProbe::qcow2Snapshots(path);
+    for (const DiskImageProbe::Qcow2Snapshot &snapshot : snapshots) {
+        tags.append(snapshot.name);
+    }
+    return tags;
+}
+
+QemuManager::OverlayPolicy QemuManager::loadOverlayPolicy()
+{
+    QSettings settings;
+    OverlayPolicy policy;
+    policy.useSnapshotFolder = settings.value("snapshots/useSnapshotFolder", policy.useSnapshotFolder).toBool();
+    policy.chainWarningDepth = qBound(1, settings.value("snapshots/chainWarningDepth", policy.chainWarningDepth).toInt(), 64);
+    return policy;
+}
+
+void QemuManager::saveOverlayPolicy(const OverlayPolicy &policy)
+{
+    QSettings settings;
+    settings.setValue("snapshots/useSnapshotFolder", policy.useSnapshotFolder);
+    settings.setValue("snapshots/chainWarningDepth", policy.chainWarningDepth);
+}
+
+QString QemuManager::snapshotFolder()
+{
+    // Mismo valor por defecto que la pestaña General de las preferencias
+    QSettings settings;
+    return settings.value("general/snapshotFolder",
+                          QStandardPaths::writableLocation(QStandardPaths::HomeLocation) + "/.local/share/kvm/snapshots").toString();
+}
+
+QString QemuManager::overlayDirectory(const QString &vmName)
+{
+    return loadOverlayPolicy().useSnapshotFolder ? snapshotFolder() + "/" + vmName : QString();
+}
+
+QString QemuManager::overlayPath(const QString &diskPath, const QString &tag, const QString &directory)
+{
+    // El nombre parte de la imagen base para no encadenar sufijos capa tras capa
+    QStringList chain = DiskImageProbe::backingChain(diskPath);
+    QString baseName = QFileInfo(chain.isEmpty() ? diskPath : chain.last()).completeBaseName();
+    QString safeTag = tag;
+    safeTag.replace(QRegularExpression("[^A-Za-z0-9._-]"), "_");
+    
+    QString folder = directory.isEmpty() ? QFileInfo(diskPath).absolutePath() : directory;
+    return QString("%1/%2-%3.qcow2").arg(folder, baseName, safeTag);
+}
+
+QString QemuManager::ephemeralDirectory()
+{
+    QSettings settings;
+    QString directory = settings.value("ephemeral/directory").toString();
+    if (!directory.isEmpty()) {
+        return directory;
+    }
+    return QFileInfo("/dev/shm").isWritable() ? QString("/dev/shm") : QDir::tempPath();
+}
+
+void QemuManager::setEphemeralDirectory(const QString &directory)
+{
+    QSettings settings;
+    settings.setValue("ephemeral/directory", directory);
+}
+
+bool QemuManager::isEphemeralRun(const QString &vmName) const
+{
+    return m_runningVMs.value(vmName).ephemeral;
+}
+
+QString QemuManager::ephemeralMarkerPath(const QString &vmName)
+{
+    // Guarda la carpeta temporal de la ejecución: sigue valiendo aunque cambie la preferencia
+    return vmDirectory(vmName) + "/ephemeral";
+}
+
 bool QemuManager::startVM(VirtualMachine *vm)
 {
     if (!vm) {
@@ -199,8 +563,9 @@ bool QemuManager::startVM(VirtualMachine *vm)
     
     QString vmName = vm->getName();
     
-    // Verificar si ya está ejecutándose
-    if (m_runningVMs.contains(vmName)) {
+    // Verificar si ya está ejecutándose (también por otra instancia del gestor)
+    qint64 existingPid = readPidFile(pidFilePath(vmName));
+    if (m_runningVMs.contains(vmName) || isQemuProcess(existingPid, vmName)) {
         emit errorOccurred(tr("La máquina virtual '%1' ya está ejecutándose").arg(vmName));
         return false;
     }
@@ -210,223 +575,1445 @@ bool QemuManager::startVM(VirtualMachine *vm)
         return false;
     }
     
-    QStringList arguments = buildQemuCommand(vm);
+    if (!createDirectoryIfNotExists(vmDirectory(vmName))) {
+        emit errorOccurred(tr("No se pudo crear el directorio: %1").arg(vmDirectory(vmName)));
+        return false;
+    }
+    cleanupRuntimeFiles(vmName);
     
-    QProcess *process = new QProcess(this);
-    process->setProgram(m_qemuPath);
-    process->setArguments(arguments);
+    CpuPlacement placement = planPlacement(vm);
+    QString memoryError;
+    if (vm->getMemoryBacking() == "hugepages"
+        && !checkHugePages(vm->getMemoryMB(), vm->getHugePageSizeKB(), &memoryError, placement.hostNodes)) {
+        emit errorOccurred(tr("No se puede iniciar la VM '%1': %2").arg(vmName, memoryError));
+        return false;
+    }
+    QStringList arguments = buildQemuCommand(vm, placement);
+    
+    // Modo efímero: QEMU crea las capas temporales en su TMPDIR, una carpeta
+    // propia de esta ejecución que se borra al terminar
+    QString scratch;
+    if (vm->isEphemeral()) {
+        scratch = QString("%1/kvm-manager-%2/%3").arg(ephemeralDirectory()).arg(::getuid()).arg(vmName);
+        QFile marker(ephemeralMarkerPath(vmName));
+        if (!QDir().mkpath(scratch) || !marker.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            || marker.write(QFile::encodeName(scratch)) <= 0) {
+            emit errorOccurred(tr("No se pudo preparar la carpeta temporal %1 de la VM efímera '%2'").arg(scratch, vmName));
+            cleanupRuntimeFiles(vmName);
+            return false;
+        }
+        qint64 available = QStorageInfo(scratch).bytesAvailable();
+        if (available >= 0 && available < qint64(1024) * 1024 * 1024) {
+            qWarning() << "QemuManager: Sólo quedan" << available / (1024 * 1024) << "MB en" << scratch
+                       << "para las escrituras de la VM efímera" << vmName;
+        }
+    }
+    
+    // Estado suspendido a disco: QEMU lo carga en lugar de arrancar el invitado.
+    // Con mapped-ram las capacidades se activan por QMP antes de empezar
+    bool restoring = hasSavedState(vmName);
+    QJsonObject savedInfo = restoring ? savedStateInfo(vmName) : QJsonObject();
+    QString restoreFormat = savedInfo.value("format").toString("stream");
+    if (restoring) {
+        arguments << "-incoming" << (restoreFormat == "mapped-ram" ? QString("defer")
+                                                                    : stateRestoreUri(savedStatePath(vmName), restoreFormat));
+    }
     
-    // Conectar señales
-    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-            this, &QemuManager::onProcessFinished);
-    connect(process, &QProcess::errorOccurred,
-            this, &QemuManager::onProcessError);
-    connect(process, &QProcess::readyReadStandardOutput,
-            this, &QemuManager::onProcessOutput);
+    // Proceso desacoplado: sobrevive al cierre de la interfaz
+    QProcess process;
+    process.setProgram(m_qemuPath);
+    process.setArguments(arguments);
+    process.setStandardInputFile(QProcess::nullDevice());
+    process.setStandardOutputFile(QProcess::nullDevice());
+    process.setStandardErrorFile(qemuLogPath(vmName));
+    if (!scratch.isEmpty()) {
+        QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+        environment.insert("TMPDIR", scratch);
+        process.setProcessEnvironment(environment);
+    }
     
     qDebug() << "Iniciando VM:" << vmName;
     qDebug() << "Comando:" << m_qemuPath << arguments.join(" ");
     
-    process->start();
-    
-    if (!process->waitForStarted(5000)) {
+    qint64 pid = 0;
+    if (!process.startDetached(&pid)) {
         emit errorOccurred(tr("No se pudo iniciar QEMU para la VM '%1'").arg(vmName));
-        delete process;
+        cleanupRuntimeFiles(vmName);
         return false;
     }
     
-    m_runningVMs[vmName] = process;
+    attachVM(vmName, pid, "running");
+    // El pinning se aplica cuando QMP responde: los hilos de las vCPUs ya existen
+    m_runningVMs[vmName].hostCpus = placement.hostCpus;
+    m_runningVMs[vmName].emulatorCpus = placement.emulatorCpus;
+    m_runningVMs[vmName].balloon = hasMemoryBalloon(vm);
+    m_runningVMs[vmName].restoring = restoring;
+    m_runningVMs[vmName].restoreFormat = restoreFormat;
+    m_runningVMs[vmName].restoreChannels = savedInfo.value("channels").toInt(1);
+    m_runningVMs[vmName].restoreStartMs = QDateTime::currentMSecsSinceEpoch();
+    m_runningVMs[vmName].ephemeral = !scratch.isEmpty();
     vm->setState("running");
+    vm->setLastStarted(QDateTime::currentDateTime());
     emit processStarted(vmName);
     
     return true;
 }
 
-bool QemuManager::stopVM(const QString &vmName)
+bool QemuManager::requestStop(const QString &vmName)
 {
     if (!m_runningVMs.contains(vmName)) {
         emit errorOccurred(tr("La máquina virtual '%1' no está ejecutándose").arg(vmName));
         return false;
     }
     
-    QProcess *process = m_runningVMs[vmName];
-    process->terminate();
+    // Salida ordenada por QMP; si no responde, por señal. La salida se
+    // notifica con processFinished()
+    qint64 pid = m_runningVMs[vmName].pid;
+    m_runningVMs[vmName].qmp->execute("quit", QJsonObject(), [pid](const QJsonObject &reply) {
+        if (reply.contains("error")) {
+            ::kill(pid, SIGTERM);
+        }
+    });
     
-    if (!process->waitForFinished(10000)) {
-        process->kill();
-        process->waitForFinished(3000);
-    }
+    QTimer::singleShot(10000, this, [this, vmName, pid]() {
+        if (isQemuProcess(pid, vmName)) {
+            qWarning() << "QemuManager: La VM" << vmName << "no terminó a tiempo, forzando cierre";
+            ::kill(pid, SIGKILL);
+        }
+    });
     
     return true;
 }
 
-bool QemuManager::pauseVM(const QString &vmName)
+bool QemuManager::isVMRunning(const QString &vmName) const
 {
-    // TODO: Implementar pausa via monitor de QEMU
-    emit errorOccurred(tr("Funcionalidad de pausa no implementada aún"));
-    return false;
+    return m_runningVMs.contains(vmName);
 }
 
-bool QemuManager::resumeVM(const QString &vmName)
+QStringList QemuManager::getRunningVMs() const
 {
-    // TODO: Implementar reanudación via monitor de QEMU
-    emit errorOccurred(tr("Funcionalidad de reanudación no implementada aún"));
-    return false;
+    return m_runningVMs.keys();
 }
 
-bool QemuManager::isQemuAvailable()
+qint64 QemuManager::getVMPid(const QString &vmName) const
 {
-    return !m_qemuPath.isEmpty();
+    return m_runningVMs.value(vmName).pid;
 }
 
-QString QemuManager::getQemuVersion()
+QList<int> QemuManager::getVMHostCpus(const QString &vmName) const
 {
-    QProcess process;
-    process.start(m_qemuPath, QStringList() << "--version");
-    process.waitForFinished();
-    
-    if (process.exitCode() == 0) {
-        return process.readAllStandardOutput().trimmed();
-    }
-    
-    return tr("No disponible");
+    return m_runningVMs.value(vmName).hostCpus;
 }
 
-QStringList QemuManager::getSupportedFormats()
+QmpClient* QemuManager::getQmpClient(const QString &vmName) const
 {
-    QStringList formats;
-    
-    QProcess process;
-    process.start("qemu-img", QStringList() << "--help");
-    process.waitForFinished();
-    
-    if (process.exitCode() == 0) {
-        QString output = process.readAllStandardOutput();
-        // Parsear formatos soportados desde la ayuda
-        formats << "qcow2" << "raw" << "vdi" << "vmdk" << "vhd";
-    } else {
-        // Formatos por defecto
-        formats << "qcow2" << "raw";
-    }
-    
-    return formats;
+    return m_runningVMs.value(vmName).qmp;
 }
 
-void QemuManager::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
+bool QemuManager::isQmpReady(const QString &vmName) const
 {
-    QProcess *process = qobject_cast<QProcess*>(sender());
-    if (!process) return;
+    return m_runningVMs.value(vmName).qmpVerified;
+}
+
+bool QemuManager::isGuestAgentConnected(const QString &vmName) const
+{
+    return m_runningVMs.value(vmName).guestAgent;
+}
+
+void QemuManager::executeGuestAgent(const QString &vmName, const QString &command, const QJsonObject &arguments,
+                                    int timeoutMs, GuestAgentCallback callback)
+{
+    auto errorReply = [](const QString &error) {
+        QJsonObject desc;
+        desc["desc"] = error;
+        QJsonObject reply;
+        reply["error"] = desc;
+        return reply;
+    };
+    if (!isGuestAgentConnected(vmName)) {
+        callback(errorReply(tr("qemu-guest-agent no está conectado en la VM '%1'").arg(vmName)));
+        return;
+    }
     
-    // Encontrar la VM asociada
-    QString vmName;
-    for (auto it = m_runningVMs.begin(); it != m_runningVMs.end(); ++it) {
-        if (it.value() == process) {
-            vmName = it.key();
-            break;
+    // El canal puede conservar restos de un cliente anterior: guest-sync-delimited
+    // los descarta (su respuesta va precedida de 0xFF) y sólo después se envía el comando
+    struct Call {
+        QByteArray buffer;
+        bool synced = false;
+        bool done = false;
+    };
+    auto call = QSharedPointer<Call>::create();
+    QLocalSocket *socket = new QLocalSocket(this);
+    QTimer *timer = new QTimer(socket);
+    timer->setSingleShot(true);
+    qint64 syncId = QRandomGenerator::global()->bounded(1, 1 << 30);
+    
+    auto finish = [socket, call, callback](const QJsonObject &reply) {
+        if (call->done) {
+            return;
         }
-    }
+        call->done = true;
+        socket->disconnect();
+        socket->abort();
+        socket->deleteLater();
+        callback(reply);
+    };
+    auto send = [socket](const QString &execute, const QJsonObject &args) {
+        QJsonObject message;
+        message["execute"] = execute;
+        if (!args.isEmpty()) {
+            message["arguments"] = args;
+        }
+        socket->write(QJsonDocument(message).toJson(QJsonDocument::Compact) + "\n");
+    };
     
-    if (!vmName.isEmpty()) {
-        m_runningVMs.remove(vmName);
-        emit processFinished(vmName, exitCode);
+    connect(timer, &QTimer::timeout, this, [finish, errorReply, command, vmName]() {
+        finish(errorReply(tr("Timeout esperando a qemu-guest-agent ('%1' en la VM '%2')").arg(command, vmName)));
+    });
+    connect(socket, &QLocalSocket::errorOccurred, this, [finish, errorReply, socket](QLocalSocket::LocalSocketError) {
+        finish(errorReply(tr("Error en el canal de qemu-guest-agent: %1").arg(socket->errorString())));
+    });
+    connect(socket, &QLocalSocket::connected, this, [socket, send, syncId]() {
+        QJsonObject args;
+        args["id"] = syncId;
+        socket->write(QByteArray(1, char(0xFF)));
+        send("guest-sync-delimited", args);
+    });
+    connect(socket, &QLocalSocket::readyRead, this, [socket, call, send, finish, syncId, command, arguments]() {
+        call->buffer.append(socket->readAll());
+        if (!call->synced) {
+            int marker = call->buffer.lastIndexOf(char(0xFF));
+            if (marker >= 0) {
+                call->buffer.remove(0, marker + 1);
+            }
+        }
         
-        if (exitStatus == QProcess::CrashExit || exitCode != 0) {
-            QString errorMsg = tr("La máquina virtual '%1' terminó con código de error %2").arg(vmName).arg(exitCode);
-            
-            // Add stderr output for debugging
-            QString stderr = process->readAllStandardError();
-            if (!stderr.isEmpty()) {
-                errorMsg += "\nDetalles: " + stderr;
-                qDebug() << "QEMU stderr:" << stderr;
+        int newline;
+        while (!call->done && (newline = call->buffer.indexOf('\n')) >= 0) {
+            QByteArray line = call->buffer.left(newline).trimmed();
+            call->buffer.remove(0, newline + 1);
+            QJsonObject reply = QJsonDocument::fromJson(line).object();
+            if (reply.isEmpty()) {
+                continue;
             }
-            
-            emit errorOccurred(errorMsg);
+            if (!call->synced) {
+                if (reply.value("return").toInteger() == syncId) {
+                    call->synced = true;
+                    send(command, arguments);
+                }
+                continue;
+            }
+            finish(reply);
         }
-    }
+    });
     
-    process->deleteLater();
+    timer->start(timeoutMs);
+    socket->connectToServer(guestAgentSocketPath(vmName));
 }
 
-void QemuManager::onProcessError(QProcess::ProcessError error)
+bool QemuManager::isRestoring(const QString &vmName) const
 {
-    QProcess *process = qobject_cast<QProcess*>(sender());
-    QString errorString;
-    
-    switch (error) {
-        case QProcess::FailedToStart:
-            errorString = tr("No se pudo iniciar QEMU");
-            break;
-        case QProcess::Crashed:
-            errorString = tr("QEMU se cerró inesperadamente");
-            break;
-        case QProcess::Timedout:
-            errorString = tr("Timeout ejecutando QEMU");
-            break;
-        default:
-            errorString = tr("Error desconocido en QEMU");
+    return m_runningVMs.value(vmName).restoring;
+}
+
+QString QemuManager::stateFromQmpStatus(const QString &status)
+{
+    // query-status distingue muchos estados de parada; todos se muestran como pausa
+    if (status == "running") {
+        return "running";
+    } else if (status == "shutdown") {
+        return "shut off";
     }
-    
-    // Add stderr output for better debugging
-    if (process) {
-        QString stderr = process->readAllStandardError();
-        if (!stderr.isEmpty()) {
-            errorString += "\nDetalles: " + stderr;
+    return "paused";
+}
+
+void QemuManager::reattachVMs(const QList<VirtualMachine*> &vms)
+{
+    for (VirtualMachine *vm : vms) {
+        QString vmName = vm->getName();
+        
+        // Ya supervisada por esta instancia (p. ej. tras recargar la lista)
+        if (m_runningVMs.contains(vmName)) {
+            vm->setState(m_runningVMs[vmName].state);
+            continue;
         }
+        
+        qint64 pid = readPidFile(pidFilePath(vmName));
+        if (!isQemuProcess(pid, vmName)) {
+            // Estado guardado obsoleto: el proceso ya no existe
+            QString idleState = hasSavedState(vmName) ? "saved" : "shut off";
+            if (vm->getState() != idleState && !(idleState == "shut off" && vm->isStopped())) {
+                vm->setState(idleState);
+            }
+            cleanupRuntimeFiles(vmName);
+            continue;
+        }
+        
+        attachVM(vmName, pid, "running");
+        
+        // Pinning aplicado por una instancia anterior: se tiene en cuenta al
+        // ubicar las VMs que se arranquen después
+        m_runningVMs[vmName].hostCpus = pinnedVcpuCpus(pid);
+        m_runningVMs[vmName].pinned = true;
+        m_runningVMs[vmName].ephemeral = QFileInfo::exists(ephemeralMarkerPath(vmName));
+        
+        // El estado real llega por QMP sin esperarlo aquí: la consulta queda
+        // en cola hasta qmpReady (que marca la VM como verificada) y, si no
+        // es "running", se publica con vmStateChanged
+        m_runningVMs[vmName].qmp->execute("query-status", QJsonObject(), [this, vmName](const QJsonObject &reply) {
+            if (reply.contains("error")) {
+                qWarning() << "QemuManager: La VM" << vmName << "no responde por QMP:" << QmpClient::errorString(reply);
+                return;
+            }
+            setRunState(vmName, stateFromQmpStatus(reply.value("return").toObject().value("status").toString()));
+        });
+        
+        vm->setState(m_runningVMs[vmName].state);
+        qDebug() << "QemuManager: VM reasociada:" << vmName << "pid" << pid << m_runningVMs[vmName].state;
+    }
+}
+
+QString QemuManager::vmDirectory(const QString &vmName)
+{
+    return QDir::homePath() + "/.VM/" + vmName;
+}
+
+QString QemuManager::pidFilePath(const QString &vmName)
+{
+    return vmDirectory(vmName) + "/qemu.pid";
+}
+
+QString QemuManager::qmpSocketPath(const QString &vmName)
+{
+    return vmDirectory(vmName) + "/qmp.sock";
+}
+
+QString QemuManager::serialLogPath(const QString &vmName)
+{
+    return vmDirectory(vmName) + "/serial.log";
+}
+
+QString QemuManager::qemuLogPath(const QString &vmName)
+{
+    return vmDirectory(vmName) + "/qemu.log";
+}
+
+QString QemuManager::guestAgentSocketPath(const QString &vmName)
+{
+    return vmDirectory(vmName) + "/qga.sock";
+}
+
+QString QemuManager::savedStatePath(const QString &vmName)
+{
+    return vmDirectory(vmName) + "/state.vmstate";
+}
+
+bool QemuManager::hasSavedState(const QString &vmName)
+{
+    return QFileInfo::exists(savedStatePath(vmName));
+}
+
+void QemuManager::removeSavedState(const QString &vmName)
+{
+    QFile::remove(savedStatePath(vmName));
+    QFile::remove(vmDirectory(vmName) + "/state.json");
+}
+
+QJsonObject QemuManager::savedStateInfo(const QString &vmName)
+{
+    // Sin archivo de información: estado de una versión anterior (exec:cat)
+    QFile file(vmDirectory(vmName) + "/state.json");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+void QemuManager::writeSavedStateInfo(const QString &vmName, const QJsonObject &info)
+{
+    QFile file(vmDirectory(vmName) + "/state.json");
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        file.write(QJsonDocument(info).toJson());
+    }
+}
+
+bool QemuManager::adoptSavedState(const QString &vmName, const QString &statePath, QJsonObject info)
+{
+    // La restauración borra el enlace; el archivo original conserva el suyo
+    QString savedPath = savedStatePath(vmName);
+    QFile::remove(savedPath);
+    if (::link(QFile::encodeName(statePath).constData(), QFile::encodeName(savedPath).constData()) != 0
+        && !QFile::copy(statePath, savedPath)) {
+        return false;
+    }
+    info["path"] = savedPath;
+    writeSavedStateInfo(vmName, info);
+    return true;
+}
+
+QString QemuManager::stateSaveUri(const QString &path, const QString &format, int channels)
+{
+    if (format == "mapped-ram") {
+        return "file:" + path;
+    }
+    if (format == "zstd") {
+        // Nivel 1: lo que cuenta es el tiempo con la VM parada, no el último byte
+        return QString("exec:zstd -q -1 -T%1 > %2").arg(channels).arg(shellQuote(path));
+    }
+    return "exec:cat > " + shellQuote(path);
+}
+
+QString QemuManager::stateRestoreUri(const QString &path, const QString &format)
+{
+    if (format == "mapped-ram") {
+        return "file:" + path;
+    }
+    if (format == "zstd") {
+        return "exec:zstd -q -d -c " + shellQuote(path);
+    }
+    return "exec:cat " + shellQuote(path);
+}
+
+QJsonArray QemuManager::mappedRamCapabilities(bool enabled)
+{
+    QJsonArray capabilities;
+    for (const char *name : {"mapped-ram", "multifd"}) {
+        QJsonObject capability;
+        capability["capability"] = name;
+        capability["state"] = enabled;
+        capabilities.append(capability);
+    }
+    return capabilities;
+}
+
+QString QemuManager::checkpointsRoot(const QString &vmName)
+{
+    return vmDirectory(vmName) + "/checkpoints";
+}
+
+QString QemuManager::checkpointDirectory(const QString &vmName, const QString &name)
+{
+    return checkpointsRoot(vmName) + "/" + name;
+}
+
+QString QemuManager::checkpointStatePath(const QString &vmName, const QString &name)
+{
+    return checkpointDirectory(vmName, name) + "/state.vmstate";
+}
+
+QString QemuManager::checkpointOverlayPath(const QString &vmName, const QString &name, int diskIndex)
+{
+    // Cada reinicio crea capas nuevas: la marca de tiempo evita pisar las que siguen en uso
+    return QString("%1/disk%2-%3.qcow2").arg(checkpointDirectory(vmName, name)).arg(diskIndex)
+                                        .arg(QDateTime::currentMSecsSinceEpoch());
+}
+
+QJsonObject QemuManager::checkpointInfo(const QString &vmName, const QString &name)
+{
+    QFile file(checkpointDirectory(vmName, name) + "/checkpoint.json");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+bool QemuManager::writeCheckpointInfo(const QString &vmName, const QString &name, const QJsonObject &info)
+{
+    QFile file(checkpointDirectory(vmName, name) + "/checkpoint.json");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    return file.write(QJsonDocument(info).toJson()) > 0;
+}
+
+QStringList QemuManager::listCheckpoints(const QString &vmName)
+{
+    // Sólo cuentan las carpetas con su checkpoint.json: una creación a medias no es un punto de control
+    QStringList names;
+    const QStringList folders = QDir(checkpointsRoot(vmName)).entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    for (const QString &folder : folders) {
+        if (QFileInfo::exists(checkpointDirectory(vmName, folder) + "/checkpoint.json")) {
+            names.append(folder);
+        }
+    }
+    return names;
+}
+
+QStringList QemuManager::checkpointImages(const QString &vmName)
+{
+    QStringList images;
+    for (const QString &name : listCheckpoints(vmName)) {
+        for (const QJsonValue &disk : checkpointInfo(vmName, name).value("disks").toArray()) {
+            images.append(disk.toString());
+        }
+    }
+    return images;
+}
+
+bool QemuManager::isValidCheckpointName(const QString &name)
+{
+    // Es el nombre de una carpeta
+    static const QRegularExpression pattern("^[A-Za-z0-9_-][A-Za-z0-9._-]*$");
+    return pattern.match(name).hasMatch();
+}
+
+QemuManager::SaveStatePolicy QemuManager::loadSaveStatePolicy()
+{
+    QSettings settings;
+    SaveStatePolicy policy;
+    QString compression = settings.value("saveState/compression", policy.compression).toString();
+    if (QStringList({"auto", "none", "zstd"}).contains(compression)) {
+        policy.compression = compression;
+    }
+    policy.channels = qBound(0, settings.value("saveState/channels", policy.channels).toInt(), 64);
+    return policy;
+}
+
+void QemuManager::saveSaveStatePolicy(const SaveStatePolicy &policy)
+{
+    QSettings settings;
+    settings.setValue("saveState/compression", policy.compression);
+    settings.setValue("saveState/channels", policy.channels);
+}
+
+int QemuManager::saveStateChannels(const SaveStatePolicy &policy)
+{
+    if (policy.channels > 0) {
+        return policy.channels;
+    }
+    // La otra mitad de las CPUs sigue atendiendo al resto de VMs
+    return qBound(2, HostInfo::cpuTopology().logicalCpus() / 2, 8);
+}
+
+bool QemuManager::isZstdAvailable()
+{
+    return !QStandardPaths::findExecutable("zstd").isEmpty();
+}
+
+QString QemuManager::chooseSaveFormat(const SaveStatePolicy &policy, bool mappedRam, bool zstd)
+{
+    QString uncompressed = mappedRam ? "mapped-ram" : "stream";
+    if (policy.compression == "none" || !zstd) {
+        return uncompressed;
+    }
+    if (policy.compression == "zstd") {
+        return "zstd";
+    }
+    
+    // Automático: hasta medir el disco con un guardado sin comprimir se
+    // supone rápido. Sin medida de zstd se estima ~300 MB/s por hilo a nivel 1
+    double disk = measuredSaveThroughput(uncompressed);
+    if (disk <= 0) {
+        return uncompressed;
+    }
+    double compressed = measuredSaveThroughput("zstd");
+    if (compressed <= 0) {
+        compressed = 300.0 * saveStateChannels(policy);
+    }
+    return compressed > disk * 1.2 ? "zstd" : uncompressed;
+}
+
+double QemuManager::measuredSaveThroughput(const QString &format)
+{
+    QSettings settings;
+    return settings.value("saveState/throughput/" + format, 0.0).toDouble();
+}
+
+void QemuManager::recordSaveThroughput(const QString &format, double mbps)
+{
+    if (mbps <= 0) {
+        return;
+    }
+    // Media móvil: un guardado en un momento de carga no cambia la decisión de golpe
+    double previous = measuredSaveThroughput(format);
+    QSettings settings;
+    settings.setValue("saveState/throughput/" + format, previous > 0 ? (previous + mbps) / 2 : mbps);
+}
+
+QJsonObject QemuManager::saveStateStats(const QString &vmName)
+{
+    QFile file(vmDirectory(vmName) + "/state-stats.json");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+void QemuManager::recordSaveStateStats(const QString &vmName, const QString &operation, const QJsonObject &stats)
+{
+    QJsonObject all = saveStateStats(vmName);
+    all[operation] = stats;
+    QFile file(vmDirectory(vmName) + "/state-stats.json");
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        file.write(QJsonDocument(all).toJson());
+    }
+}
+
+bool QemuManager::isQemuAvailable()
+{
+    return !m_qemuPath.isEmpty();
+}
+
+QString QemuManager::getQemuVersion()
+{
+    QProcess process;
+    process.start(m_qemuPath, QStringList() << "--version");
+    process.waitForFinished();
+    
+    if (process.exitCode() == 0) {
+        return process.readAllStandardOutput().trimmed();
+    }
+    
+    return tr("No disponible");
+}
+
+QStringList QemuManager::getCpuModels()
+{
+    if (!m_cpuModels.isEmpty()) {
+        return m_cpuModels;
+    }
+    
+    QProcess process;
+    process.start(m_qemuPath, QStringList() << "-cpu" << "help");
+    process.waitForFinished(5000);
+    
+    // Líneas "x86 Skylake-Client-v1  Intel Core Processor (Skylake)"
+    static const QRegularExpression modelLine(R"(^x86\s+(\S+))", QRegularExpression::MultilineOption);
+    QRegularExpressionMatchIterator it = modelLine.globalMatch(QString::fromUtf8(process.readAllStandardOutput()));
+    while (it.hasNext()) {
+        QString model = it.next().captured(1);
+        if (model != "host" && model != "max" && model != "base") {
+            m_cpuModels.append(model);
+        }
+    }
+    
+    if (m_cpuModels.isEmpty()) {
+        m_cpuModels << "qemu64" << "kvm64" << "Nehalem" << "SandyBridge" << "IvyBridge"
+                    << "Haswell" << "Broadwell" << "Skylake-Client" << "Skylake-Server"
+                    << "Cascadelake-Server" << "Icelake-Server" << "EPYC" << "EPYC-Rome" << "EPYC-Milan";
+    }
+    
+    return m_cpuModels;
+}
+
+QString QemuManager::cpuModelArgument(const QString &model)
+{
+    // Sin KVM (TCG) no existe "host": "max" ofrece todo lo que emula QEMU
+    if (model == "host-passthrough" || model == "host-model") {
+        if (!HostInfo::isKvmAccessible()) {
+            return "max";
+        }
+        // migratable=off expondría invtsc sin frecuencia de TSC y QEMU se
+        // negaría a migrar: sin migración no hay guardado, puntos de control
+        // con memoria ni fork. "host" ya es migrable, como en libvirt
+        return model == "host-passthrough" ? "host" : "host,migratable=on";
+    }
+    return model.isEmpty() ? QString("qemu64") : model;
+}
+
+QStringList QemuManager::getSupportedFormats()
+{
+    QStringList formats;
+    
+    QProcess process;
+    process.start("qemu-img", QStringList() << "--help");
+    process.waitForFinished();
+    
+    if (process.exitCode() == 0) {
+        QString output = process.readAllStandardOutput();
+        // Parsear formatos soportados desde la ayuda
+        formats << "qcow2" << "raw" << "vdi" << "vmdk" << "vhd";
+    } else {
+        // Formatos por defecto
+        formats << "qcow2" << "raw";
+    }
+    
+    return formats;
+}
+
+void QemuManager::checkRunningVMs()
+{
+    const QStringList vmNames = m_runningVMs.keys();
+    for (const QString &vmName : vmNames) {
+        if (!m_runningVMs.contains(vmName)) {
+            continue;
+        }
+        
+        RunningVM &entry = m_runningVMs[vmName];
+        if (!isQemuProcess(entry.pid, vmName)) {
+            handleVMExit(vmName);
+            continue;
+        }
+        
+        // QEMU crea el socket QMP durante el arranque: reintentar hasta conectar
+        if (entry.qmp->state() == QLocalSocket::UnconnectedState && QFileInfo::exists(qmpSocketPath(vmName))) {
+            entry.qmp->connectToServer(qmpSocketPath(vmName));
+        }
+    }
+    
+    if (m_runningVMs.isEmpty()) {
+        m_watchTimer->stop();
+    }
+}
+
+void QemuManager::attachVM(const QString &vmName, qint64 pid, const QString &state)
+{
+    RunningVM entry;
+    entry.pid = pid;
+    entry.state = state;
+    entry.qmp = new QmpClient(this);
+    
+    connect(entry.qmp, &QmpClient::ready, this, [this, vmName]() {
+        if (m_runningVMs.contains(vmName)) {
+            m_runningVMs[vmName].qmpVerified = true;
+            applyPinning(vmName);
+            if (m_runningVMs[vmName].restoring) {
+                startIncoming(vmName);
+            }
+            
+            // El invitado sólo publica estadísticas de memoria si se le pide un intervalo
+            if (m_runningVMs[vmName].balloon) {
+                QJsonObject arguments;
+                arguments["path"] = balloonPath();
+                arguments["property"] = "guest-stats-polling-interval";
+                arguments["value"] = BalloonStatsIntervalSecs;
+                m_runningVMs[vmName].qmp->execute("qom-set", arguments, nullptr);
+                m_runningVMs[vmName].balloon = false;
+            }
+            
+            emit qmpReady(vmName);
+        }
+    });
+    connect(entry.qmp, &QmpClient::eventReceived, this,
+            [this, vmName](const QString &event, const QJsonObject &data) {
+        handleQmpEvent(vmName, event, data);
+    });
+    connect(entry.qmp, &QmpClient::disconnected, this, [this, vmName]() {
+        // QEMU cierra el socket al terminar; confirmar con el proceso
+        if (m_runningVMs.contains(vmName) && !isQemuProcess(m_runningVMs[vmName].pid, vmName)) {
+            handleVMExit(vmName);
+        }
+    });
+    
+    m_runningVMs[vmName] = entry;
+    
+    if (QFileInfo::exists(qmpSocketPath(vmName))) {
+        entry.qmp->connectToServer(qmpSocketPath(vmName));
     }
     
-    qDebug() << "Error en QemuManager:" << errorString;
-    emit errorOccurred(errorString);
+    if (!m_watchTimer->isActive()) {
+        m_watchTimer->start();
+    }
 }
 
-void QemuManager::onProcessOutput()
+void QemuManager::handleVMExit(const QString &vmName)
 {
-    QProcess *process = qobject_cast<QProcess*>(sender());
-    if (!process) return;
+    RunningVM entry = m_runningVMs.take(vmName);
+    entry.qmp->deleteLater();
+    
+    // Restauración fallida (p. ej. la configuración cambió desde que se
+    // guardó): apartar el estado para que el próximo arranque sea en frío
+    if (entry.restoring && hasSavedState(vmName)) {
+        QString failedPath = savedStatePath(vmName) + ".failed";
+        QFile::remove(failedPath);
+        QFile::rename(savedStatePath(vmName), failedPath);
+        removeSavedState(vmName);
+        emit errorOccurred(tr("No se pudo restaurar el estado guardado de la VM '%1'. Se ha conservado en %2 "
+                              "y el próximo arranque será en frío").arg(vmName, failedPath));
+    }
     
-    QString vmName;
-    for (auto it = m_runningVMs.begin(); it != m_runningVMs.end(); ++it) {
-        if (it.value() == process) {
-            vmName = it.key();
-            break;
+    // Sin QMP nunca verificado, QEMU terminó durante el arranque
+    int exitCode = 0;
+    if (!entry.qmpVerified) {
+        exitCode = 1;
+        QString errorMsg = tr("QEMU terminó durante el arranque de la VM '%1'").arg(vmName);
+        QString details = readLogTail(vmName);
+        if (!details.isEmpty()) {
+            errorMsg += "\nDetalles: " + details;
+            qDebug() << "QEMU stderr:" << details;
         }
+        emit errorOccurred(errorMsg);
     }
     
-    if (!vmName.isEmpty()) {
-        QString output = process->readAllStandardOutput();
-        emit outputReceived(vmName, output);
+    cleanupRuntimeFiles(vmName);
+    qDebug() << "QemuManager: VM terminada:" << vmName;
+    emit processFinished(vmName, exitCode);
+}
+
+void QemuManager::handleQmpEvent(const QString &vmName, const QString &event, const QJsonObject &data)
+{
+    qDebug() << "QemuManager: Evento QMP" << vmName << event << data;
+    
+    if (event == "STOP") {
+        setRunState(vmName, "paused");
+    } else if (event == "RESUME") {
+        finishRestore(vmName, "running");
+        setRunState(vmName, "running");
+    } else if (event == "VSERPORT_CHANGE" && data.value("id").toString() == "qga0port") {
+        // qemu-ga abre el puerto al arrancar y lo cierra al pararse
+        bool open = data.value("open").toBool();
+        if (m_runningVMs.contains(vmName) && m_runningVMs[vmName].guestAgent != open) {
+            m_runningVMs[vmName].guestAgent = open;
+            emit guestAgentChanged(vmName, open);
+        }
     }
 }
 
-QStringList QemuManager::buildQemuCommand(VirtualMachine *vm)
+void QemuManager::startIncoming(const QString &vmName)
+{
+    RunningVM &entry = m_runningVMs[vmName];
+    if (entry.restoreFormat != "mapped-ram") {
+        checkRestore(vmName);
+        return;
+    }
+    
+    // QEMU espera con -incoming defer: mismas capacidades y canales que al guardar
+    QJsonObject capabilities;
+    capabilities["capabilities"] = mappedRamCapabilities(true);
+    entry.qmp->execute("migrate-set-capabilities", capabilities, nullptr);
+    QJsonObject parameters;
+    parameters["multifd-channels"] = entry.restoreChannels;
+    entry.qmp->execute("migrate-set-parameters", parameters, nullptr);
+    
+    QJsonObject arguments;
+    arguments["uri"] = stateRestoreUri(savedStatePath(vmName), entry.restoreFormat);
+    entry.qmp->execute("migrate-incoming", arguments, [this, vmName](const QJsonObject &reply) {
+        if (reply.contains("error")) {
+            // Sin nada que cargar QEMU esperaría para siempre; al salir se aparta el estado
+            qDebug() << "QemuManager: migrate-incoming falló para" << vmName << QmpClient::errorString(reply);
+            requestStop(vmName);
+            return;
+        }
+        checkRestore(vmName);
+    });
+}
+
+void QemuManager::checkRestore(const QString &vmName)
+{
+    if (!m_runningVMs.contains(vmName) || !m_runningVMs[vmName].restoring) {
+        return;
+    }
+    
+    // Un invitado guardado en pausa no emite RESUME: la carga termina cuando
+    // QEMU deja el estado "inmigrate"
+    m_runningVMs[vmName].qmp->execute("query-status", QJsonObject(), [this, vmName](const QJsonObject &reply) {
+        QString status = reply.value("return").toObject().value("status").toString();
+        if (reply.contains("error") || status == "inmigrate") {
+            QTimer::singleShot(200, this, [this, vmName]() {
+                checkRestore(vmName);
+            });
+            return;
+        }
+        finishRestore(vmName, stateFromQmpStatus(status));
+    });
+}
+
+void QemuManager::finishRestore(const QString &vmName, const QString &state)
+{
+    if (!m_runningVMs.contains(vmName) || !m_runningVMs[vmName].restoring) {
+        return;
+    }
+    
+    // Tiempo desde el lanzamiento de QEMU hasta el invitado listo
+    RunningVM &entry = m_runningVMs[vmName];
+    entry.restoring = false;
+    QJsonObject info = savedStateInfo(vmName);
+    qint64 msecs = qMax<qint64>(1, QDateTime::currentMSecsSinceEpoch() - entry.restoreStartMs);
+    qint64 ramBytes = info.value("ramBytes").toInteger();
+    QJsonObject stats;
+    stats["format"] = entry.restoreFormat;
+    stats["channels"] = entry.restoreChannels;
+    stats["ramBytes"] = ramBytes;
+    stats["fileBytes"] = info.value("fileBytes").toInteger();
+    stats["msecs"] = msecs;
+    stats["mbps"] = ramBytes / (1024.0 * 1024.0) / (msecs / 1000.0);
+    stats["finished"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    recordSaveStateStats(vmName, "restore", stats);
+    removeSavedState(vmName);
+    qDebug() << "QemuManager: Estado restaurado:" << vmName << state << entry.restoreFormat
+             << msecs << "ms" << stats.value("mbps").toDouble() << "MB/s";
+    
+    // Con mapped-ram activo fallarían savevm y los guardados por exec: o zstd
+    // posteriores; la migración entrante ya terminó, así que se pueden quitar
+    if (entry.restoreFormat == "mapped-ram") {
+        QJsonObject capabilities;
+        capabilities["capabilities"] = mappedRamCapabilities(false);
+        entry.qmp->execute("migrate-set-capabilities", capabilities, [vmName](const QJsonObject &reply) {
+            if (reply.contains("error")) {
+                qWarning() << "QemuManager: no se pudo desactivar mapped-ram en" << vmName
+                           << QmpClient::errorString(reply);
+            }
+        });
+    }
+    
+    // Un invitado que se paró sólo para guardarlo llega en pausa: se reanuda
+    // y el evento RESUME fija el estado
+    if (state == "paused" && info.value("resume").toBool()) {
+        entry.qmp->execute("cont", QJsonObject(), nullptr);
+        return;
+    }
+    setRunState(vmName, state);
+}
+
+void QemuManager::setRunState(const QString &vmName, const QString &state)
+{
+    if (!m_runningVMs.contains(vmName) || m_runningVMs[vmName].state == state) {
+        return;
+    }
+    m_runningVMs[vmName].state = state;
+    emit vmStateChanged(vmName, state);
+}
+
+void QemuManager::cleanupRuntimeFiles(const QString &vmName)
+{
+    QFile::remove(pidFilePath(vmName));
+    QFile::remove(qmpSocketPath(vmName));
+    QFile::remove(guestAgentSocketPath(vmName));
+    
+    // QEMU borra sus capas temporales al cerrar los discos, salvo si lo matan
+    QFile marker(ephemeralMarkerPath(vmName));
+    if (marker.open(QIODevice::ReadOnly)) {
+        QString scratch = QFile::decodeName(marker.readAll());
+        marker.close();
+        if (!scratch.isEmpty()) {
+            QDir(scratch).removeRecursively();
+        }
+        marker.remove();
+    }
+}
+
+QString QemuManager::readLogTail(const QString &vmName)
+{
+    QFile log(qemuLogPath(vmName));
+    if (!log.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    
+    const qint64 maxBytes = 4096;
+    if (log.size() > maxBytes) {
+        log.seek(log.size() - maxBytes);
+    }
+    return QString::fromUtf8(log.readAll()).trimmed();
+}
+
+qint64 QemuManager::readPidFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    return file.readAll().trimmed().toLongLong();
+}
+
+bool QemuManager::isQemuProcess(qint64 pid, const QString &vmName)
+{
+    if (pid <= 0) {
+        return false;
+    }
+    
+    // El socket QMP en la línea de comandos descarta PIDs reutilizados
+    QFile cmdline(QString("/proc/%1/cmdline").arg(pid));
+    if (!cmdline.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    return cmdline.readAll().contains(qmpSocketPath(vmName).toLocal8Bit());
+}
+
+QemuManager::CpuPlacement QemuManager::planPlacement(VirtualMachine *vm) const
+{
+    CpuPlacement placement;
+    QString policy = vm->getCPUPinning();
+    if (!cpuPinningPolicies().contains(policy) || policy == "none") {
+        return placement;
+    }
+    
+    int vcpus = qMax(1, vm->getCPUCount());
+    const QList<HostInfo::NumaNode> nodes = HostInfo::numaNodes();
+    if (nodes.first().cpus.isEmpty()) {
+        return placement;
+    }
+    QMap<int, int> load = hostCpuLoad();
+    
+    // CPU con menos vCPUs fijadas, contando las ya elegidas para esta VM
+    auto pickCpu = [&load](const QList<int> &candidates) {
+        int best = candidates.first();
+        for (int cpu : candidates) {
+            if (load.value(cpu) < load.value(best)) {
+                best = cpu;
+            }
+        }
+        load[best]++;
+        return best;
+    };
+    auto nodeLoad = [&load](const HostInfo::NumaNode &node) {
+        int pinned = 0;
+        for (int cpu : node.cpus) {
+            pinned += load.value(cpu);
+        }
+        return double(pinned) / node.cpus.size();
+    };
+    
+    QList<HostInfo::NumaNode> used;
+    if (policy == "manual") {
+        QList<int> cpus = HostInfo::parseCpuList(vm->getCPUSet());
+        if (cpus.isEmpty()) {
+            qWarning() << "QemuManager: Lista de CPUs inválida para" << vm->getName() << vm->getCPUSet();
+            return placement;
+        }
+        for (int i = 0; i < vcpus; ++i) {
+            placement.hostCpus.append(pickCpu(cpus));
+        }
+        placement.emulatorCpus = cpus;
+        for (const HostInfo::NumaNode &node : nodes) {
+            for (int cpu : cpus) {
+                if (node.cpus.contains(cpu)) {
+                    used.append(node);
+                    break;
+                }
+            }
+        }
+    } else if (policy == "pack") {
+        // Un solo nodo: el menos cargado entre los que tienen memoria libre y CPUs suficientes
+        qint64 memoryKB = qint64(vm->getMemoryMB()) * 1024;
+        auto fits = [memoryKB, vcpus](const HostInfo::NumaNode &node) {
+            return node.memFreeKB >= memoryKB && node.cpus.size() >= vcpus;
+        };
+        int best = 0;
+        for (int i = 1; i < nodes.size(); ++i) {
+            if ((fits(nodes[i]) && !fits(nodes[best]))
+                || (fits(nodes[i]) == fits(nodes[best]) && nodeLoad(nodes[i]) < nodeLoad(nodes[best]))) {
+                best = i;
+            }
+        }
+        for (int i = 0; i < vcpus; ++i) {
+            placement.hostCpus.append(pickCpu(nodes[best].cpus));
+        }
+        placement.emulatorCpus = nodes[best].cpus;
+        used.append(nodes[best]);
+    } else {
+        // spread: vCPUs repartidas por turnos, empezando por el nodo menos cargado
+        QList<HostInfo::NumaNode> ordered = nodes;
+        QMap<int, double> initialLoad;
+        for (const HostInfo::NumaNode &node : nodes) {
+            initialLoad[node.id] = nodeLoad(node);
+        }
+        std::stable_sort(ordered.begin(), ordered.end(),
+                         [&initialLoad](const HostInfo::NumaNode &a, const HostInfo::NumaNode &b) {
+            return initialLoad[a.id] < initialLoad[b.id];
+        });
+        
+        used = ordered.mid(0, qMin(vcpus, int(ordered.size())));
+        for (int i = 0; i < vcpus; ++i) {
+            placement.hostCpus.append(pickCpu(used[i % used.size()].cpus));
+        }
+        for (const HostInfo::NumaNode &node : used) {
+            placement.emulatorCpus.append(node.cpus);
+        }
+    }
+    
+    // Con un solo nodo en el anfitrión no hay memoria que ubicar
+    if (nodes.size() > 1) {
+        for (const HostInfo::NumaNode &node : used) {
+            placement.hostNodes.append(node.id);
+        }
+        placement.memoryPolicy = placement.hostNodes.size() > 1 ? "interleave" : "bind";
+    }
+    
+    qDebug() << "QemuManager: Ubicación de" << vm->getName() << policy
+             << "vCPUs:" << placement.hostCpus << "nodos:" << placement.hostNodes;
+    return placement;
+}
+
+QMap<int, int> QemuManager::hostCpuLoad() const
+{
+    QMap<int, int> load;
+    for (const RunningVM &entry : m_runningVMs) {
+        for (int cpu : entry.hostCpus) {
+            load[cpu]++;
+        }
+    }
+    return load;
+}
+
+void QemuManager::applyPinning(const QString &vmName)
+{
+    RunningVM &entry = m_runningVMs[vmName];
+    if (entry.pinned || entry.hostCpus.isEmpty()) {
+        return;
+    }
+    entry.pinned = true;
+    
+    // Con debug-threads=on los hilos se llaman "CPU 0/KVM", "IO iothread0"...
+    static const QRegularExpression vcpuThread(R"(^CPU (\d+)/)");
+    for (const auto &thread : qemuThreads(entry.pid)) {
+        QRegularExpressionMatch match = vcpuThread.match(thread.second);
+        QList<int> cpus;
+        if (match.hasMatch()) {
+            cpus << entry.hostCpus[match.captured(1).toInt() % entry.hostCpus.size()];
+        } else {
+            // Hilo principal, IOThreads y trabajadores: en los nodos de la VM
+            cpus = entry.emulatorCpus;
+        }
+        
+        if (!cpus.isEmpty() && !setThreadAffinity(thread.first, cpus)) {
+            qWarning() << "QemuManager: No se pudo fijar el hilo" << thread.second << "de" << vmName;
+        }
+    }
+    
+    qDebug() << "QemuManager: vCPUs de" << vmName << "fijadas a" << entry.hostCpus;
+}
+
+QList<QPair<qint64, QString>> QemuManager::qemuThreads(qint64 pid)
+{
+    QList<QPair<qint64, QString>> threads;
+    QDir tasks(QString("/proc/%1/task").arg(pid));
+    for (const QString &tid : tasks.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QFile comm(tasks.filePath(tid + "/comm"));
+        if (comm.open(QIODevice::ReadOnly)) {
+            threads.append(qMakePair(tid.toLongLong(), QString::fromUtf8(comm.readAll()).trimmed()));
+        }
+    }
+    return threads;
+}
+
+QList<int> QemuManager::pinnedVcpuCpus(qint64 pid)
+{
+    static const QRegularExpression vcpuThread(R"(^CPU (\d+)/)");
+    QMap<int, int> vcpuCpus;
+    
+    for (const auto &thread : qemuThreads(pid)) {
+        QRegularExpressionMatch match = vcpuThread.match(thread.second);
+        if (!match.hasMatch()) {
+            continue;
+        }
+        
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(pid_t(thread.first), sizeof(set), &set) != 0 || CPU_COUNT(&set) != 1) {
+            return QList<int>();    // VM sin pinning
+        }
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                vcpuCpus[match.captured(1).toInt()] = cpu;
+                break;
+            }
+        }
+    }
+    
+    return vcpuCpus.values();
+}
+
+bool QemuManager::setThreadAffinity(qint64 tid, const QList<int> &cpus)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return sched_setaffinity(pid_t(tid), sizeof(set), &set) == 0;
+}
+
+bool QemuManager::hasMemoryBalloon(VirtualMachine *vm)
+{
+    // El balón devuelve páginas de 4 KB: con páginas enormes no liberaría nada
+    QString profile = vm->getDeviceProfile();
+    return vm->isMemoryBalloonEnabled() && (profile == "virtio" || profile == "q35-virtio")
+           && vm->getMemoryBacking() != "hugepages";
+}
+
+bool QemuManager::hasGuestAgentChannel(VirtualMachine *vm)
+{
+    // virtio-serial sólo existe en los perfiles paravirtualizados
+    QString profile = vm->getDeviceProfile();
+    return profile == "virtio" || profile == "q35-virtio";
+}
+
+QStringList QemuManager::memoryBackings()
+{
+    return {"anonymous", "memfd", "hugepages"};
+}
+
+bool QemuManager::checkHugePages(int memoryMB, int sizeKB, QString *error, const QList<int> &hostNodes)
+{
+    qint64 memoryKB = qint64(memoryMB) * 1024;
+    QString pageSize = sizeKB >= 1024 * 1024 ? QString("%1 GB").arg(sizeKB / (1024 * 1024))
+                                             : QString("%1 MB").arg(sizeKB / 1024);
+    if (sizeKB <= 0 || memoryKB % sizeKB != 0) {
+        if (error) {
+            *error = tr("La memoria debe ser múltiplo del tamaño de página (%1)").arg(pageSize);
+        }
+        return false;
+    }
+    
+    // Con la memoria ligada a nodos NUMA sólo cuentan las páginas de esos nodos
+    qint64 freePages = 0;
+    if (hostNodes.isEmpty()) {
+        freePages = HostInfo::hugePagePool(sizeKB).free;
+    } else {
+        for (int node : hostNodes) {
+            freePages += HostInfo::hugePagePool(sizeKB, node).free;
+        }
+    }
+    
+    qint64 needed = memoryKB / sizeKB;
+    if (freePages < needed) {
+        if (error) {
+            *error = tr("Se necesitan %1 páginas enormes de %2 y sólo hay %3 libres "
+                        "(/sys/kernel/mm/hugepages/hugepages-%4kB/nr_hugepages)")
+                     .arg(needed).arg(pageSize).arg(freePages).arg(sizeKB);
+        }
+        return false;
+    }
+    
+    return true;
+}
+
+QStringList QemuManager::cpuPinningPolicies()
+{
+    return {"none", "spread", "pack", "manual"};
+}
+
+QStringList QemuManager::deviceProfiles()
+{
+    return QStringList() << "legacy" << "virtio" << "q35-virtio";
+}
+
+QStringList QemuManager::diskControllers()
+{
+    return QStringList() << "virtio-blk" << "virtio-scsi";
+}
+
+VirtualMachine::DiskTuning QemuManager::defaultDiskTuning(const QString &diskPath, const QString &deviceProfile)
+{
+    VirtualMachine::DiskTuning tuning;
+    
+    // legacy conserva los valores de QEMU, los de las VMs ya instaladas
+    if (deviceProfile == "legacy") {
+        tuning.cache = "writeback";
+        tuning.aio = "threads";
+        tuning.discard = false;
+        tuning.detectZeroes = "off";
+        tuning.iothread = false;
+        tuning.queues = 0;
+        return tuning;
+    }
+    
+    // El archivo puede no existir aún: se mira el sistema de archivos del directorio
+    QStorageInfo storage(QFileInfo(diskPath).absolutePath());
+    QString fsType = QString::fromLatin1(storage.fileSystemType());
+    
+    // O_DIRECT (cache=none) sólo es fiable en sistemas de archivos locales;
+    // tmpfs, ZFS antiguos, FUSE y los de red lo rechazan o lo emulan
+    static const QStringList directIoFilesystems = {"ext4", "xfs", "btrfs", "f2fs"};
+    if (storage.isValid() && directIoFilesystems.contains(fsType)) {
+        tuning.cache = "none";
+        tuning.aio = "native";
+    } else {
+        tuning.cache = "writeback";
+        tuning.aio = "threads";
+    }
+    
+    // Devolver al anfitrión los bloques que el invitado libera o pone a cero
+    tuning.discard = true;
+    tuning.detectZeroes = "unmap";
+    tuning.iothread = true;
+    tuning.queues = 0;
+    
+    return tuning;
+}
+
+QStringList QemuManager::diskCacheModes()
+{
+    return QStringList() << "none" << "writeback" << "unsafe";
+}
+
+QStringList QemuManager::diskAioModes()
+{
+    return QStringList() << "threads" << "native" << "io_uring";
+}
+
+QStringList QemuManager::buildQemuCommand(VirtualMachine *vm, const CpuPlacement &placement)
 {
     QStringList args;
     
+    // legacy: IDE, e1000, VGA estándar y AC97 (no requiere drivers en el invitado)
+    // virtio / q35-virtio: dispositivos paravirtualizados sobre i440FX o Q35
+    QString profile = vm->getDeviceProfile();
+    bool paravirt = profile == "virtio" || profile == "q35-virtio";
+    bool virtioScsi = paravirt && vm->getDiskController() == "virtio-scsi";
+    
     // Configuración básica - Try KVM first, fallback to TCG
-    args << "-machine" << "pc-i440fx-2.12,accel=kvm:tcg";
-    args << "-cpu" << "qemu64";
+    QString machine;
+    if (profile == "q35-virtio") {
+        machine = "q35,accel=kvm:tcg";
+    } else if (profile == "virtio") {
+        machine = "pc,accel=kvm:tcg";
+    } else {
+        machine = "pc-i440fx-2.12,accel=kvm:tcg";
+    }
+    // mem-merge marca la RAM del invitado (también la de los memory-backend)
+    // con MADV_MERGEABLE para que KSM pueda fusionarla; las páginas enormes
+    // nunca se fusionan
+    bool mergeable = vm->isMemoryMergeable() && vm->getMemoryBacking() != "hugepages";
+    machine += mergeable ? ",mem-merge=on" : ",mem-merge=off";
+    // La RAM sale de un memory-backend propio ("mem0") si hace falta alguna
+    // de sus opciones. Sin nodos NUMA que fijar se enlaza con la máquina; con
+    // ellos, con un nodo NUMA del invitado (más abajo)
+    QString backing = vm->getMemoryBacking();
+    bool numaBinding = !placement.hostNodes.isEmpty();
+    bool memoryBackend = backing == "memfd" || backing == "hugepages" || vm->isMemoryPrealloc()
+                         || vm->isMemoryShared() || numaBinding;
+    if (memoryBackend && !numaBinding) {
+        machine += ",memory-backend=mem0";
+    }
+    args << "-machine" << machine;
+    args << "-cpu" << cpuModelArgument(vm->getCPUModel());
     
     // CPUs dinámicos
     int cpuCount = vm->getCPUCount();
     if (cpuCount < 1) cpuCount = 1;
-    args << "-smp" << QString::number(cpuCount);
+    if (vm->hasCPUTopology()) {
+        QString smp = QString("%1,sockets=%2,cores=%3,threads=%4")
+                      .arg(cpuCount).arg(vm->getCPUSockets()).arg(vm->getCPUCores()).arg(vm->getCPUThreads());
+        if (vm->getCPUDies() > 1) {
+            smp += QString(",dies=%1").arg(vm->getCPUDies());
+        }
+        args << "-smp" << smp;
+    } else {
+        args << "-smp" << QString::number(cpuCount);
+    }
     
     // Memoria
     args << "-m" << QString::number(vm->getMemoryMB());
+    if (memoryBackend) {
+        // memfd con hugetlb=on usa páginas enormes sin montar hugetlbfs
+        QStringList memory;
+        memory << QString("%1,id=mem0,size=%2M")
+                  .arg(backing == "anonymous" ? "memory-backend-ram" : "memory-backend-memfd")
+                  .arg(vm->getMemoryMB());
+        if (backing == "hugepages") {
+            memory << "hugetlb=on" << QString("hugetlbsize=%1K").arg(vm->getHugePageSizeKB());
+        }
+        if (vm->isMemoryShared()) {
+            memory << "share=on";
+        }
+        if (vm->isMemoryPrealloc()) {
+            // Reserva toda la RAM al arrancar, en paralelo
+            int threads = qBound(1, cpuCount, qMax(1, HostInfo::cpuTopology().logicalCpus()));
+            memory << "prealloc=on" << QString("prealloc-threads=%1").arg(threads);
+        }
+        
+        // Memoria del invitado en los mismos nodos NUMA que sus vCPUs. -object
+        // se lee como keyval: una lista se escribe host-nodes.0=..,host-nodes.1=..
+        for (int i = 0; i < placement.hostNodes.size(); ++i) {
+            memory << QString("host-nodes.%1=%2").arg(i).arg(placement.hostNodes.at(i));
+        }
+        if (numaBinding) {
+            memory << "policy=" + placement.memoryPolicy;
+        }
+        
+        args << "-object" << memory.join(',');
+        if (numaBinding) {
+            args << "-numa" << QString("node,nodeid=0,cpus=0-%1,memdev=mem0").arg(cpuCount - 1);
+        }
+    }
     
     // Display
-    args << "-vga" << "std";
+    if (paravirt) {
+        args << "-vga" << "none";
+        args << "-device" << QString("virtio-vga,max_outputs=%1").arg(qMax(1, vm->getMonitorCount()));
+        // Tableta absoluta: evita capturar el ratón y el coste de emular PS/2
+        args << "-device" << "virtio-tablet-pci";
+    } else {
+        args << "-vga" << "std";
+    }
     args << "-display" << "gtk,show-cursor=on";
     
     // Audio
     args << "-audiodev" << "pa,id=audio0";
-    args << "-device" << "AC97,audiodev=audio0";
+    if (paravirt) {
+        args << "-device" << "intel-hda";
+        args << "-device" << "hda-duplex,audiodev=audio0";
+    } else {
+        args << "-device" << "AC97,audiodev=audio0";
+    }
     
     // Configurar discos duros
     QStringList hardDisks = vm->getHardDisks();
     for (int i = 0; i < hardDisks.size(); ++i) {
         const QString &diskPath = hardDisks[i];
-        if (QFileInfo::exists(diskPath)) {
-            args << "-drive" << QString("file=%1,format=qcow2,if=ide,index=%2,media=disk").arg(diskPath).arg(i);
+        if (!QFileInfo::exists(diskPath)) {
+            continue;
+        }
+        
+        VirtualMachine::DiskTuning tuning = vm->hasDiskTuning(diskPath)
+            ? vm->getDiskTuning(diskPath) : defaultDiskTuning(diskPath, vm->getDeviceProfile());
+        
+        // La capa temporal hereda la caché y tmpfs puede no admitir O_DIRECT;
+        // lo escrito se descarta al apagar, así que la caché del anfitrión basta
+        if (vm->isEphemeral() && (tuning.cache == "none" || tuning.cache == "directsync")) {
+            tuning.cache = "writeback";
+        }
+        
+        // aio=native exige O_DIRECT; con caché del anfitrión QEMU se niega a arrancar
+        if (tuning.aio == "native" && tuning.cache != "none") {
+            qWarning() << "QemuManager: aio=native requiere cache=none, usando threads para" << diskPath;
+            tuning.aio = "threads";
+        }
+        
+        QString ioOptions = QString("cache=%1,aio=%2,discard=%3,detect-zeroes=%4")
+                            .arg(tuning.cache, tuning.aio,
+                                 QString(tuning.discard ? "unmap" : "ignore"),
+                                 // detect-zeroes=unmap sólo es válido con discard=unmap
+                                 tuning.detectZeroes == "unmap" && !tuning.discard ? QString("on") : tuning.detectZeroes);
+        if (vm->isEphemeral()) {
+            // Las escrituras van a una capa qcow2 temporal en TMPDIR; el disco sólo se lee
+            ioOptions += ",snapshot=on";
+        }
+        
+        // Formato guardado al añadir el disco; la cabecera sólo se consulta
+        // en configuraciones antiguas (nunca se deja adivinar a QEMU)
+        DiskImageProbe::Info image = DiskImageProbe::probe(diskPath);
+        QString format = vm->getDiskFormat(diskPath);
+        if (format.isEmpty()) {
+            format = image.valid ? image.format : "raw";
+        }
+        
+        QString formatOptions = QString("format=%1").arg(format);
+        if (format == "qcow2" && image.format == "qcow2") {
+            // Caché L2 para toda la imagen: evita lecturas de metadatos en E/S aleatoria
+            qint64 l2CacheSize = DiskImageProbe::qcow2L2CacheSize(image);
+            if (l2CacheSize > 0) {
+                formatOptions += QString(",l2-cache-size=%1,cache-clean-interval=600").arg(l2CacheSize);
+            }
+        }
+        
+        if (!paravirt) {
+            args << "-drive" << QString("file=%1,%2,if=ide,index=%3,media=disk,%4")
+                                .arg(escapeOptionValue(diskPath), formatOptions).arg(i).arg(ioOptions);
+            continue;
+        }
+        
+        QString driveId = QString("disk%1").arg(i);
+        args << "-drive" << QString("file=%1,%2,if=none,id=%3,%4")
+                            .arg(escapeOptionValue(diskPath), formatOptions, driveId, ioOptions);
+        
+        // Un IOThread por disco saca la emulación del bucle principal
+        QString iothreadOption;
+        if (tuning.iothread) {
+            args << "-object" << QString("iothread,id=iothread%1").arg(i);
+            iothreadOption = QString(",iothread=iothread%1").arg(i);
+        }
+        int queues = tuning.queues > 0 ? tuning.queues : cpuCount;
+        
+        if (virtioScsi) {
+            // El IOThread pertenece al controlador: uno por disco
+            args << "-device" << QString("virtio-scsi-pci,id=scsi%1,num_queues=%2%3").arg(i).arg(queues).arg(iothreadOption);
+            args << "-device" << QString("scsi-hd,bus=scsi%1.0,drive=%2").arg(i).arg(driveId);
+        } else {
+            args << "-device" << QString("virtio-blk-pci,drive=%1,num-queues=%2%3").arg(driveId).arg(queues).arg(iothreadOption);
         }
     }
     
@@ -465,13 +2052,36 @@ QStringList QemuManager::buildQemuCommand(VirtualMachine *vm)
     
     // Red (NAT por defecto)
     args << "-netdev" << "user,id=net0";
-    args << "-device" << "e1000,netdev=net0";
+    QString nic = paravirt ? "virtio-net-pci,netdev=net0" : "e1000,netdev=net0";
+    if (!vm->getMacAddress().isEmpty()) {
+        nic += ",mac=" + vm->getMacAddress();
+    }
+    args << "-device" << nic;
+    
+    // Balón: el invitado devuelve al anfitrión las páginas que libera
+    // (free-page-reporting) y cede memoria bajo demanda (comando QMP balloon)
+    if (hasMemoryBalloon(vm)) {
+        args << "-device" << "virtio-balloon-pci,id=balloon0,deflate-on-oom=on,free-page-reporting=on";
+    }
+    
+    // Canal del agente de invitado: QEMU avisa (VSERPORT_CHANGE) cuando
+    // qemu-ga abre el puerto, es decir, cuando el sistema ya ha arrancado
+    if (hasGuestAgentChannel(vm)) {
+        args << "-chardev" << QString("socket,id=qga0,path=%1,server=on,wait=off")
+                                  .arg(escapeOptionValue(guestAgentSocketPath(vm->getName())));
+        args << "-device" << "virtio-serial-pci,id=serial0";
+        args << "-device" << QString("virtserialport,bus=serial0.0,chardev=qga0,id=qga0port,name=%1")
+                                  .arg(guestAgentPortName());
+    }
     
-    // Monitor (para control)
-    args << "-monitor" << "stdio";
+    // Control por QMP y registro de la consola serie (el proceso no tiene terminal)
+    args << "-pidfile" << pidFilePath(vm->getName());
+    args << "-qmp" << QString("unix:%1,server=on,wait=off").arg(escapeOptionValue(qmpSocketPath(vm->getName())));
+    args << "-serial" << QString("file:%1").arg(escapeOptionValue(serialLogPath(vm->getName())));
     
     // Nombre de la VM
-    args << "-name" << vm->getName();
+    // debug-threads=on nombra los hilos ("CPU 0/KVM") para poder fijarlos
+    args << "-name" << QString("guest=%1,debug-threads=on").arg(escapeOptionValue(vm->getName()));
     
     // UUID
     if (!vm->getUUID().isEmpty()) {
@@ -532,6 +2142,42 @@ bool QemuManager::validateDiskPath(const QString &path)
     return true;
 }
 
+bool QemuManager::runSnapshotCommand(const QStringList &arguments, const QString &errorMessage)
+{
+    QString path = arguments.last();
+    if (!QFileInfo::exists(path)) {
+        emit errorOccurred(tr("El archivo de disco no existe: %1").arg(path));
+        return false;
+    }
+    
+    // Crear o aplicar una instantánea con mucha memoria guardada puede
+    // tardar minutos; sin límite para no dar por buena una a medias
+    QProcess process;
+    process.start("qemu-img", arguments);
+    QString error = waitForImgProcess(process, -1);
+    
+    if (!error.isEmpty()) {
+        emit errorOccurred(QString("%1: %2").arg(errorMessage, error));
+        return false;
+    }
+    
+    return true;
+}
+
+QString QemuManager::escapeOptionValue(const QString &value)
+{
+    // QEMU separa las subopciones por comas; una coma literal se escribe ",,"
+    QString escaped = value;
+    return escaped.replace(",", ",,");
+}
+
+QString QemuManager::shellQuote(const QString &value)
+{
+    // Las URIs exec: de QEMU pasan por /bin/sh
+    QString quoted = value;
+    return "'" + quoted.replace("'", "'\\''") + "'";
+}
+
 QString QemuManager::formatSizeString(qint64 sizeGB)
 {
     return QString("%1G").arg(sizeGB);
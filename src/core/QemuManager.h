@@ -7,8 +7,18 @@
 #include <QStringList>
 #include <QDir>
 #include <QFileInfo>
+#include <QMap>
+#include <QList>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonValue>
+#include <QSharedPointer>
+#include <functional>
 
-class VirtualMachine;
+#include "VirtualMachine.h"
+
+class QmpClient;
+class QTimer;
 
 class QemuManager : public QObject
 {
@@ -16,47 +26,268 @@ class QemuManager : public QObject
 
 public:
     explicit QemuManager(QObject *parent = nullptr);
+    ~QemuManager();
     
     // Disk management
     bool createDisk(const QString &path, const QString &format, qint64 sizeGB, bool preallocated = false);
+    // Same as createDisk without blocking the event loop; errors are also
+    // reported through errorOccurred
+    void createDiskAsync(const QString &path, const QString &format, qint64 sizeGB, bool preallocated,
+                         std::function<void(bool ok)> callback);
     bool resizeDisk(const QString &path, qint64 newSizeGB);
-    bool convertDisk(const QString &sourcePath, const QString &destPath, const QString &destFormat);
-    bool copyDisk(const QString &sourcePath, const QString &destPath);
+    // With a snapshot tag the copy holds the disk as it was in that internal
+    // snapshot; the source may then be in use by a running VM
+    bool convertDisk(const QString &sourcePath, const QString &destPath, const QString &destFormat,
+                     const QString &snapshot = QString());
+    bool copyDisk(const QString &sourcePath, const QString &destPath, const QString &snapshot = QString());
+    // Non-blocking copyDisk; the copy has no time limit
+    void copyDiskAsync(const QString &sourcePath, const QString &destPath, const QString &snapshot,
+                       std::function<void(bool ok)> callback);
+    // Thin qcow2 image whose unwritten clusters are read from basePath; the
+    // base must not change while the overlay exists
+    bool createOverlayDisk(const QString &basePath, const QString &overlayPath);
+    // Many overlays (base, overlay) with up to `parallel` qemu-img running at
+    // once; returns the overlays that could not be created
+    QStringList createOverlayDisks(const QList<QPair<QString, QString>> &overlays, int parallel);
+    void createOverlayDisksAsync(const QList<QPair<QString, QString>> &overlays, int parallel,
+                                 std::function<void(const QStringList &failed)> callback);
     qint64 getDiskSize(const QString &path);
     QString getDiskFormat(const QString &path);
     
-    // VM execution  
+    // Internal snapshots (qcow2)
+    bool createDiskSnapshot(const QString &path, const QString &tag);
+    bool deleteDiskSnapshot(const QString &path, const QString &tag);
+    bool applyDiskSnapshot(const QString &path, const QString &tag);
+    QStringList listDiskSnapshots(const QString &path);
+    
+    // External snapshots: a qcow2 overlay on top of each disk. Long chains
+    // make every read of unallocated data walk the backing images
+    struct OverlayPolicy {
+        bool useSnapshotFolder = false;     // general/snapshotFolder/<vm> instead of next to the disk
+        int chainWarningDepth = 4;          // overlays above the base image before warning
+    };
+    static OverlayPolicy loadOverlayPolicy();
+    static void saveOverlayPolicy(const OverlayPolicy &policy);
+    static QString snapshotFolder();
+    // Folder for a VM's new overlays; empty means next to each disk
+    static QString overlayDirectory(const QString &vmName);
+    // "<base image name>-<tag>.qcow2" in directory (or next to the disk)
+    static QString overlayPath(const QString &diskPath, const QString &tag, const QString &directory);
+    
+    // Ephemeral runs (VirtualMachine::isEphemeral): QEMU keeps the guest's
+    // writes in snapshot=on overlays, created in a per-run scratch folder
+    // under ephemeralDirectory() (TMPDIR of the process) and removed when
+    // QEMU exits. The default is /dev/shm, so writes never reach a disk
+    static QString ephemeralDirectory();
+    static void setEphemeralDirectory(const QString &directory);
+    bool isEphemeralRun(const QString &vmName) const;
+    
+    // VM execution (detached QEMU processes supervised over QMP)
     bool startVM(VirtualMachine *vm);
-    bool stopVM(const QString &vmName);
-    bool pauseVM(const QString &vmName);
-    bool resumeVM(const QString &vmName);
+    bool requestStop(const QString &vmName);
+    bool isVMRunning(const QString &vmName) const;
+    QStringList getRunningVMs() const;
+    qint64 getVMPid(const QString &vmName) const;
+    QmpClient* getQmpClient(const QString &vmName) const;
+    // Señales de disponibilidad: QMP respondió / qemu-ga abrió su canal
+    bool isQmpReady(const QString &vmName) const;
+    bool isGuestAgentConnected(const QString &vmName) const;
+    // One qemu-guest-agent command (guest-fsfreeze-freeze...) over a fresh
+    // connection to its socket; the reply holds "return" or "error", as in QMP
+    using GuestAgentCallback = std::function<void(const QJsonObject &reply)>;
+    void executeGuestAgent(const QString &vmName, const QString &command, const QJsonObject &arguments,
+                           int timeoutMs, GuestAgentCallback callback);
+    // Loading a saved state with -incoming; false once the guest is live
+    bool isRestoring(const QString &vmName) const;
+    static QString stateFromQmpStatus(const QString &status);
+    
+    // Re-attach guests left running by a previous manager instance
+    void reattachVMs(const QList<VirtualMachine*> &vms);
+    
+    // Per-VM runtime files
+    static QString vmDirectory(const QString &vmName);
+    static QString pidFilePath(const QString &vmName);
+    static QString qmpSocketPath(const QString &vmName);
+    static QString serialLogPath(const QString &vmName);
+    static QString qemuLogPath(const QString &vmName);
+    static QString guestAgentSocketPath(const QString &vmName);
+    
+    // Guest state suspended to disk; the next startVM() restores it. The
+    // info file next to it records how it was written (format, channels...)
+    static QString savedStatePath(const QString &vmName);
+    static bool hasSavedState(const QString &vmName);
+    static void removeSavedState(const QString &vmName);
+    static QJsonObject savedStateInfo(const QString &vmName);
+    static void writeSavedStateInfo(const QString &vmName, const QJsonObject &info);
+    // Makes an existing state file (a checkpoint's RAM) the saved state of
+    // vmName without copying it: a hard link, or a copy across filesystems.
+    // info says how it was written (format, channels...) and whether to resume
+    static bool adoptSavedState(const QString &vmName, const QString &statePath, QJsonObject info);
+    // Migration URIs for a state file: "stream" (exec: through cat), "zstd"
+    // (exec: through multithreaded zstd) or "mapped-ram" (file:, written by
+    // multifd channels at fixed offsets; needs mappedRamCapabilities() on
+    // both sides)
+    static QString stateSaveUri(const QString &path, const QString &format, int channels);
+    static QString stateRestoreUri(const QString &path, const QString &format);
+    static QJsonArray mappedRamCapabilities(bool enabled);
+    
+    // Checkpoints for quick resets, one folder each under checkpointsRoot():
+    // the guest RAM (state.vmstate, absent for a powered-off checkpoint),
+    // checkpoint.json (the frozen disk images and how the RAM was written)
+    // and the thin overlays created on those images. A frozen image must
+    // not change while a checkpoint refers to it
+    static QString checkpointsRoot(const QString &vmName);
+    static QString checkpointDirectory(const QString &vmName, const QString &name);
+    static QString checkpointStatePath(const QString &vmName, const QString &name);
+    static QString checkpointOverlayPath(const QString &vmName, const QString &name, int diskIndex);
+    static QJsonObject checkpointInfo(const QString &vmName, const QString &name);
+    static bool writeCheckpointInfo(const QString &vmName, const QString &name, const QJsonObject &info);
+    static QStringList listCheckpoints(const QString &vmName);
+    // Images frozen by any of the VM's checkpoints
+    static QStringList checkpointImages(const QString &vmName);
+    static bool isValidCheckpointName(const QString &name);
+    
+    // Suspend-to-disk format. "auto" compresses only when zstd has proven
+    // faster than writing the raw RAM to this host's disk
+    struct SaveStatePolicy {
+        QString compression = "auto";   // auto, none, zstd
+        int channels = 0;               // multifd channels / zstd threads; 0 = half the CPUs (2-8)
+    };
+    static SaveStatePolicy loadSaveStatePolicy();
+    static void saveSaveStatePolicy(const SaveStatePolicy &policy);
+    static int saveStateChannels(const SaveStatePolicy &policy);
+    static bool isZstdAvailable();
+    static QString chooseSaveFormat(const SaveStatePolicy &policy, bool mappedRam, bool zstd);
+    // Guest RAM MB/s of the recent saves in a format (smoothed); 0 = never measured
+    static double measuredSaveThroughput(const QString &format);
+    static void recordSaveThroughput(const QString &format, double mbps);
+    // Last "save" and "restore" of a VM: format, bytes, msecs and MB/s
+    static QJsonObject saveStateStats(const QString &vmName);
+    static void recordSaveStateStats(const QString &vmName, const QString &operation, const QJsonObject &stats);
+    
+    // Emulated device sets accepted by VirtualMachine::setDeviceProfile()
+    static QStringList deviceProfiles();
+    static QStringList diskControllers();
+    
+    // Storage I/O tuning; defaults depend on the filesystem holding the image.
+    // The legacy profile keeps QEMU's own (writeback, threads, no discard or
+    // IOThread) so that existing guests behave as before
+    static VirtualMachine::DiskTuning defaultDiskTuning(const QString &diskPath, const QString &deviceProfile);
+    static QStringList diskCacheModes();
+    static QStringList diskAioModes();
     
     // System checks
     bool isQemuAvailable();
     QString getQemuVersion();
     QStringList getSupportedFormats();
     
+    // Named CPU models accepted by -cpu (besides host-passthrough/host-model)
+    QStringList getCpuModels();
+    static QString cpuModelArgument(const QString &model);
+    
+    // virtio-balloon device added by buildQemuCommand() (QOM path and stats interval)
+    static bool hasMemoryBalloon(VirtualMachine *vm);
+    static const char *balloonPath() { return "/machine/peripheral/balloon0"; }
+    static const int BalloonStatsIntervalSecs = 5;
+    
+    // Canal virtio-serial para qemu-guest-agent (perfiles paravirtualizados)
+    static bool hasGuestAgentChannel(VirtualMachine *vm);
+    static const char *guestAgentPortName() { return "org.qemu.guest_agent.0"; }
+    
+    // Guest RAM backings accepted by VirtualMachine::setMemoryBacking()
+    static QStringList memoryBackings();
+    // Free huge pages for the whole guest RAM (on the given NUMA nodes, if any)
+    static bool checkHugePages(int memoryMB, int hugePageSizeKB, QString *error,
+                               const QList<int> &hostNodes = QList<int>());
+    
+    // vCPU placement policies accepted by VirtualMachine::setCPUPinning()
+    static QStringList cpuPinningPolicies();
+    // Host CPUs the vCPUs of a running VM are pinned to (vCPU index order)
+    QList<int> getVMHostCpus(const QString &vmName) const;
+
 signals:
     void processStarted(const QString &vmName);
     void processFinished(const QString &vmName, int exitCode);
+    void vmStateChanged(const QString &vmName, const QString &state);
+    void qmpReady(const QString &vmName);
+    void guestAgentChanged(const QString &vmName, bool connected);
     void errorOccurred(const QString &error);
-    void outputReceived(const QString &vmName, const QString &output);
 
 private slots:
-    void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
-    void onProcessError(QProcess::ProcessError error);
-    void onProcessOutput();
+    void checkRunningVMs();
 
 private:
-    QStringList buildQemuCommand(VirtualMachine *vm);
+    // QEMU process started detached; it outlives the manager
+    struct RunningVM {
+        qint64 pid = 0;
+        QmpClient *qmp = nullptr;
+        QString state;
+        bool qmpVerified = false;
+        QList<int> hostCpus;        // vCPU i -> CPU del anfitrión
+        QList<int> emulatorCpus;    // hilo principal e IOThreads
+        bool pinned = false;
+        bool balloon = false;       // activar el sondeo de estadísticas
+        bool restoring = false;     // -incoming desde savedStatePath()
+        QString restoreFormat;      // formato del estado que se carga
+        int restoreChannels = 0;
+        qint64 restoreStartMs = 0;
+        bool guestAgent = false;    // qemu-ga tiene abierto el puerto
+        bool ephemeral = false;     // discos con snapshot=on
+    };
+    
+    // Ubicación calculada antes de lanzar QEMU
+    struct CpuPlacement {
+        QList<int> hostCpus;
+        QList<int> emulatorCpus;
+        QList<int> hostNodes;
+        QString memoryPolicy;       // "bind" o "interleave"
+    };
+    
+    void attachVM(const QString &vmName, qint64 pid, const QString &state);
+    void handleVMExit(const QString &vmName);
+    void handleQmpEvent(const QString &vmName, const QString &event, const QJsonObject &data);
+    void setRunState(const QString &vmName, const QString &state);
+    void startIncoming(const QString &vmName);
+    void checkRestore(const QString &vmName);
+    void finishRestore(const QString &vmName, const QString &state);
+    void cleanupRuntimeFiles(const QString &vmName);
+    static QString ephemeralMarkerPath(const QString &vmName);
+    QString readLogTail(const QString &vmName);
+    static qint64 readPidFile(const QString &path);
+    static bool isQemuProcess(qint64 pid, const QString &vmName);
+    
+    // vCPU pinning and NUMA placement
+    CpuPlacement planPlacement(VirtualMachine *vm) const;
+    QMap<int, int> hostCpuLoad() const;
+    void applyPinning(const QString &vmName);
+    static QList<QPair<qint64, QString>> qemuThreads(qint64 pid);
+    static QList<int> pinnedVcpuCpus(qint64 pid);
+    static bool setThreadAffinity(qint64 tid, const QList<int> &cpus);
+    
+    QStringList buildQemuCommand(VirtualMachine *vm, const CpuPlacement &placement);
     QString findQemuExecutable();
     bool validateDiskPath(const QString &path);
+    bool prepareDiskCreation(const QString &path, const QString &format, qint64 sizeGB, bool preallocated,
+                             QStringList *arguments);
+    bool runSnapshotCommand(const QStringList &arguments, const QString &errorMessage);
+    
+    // Signal-driven qemu-img: done gets the error, empty on success. With
+    // timeoutMs <= 0 the run has no time limit
+    void runImgAsync(const QStringList &arguments, int timeoutMs, std::function<void(const QString &error)> done);
+    QStringList convertArguments(const QString &sourcePath, const QString &destPath, const QString &destFormat,
+                                 const QString &snapshot);
+    struct OverlayBatch;
+    void launchOverlay(const QSharedPointer<OverlayBatch> &batch);
     
-    QMap<QString, QProcess*> m_runningVMs;
+    QMap<QString, RunningVM> m_runningVMs;
+    QTimer *m_watchTimer;
     QString m_qemuPath;
+    QStringList m_cpuModels;
     
     // Helper methods
     QString formatSizeString(qint64 sizeGB);
+    static QString escapeOptionValue(const QString &value);
+    static QString shellQuote(const QString &value);
     bool createDirectoryIfNotExists(const QString &path);
 };
 
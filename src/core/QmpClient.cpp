@@ -0,0 +1,269 @@
+#include "QmpClient.h"
+
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QElapsedTimer>
+#include <QDebug>
+
+QmpClient::QmpClient(QObject *parent)
+    : QObject(parent)
+    , m_socket(new QLocalSocket(this))
+    , m_ready(false)
+    , m_nextId(1)
+{
+    connect(m_socket, &QLocalSocket::readyRead, this, &QmpClient::onReadyRead);
+    connect(m_socket, &QLocalSocket::disconnected, this, &QmpClient::onDisconnected);
+    connect(m_socket, &QLocalSocket::errorOccurred, this, &QmpClient::onSocketError);
+}
+
+QmpClient::~QmpClient()
+{
+    // Evitar que el cierre del socket llame a los slots durante la destrucción
+    m_socket->disconnect(this);
+    m_socket->abort();
+}
+
+void QmpClient::connectToServer(const QString &socketPath)
+{
+    if (m_socket->state() != QLocalSocket::UnconnectedState) {
+        m_socket->abort();
+    }
+    
+    m_socketPath = socketPath;
+    m_buffer.clear();
+    m_greeting = QJsonObject();
+    m_ready = false;
+    
+    m_socket->connectToServer(socketPath);
+}
+
+void QmpClient::disconnectFromServer()
+{
+    m_socket->disconnectFromServer();
+}
+
+bool QmpClient::waitForReady(int msecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    
+    while (!m_ready) {
+        int remaining = msecs - int(timer.elapsed());
+        if (remaining <= 0) {
+            return false;
+        }
+        
+        if (m_socket->state() == QLocalSocket::ConnectingState) {
+            m_socket->waitForConnected(remaining);
+            continue;
+        }
+        
+        if (m_socket->state() != QLocalSocket::ConnectedState) {
+            return false;
+        }
+        
+        // readyRead se emite de forma síncrona y avanza la negociación
+        m_socket->waitForReadyRead(remaining);
+    }
+    
+    return true;
+}
+
+void QmpClient::execute(const QString &command, const QJsonObject &arguments, Callback callback)
+{
+    if (m_socket->state() == QLocalSocket::UnconnectedState) {
+        if (callback) {
+            QJsonObject error;
+            error["class"] = "GenericError";
+            error["desc"] = tr("No hay conexión QMP con %1").arg(m_socketPath);
+            QJsonObject reply;
+            reply["error"] = error;
+            callback(reply);
+        }
+        return;
+    }
+    
+    qint64 id = m_nextId++;
+    m_pending.insert(id, callback);
+    
+    if (m_ready) {
+        sendCommand(id, command, arguments);
+    } else {
+        m_queued.append(qMakePair(id, QueuedCommand{command, arguments}));
+    }
+}
+
+bool QmpClient::executeSync(const QString &command, const QJsonObject &arguments,
+                            QJsonValue *result, QString *error, int msecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    
+    if (!waitForReady(msecs)) {
+        if (error) {
+            *error = tr("El socket QMP no está disponible: %1").arg(m_socketPath);
+        }
+        return false;
+    }
+    
+    bool done = false;
+    QJsonObject reply;
+    qint64 id = m_nextId;
+    execute(command, arguments, [&done, &reply](const QJsonObject &response) {
+        reply = response;
+        done = true;
+    });
+    
+    while (!done && m_socket->state() == QLocalSocket::ConnectedState) {
+        int remaining = msecs - int(timer.elapsed());
+        if (remaining <= 0) {
+            break;
+        }
+        m_socket->waitForReadyRead(remaining);
+    }
+    
+    if (!done) {
+        // El callback referencia variables locales: no debe llegar a ejecutarse
+        m_pending.remove(id);
+        if (error) {
+            *error = tr("Timeout esperando la respuesta QMP a '%1'").arg(command);
+        }
+        return false;
+    }
+    
+    if (reply.contains("error")) {
+        if (error) {
+            *error = errorString(reply);
+        }
+        return false;
+    }
+    
+    if (result) {
+        *result = reply.value("return");
+    }
+    return true;
+}
+
+QString QmpClient::errorString(const QJsonObject &reply)
+{
+    QJsonObject error = reply.value("error").toObject();
+    return error.value("desc").toString(error.value("class").toString());
+}
+
+void QmpClient::onReadyRead()
+{
+    m_buffer.append(m_socket->readAll());
+    
+    int newline;
+    while ((newline = m_buffer.indexOf('\n')) >= 0) {
+        QByteArray line = m_buffer.left(newline).trimmed();
+        m_buffer.remove(0, newline + 1);
+        
+        if (line.isEmpty()) {
+            continue;
+        }
+        
+        QJsonParseError parseError;
+        QJsonDocument doc = QJsonDocument::fromJson(line, &parseError);
+        if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
+            qWarning() << "QmpClient: Mensaje QMP inválido:" << line;
+            continue;
+        }
+        
+        handleMessage(doc.object());
+    }
+}
+
+void QmpClient::onDisconnected()
+{
+    m_ready = false;
+    failPending(tr("Conexión QMP cerrada"));
+    emit disconnected();
+}
+
+void QmpClient::onSocketError(QLocalSocket::LocalSocketError socketError)
+{
+    // El cierre por parte de QEMU se gestiona en onDisconnected()
+    if (socketError == QLocalSocket::PeerClosedError) {
+        return;
+    }
+    
+    // Fallo al conectar: los comandos encolados nunca se enviarán
+    if (m_socket->state() == QLocalSocket::UnconnectedState) {
+        failPending(m_socket->errorString());
+    }
+    emit errorOccurred(tr("Error en el socket QMP %1: %2").arg(m_socketPath, m_socket->errorString()));
+}
+
+void QmpClient::sendCommand(qint64 id, const QString &command, const QJsonObject &arguments)
+{
+    QJsonObject message;
+    message["execute"] = command;
+    message["id"] = id;
+    if (!arguments.isEmpty()) {
+        message["arguments"] = arguments;
+    }
+    
+    m_socket->write(QJsonDocument(message).toJson(QJsonDocument::Compact) + '\n');
+}
+
+void QmpClient::handleMessage(const QJsonObject &message)
+{
+    // Saludo inicial: negociar capacidades (id 0 reservado)
+    if (message.contains("QMP")) {
+        m_greeting = message.value("QMP").toObject();
+        sendCommand(0, "qmp_capabilities", QJsonObject());
+        return;
+    }
+    
+    if (message.contains("event")) {
+        emit eventReceived(message.value("event").toString(), message.value("data").toObject());
+        return;
+    }
+    
+    if (!message.contains("id")) {
+        return;
+    }
+    
+    qint64 id = message.value("id").toInteger();
+    if (id == 0) {
+        if (message.contains("error")) {
+            emit errorOccurred(tr("QEMU rechazó la negociación QMP: %1").arg(errorString(message)));
+            m_socket->abort();
+            return;
+        }
+        
+        m_ready = true;
+        const auto queued = m_queued;
+        m_queued.clear();
+        for (const auto &entry : queued) {
+            sendCommand(entry.first, entry.second.command, entry.second.arguments);
+        }
+        emit ready();
+        return;
+    }
+    
+    Callback callback = m_pending.take(id);
+    if (callback) {
+        callback(message);
+    }
+}
+
+void QmpClient::failPending(const QString &error)
+{
+    QJsonObject errorObject;
+    errorObject["class"] = "GenericError";
+    errorObject["desc"] = error;
+    QJsonObject reply;
+    reply["error"] = errorObject;
+    
+    const QHash<qint64, Callback> pending = m_pending;
+    m_pending.clear();
+    m_queued.clear();
+    
+    for (const Callback &callback : pending) {
+        if (callback) {
+            callback(reply);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef QMPCLIENT_H
+#define QMPCLIENT_H
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QLocalSocket>
+#include <functional>
+
+/**
+ * @brief Cliente del protocolo QMP (QEMU Machine Protocol)
+ * Mantiene una conexión persistente con el socket QMP de una VM. La
+ * negociación de capacidades se hace automáticamente al conectar; los
+ * comandos enviados antes de terminarla se encolan.
+ */
+class QmpClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Recibe la respuesta completa: contiene "return" o "error"
+    using Callback = std::function<void(const QJsonObject &reply)>;
+    
+    explicit QmpClient(QObject *parent = nullptr);
+    ~QmpClient();
+    
+    void connectToServer(const QString &socketPath);
+    void disconnectFromServer();
+    bool waitForReady(int msecs = 3000);
+    bool isReady() const { return m_ready; }
+    QLocalSocket::LocalSocketState state() const { return m_socket->state(); }
+    QString socketPath() const { return m_socketPath; }
+    
+    // Saludo inicial de QEMU (versión y capacidades)
+    QJsonObject greeting() const { return m_greeting; }
+    
+    // Ejecución asíncrona; la respuesta llega por el callback
+    void execute(const QString &command, const QJsonObject &arguments = QJsonObject(),
+                 Callback callback = nullptr);
+    
+    // Ejecución bloqueante con timeout; para llamadas desde la API síncrona
+    bool executeSync(const QString &command, const QJsonObject &arguments = QJsonObject(),
+                     QJsonValue *result = nullptr, QString *error = nullptr, int msecs = 5000);
+    
+    static QString errorString(const QJsonObject &reply);
+
+signals:
+    void ready();
+    void disconnected();
+    void eventReceived(const QString &event, const QJsonObject &data);
+    void errorOccurred(const QString &error);
+
+private slots:
+    void onReadyRead();
+    void onDisconnected();
+    void onSocketError(QLocalSocket::LocalSocketError socketError);
+
+private:
+    void sendCommand(qint64 id, const QString &command, const QJsonObject &arguments);
+    void handleMessage(const QJsonObject &message);
+    void failPending(const QString &error);
+    
+    struct QueuedCommand {
+        QString command;
+        QJsonObject arguments;
+    };
+    
+    QLocalSocket *m_socket;
+    QString m_socketPath;
+    QByteArray m_buffer;
+    QJsonObject m_greeting;
+    bool m_ready;
+    qint64 m_nextId;
+    QHash<qint64, Callback> m_pending;
+    QList<QPair<qint64, QueuedCommand>> m_queued;
+};
+
+#endif // QMPCLIENT_H
\ No newline at end of file
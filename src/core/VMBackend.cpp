@@ -0,0 +1,26 @@
+#include "VMBackend.h"
+
+VMBackend::VMBackend(QObject *parent)
+    : QObject(parent)
+{
+}
+
+VMBackend::~VMBackend()
+{
+}
+
+VMBackend::Result VMBackend::success(const QJsonValue &value)
+{
+    Result result;
+    result.ok = true;
+    result.value = value;
+    return result;
+}
+
+VMBackend::Result VMBackend::failure(const QString &error)
+{
+    Result result;
+    result.ok = false;
+    result.error = error;
+    return result;
+}
\ No newline at end of file
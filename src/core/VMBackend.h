@@ -0,0 +1,106 @@
+#ifndef VMBACKEND_H
+#define VMBACKEND_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QJsonValue>
+#include <functional>
+
+class VirtualMachine;
+
+/**
+ * @brief Interfaz común de los backends de ejecución de VMs
+ * Todas las operaciones son asíncronas y terminan llamando exactamente una
+ * vez al callback. Si el error ya se notificó con errorOccurred(), el campo
+ * error del resultado puede ir vacío.
+ */
+class VMBackend : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Result {
+        bool ok = false;
+        QJsonValue value;
+        QString error;
+    };
+    using Callback = std::function<void(const Result &result)>;
+    
+    explicit VMBackend(QObject *parent = nullptr);
+    virtual ~VMBackend();
+    
+    // Identificador guardado en la configuración de cada VM
+    virtual QString id() const = 0;
+    virtual bool isAvailable() = 0;
+    
+    // Control
+    virtual void start(VirtualMachine *vm, Callback callback) = 0;
+    virtual void stop(VirtualMachine *vm, Callback callback) = 0;
+    virtual void pause(VirtualMachine *vm, Callback callback) = 0;
+    virtual void resume(VirtualMachine *vm, Callback callback) = 0;
+    virtual void reset(VirtualMachine *vm, Callback callback) = 0;
+    
+    // Consultas: estado como cadena, estadísticas como objeto JSON
+    virtual void queryState(VirtualMachine *vm, Callback callback) = 0;
+    virtual void queryStats(VirtualMachine *vm, Callback callback) = 0;
+    
+    // Memoria que el balón deja al invitado; sus estadísticas van en el
+    // objeto "balloon" de queryStats() (valores en MB)
+    virtual void setBalloonTarget(VirtualMachine *vm, qint64 targetMB, Callback callback) = 0;
+    
+    // Suspensión a disco: la VM termina en estado "saved" y el siguiente
+    // start() la restaura donde se quedó
+    virtual void saveState(VirtualMachine *vm, Callback callback) = 0;
+    
+    // Instantáneas: la lista es un array de objetos con al menos "name"; el
+    // backend QEMU añade los datos de la tabla qcow2 (created, vmStateSize,
+    // diskSize, vmClockNsec). Las operaciones largas informan con jobProgress()
+    virtual void listSnapshots(VirtualMachine *vm, Callback callback) = 0;
+    virtual void createSnapshot(VirtualMachine *vm, const QString &tag, Callback callback) = 0;
+    virtual void deleteSnapshot(VirtualMachine *vm, const QString &tag, Callback callback) = 0;
+    virtual void revertSnapshot(VirtualMachine *vm, const QString &tag, Callback callback) = 0;
+    
+    // Instantáneas externas: una capa qcow2 nueva encima de cada disco, en
+    // "directory" o junto al disco si va vacío. El resultado es la lista de
+    // discos que quedan en uso, en el orden de getHardDisks()
+    virtual void createExternalSnapshot(VirtualMachine *vm, const QString &tag, const QString &directory,
+                                        Callback callback) = 0;
+    // Las comprobaciones de createExternalSnapshot sin crear nada: el error
+    // que daría ahora, o vacío si puede hacerse
+    virtual QString checkExternalSnapshot(VirtualMachine *vm, const QString &tag, const QString &directory) = 0;
+    // Deshace la capa recién creada: "disks" son los discos de antes de
+    // createExternalSnapshot, que vuelven a estar en uso (son el resultado)
+    virtual void discardExternalSnapshot(VirtualMachine *vm, const QStringList &disks, Callback callback) = 0;
+    // Fusión de la cadena de un disco: "commit" vuelca las capas en la imagen
+    // base, que pasa a ser el disco; "stream" copia los datos de las bases en
+    // la capa superior y la deja independiente. El resultado es la ruta del
+    // disco que queda en uso
+    virtual void mergeDiskChain(VirtualMachine *vm, const QString &diskPath, const QString &mode,
+                                Callback callback) = 0;
+    
+    // Puntos de control para reiniciar una VM de pruebas en segundos: los
+    // discos actuales quedan congelados bajo capas nuevas y, con la VM en
+    // marcha, la RAM se guarda aparte. El resultado lleva en "overlays" los
+    // discos que quedan en uso, en el orden de getHardDisks(), también si la
+    // RAM no se pudo guardar después de cambiar de capa. resetToCheckpoint
+    // descarta las capas, crea otras vacías sobre las imágenes congeladas y
+    // deja la RAM como estado guardado ("memory"); el siguiente arranque la carga
+    virtual void createCheckpoint(VirtualMachine *vm, const QString &name, Callback callback) = 0;
+    virtual void resetToCheckpoint(VirtualMachine *vm, const QString &name, Callback callback) = 0;
+    // Borra los ficheros del punto de control salvo los de "keep" (imágenes
+    // que aún son la base de algún disco); el resultado es su nombre
+    virtual void deleteCheckpoint(VirtualMachine *vm, const QString &name, const QStringList &keep,
+                                  Callback callback) = 0;
+    
+    static Result success(const QJsonValue &value = QJsonValue());
+    static Result failure(const QString &error = QString());
+
+signals:
+    void vmStateChanged(const QString &vmName, const QString &state);
+    void errorOccurred(const QString &error);
+    // Avance (0-100) de una operación larga; job: "snapshot-save", "snapshot-load"...
+    void jobProgress(const QString &vmName, const QString &job, int percent);
+};
+
+#endif // VMBACKEND_H
\ No newline at end of file
@@ -11,6 +11,8 @@
 #include <QDebug>
 #include <QRegularExpression>
 #include <QStringConverter>
+#include <QUuid>
+#include <QXmlStreamReader>
 
 VMXmlManager::VMXmlManager(QObject *parent)
     : QObject(parent)
@@ -181,8 +183,13 @@ QStringList VMXmlManager::getAvailableVMs()
     qDebug() << "VMXmlManager: Archivos XML encontrados:" << xmlFiles;
     
     for (const QString &fileName : xmlFiles) {
-        QFileInfo fileInfo(fileName);
-        QString vmName = fileInfo.baseName().replace("_", " "); // Deshacer sanitización básica
+        // El nombre del archivo no es reversible (puntos, '_' y espacios):
+        // el nombre real es el de <BasicInfo><Name>, que también sirve de
+        // clave en la sincronización con libvirt
+        QString vmName = readVMName(dir.filePath(fileName));
+        if (vmName.isEmpty()) {
+            vmName = QFileInfo(fileName).completeBaseName();
+        }
         vmList.append(vmName);
         qDebug() << "VMXmlManager: VM detectada:" << vmName << "desde archivo:" << fileName;
     }
@@ -190,6 +197,31 @@ QStringList VMXmlManager::getAvailableVMs()
     return vmList;
 }
 
+QString VMXmlManager::readVMName(const QString &filePath)
+{
+    // Sólo se lee hasta el primer <Name>, sin cargar el documento entero
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    
+    QXmlStreamReader reader(&file);
+    bool inBasicInfo = false;
+    while (!reader.atEnd()) {
+        reader.readNext();
+        if (reader.isStartElement()) {
+            if (reader.name() == QLatin1String("BasicInfo")) {
+                inBasicInfo = true;
+            } else if (inBasicInfo && reader.name() == QLatin1String("Name")) {
+                return reader.readElementText().trimmed();
+            }
+        } else if (reader.isEndElement() && reader.name() == QLatin1String("BasicInfo")) {
+            break;
+        }
+    }
+    return QString();
+}
+
 QStringList VMXmlManager::getVMFiles()
 {
     QStringList fileList;
@@ -261,6 +293,7 @@ QDomDocument VMXmlManager::createVMDocument(VirtualMachine *vm)
     addDisplayElement(doc, root, vm);
     addAudioElement(doc, root, vm);
     addSharedFoldersElement(doc, root, vm);
+    addSnapshotsElement(doc, root, vm);
     
     return doc;
 }
@@ -285,10 +318,46 @@ void VMXmlManager::addBasicInfoElement(QDomDocument &doc, QDomElement &root, Vir
     osType.appendChild(doc.createTextNode(vm->getOSType()));
     basicInfo.appendChild(osType);
     
+    QDomElement backend = doc.createElement("Backend");
+    backend.appendChild(doc.createTextNode(vm->getBackend()));
+    basicInfo.appendChild(backend);
+    
     QDomElement state = doc.createElement("State");
     state.appendChild(doc.createTextNode(vm->getState()));
     basicInfo.appendChild(state);
     
+    QDomElement priority = doc.createElement("Priority");
+    priority.appendChild(doc.createTextNode(vm->getPriority()));
+    basicInfo.appendChild(priority);
+    
+    if (!vm->getStartAfter().isEmpty()) {
+        QDomElement startAfter = doc.createElement("StartAfter");
+        for (const QString &dependency : vm->getStartAfter()) {
+            QDomElement vmElement = doc.createElement("VM");
+            vmElement.appendChild(doc.createTextNode(dependency));
+            startAfter.appendChild(vmElement);
+        }
+        basicInfo.appendChild(startAfter);
+    }
+    
+    if (!vm->getWarmPool().isEmpty()) {
+        QDomElement warmPool = doc.createElement("WarmPool");
+        warmPool.appendChild(doc.createTextNode(vm->getWarmPool()));
+        basicInfo.appendChild(warmPool);
+    }
+    
+    if (vm->isTemplate()) {
+        QDomElement isTemplate = doc.createElement("Template");
+        isTemplate.appendChild(doc.createTextNode("true"));
+        basicInfo.appendChild(isTemplate);
+    }
+    
+    if (!vm->getGroup().isEmpty()) {
+        QDomElement group = doc.createElement("Group");
+        group.appendChild(doc.createTextNode(vm->getGroup()));
+        basicInfo.appendChild(group);
+    }
+    
     root.appendChild(basicInfo);
 }
 
@@ -298,12 +367,34 @@ void VMXmlManager::addSystemElement(QDomDocument &doc, QDomElement &root, Virtua
     
     QDomElement memory = doc.createElement("Memory");
     memory.setAttribute("mb", vm->getMemoryMB());
+    memory.setAttribute("backing", vm->getMemoryBacking());
+    memory.setAttribute("hugePageKB", vm->getHugePageSizeKB());
+    memory.setAttribute("prealloc", vm->isMemoryPrealloc() ? "true" : "false");
+    memory.setAttribute("share", vm->isMemoryShared() ? "true" : "false");
+    memory.setAttribute("merge", vm->isMemoryMergeable() ? "true" : "false");
+    memory.setAttribute("balloon", vm->isMemoryBalloonEnabled() ? "true" : "false");
     system.appendChild(memory);
     
     QDomElement cpu = doc.createElement("CPU");
     cpu.setAttribute("count", vm->getCPUCount());
+    cpu.setAttribute("model", vm->getCPUModel());
+    if (vm->hasCPUTopology()) {
+        cpu.setAttribute("sockets", vm->getCPUSockets());
+        cpu.setAttribute("dies", vm->getCPUDies());
+        cpu.setAttribute("cores", vm->getCPUCores());
+        cpu.setAttribute("threads", vm->getCPUThreads());
+    }
+    cpu.setAttribute("pinning", vm->getCPUPinning());
+    if (vm->getCPUPinning() == "manual") {
+        cpu.setAttribute("cpuset", vm->getCPUSet());
+    }
     system.appendChild(cpu);
     
+    QDomElement deviceProfile = doc.createElement("DeviceProfile");
+    deviceProfile.setAttribute("name", vm->getDeviceProfile());
+    deviceProfile.setAttribute("diskController", vm->getDiskController());
+    system.appendChild(deviceProfile);
+    
     QDomElement bootOrder = doc.createElement("BootOrder");
     for (const QString &device : vm->getBootOrder()) {
         QDomElement bootDevice = doc.createElement("Device");
@@ -323,8 +414,23 @@ void VMXmlManager::addStorageElement(QDomDocument &doc, QDomElement &root, Virtu
     for (const QString &disk : vm->getHardDisks()) {
         QDomElement diskElement = doc.createElement("Disk");
         diskElement.setAttribute("path", disk);
+        if (!vm->getDiskFormat(disk).isEmpty()) {
+            diskElement.setAttribute("format", vm->getDiskFormat(disk));
+        }
+        if (vm->hasDiskTuning(disk)) {
+            VirtualMachine::DiskTuning tuning = vm->getDiskTuning(disk);
+            diskElement.setAttribute("cache", tuning.cache);
+            diskElement.setAttribute("aio", tuning.aio);
+            diskElement.setAttribute("discard", tuning.discard ? "true" : "false");
+            diskElement.setAttribute("detectZeroes", tuning.detectZeroes);
+            diskElement.setAttribute("iothread", tuning.iothread ? "true" : "false");
+            diskElement.setAttribute("queues", tuning.queues);
+        }
         hardDisks.appendChild(diskElement);
     }
+    if (vm->isEphemeral()) {
+        hardDisks.setAttribute("ephemeral", "true");
+    }
     storage.appendChild(hardDisks);
     
     QDomElement cdrom = doc.createElement("CDROM");
@@ -337,6 +443,9 @@ void VMXmlManager::addStorageElement(QDomDocument &doc, QDomElement &root, Virtu
 void VMXmlManager::addNetworkElement(QDomDocument &doc, QDomElement &root, VirtualMachine *vm)
 {
     QDomElement network = doc.createElement("Network");
+    if (!vm->getMacAddress().isEmpty()) {
+        network.setAttribute("mac", vm->getMacAddress());
+    }
     
     QDomElement adapters = doc.createElement("Adapters");
     for (const QString &adapter : vm->getNetworkAdapters()) {
@@ -396,6 +505,28 @@ void VMXmlManager::addSharedFoldersElement(QDomDocument &doc, QDomElement &root,
     root.appendChild(sharedFolders);
 }
 
+void VMXmlManager::addSnapshotsElement(QDomDocument &doc, QDomElement &root, VirtualMachine *vm)
+{
+    // Sólo el árbol: el contenido de cada instantánea está en los discos
+    QDomElement snapshots = doc.createElement("Snapshots");
+    snapshots.setAttribute("current", vm->getCurrentSnapshot());
+    
+    for (const VirtualMachine::SnapshotInfo &info : vm->getSnapshots()) {
+        QDomElement snapshot = doc.createElement("Snapshot");
+        snapshot.setAttribute("name", info.name);
+        snapshot.setAttribute("parent", info.parent);
+        snapshot.setAttribute("created", info.created.toString(Qt::ISODate));
+        if (!info.description.isEmpty()) {
+            QDomElement description = doc.createElement("Description");
+            description.appendChild(doc.createTextNode(info.description));
+            snapshot.appendChild(description);
+        }
+        snapshots.appendChild(snapshot);
+    }
+    
+    root.appendChild(snapshots);
+}
+
 bool VMXmlManager::parseVMDocument(const QDomDocument &doc, VirtualMachine *vm)
 {
     qDebug() << "VMXmlManager: parseVMDocument iniciado";
@@ -444,6 +575,11 @@ bool VMXmlManager::parseVMDocument(const QDomDocument &doc, VirtualMachine *vm)
         parseSharedFolders(sharedFolders, vm);
     }
     
+    QDomElement snapshots = root.firstChildElement("Snapshots");
+    if (!snapshots.isNull()) {
+        parseSnapshots(snapshots, vm);
+    }
+    
     return true;
 }
 
@@ -452,7 +588,25 @@ void VMXmlManager::parseBasicInfo(const QDomElement &element, VirtualMachine *vm
     vm->setUUID(element.firstChildElement("UUID").text());
     vm->setDescription(element.firstChildElement("Description").text());
     vm->setOSType(element.firstChildElement("OSType").text());
+    
+    // Configuraciones anteriores sin backend: QEMU directo
+    QString backend = element.firstChildElement("Backend").text();
+    vm->setBackend(backend.isEmpty() ? "qemu" : backend);
     vm->setState(element.firstChildElement("State").text());
+    
+    QString priority = element.firstChildElement("Priority").text();
+    vm->setPriority(priority.isEmpty() ? "normal" : priority);
+    
+    QStringList startAfter;
+    QDomElement vmElement = element.firstChildElement("StartAfter").firstChildElement("VM");
+    while (!vmElement.isNull()) {
+        startAfter.append(vmElement.text());
+        vmElement = vmElement.nextSiblingElement("VM");
+    }
+    vm->setStartAfter(startAfter);
+    vm->setWarmPool(element.firstChildElement("WarmPool").text());
+    vm->setTemplate(element.firstChildElement("Template").text() == "true");
+    vm->setGroup(element.firstChildElement("Group").text());
 }
 
 void VMXmlManager::parseSystemInfo(const QDomElement &element, VirtualMachine *vm)
@@ -460,11 +614,32 @@ void VMXmlManager::parseSystemInfo(const QDomElement &element, VirtualMachine *v
     QDomElement memory = element.firstChildElement("Memory");
     if (!memory.isNull()) {
         vm->setMemoryMB(memory.attribute("mb").toInt());
+        vm->setMemoryBacking(memory.attribute("backing", "anonymous"));
+        vm->setHugePageSizeKB(memory.attribute("hugePageKB", "2048").toInt());
+        vm->setMemoryPrealloc(memory.attribute("prealloc") == "true");
+        vm->setMemoryShared(memory.attribute("share") == "true");
+        vm->setMemoryMergeable(memory.attribute("merge", "true") == "true");
+        vm->setMemoryBalloonEnabled(memory.attribute("balloon", "true") == "true");
     }
     
     QDomElement cpu = element.firstChildElement("CPU");
     if (!cpu.isNull()) {
         vm->setCPUCount(cpu.attribute("count").toInt());
+        // Configuraciones anteriores: el modelo genérico con el que se crearon
+        vm->setCPUModel(cpu.attribute("model", "qemu64"));
+        if (cpu.hasAttribute("sockets")) {
+            vm->setCPUTopology(cpu.attribute("sockets").toInt(), cpu.attribute("dies", "1").toInt(),
+                               cpu.attribute("cores", "1").toInt(), cpu.attribute("threads", "1").toInt());
+        }
+        vm->setCPUPinning(cpu.attribute("pinning", "none"));
+        vm->setCPUSet(cpu.attribute("cpuset"));
+    }
+    
+    // Configuraciones anteriores sin perfil: dispositivos emulados clásicos
+    QDomElement deviceProfile = element.firstChildElement("DeviceProfile");
+    if (!deviceProfile.isNull()) {
+        vm->setDeviceProfile(deviceProfile.attribute("name", "legacy"));
+        vm->setDiskController(deviceProfile.attribute("diskController", "virtio-blk"));
     }
     
     QDomElement bootOrder = element.firstChildElement("BootOrder");
@@ -487,9 +662,25 @@ void VMXmlManager::parseStorageInfo(const QDomElement &element, VirtualMachine *
         QDomElement disk = hardDisks.firstChildElement("Disk");
         while (!disk.isNull()) {
             disks.append(disk.attribute("path"));
+            if (disk.hasAttribute("format")) {
+                vm->setDiskFormat(disk.attribute("path"), disk.attribute("format"));
+            }
+            
+            // Sin atributos de ajuste: se usan los valores por defecto del anfitrión al arrancar
+            if (disk.hasAttribute("cache")) {
+                VirtualMachine::DiskTuning tuning;
+                tuning.cache = disk.attribute("cache", tuning.cache);
+                tuning.aio = disk.attribute("aio", tuning.aio);
+                tuning.discard = disk.attribute("discard") == "true";
+                tuning.detectZeroes = disk.attribute("detectZeroes", tuning.detectZeroes);
+                tuning.iothread = disk.attribute("iothread") == "true";
+                tuning.queues = disk.attribute("queues", "1").toInt();
+                vm->setDiskTuning(disk.attribute("path"), tuning);
+            }
             disk = disk.nextSiblingElement("Disk");
         }
         vm->setHardDisks(disks);
+        vm->setEphemeral(hardDisks.attribute("ephemeral") == "true");
     }
     
     QDomElement cdrom = element.firstChildElement("CDROM");
@@ -500,6 +691,8 @@ void VMXmlManager::parseStorageInfo(const QDomElement &element, VirtualMachine *
 
 void VMXmlManager::parseNetworkInfo(const QDomElement &element, VirtualMachine *vm)
 {
+    vm->setMacAddress(element.attribute("mac"));
+    
     QDomElement adapters = element.firstChildElement("Adapters");
     if (!adapters.isNull()) {
         QStringList adapterList;
@@ -551,6 +744,25 @@ void VMXmlManager::parseSharedFolders(const QDomElement &element, VirtualMachine
     vm->setSharedFolders(folders);
 }
 
+void VMXmlManager::parseSnapshots(const QDomElement &element, VirtualMachine *vm)
+{
+    QList<VirtualMachine::SnapshotInfo> snapshots;
+    QDomElement snapshot = element.firstChildElement("Snapshot");
+    while (!snapshot.isNull()) {
+        VirtualMachine::SnapshotInfo info;
+        info.name = snapshot.attribute("name");
+        info.parent = snapshot.attribute("parent");
+        info.created = QDateTime::fromString(snapshot.attribute("created"), Qt::ISODate);
+        info.description = snapshot.firstChildElement("Description").text();
+        if (!info.name.isEmpty()) {
+            snapshots.append(info);
+        }
+        snapshot = snapshot.nextSiblingElement("Snapshot");
+    }
+    vm->setSnapshots(snapshots);
+    vm->setCurrentSnapshot(element.attribute("current"));
+}
+
 bool VMXmlManager::cloneVM(const QString &sourceName, const QString &cloneName)
 {
     // Verificar que el VM origen existe y el clon no existe
@@ -577,14 +789,33 @@ bool VMXmlManager::cloneVM(const QString &sourceName, const QString &cloneName)
     // Crear una nueva VM basada en la original
     VirtualMachine *cloneVM = new VirtualMachine(cloneName, this);
     
-    // Copiar toda la configuración excepto nombre y UUID
+    // Copiar toda la configuración excepto nombre, UUID y MAC
     cloneVM->setOSType(sourceVM->getOSType());
     cloneVM->setMemoryMB(sourceVM->getMemoryMB());
+    cloneVM->setMemoryBacking(sourceVM->getMemoryBacking());
+    cloneVM->setHugePageSizeKB(sourceVM->getHugePageSizeKB());
+    cloneVM->setMemoryPrealloc(sourceVM->isMemoryPrealloc());
+    cloneVM->setMemoryShared(sourceVM->isMemoryShared());
+    cloneVM->setMemoryMergeable(sourceVM->isMemoryMergeable());
+    cloneVM->setMemoryBalloonEnabled(sourceVM->isMemoryBalloonEnabled());
+    cloneVM->setPriority(sourceVM->getPriority());
+    cloneVM->setStartAfter(sourceVM->getStartAfter());
     cloneVM->setCPUCount(sourceVM->getCPUCount());
+    cloneVM->setCPUModel(sourceVM->getCPUModel());
+    if (sourceVM->hasCPUTopology()) {
+        cloneVM->setCPUTopology(sourceVM->getCPUSockets(), sourceVM->getCPUDies(),
+                                sourceVM->getCPUCores(), sourceVM->getCPUThreads());
+    }
+    cloneVM->setCPUPinning(sourceVM->getCPUPinning());
+    cloneVM->setCPUSet(sourceVM->getCPUSet());
+    cloneVM->setDeviceProfile(sourceVM->getDeviceProfile());
+    cloneVM->setDiskController(sourceVM->getDiskController());
     cloneVM->setDescription(sourceVM->getDescription() + tr(" (Clonado de %1)").arg(sourceName));
     cloneVM->setHardDisks(sourceVM->getHardDisks());
+    cloneVM->setEphemeral(sourceVM->isEphemeral());
     cloneVM->setCDROMImage(sourceVM->getCDROMImage());
     cloneVM->setNetworkAdapters(sourceVM->getNetworkAdapters());
+    cloneVM->setMacAddress(VirtualMachine::generateMacAddress());
     cloneVM->setAudioController(sourceVM->getAudioController());
     cloneVM->setUSBController(sourceVM->getUSBController());
     cloneVM->setSharedFolders(sourceVM->getSharedFolders());
@@ -593,7 +824,9 @@ bool VMXmlManager::cloneVM(const QString &sourceName, const QString &cloneName)
     cloneVM->setMonitorCount(sourceVM->getMonitorCount());
     cloneVM->setBootOrder(sourceVM->getBootOrder());
     
-    // El UUID se generará automáticamente en el constructor de VirtualMachine
+    // Identidad propia: dos invitados con el mismo UUID o MAC chocan en la red
+    // y en las herramientas que los distinguen por ella. Ser plantilla tampoco se hereda
+    cloneVM->setUUID(QUuid::createUuid().toString(QUuid::WithoutBraces));
     
     // Actualizar rutas de discos duros para el clon
     QStringList cloneDisks;
@@ -602,6 +835,10 @@ bool VMXmlManager::cloneVM(const QString &sourceName, const QString &cloneName)
         QString cloneDisk = originalDisk;
         cloneDisk.replace(sourceName, cloneName);
         cloneDisks.append(cloneDisk);
+        cloneVM->setDiskFormat(cloneDisk, sourceVM->getDiskFormat(originalDisk));
+        if (sourceVM->hasDiskTuning(originalDisk)) {
+            cloneVM->setDiskTuning(cloneDisk, sourceVM->getDiskTuning(originalDisk));
+        }
     }
     cloneVM->setHardDisks(cloneDisks);
     
@@ -68,6 +68,7 @@ private:
     void addDisplayElement(QDomDocument &doc, QDomElement &root, VirtualMachine *vm);
     void addAudioElement(QDomDocument &doc, QDomElement &root, VirtualMachine *vm);
     void addSharedFoldersElement(QDomDocument &doc, QDomElement &root, VirtualMachine *vm);
+    void addSnapshotsElement(QDomDocument &doc, QDomElement &root, VirtualMachine *vm);
     
     // Parseo XML
     void parseBasicInfo(const QDomElement &element, VirtualMachine *vm);
@@ -77,8 +78,11 @@ private:
     void parseDisplayInfo(const QDomElement &element, VirtualMachine *vm);
     void parseAudioInfo(const QDomElement &element, VirtualMachine *vm);
     void parseSharedFolders(const QDomElement &element, VirtualMachine *vm);
+    void parseSnapshots(const QDomElement &element, VirtualMachine *vm);
     
     QString sanitizeFileName(const QString &name);
+    // <BasicInfo><Name> of a VM file; empty if it cannot be read
+    static QString readVMName(const QString &filePath);
 };
 
 #endif // VMXMLMANAGER_H
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include "VirshSession.h"
+
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QTimer>
+#include <QRegularExpression>
+#include <QDebug>
+
+VirshSession::VirshSession(QObject *parent)
+    : QObject(parent)
+    , m_process(new QProcess(this))
+    , m_nextId(1)
+{
+    // stdout y stderr en el mismo canal para conservar el orden de los mensajes
+    m_process->setProcessChannelMode(QProcess::MergedChannels);
+    connect(m_process, &QProcess::readyReadStandardOutput, this, &VirshSession::onReadyRead);
+    connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &VirshSession::onFinished);
+}
+
+VirshSession::~VirshSession()
+{
+    if (m_process->state() != QProcess::NotRunning) {
+        m_process->disconnect(this);
+        m_process->write("quit\n");
+        if (!m_process->waitForFinished(1000)) {
+            m_process->kill();
+            m_process->waitForFinished(1000);
+        }
+    }
+}
+
+bool VirshSession::isAvailable()
+{
+    return ensureStarted();
+}
+
+void VirshSession::execute(const QStringList &arguments, Callback callback)
+{
+    if (!ensureStarted()) {
+        if (callback) {
+            Result result;
+            result.error = tr("No se pudo iniciar virsh");
+            callback(result);
+        }
+        return;
+    }
+    
+    QStringList quoted;
+    for (const QString &argument : arguments) {
+        quoted.append(quoteArgument(argument));
+    }
+    
+    PendingCommand pending;
+    pending.marker = QString("__kvm_manager_end_%1__").arg(m_nextId++);
+    pending.command = quoted.join(' ');
+    pending.callback = callback;
+    m_pending.enqueue(pending);
+    
+    // El "echo" se ejecuta cuando virsh termina el comando anterior
+    m_process->write(pending.command.toUtf8() + '\n');
+    m_process->write(QString("echo %1\n").arg(pending.marker).toUtf8());
+}
+
+VirshSession::Result VirshSession::executeSync(const QStringList &arguments, int msecs)
+{
+    return executeBatch(QList<QStringList>() << arguments, msecs).first();
+}
+
+QList<VirshSession::Result> VirshSession::executeBatch(const QList<QStringList> &commands, int msecs)
+{
+    QList<Result> results(commands.size());
+    QStringList markers;
+    int remaining = commands.size();
+    
+    for (int i = 0; i < commands.size(); ++i) {
+        markers.append(QString("__kvm_manager_end_%1__").arg(m_nextId));
+        execute(commands[i], [&results, &remaining, i](const Result &result) {
+            results[i] = result;
+            remaining--;
+        });
+    }
+    
+    QElapsedTimer timer;
+    timer.start();
+    while (remaining > 0 && m_process->state() == QProcess::Running) {
+        int timeLeft = msecs - int(timer.elapsed());
+        if (timeLeft <= 0) {
+            break;
+        }
+        m_process->waitForReadyRead(timeLeft);
+    }
+    
+    if (remaining > 0) {
+        // Los callbacks referencian variables locales: las respuestas que aún
+        // puedan llegar se consumirán sin notificar a nadie
+        for (PendingCommand &pending : m_pending) {
+            if (markers.contains(pending.marker)) {
+                pending.callback = nullptr;
+            }
+        }
+        for (int i = 0; i < results.size(); ++i) {
+            if (!results[i].ok && results[i].error.isEmpty() && results[i].output.isEmpty()) {
+                results[i].error = tr("Timeout ejecutando virsh %1").arg(commands[i].join(' '));
+            }
+        }
+    }
+    
+    return results;
+}
+
+void VirshSession::executeBatchAsync(const QList<QStringList> &commands,
+                                     std::function<void(const QList<Result> &results)> callback, int msecs)
+{
+    // Estado compartido: las respuestas pueden llegar después del timeout
+    struct BatchState {
+        QList<Result> results;
+        int remaining = 0;
+        bool finished = false;
+    };
+    auto state = QSharedPointer<BatchState>::create();
+    state->results.resize(commands.size());
+    state->remaining = commands.size();
+    if (commands.isEmpty()) {
+        callback(state->results);
+        return;
+    }
+    
+    for (int i = 0; i < commands.size(); ++i) {
+        execute(commands[i], [state, i, callback](const Result &result) {
+            if (state->finished) {
+                return;
+            }
+            state->results[i] = result;
+            if (--state->remaining == 0) {
+                state->finished = true;
+                callback(state->results);
+            }
+        });
+    }
+    
+    QTimer::singleShot(msecs, this, [state, commands, callback]() {
+        if (state->finished) {
+            return;
+        }
+        state->finished = true;
+        for (int i = 0; i < state->results.size(); ++i) {
+            Result &result = state->results[i];
+            if (!result.ok && result.error.isEmpty() && result.output.isEmpty()) {
+                result.error = tr("Timeout ejecutando virsh %1").arg(commands[i].join(' '));
+            }
+        }
+        callback(state->results);
+    });
+}
+
+QString VirshSession::quoteArgument(const QString &argument)
+{
+    static const QRegularExpression safe("^[A-Za-z0-9_@%+=:,./-]+$");
+    if (safe.match(argument).hasMatch()) {
+        return argument;
+    }
+    
+    // virsh interpreta las comillas simples como en la shell
+    QString escaped = argument;
+    escaped.replace("'", "'\\''");
+    return "'" + escaped + "'";
+}
+
+void VirshSession::onReadyRead()
+{
+    m_buffer.append(m_process->readAllStandardOutput());
+    
+    int newline;
+    while ((newline = m_buffer.indexOf('\n')) >= 0) {
+        QString line = QString::fromUtf8(m_buffer.left(newline));
+        m_buffer.remove(0, newline + 1);
+        
+        // Sin terminal virsh puede seguir mostrando el prompt
+        if (line.startsWith("virsh # ")) {
+            line = line.mid(8);
+        }
+        
+        if (m_pending.isEmpty()) {
+            continue;
+        }
+        
+        PendingCommand &head = m_pending.head();
+        if (line.trimmed() != head.marker) {
+            head.lines.append(line);
+            continue;
+        }
+        
+        PendingCommand finished = m_pending.dequeue();
+        Result result;
+        QStringList output;
+        QStringList errors;
+        for (const QString &outputLine : finished.lines) {
+            if (outputLine.startsWith("error:")) {
+                errors.append(outputLine.mid(6).trimmed());
+            } else {
+                output.append(outputLine);
+            }
+        }
+        result.ok = errors.isEmpty();
+        result.output = output.join('\n');
+        result.error = errors.join('\n');
+        
+        if (!result.ok) {
+            qDebug() << "VirshSession: Comando fallido:" << finished.command << "Error:" << result.error;
+        }
+        if (finished.callback) {
+            finished.callback(result);
+        }
+    }
+}
+
+void VirshSession::onFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    Q_UNUSED(exitCode)
+    Q_UNUSED(exitStatus)
+    
+    m_buffer.clear();
+    failPending(tr("La sesión de virsh terminó inesperadamente"));
+}
+
+bool VirshSession::ensureStarted()
+{
+    if (m_process->state() == QProcess::Running) {
+        return true;
+    }
+    
+    // -q: sin mensaje de bienvenida en modo interactivo
+    m_process->start("virsh", QStringList() << "-q");
+    if (!m_process->waitForStarted(5000)) {
+        emit errorOccurred(tr("No se pudo iniciar virsh: %1").arg(m_process->errorString()));
+        return false;
+    }
+    
+    qDebug() << "VirshSession: Sesión de virsh iniciada";
+    return true;
+}
+
+void VirshSession::failPending(const QString &error)
+{
+    Result result;
+    result.error = error;
+    
+    QQueue<PendingCommand> pending = m_pending;
+    m_pending.clear();
+    for (const PendingCommand &command : pending) {
+        if (command.callback) {
+            command.callback(result);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef VIRSHSESSION_H
+#define VIRSHSESSION_H
+
+#include <QObject>
+#include <QProcess>
+#include <QString>
+#include <QStringList>
+#include <QQueue>
+#include <QList>
+#include <functional>
+
+/**
+ * @brief Sesión interactiva persistente de virsh
+ * Evita lanzar un proceso por comando: los comandos se escriben en la
+ * entrada de un único virsh y cada uno va seguido de un "echo" con un
+ * marcador que delimita su salida. Varios comandos pueden estar en vuelo
+ * a la vez; las respuestas llegan en orden.
+ */
+class VirshSession : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Result {
+        bool ok = false;
+        QString output;
+        QString error;
+    };
+    using Callback = std::function<void(const Result &result)>;
+    
+    explicit VirshSession(QObject *parent = nullptr);
+    ~VirshSession();
+    
+    bool isAvailable();
+    void execute(const QStringList &arguments, Callback callback = nullptr);
+    Result executeSync(const QStringList &arguments, int msecs = 30000);
+    
+    // Envía todos los comandos seguidos y espera a sus respuestas (en orden)
+    QList<Result> executeBatch(const QList<QStringList> &commands, int msecs = 60000);
+    // Igual sin bloquear: callback recibe todas las respuestas a la vez
+    void executeBatchAsync(const QList<QStringList> &commands,
+                           std::function<void(const QList<Result> &results)> callback, int msecs = 60000);
+    int pendingCount() const { return m_pending.size(); }
+    
+    static QString quoteArgument(const QString &argument);
+
+signals:
+    void errorOccurred(const QString &error);
+
+private slots:
+    void onReadyRead();
+    void onFinished(int exitCode, QProcess::ExitStatus exitStatus);
+
+private:
+    struct PendingCommand {
+        QString marker;
+        QString command;
+        QStringList lines;
+        Callback callback;
+    };
+    
+    bool ensureStarted();
+    void failPending(const QString &error);
+    
+    QProcess *m_process;
+    QByteArray m_buffer;
+    QQueue<PendingCommand> m_pending;
+    quint64 m_nextId;
+};
+
+#endif // VIRSHSESSION_H
\ No newline at end of file
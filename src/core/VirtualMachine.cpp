@@ -1,14 +1,35 @@
 #include "VirtualMachine.h"
 
+#include <QJsonArray>
+#include <QRandomGenerator>
+
 VirtualMachine::VirtualMachine(const QString &name, QObject *parent)
     : QObject(parent)
     , m_name(name)
     , m_uuid("")
     , m_description("")
     , m_osType("Linux")
+    , m_backend("qemu")
     , m_state("shut off")
     , m_memoryMB(2048)
+    , m_memoryBacking("anonymous")
+    , m_hugePageSizeKB(2048)
+    , m_memoryPrealloc(false)
+    , m_memoryShared(false)
+    , m_memoryMerge(true)
+    , m_memoryBalloon(true)
+    , m_priority("normal")
+    , m_template(false)
     , m_cpuCount(1)
+    , m_cpuModel("host-passthrough")
+    , m_cpuSockets(0)
+    , m_cpuDies(1)
+    , m_cpuCores(1)
+    , m_cpuThreads(1)
+    , m_cpuPinning("none")
+    , m_deviceProfile("legacy")
+    , m_diskController("virtio-blk")
+    , m_ephemeral(false)
     , m_audioController("PulseAudio")
     , m_usbController("USB 3.0 (xHCI)")
     , m_videoMemoryMB(128)
@@ -49,6 +70,42 @@ void VirtualMachine::setState(const QString &state)
     }
 }
 
+void VirtualMachine::setCPUTopology(int sockets, int dies, int cores, int threads)
+{
+    m_cpuSockets = sockets;
+    m_cpuDies = dies;
+    m_cpuCores = cores;
+    m_cpuThreads = threads;
+    
+    if (sockets > 0) {
+        m_cpuCount = sockets * dies * cores * threads;
+    }
+}
+
+void VirtualMachine::replaceHardDisk(const QString &oldPath, const QString &newPath, const QString &format)
+{
+    int index = m_hardDisks.indexOf(oldPath);
+    if (index < 0 || oldPath == newPath) {
+        return;
+    }
+    
+    m_hardDisks[index] = newPath;
+    m_diskFormats.remove(oldPath);
+    m_diskFormats[newPath] = format;
+    if (m_diskTuning.contains(oldPath)) {
+        m_diskTuning[newPath] = m_diskTuning.take(oldPath);
+    }
+}
+
+QString VirtualMachine::generateMacAddress()
+{
+    QString mac = "52:54:00";
+    for (int i = 0; i < 3; ++i) {
+        mac += QString(":%1").arg(QRandomGenerator::global()->bounded(256), 2, 16, QChar('0'));
+    }
+    return mac;
+}
+
 VirtualMachine::State VirtualMachine::getStateEnum() const
 {
     if (m_state == "shut off" || m_state == "shutoff") {
@@ -66,4 +123,79 @@ VirtualMachine::State VirtualMachine::getStateEnum() const
     } else {
         return Unknown;
     }
+}
+
+QJsonObject VirtualMachine::toJson() const
+{
+    QJsonObject json;
+    json["name"] = m_name;
+    json["uuid"] = m_uuid;
+    json["description"] = m_description;
+    json["osType"] = m_osType;
+    json["backend"] = m_backend;
+    json["state"] = m_state;
+    json["memoryMB"] = m_memoryMB;
+    json["memoryBacking"] = m_memoryBacking;
+    if (m_memoryBacking == "hugepages") {
+        json["hugePageSizeKB"] = m_hugePageSizeKB;
+    }
+    json["memoryPrealloc"] = m_memoryPrealloc;
+    json["memoryShared"] = m_memoryShared;
+    json["memoryMerge"] = m_memoryMerge;
+    json["memoryBalloon"] = m_memoryBalloon;
+    json["priority"] = m_priority;
+    if (!m_startAfter.isEmpty()) {
+        json["startAfter"] = QJsonArray::fromStringList(m_startAfter);
+    }
+    if (!m_warmPool.isEmpty()) {
+        json["warmPool"] = m_warmPool;
+    }
+    json["template"] = m_template;
+    if (!m_group.isEmpty()) {
+        json["group"] = m_group;
+    }
+    json["cpuCount"] = m_cpuCount;
+    json["cpuModel"] = m_cpuModel;
+    if (hasCPUTopology()) {
+        QJsonObject topology;
+        topology["sockets"] = m_cpuSockets;
+        topology["dies"] = m_cpuDies;
+        topology["cores"] = m_cpuCores;
+        topology["threads"] = m_cpuThreads;
+        json["cpuTopology"] = topology;
+    }
+    json["cpuPinning"] = m_cpuPinning;
+    if (m_cpuPinning == "manual") {
+        json["cpuSet"] = m_cpuSet;
+    }
+    json["deviceProfile"] = m_deviceProfile;
+    json["diskController"] = m_diskController;
+    json["hardDisks"] = QJsonArray::fromStringList(m_hardDisks);
+    json["ephemeral"] = m_ephemeral;
+    
+    QJsonObject diskFormats;
+    for (auto it = m_diskFormats.constBegin(); it != m_diskFormats.constEnd(); ++it) {
+        diskFormats[it.key()] = it.value();
+    }
+    json["diskFormats"] = diskFormats;
+    
+    QJsonObject diskTuning;
+    for (auto it = m_diskTuning.constBegin(); it != m_diskTuning.constEnd(); ++it) {
+        QJsonObject tuning;
+        tuning["cache"] = it.value().cache;
+        tuning["aio"] = it.value().aio;
+        tuning["discard"] = it.value().discard;
+        tuning["detectZeroes"] = it.value().detectZeroes;
+        tuning["iothread"] = it.value().iothread;
+        tuning["queues"] = it.value().queues;
+        diskTuning[it.key()] = tuning;
+    }
+    json["diskTuning"] = diskTuning;
+    json["cdromImage"] = m_cdromImage;
+    json["networkAdapters"] = QJsonArray::fromStringList(m_networkAdapters);
+    json["macAddress"] = m_macAddress;
+    json["bootOrder"] = QJsonArray::fromStringList(m_bootOrder);
+    json["createdDate"] = m_createdDate.toString(Qt::ISODate);
+    json["lastStarted"] = m_lastStarted.toString(Qt::ISODate);
+    return json;
 }
\ No newline at end of file
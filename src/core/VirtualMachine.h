@@ -5,7 +5,9 @@
 #include <QString>
 #include <QStringList>
 #include <QMap>
+#include <QList>
 #include <QDateTime>
+#include <QJsonObject>
 
 class VirtualMachine : public QObject
 {
@@ -22,7 +24,7 @@ public:
         Stopping
     };
     Q_ENUM(State)
-
+    
     explicit VirtualMachine(const QString &name, QObject *parent = nullptr);
     ~VirtualMachine();
     
@@ -39,6 +41,10 @@ public:
     QString getOSType() const { return m_osType; }
     void setOSType(const QString &osType) { m_osType = osType; }
     
+    // Backend that owns the VM ("qemu" or "libvirt")
+    QString getBackend() const { return m_backend; }
+    void setBackend(const QString &backend) { m_backend = backend; }
+    
     // State Management
     QString getState() const { return m_state; }
     void setState(const QString &state);
@@ -52,13 +58,103 @@ public:
     int getMemoryMB() const { return m_memoryMB; }
     void setMemoryMB(int memoryMB) { m_memoryMB = memoryMB; }
     
+    // Guest RAM backing: "anonymous" (plain -m), "memfd" or "hugepages"
+    QString getMemoryBacking() const { return m_memoryBacking; }
+    void setMemoryBacking(const QString &backing) { m_memoryBacking = backing; }
+    // Huge page size in KiB (2048 or 1048576) for the "hugepages" backing
+    int getHugePageSizeKB() const { return m_hugePageSizeKB; }
+    void setHugePageSizeKB(int sizeKB) { m_hugePageSizeKB = sizeKB; }
+    // Touch all guest RAM at startup using one thread per vCPU
+    bool isMemoryPrealloc() const { return m_memoryPrealloc; }
+    void setMemoryPrealloc(bool prealloc) { m_memoryPrealloc = prealloc; }
+    // share=on, required by vhost-user devices and virtiofsd
+    bool isMemoryShared() const { return m_memoryShared; }
+    void setMemoryShared(bool shared) { m_memoryShared = shared; }
+    // Let KSM merge identical guest pages (-machine mem-merge)
+    bool isMemoryMergeable() const { return m_memoryMerge; }
+    void setMemoryMergeable(bool mergeable) { m_memoryMerge = mergeable; }
+    // virtio-balloon device (paravirtualized profiles only)
+    bool isMemoryBalloonEnabled() const { return m_memoryBalloon; }
+    void setMemoryBalloonEnabled(bool enabled) { m_memoryBalloon = enabled; }
+    // Order in which the host memory-pressure controller reclaims memory:
+    // "low" guests first, then "normal"; "high" guests are never touched
+    QString getPriority() const { return m_priority; }
+    void setPriority(const QString &priority) { m_priority = priority; }
+    // VMs that must be up before this one in a bulk start (BootScheduler)
+    QStringList getStartAfter() const { return m_startAfter; }
+    void setStartAfter(const QStringList &vmNames) { m_startAfter = vmNames; }
+    // Template whose warm pool holds this standby instance (empty = not pooled)
+    QString getWarmPool() const { return m_warmPool; }
+    void setWarmPool(const QString &templateName) { m_warmPool = templateName; }
+    // Golden template: its disks are kept read-only as the base of the VMs
+    // created from it (KVMManager::createVMFromTemplate) and it never starts
+    bool isTemplate() const { return m_template; }
+    void setTemplate(bool isTemplate) { m_template = isTemplate; }
+    // Group of VMs that make up one application; group snapshots capture
+    // all of its members at the same instant (empty = no group)
+    QString getGroup() const { return m_group; }
+    void setGroup(const QString &group) { m_group = group; }
+    
     int getCPUCount() const { return m_cpuCount; }
     void setCPUCount(int cpuCount) { m_cpuCount = cpuCount; }
     
+    // "host-passthrough", "host-model" or a named QEMU model (e.g. "Skylake-Client")
+    QString getCPUModel() const { return m_cpuModel; }
+    void setCPUModel(const QString &model) { m_cpuModel = model; }
+    
+    // Guest CPU topology; sockets == 0 means a flat -smp with one core per socket
+    bool hasCPUTopology() const { return m_cpuSockets > 0; }
+    int getCPUSockets() const { return m_cpuSockets; }
+    int getCPUDies() const { return m_cpuDies; }
+    int getCPUCores() const { return m_cpuCores; }
+    int getCPUThreads() const { return m_cpuThreads; }
+    void setCPUTopology(int sockets, int dies, int cores, int threads);
+    void clearCPUTopology() { setCPUTopology(0, 1, 1, 1); }
+    
+    // Host placement of the vCPU threads: "none", "spread", "pack" or "manual"
+    // (the latter pins to the host CPU list in getCPUSet(), e.g. "2-5,8")
+    QString getCPUPinning() const { return m_cpuPinning; }
+    void setCPUPinning(const QString &policy) { m_cpuPinning = policy; }
+    QString getCPUSet() const { return m_cpuSet; }
+    void setCPUSet(const QString &cpuSet) { m_cpuSet = cpuSet; }
+    
+    // Emulated device set ("legacy", "virtio" or "q35-virtio")
+    QString getDeviceProfile() const { return m_deviceProfile; }
+    void setDeviceProfile(const QString &profile) { m_deviceProfile = profile; }
+    
+    // Paravirtual disk controller ("virtio-blk" or "virtio-scsi")
+    QString getDiskController() const { return m_diskController; }
+    void setDiskController(const QString &controller) { m_diskController = controller; }
+    
     // Storage Configuration
     QStringList getHardDisks() const { return m_hardDisks; }
     void setHardDisks(const QStringList &disks) { m_hardDisks = disks; }
     void addHardDisk(const QString &diskPath) { m_hardDisks.append(diskPath); }
+    // Ephemeral runs write to throwaway overlays (QEMU snapshot=on) in a
+    // scratch folder, usually tmpfs; the disks are never modified
+    bool isEphemeral() const { return m_ephemeral; }
+    void setEphemeral(bool ephemeral) { m_ephemeral = ephemeral; }
+    
+    // Image format recorded when the disk is added, so QEMU never has to
+    // guess it from guest-writable data (empty = not recorded yet)
+    QString getDiskFormat(const QString &diskPath) const { return m_diskFormats.value(diskPath); }
+    void setDiskFormat(const QString &diskPath, const QString &format) { m_diskFormats[diskPath] = format; }
+    
+    // Per-disk I/O options for the QEMU backend
+    struct DiskTuning {
+        QString cache = "writeback";    // none, writeback, unsafe
+        QString aio = "threads";        // threads, native, io_uring
+        bool discard = false;           // pass guest TRIM/UNMAP to the image
+        QString detectZeroes = "off";   // off, on, unmap
+        bool iothread = false;          // dedicated IOThread (virtio profiles)
+        int queues = 1;                 // virtqueues; 0 = one per vCPU
+    };
+    bool hasDiskTuning(const QString &diskPath) const { return m_diskTuning.contains(diskPath); }
+    DiskTuning getDiskTuning(const QString &diskPath) const { return m_diskTuning.value(diskPath); }
+    void setDiskTuning(const QString &diskPath, const DiskTuning &tuning) { m_diskTuning[diskPath] = tuning; }
+    // Swaps a disk for another image of the same chain (new overlay or merged
+    // base), keeping its position and tuning
+    void replaceHardDisk(const QString &oldPath, const QString &newPath, const QString &format);
     
     QString getCDROMImage() const { return m_cdromImage; }
     void setCDROMImage(const QString &image) { m_cdromImage = image; }
@@ -67,6 +163,11 @@ public:
     QStringList getNetworkAdapters() const { return m_networkAdapters; }
     void setNetworkAdapters(const QStringList &adapters) { m_networkAdapters = adapters; }
     void addNetworkAdapter(const QString &adapter) { m_networkAdapters.append(adapter); }
+    // Guest NIC address (empty = QEMU's default, the same for every VM)
+    QString getMacAddress() const { return m_macAddress; }
+    void setMacAddress(const QString &mac) { m_macAddress = mac; }
+    // Random locally administered address in the 52:54:00 range used by KVM
+    static QString generateMacAddress();
     
     // Audio Configuration
     QString getAudioController() const { return m_audioController; }
@@ -109,6 +210,23 @@ public:
     // Boot Configuration
     QStringList getBootOrder() const { return m_bootOrder; }
     void setBootOrder(const QStringList &order) { m_bootOrder = order; }
+    
+    // Snapshot tree metadata; the snapshots themselves live in the disk
+    // images, this only records what the images cannot (parent, description)
+    struct SnapshotInfo {
+        QString name;
+        QString parent;             // empty for a root snapshot
+        QString description;
+        QDateTime created;
+    };
+    QList<SnapshotInfo> getSnapshots() const { return m_snapshots; }
+    void setSnapshots(const QList<SnapshotInfo> &snapshots) { m_snapshots = snapshots; }
+    // Snapshot the current state descends from (last taken or restored)
+    QString getCurrentSnapshot() const { return m_currentSnapshot; }
+    void setCurrentSnapshot(const QString &name) { m_currentSnapshot = name; }
+    
+    // Serialization (machine-readable summary for kvmctl and scripting)
+    QJsonObject toJson() const;
 
 signals:
     void stateChanged(const QString &oldState, const QString &newState);
@@ -119,18 +237,43 @@ private:
     QString m_uuid;
     QString m_description;
     QString m_osType;
+    QString m_backend;
     QString m_state;
     
     // System configuration
     int m_memoryMB;
+    QString m_memoryBacking;
+    int m_hugePageSizeKB;
+    bool m_memoryPrealloc;
+    bool m_memoryShared;
+    bool m_memoryMerge;
+    bool m_memoryBalloon;
+    QString m_priority;
+    QStringList m_startAfter;
+    QString m_warmPool;
+    bool m_template;
+    QString m_group;
     int m_cpuCount;
+    QString m_cpuModel;
+    int m_cpuSockets;
+    int m_cpuDies;
+    int m_cpuCores;
+    int m_cpuThreads;
+    QString m_cpuPinning;
+    QString m_cpuSet;
+    QString m_deviceProfile;
+    QString m_diskController;
     
     // Storage configuration
     QStringList m_hardDisks;
+    QMap<QString, QString> m_diskFormats;
+    QMap<QString, DiskTuning> m_diskTuning;
     QString m_cdromImage;
+    bool m_ephemeral;
     
     // Network configuration
     QStringList m_networkAdapters;
+    QString m_macAddress;
     
     // Audio configuration
     QString m_audioController;
@@ -156,6 +299,10 @@ private:
     
     // Boot configuration
     QStringList m_bootOrder;
+    
+    // Snapshots
+    QList<SnapshotInfo> m_snapshots;
+    QString m_currentSnapshot;
 };
 
 #endif // VIRTUALMACHINE_H
\ No newline at end of file
@@ -0,0 +1,595 @@
+#include "WarmPool.h"
+#include "KVMManager.h"
+#include "QemuManager.h"
+#include "VirtualMachine.h"
+
+#include <QTimer>
+#include <QSettings>
+#include <QPointer>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QUuid>
+#include <QJsonArray>
+#include <QDebug>
+
+WarmPool::WarmPool(KVMManager *kvmManager, QObject *parent)
+    : QObject(parent)
+    , m_kvmManager(kvmManager)
+    , m_timer(new QTimer(this))
+    , m_started(false)
+{
+    // El sondeo cubre los tiempos de espera; las señales de disponibilidad
+    // aparcan la instancia en cuanto el invitado está listo
+    m_timer->setInterval(5000);
+    connect(m_timer, &QTimer::timeout, this, &WarmPool::refill);
+    connect(m_kvmManager->getQemuManager(), &QemuManager::qmpReady, this, &WarmPool::refill);
+    connect(m_kvmManager->getQemuManager(), &QemuManager::guestAgentChanged, this, &WarmPool::refill);
+}
+
+WarmPool::Pool WarmPool::Policy::pool(const QString &templateName) const
+{
+    for (const Pool &pool : pools) {
+        if (pool.templateName == templateName) {
+            return pool;
+        }
+    }
+    Pool empty;
+    empty.templateName = templateName;
+    return empty;
+}
+
+WarmPool::Policy WarmPool::loadPolicy()
+{
+    QSettings settings;
+    Policy policy;
+    
+    policy.enabled = settings.value("warmPool/enabled", policy.enabled).toBool();
+    policy.memoryBudgetMB = qBound(0, settings.value("warmPool/memoryBudgetMB", policy.memoryBudgetMB).toInt(), 1024 * 1024);
+    policy.maxParallel = qBound(1, settings.value("warmPool/maxParallel", policy.maxParallel).toInt(), 16);
+    policy.bootDelaySecs = qBound(0, settings.value("warmPool/bootDelaySecs", policy.bootDelaySecs).toInt(), 600);
+    policy.readyTimeoutSecs = qBound(30, settings.value("warmPool/readyTimeoutSecs", policy.readyTimeoutSecs).toInt(), 3600);
+    
+    int count = settings.beginReadArray("warmPool/pools");
+    for (int i = 0; i < count; ++i) {
+        settings.setArrayIndex(i);
+        Pool pool;
+        pool.templateName = settings.value("template").toString();
+        pool.size = qBound(0, settings.value("size").toInt(), 64);
+        QString park = settings.value("park", pool.park).toString();
+        if (parkModes().contains(park)) {
+            pool.park = park;
+        }
+        if (!pool.templateName.isEmpty()) {
+            policy.pools.append(pool);
+        }
+    }
+    settings.endArray();
+    
+    return policy;
+}
+
+void WarmPool::savePolicy(const Policy &policy)
+{
+    QSettings settings;
+    settings.setValue("warmPool/enabled", policy.enabled);
+    settings.setValue("warmPool/memoryBudgetMB", policy.memoryBudgetMB);
+    settings.setValue("warmPool/maxParallel", policy.maxParallel);
+    settings.setValue("warmPool/bootDelaySecs", policy.bootDelaySecs);
+    settings.setValue("warmPool/readyTimeoutSecs", policy.readyTimeoutSecs);
+    
+    settings.remove("warmPool/pools");
+    settings.beginWriteArray("warmPool/pools", policy.pools.size());
+    for (int i = 0; i < policy.pools.size(); ++i) {
+        settings.setArrayIndex(i);
+        settings.setValue("template", policy.pools.at(i).templateName);
+        settings.setValue("size", policy.pools.at(i).size);
+        settings.setValue("park", policy.pools.at(i).park);
+    }
+    settings.endArray();
+}
+
+QStringList WarmPool::parkModes()
+{
+    return {"saved", "paused"};
+}
+
+void WarmPool::start()
+{
+    if (m_started) {
+        return;
+    }
+    m_started = true;
+    m_timer->start();
+    QTimer::singleShot(0, this, &WarmPool::refill);
+}
+
+void WarmPool::setPool(const QString &templateName, int size, const QString &park)
+{
+    Policy policy = loadPolicy();
+    size = qBound(0, size, 64);
+    
+    bool found = false;
+    for (int i = 0; i < policy.pools.size(); ++i) {
+        if (policy.pools.at(i).templateName != templateName) {
+            continue;
+        }
+        found = true;
+        if (size == 0) {
+            policy.pools.removeAt(i);
+        } else {
+            policy.pools[i].size = size;
+            if (parkModes().contains(park)) {
+                policy.pools[i].park = park;
+            }
+        }
+        break;
+    }
+    if (!found && size > 0) {
+        Pool pool;
+        pool.templateName = templateName;
+        pool.size = size;
+        if (parkModes().contains(park)) {
+            pool.park = park;
+        }
+        policy.pools.append(pool);
+    }
+    
+    savePolicy(policy);
+    m_backoff.remove(templateName);
+    emit poolChanged(templateName);
+    if (m_started) {
+        QTimer::singleShot(0, this, &WarmPool::refill);
+    }
+}
+
+QStringList WarmPool::instances(const QString &templateName) const
+{
+    QStringList names;
+    for (const QString &name : m_kvmManager->getVirtualMachines()) {
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(name);
+        if (vm && vm->getWarmPool() == templateName
+                && !(m_stages.contains(name) && m_stages.value(name).stage == Discarding)) {
+            names.append(name);
+        }
+    }
+    return names;
+}
+
+QStringList WarmPool::readyInstances(const QString &templateName) const
+{
+    // Las pausadas primero: reanudarlas no lee nada del disco
+    QStringList paused;
+    QStringList saved;
+    for (const QString &name : instances(templateName)) {
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(name);
+        if (m_stages.contains(name) || !isReady(vm)) {
+            continue;
+        }
+        (vm->getState() == "paused" ? paused : saved).append(name);
+    }
+    return paused + saved;
+}
+
+bool WarmPool::isReady(VirtualMachine *vm) const
+{
+    return vm && (vm->getState() == "saved" || vm->getState() == "paused");
+}
+
+QJsonObject WarmPool::status() const
+{
+    Policy policy = loadPolicy();
+    
+    QStringList templates;
+    for (const Pool &pool : policy.pools) {
+        templates.append(pool.templateName);
+    }
+    for (const QString &name : m_kvmManager->getVirtualMachines()) {
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(name);
+        if (vm && !vm->getWarmPool().isEmpty() && !templates.contains(vm->getWarmPool())) {
+            templates.append(vm->getWarmPool());
+        }
+    }
+    
+    QJsonArray pools;
+    for (const QString &templateName : templates) {
+        Pool pool = policy.pool(templateName);
+        QJsonArray members;
+        for (const QString &name : instances(templateName)) {
+            VirtualMachine *vm = m_kvmManager->getVirtualMachine(name);
+            QJsonObject member;
+            member["name"] = name;
+            member["stage"] = stageName(vm);
+            member["state"] = vm->getState();
+            member["memoryMB"] = vm->getMemoryMB();
+            members.append(member);
+        }
+        
+        QJsonObject entry;
+        entry["template"] = templateName;
+        entry["size"] = pool.size;
+        entry["park"] = pool.park;
+        entry["ready"] = int(readyInstances(templateName).size());
+        entry["failures"] = m_backoff.value(templateName).failures;
+        entry["instances"] = members;
+        pools.append(entry);
+    }
+    
+    QJsonObject result;
+    result["started"] = m_started;
+    result["enabled"] = policy.enabled;
+    result["memoryBudgetMB"] = policy.memoryBudgetMB;
+    result["memoryUsedMB"] = usedMemoryMB();
+    result["maxParallel"] = policy.maxParallel;
+    result["pools"] = pools;
+    return result;
+}
+
+QString WarmPool::stageName(VirtualMachine *vm) const
+{
+    if (m_stages.contains(vm->getName())) {
+        switch (m_stages.value(vm->getName()).stage) {
+        case Launching: return "launching";
+        case Booting: return "booting";
+        case Parking: return "parking";
+        case Discarding: return "discarding";
+        }
+    }
+    return isReady(vm) ? "ready" : vm->getState();
+}
+
+void WarmPool::acquire(const QString &templateName, VMBackend::Callback callback)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QPointer<WarmPool> self(this);
+    
+    auto handOut = [self, callback, timer](const QString &vmName, const QString &from) {
+        return [self, callback, timer, vmName, from](const VMBackend::Result &result) {
+            if (result.ok) {
+                QJsonObject value;
+                value["name"] = vmName;
+                value["warm"] = from != "cold";
+                value["from"] = from;
+                value["msecs"] = timer.elapsed();
+                callback(VMBackend::success(value));
+            } else {
+                callback(result);
+            }
+            // La reserva se repone fuera de la entrega
+            if (self && self->m_started) {
+                QTimer::singleShot(0, self, &WarmPool::refill);
+            }
+        };
+    };
+    
+    QStringList ready = readyInstances(templateName);
+    if (!ready.isEmpty()) {
+        // Fuera de la reserva antes de arrancar: ya no se repone ni se descarta
+        QString vmName = ready.first();
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(vmName);
+        QString from = vm->getState();
+        vm->setWarmPool(QString());
+        vm->setDescription(tr("Clon enlazado de %1").arg(templateName));
+        m_kvmManager->saveVMConfiguration(vm);
+        emit poolChanged(templateName);
+        
+        qDebug() << "WarmPool: entregando" << vmName << "(" << from << ") de" << templateName;
+        if (from == "paused") {
+            m_kvmManager->resumeVMAsync(vmName, handOut(vmName, from));
+            return;
+        }
+        // QEMU arranca enseguida y carga la memoria con -incoming en segundo
+        // plano: la instancia no está lista hasta que el invitado corre
+        KVMManager *kvmManager = m_kvmManager;
+        VMBackend::Callback done = handOut(vmName, from);
+        qint64 startMs = QDateTime::currentMSecsSinceEpoch();
+        kvmManager->startVMAsync(vmName, [kvmManager, vmName, startMs, done](const VMBackend::Result &result) {
+            if (!result.ok) {
+                done(result);
+                return;
+            }
+            kvmManager->waitForRestore(vmName, QJsonObject(), startMs, done);
+        });
+        return;
+    }
+    
+    // Sin instancias listas: un clon enlazado arrancado en frío
+    QString reason;
+    if (!canSpawn(templateName, &reason)) {
+        callback(VMBackend::failure(reason));
+        return;
+    }
+    QString vmName = generateName(templateName);
+    if (!m_kvmManager->createLinkedClone(templateName, vmName)) {
+        callback(VMBackend::failure(tr("No se pudo crear un clon enlazado de '%1'").arg(templateName)));
+        return;
+    }
+    qDebug() << "WarmPool: reserva de" << templateName << "vacía; arranque en frío de" << vmName;
+    m_kvmManager->startVMAsync(vmName, handOut(vmName, "cold"));
+}
+
+void WarmPool::refill()
+{
+    if (!m_started) {
+        return;
+    }
+    
+    Policy policy = loadPolicy();
+    adopt(policy);
+    
+    for (const QString &vmName : m_stages.keys()) {
+        if (m_stages.contains(vmName) && m_stages.value(vmName).stage == Booting) {
+            checkBooting(vmName, policy);
+        }
+    }
+    
+    if (!policy.enabled) {
+        return;
+    }
+    
+    // Sobrantes: plantillas sin reserva o con más instancias de las pedidas.
+    // Sólo se descartan instancias listas, las más nuevas primero
+    QStringList templates;
+    for (const QString &name : m_kvmManager->getVirtualMachines()) {
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(name);
+        if (vm && !vm->getWarmPool().isEmpty() && !templates.contains(vm->getWarmPool())) {
+            templates.append(vm->getWarmPool());
+        }
+    }
+    for (const QString &templateName : templates) {
+        int excess = instances(templateName).size() - policy.pool(templateName).size;
+        QStringList ready = readyInstances(templateName);
+        while (excess-- > 0 && !ready.isEmpty()) {
+            discard(ready.takeLast());
+        }
+    }
+    
+    for (const Pool &pool : policy.pools) {
+        while (pool.size > instances(pool.templateName).size()) {
+            if (inFlight() >= policy.maxParallel) {
+                return;
+            }
+            
+            Backoff backoff = m_backoff.value(pool.templateName);
+            if (backoff.failures >= MaxFailures) {
+                if (backoff.lastFailure.elapsed() < BackoffSecs * 1000LL) {
+                    break;
+                }
+                m_backoff.remove(pool.templateName);
+            }
+            
+            QString reason;
+            if (!canSpawn(pool.templateName, &reason)) {
+                break;
+            }
+            VirtualMachine *templateVM = m_kvmManager->getVirtualMachine(pool.templateName);
+            if (usedMemoryMB() + templateVM->getMemoryMB() > policy.memoryBudgetMB) {
+                break;
+            }
+            
+            spawn(pool);
+        }
+    }
+}
+
+void WarmPool::adopt(const Policy &policy)
+{
+    // Instancias que este proceso no ha visto nacer (otra sesión, reinicio)
+    for (const QString &name : m_kvmManager->getVirtualMachines()) {
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(name);
+        if (!vm || vm->getWarmPool().isEmpty() || m_stages.contains(name)) {
+            continue;
+        }
+        
+        QString state = vm->getState();
+        if (state == "running") {
+            setStage(name, vm->getWarmPool(), Booting);
+        } else if (!isReady(vm)) {
+            // Apagada: un arranque que no llegó a aparcarse. Se respeta un
+            // margen por si otro proceso la acaba de crear
+            QFileInfo directory(QemuManager::vmDirectory(name));
+            if (directory.lastModified().secsTo(QDateTime::currentDateTime()) > policy.readyTimeoutSecs) {
+                discard(name);
+            }
+        }
+    }
+}
+
+void WarmPool::spawn(const Pool &pool)
+{
+    QString templateName = pool.templateName;
+    QString vmName = generateName(templateName + "-warm");
+    if (!m_kvmManager->createLinkedClone(templateName, vmName)) {
+        recordFailure(templateName);
+        return;
+    }
+    
+    VirtualMachine *vm = m_kvmManager->getVirtualMachine(vmName);
+    vm->setWarmPool(templateName);
+    vm->setDescription(tr("Instancia en espera de %1").arg(templateName));
+    m_kvmManager->saveVMConfiguration(vm);
+    setStage(vmName, templateName, Launching);
+    emit poolChanged(templateName);
+    
+    qDebug() << "WarmPool: arrancando" << vmName << "para la reserva de" << templateName;
+    QPointer<WarmPool> self(this);
+    m_kvmManager->startVMAsync(vmName, [self, vmName, templateName](const VMBackend::Result &result) {
+        if (!self) {
+            return;
+        }
+        if (!result.ok) {
+            self->discard(vmName, result.error);
+        } else if (self->m_stages.contains(vmName) && self->m_stages.value(vmName).stage == Launching) {
+            self->setStage(vmName, templateName, Booting);
+        }
+    });
+}
+
+void WarmPool::checkBooting(const QString &vmName, const Policy &policy)
+{
+    VirtualMachine *vm = m_kvmManager->getVirtualMachine(vmName);
+    if (!vm) {
+        m_stages.remove(vmName);
+        return;
+    }
+    
+    QemuManager *qemuManager = m_kvmManager->getQemuManager();
+    qint64 elapsed = m_stages.value(vmName).since.elapsed();
+    if (!qemuManager->isVMRunning(vmName)) {
+        discard(vmName, tr("QEMU terminó antes de que el invitado estuviera listo"));
+        return;
+    }
+    
+    // Con agente, su canal; sin él, QMP y un margen para que el invitado arranque
+    bool ready = QemuManager::hasGuestAgentChannel(vm)
+                 ? qemuManager->isGuestAgentConnected(vmName)
+                 : qemuManager->isQmpReady(vmName) && elapsed >= policy.bootDelaySecs * 1000LL;
+    if (ready) {
+        park(vmName);
+    } else if (elapsed > policy.readyTimeoutSecs * 1000LL) {
+        discard(vmName, tr("el invitado no estuvo listo tras %1 s").arg(policy.readyTimeoutSecs));
+    }
+}
+
+void WarmPool::park(const QString &vmName)
+{
+    QString templateName = m_stages.value(vmName).templateName;
+    setStage(vmName, templateName, Parking);
+    
+    QPointer<WarmPool> self(this);
+    auto parked = [self, vmName, templateName](const VMBackend::Result &result) {
+        if (!self) {
+            return;
+        }
+        if (!result.ok) {
+            self->discard(vmName, result.error);
+            return;
+        }
+        self->m_stages.remove(vmName);
+        self->m_backoff.remove(templateName);
+        qDebug() << "WarmPool:" << vmName << "lista en la reserva de" << templateName;
+        emit self->instanceReady(templateName, vmName);
+        emit self->poolChanged(templateName);
+    };
+    
+    if (loadPolicy().pool(templateName).park == "paused") {
+        m_kvmManager->pauseVMAsync(vmName, parked);
+    } else {
+        m_kvmManager->saveVMStateAsync(vmName, parked);
+    }
+}
+
+void WarmPool::discard(const QString &vmName, const QString &error)
+{
+    VirtualMachine *vm = m_kvmManager->getVirtualMachine(vmName);
+    QString templateName = vm ? vm->getWarmPool() : m_stages.value(vmName).templateName;
+    if (!error.isEmpty()) {
+        qWarning().noquote() << "WarmPool:" << vmName << "descartada -" << error;
+        recordFailure(templateName);
+        emit instanceFailed(templateName, vmName, error);
+    }
+    setStage(vmName, templateName, Discarding);
+    
+    // Parar una instancia guardada sólo borra su estado; luego se van la
+    // configuración, la capa y los archivos de ejecución
+    QPointer<WarmPool> self(this);
+    auto remove = [self, vmName, templateName]() {
+        if (!self) {
+            return;
+        }
+        if (self->m_kvmManager->getVirtualMachine(vmName)) {
+            self->m_kvmManager->deleteVirtualMachine(vmName);
+        }
+        QDir(QemuManager::vmDirectory(vmName)).removeRecursively();
+        self->m_stages.remove(vmName);
+        emit self->poolChanged(templateName);
+    };
+    
+    if (vm && vm->getState() != "shut off") {
+        m_kvmManager->stopVMAsync(vmName, [remove](const VMBackend::Result &) {
+            remove();
+        });
+    } else {
+        remove();
+    }
+}
+
+void WarmPool::recordFailure(const QString &templateName)
+{
+    Backoff &backoff = m_backoff[templateName];
+    backoff.failures++;
+    backoff.lastFailure.start();
+    if (backoff.failures == MaxFailures) {
+        qWarning().noquote() << "WarmPool:" << MaxFailures << "fallos seguidos con" << templateName
+                             << "- se reintenta dentro de" << BackoffSecs << "s";
+    }
+}
+
+void WarmPool::setStage(const QString &vmName, const QString &templateName, Stage stage)
+{
+    Transient &transient = m_stages[vmName];
+    transient.templateName = templateName;
+    transient.stage = stage;
+    transient.since.start();
+}
+
+bool WarmPool::canSpawn(const QString &templateName, QString *reason) const
+{
+    VirtualMachine *vm = m_kvmManager->getVirtualMachine(templateName);
+    if (!vm) {
+        *reason = tr("La plantilla '%1' no existe").arg(templateName);
+        return false;
+    }
+    if (vm->getBackend() != "qemu") {
+        *reason = tr("La reserva sólo admite plantillas con el backend QEMU");
+        return false;
+    }
+    if (!vm->getWarmPool().isEmpty()) {
+        *reason = tr("'%1' es una instancia de reserva, no una plantilla").arg(templateName);
+        return false;
+    }
+    // Los clones leen de sus discos: sólo una plantilla garantiza que no
+    // cambien (no arranca ni admite capas) mientras existan
+    if (!vm->isTemplate()) {
+        *reason = tr("'%1' no está marcada como plantilla").arg(templateName);
+        return false;
+    }
+    return true;
+}
+
+int WarmPool::inFlight() const
+{
+    int count = 0;
+    for (const Transient &transient : m_stages) {
+        if (transient.stage != Discarding) {
+            count++;
+        }
+    }
+    return count;
+}
+
+qint64 WarmPool::usedMemoryMB() const
+{
+    qint64 total = 0;
+    for (const QString &name : m_kvmManager->getVirtualMachines()) {
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(name);
+        if (!vm || vm->getWarmPool().isEmpty()) {
+            continue;
+        }
+        bool inFlight = m_stages.contains(name) && m_stages.value(name).stage != Discarding;
+        if (inFlight || vm->getState() == "running" || vm->getState() == "paused") {
+            total += vm->getMemoryMB();
+        }
+    }
+    return total;
+}
+
+QString WarmPool::generateName(const QString &prefix) const
+{
+    QString name;
+    do {
+        name = prefix + "-" + QUuid::createUuid().toString(QUuid::Id128).left(8);
+    } while (m_kvmManager->getVirtualMachine(name));
+    return name;
+}
\ No newline at end of file
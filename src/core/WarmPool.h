@@ -0,0 +1,131 @@
+#ifndef WARMPOOL_H
+#define WARMPOOL_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QList>
+#include <QJsonObject>
+#include <QElapsedTimer>
+
+#include "VMBackend.h"
+
+class QTimer;
+class KVMManager;
+class VirtualMachine;
+
+/**
+ * @brief Reserva de VMs arrancadas de antemano ("warm pool")
+ * Para cada plantilla configurada mantiene N instancias en espera: clones
+ * enlazados (una capa qcow2 fina por disco) que se arrancan, se esperan
+ * hasta que el invitado está listo y se aparcan suspendidas a disco o en
+ * pausa. acquire() entrega una de ellas (reanudarla es inmediato y
+ * restaurarla tarda lo que la lectura del estado) y repone la reserva en
+ * segundo plano, sin pasar nunca del presupuesto de memoria: cuentan las
+ * instancias que arrancan y las aparcadas en pausa.
+ *
+ * Cada instancia lleva en su configuración la plantilla a la que pertenece
+ * (VirtualMachine::getWarmPool()); junto con su estado es lo único que se
+ * guarda, de modo que otra instancia del gestor adopta la reserva tal como
+ * la encuentra. La reposición sólo corre tras start().
+ */
+class WarmPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Pool {
+        QString templateName;
+        int size = 0;                   // instancias listas que se mantienen
+        QString park = "saved";         // "saved" (sin RAM) o "paused" (entrega inmediata)
+    };
+    
+    // Política configurable (grupo "warmPool" de QSettings)
+    struct Policy {
+        bool enabled = true;
+        int memoryBudgetMB = 8192;      // RAM de las instancias arrancando o en pausa
+        int maxParallel = 2;            // instancias arrancando a la vez
+        int bootDelaySecs = 45;         // espera tras QMP si el invitado no tiene agente
+        int readyTimeoutSecs = 180;
+        QList<Pool> pools;
+        
+        Pool pool(const QString &templateName) const;
+    };
+    
+    explicit WarmPool(KVMManager *kvmManager, QObject *parent = nullptr);
+    
+    static Policy loadPolicy();
+    static void savePolicy(const Policy &policy);
+    static QStringList parkModes();
+    
+    // Empieza a reponer (la GUI y "kvmctl serve"); sin ello sólo entrega
+    void start();
+    bool isStarted() const { return m_started; }
+    
+    // Tamaño 0 vacía la reserva de la plantilla
+    void setPool(const QString &templateName, int size, const QString &park);
+    QStringList instances(const QString &templateName) const;
+    // Política, memoria usada y cada instancia con su etapa
+    QJsonObject status() const;
+    
+    // Entrega una instancia lista (o, si no hay, un clon enlazado arrancado
+    // en frío) y la saca de la reserva: result.value = {name, warm, from, msecs}
+    void acquire(const QString &templateName, VMBackend::Callback callback);
+
+signals:
+    void poolChanged(const QString &templateName);
+    void instanceReady(const QString &templateName, const QString &vmName);
+    void instanceFailed(const QString &templateName, const QString &vmName, const QString &error);
+
+private slots:
+    void refill();
+
+private:
+    // Etapas que sólo existen en este proceso; las instancias guardadas o
+    // en pausa sin etapa están listas
+    enum Stage {
+        Launching,      // clon creado, arranque enviado
+        Booting,        // en marcha, esperando al invitado
+        Parking,        // suspendiendo o pausando
+        Discarding
+    };
+    
+    struct Transient {
+        QString templateName;
+        Stage stage = Launching;
+        QElapsedTimer since;
+    };
+    
+    // Fallos seguidos por plantilla: tras MaxFailures se espera antes de reintentar
+    struct Backoff {
+        int failures = 0;
+        QElapsedTimer lastFailure;
+    };
+    
+    static const int MaxFailures = 3;
+    static const int BackoffSecs = 300;
+    
+    void adopt(const Policy &policy);
+    void spawn(const Pool &pool);
+    void checkBooting(const QString &vmName, const Policy &policy);
+    void park(const QString &vmName);
+    void discard(const QString &vmName, const QString &error = QString());
+    void recordFailure(const QString &templateName);
+    void setStage(const QString &vmName, const QString &templateName, Stage stage);
+    bool isReady(VirtualMachine *vm) const;
+    bool canSpawn(const QString &templateName, QString *reason) const;
+    QStringList readyInstances(const QString &templateName) const;
+    int inFlight() const;
+    qint64 usedMemoryMB() const;
+    QString stageName(VirtualMachine *vm) const;
+    QString generateName(const QString &prefix) const;
+    
+    KVMManager *m_kvmManager;
+    QTimer *m_timer;
+    bool m_started;
+    QHash<QString, Transient> m_stages;
+    QHash<QString, Backoff> m_backoff;
+};
+
+#endif // WARMPOOL_H
\ No newline at end of file
@@ -2,6 +2,9 @@
 #include "../core/VirtualMachine.h"
 #include "../core/KVMManager.h"
 #include "../core/QemuManager.h"
+#include "../core/DiskImageProbe.h"
+#include "../core/HostInfo.h"
+#include "../core/AdmissionController.h"
 
 #include <QApplication>
 #include <QMessageBox>
@@ -17,6 +20,9 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QRandomGenerator>
+#include <QStorageInfo>
+#include <QStandardItemModel>
+#include <QSignalBlocker>
 
 AdvancedVMConfigDialog::AdvancedVMConfigDialog(VirtualMachine *vm, KVMManager *kvmManager, QWidget *parent)
     : QDialog(parent)
@@ -137,17 +143,66 @@ void AdvancedVMConfigDialog::setupSystemTab()
     connect(m_memorySpin, QOverload<int>::of(&QSpinBox::valueChanged), this, &AdvancedVMConfigDialog::onMemorySpinChanged);
     
     m_memoryInfoLabel = new QLabel;
+    m_memoryInfoLabel->setWordWrap(true);
     
-    // Host memory usage bar
+    // Host memory committed by running VMs plus this one (admission ledger)
     m_hostMemoryBar = new QProgressBar;
     m_hostMemoryBar->setMaximum(100);
-    m_hostMemoryBar->setFormat("Memoria del Host: %p%");
     
     memoryLayout->addWidget(m_memorySlider, 0, 1);
     memoryLayout->addWidget(m_memorySpin, 0, 2);
     memoryLayout->addWidget(m_memoryInfoLabel, 1, 0, 1, 3);
     memoryLayout->addWidget(m_hostMemoryBar, 2, 0, 1, 3);
     
+    // Memory backing: huge pages avoid TLB misses and THP compaction stalls
+    m_memoryBackingCombo = new QComboBox;
+    m_memoryBackingCombo->addItem("Memoria anónima", "anonymous");
+    m_memoryBackingCombo->addItem("memfd", "memfd");
+    m_memoryBackingCombo->addItem("Páginas enormes (hugetlb)", "hugepages");
+    
+    m_hugePageSizeCombo = new QComboBox;
+    QList<HostInfo::HugePagePool> pools = HostInfo::hugePagePools();
+    if (pools.isEmpty()) {
+        pools << HostInfo::HugePagePool{2048, 0, 0} << HostInfo::HugePagePool{1024 * 1024, 0, 0};
+    }
+    for (const HostInfo::HugePagePool &pool : pools) {
+        m_hugePageSizeCombo->addItem(pool.sizeKB >= 1024 * 1024 ? QString("%1 GB").arg(pool.sizeKB / (1024 * 1024))
+                                                                : QString("%1 MB").arg(pool.sizeKB / 1024), pool.sizeKB);
+    }
+    
+    m_memoryPreallocCheck = new QCheckBox("Reservar toda la memoria al arrancar");
+    m_memoryPreallocCheck->setToolTip("Evita los fallos de página del primer acceso; "
+                                      "se usa un hilo por vCPU para que el arranque no se alargue");
+    m_memoryShareCheck = new QCheckBox("Memoria compartida (share=on)");
+    m_memoryShareCheck->setToolTip("Necesaria para dispositivos vhost-user y virtiofs");
+    m_memoryMergeCheck = new QCheckBox("Permitir que KSM fusione páginas idénticas (mem-merge)");
+    m_memoryMergeCheck->setToolTip("Ahorra RAM cuando hay varios invitados parecidos a cambio de CPU del hilo ksmd; "
+                                   "no se aplica a las páginas enormes");
+    
+    m_hugePagesInfoLabel = new QLabel;
+    m_hugePagesInfoLabel->setWordWrap(true);
+    
+    connect(m_memoryBackingCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &AdvancedVMConfigDialog::updateHugePagesInfo);
+    connect(m_hugePageSizeCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &AdvancedVMConfigDialog::updateHugePagesInfo);
+    
+    memoryLayout->addWidget(new QLabel("Respaldo:"), 3, 0);
+    memoryLayout->addWidget(m_memoryBackingCombo, 3, 1);
+    memoryLayout->addWidget(m_hugePageSizeCombo, 3, 2);
+    memoryLayout->addWidget(m_hugePagesInfoLabel, 4, 0, 1, 3);
+    memoryLayout->addWidget(m_memoryPreallocCheck, 5, 0, 1, 3);
+    memoryLayout->addWidget(m_memoryShareCheck, 6, 0, 1, 3);
+    memoryLayout->addWidget(m_memoryMergeCheck, 7, 0, 1, 3);
+    
+    // Order in which the host memory-pressure controller reclaims memory
+    m_memoryPriorityCombo = new QComboBox;
+    m_memoryPriorityCombo->addItem("Baja (se recupera primero)", "low");
+    m_memoryPriorityCombo->addItem("Normal", "normal");
+    m_memoryPriorityCombo->addItem("Alta (nunca se toca)", "high");
+    m_memoryPriorityCombo->setToolTip("Cuando el anfitrión se queda sin memoria se encoge el balón, "
+                                      "se pausa y por último se suspende a disco, empezando por las VMs de prioridad baja");
+    memoryLayout->addWidget(new QLabel("Prioridad ante falta de memoria:"), 8, 0);
+    memoryLayout->addWidget(m_memoryPriorityCombo, 8, 1, 1, 2);
+    
     // Processor Configuration
     auto *cpuGroup = new QGroupBox("Procesador");
     auto *cpuLayout = new QFormLayout(cpuGroup);
@@ -163,11 +218,89 @@ void AdvancedVMConfigDialog::setupSystemTab()
     m_enablePAECheck = new QCheckBox("Habilitar PAE/NX");
     m_enableVTxCheck = new QCheckBox("Habilitar VT-x/AMD-V");
     
+    // CPU model: host passthrough exposes every host feature to the guest
+    m_cpuModelCombo = new QComboBox;
+    m_cpuModelCombo->addItem("Anfitrión (host-passthrough)", "host-passthrough");
+    m_cpuModelCombo->addItem("Modelo del anfitrión (host-model)", "host-model");
+    if (m_kvmManager && m_kvmManager->getQemuManager()) {
+        for (const QString &model : m_kvmManager->getQemuManager()->getCpuModels()) {
+            m_cpuModelCombo->addItem(model, model);
+        }
+    }
+    m_cpuModelCombo->setToolTip("host-passthrough ofrece el mejor rendimiento; "
+                                "los modelos con nombre facilitan mover la VM entre anfitriones distintos.\n"
+                                "Las características no migrables (invtsc) quedan ocultas: con migratable=off "
+                                "no se podría guardar el estado, crear puntos de control con memoria ni hacer fork");
+    
+    // Guest topology: sockets x dies x cores x threads = vCPUs
+    m_customTopologyCheck = new QCheckBox("Topología personalizada");
+    auto *topologyLayout = new QHBoxLayout;
+    m_cpuSocketsSpin = new QSpinBox;
+    m_cpuDiesSpin = new QSpinBox;
+    m_cpuCoresSpin = new QSpinBox;
+    m_cpuThreadsSpin = new QSpinBox;
+    const QList<QPair<QSpinBox*, QString>> topologySpins = {
+        {m_cpuSocketsSpin, "Sockets"}, {m_cpuDiesSpin, "Dies"},
+        {m_cpuCoresSpin, "Núcleos"}, {m_cpuThreadsSpin, "Hilos"}
+    };
+    for (const auto &entry : topologySpins) {
+        entry.first->setRange(1, 32);
+        entry.first->setEnabled(false);
+        topologyLayout->addWidget(new QLabel(entry.second + ":"));
+        topologyLayout->addWidget(entry.first);
+        connect(entry.first, QOverload<int>::of(&QSpinBox::valueChanged), this, &AdvancedVMConfigDialog::updateCpuTopologyInfo);
+    }
+    connect(m_customTopologyCheck, &QCheckBox::toggled, this, &AdvancedVMConfigDialog::updateCpuTopologyInfo);
+    
+    m_cpuTopologyInfoLabel = new QLabel;
+    m_cpuTopologyInfoLabel->setWordWrap(true);
+    
+    // Host placement of the vCPU threads
+    m_cpuPinningCombo = new QComboBox;
+    m_cpuPinningCombo->addItem("Sin fijar", "none");
+    m_cpuPinningCombo->addItem("Repartir entre nodos NUMA", "spread");
+    m_cpuPinningCombo->addItem("Agrupar en un nodo NUMA", "pack");
+    m_cpuPinningCombo->addItem("CPUs del anfitrión indicadas", "manual");
+    m_cpuPinningCombo->setToolTip("Las vCPUs se fijan a CPUs del anfitrión al arrancar, "
+                                  "teniendo en cuenta las demás VMs en ejecución");
+    m_cpuSetEdit = new QLineEdit;
+    m_cpuSetEdit->setPlaceholderText("p. ej. 2-5,8");
+    m_cpuSetEdit->setEnabled(false);
+    connect(m_cpuPinningCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), [this]() {
+        m_cpuSetEdit->setEnabled(m_cpuPinningCombo->currentData().toString() == "manual");
+    });
+    
     cpuLayout->addRow("&Procesadores:", m_cpuCountSpin);
+    cpuLayout->addRow("&Modelo de CPU:", m_cpuModelCombo);
+    cpuLayout->addRow(m_customTopologyCheck);
+    cpuLayout->addRow(topologyLayout);
+    cpuLayout->addRow(m_cpuTopologyInfoLabel);
+    cpuLayout->addRow("&Ubicación:", m_cpuPinningCombo);
+    cpuLayout->addRow("CPUs del &anfitrión:", m_cpuSetEdit);
     cpuLayout->addRow("&Chipset:", m_chipsetCombo);
     cpuLayout->addRow(m_enablePAECheck);
     cpuLayout->addRow(m_enableVTxCheck);
     
+    // Device Profile
+    auto *devicesGroup = new QGroupBox("Dispositivos");
+    auto *devicesLayout = new QFormLayout(devicesGroup);
+    
+    m_deviceProfileCombo = new QComboBox;
+    m_deviceProfileCombo->addItem("Legado (IDE, e1000, VGA)", "legacy");
+    m_deviceProfileCombo->addItem("Paravirtualizado (virtio)", "virtio");
+    m_deviceProfileCombo->addItem("Q35 + virtio", "q35-virtio");
+    m_deviceProfileCombo->setToolTip("Los perfiles virtio requieren drivers virtio en el sistema invitado");
+    
+    m_diskControllerCombo = new QComboBox;
+    m_diskControllerCombo->addItem("virtio-blk", "virtio-blk");
+    m_diskControllerCombo->addItem("virtio-scsi", "virtio-scsi");
+    connect(m_deviceProfileCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), [this]() {
+        m_diskControllerCombo->setEnabled(m_deviceProfileCombo->currentData().toString() != "legacy");
+    });
+    
+    devicesLayout->addRow("&Perfil:", m_deviceProfileCombo);
+    devicesLayout->addRow("Controlador de &disco:", m_diskControllerCombo);
+    
     // Boot Order
     auto *bootGroup = new QGroupBox("Orden de Arranque");
     auto *bootLayout = new QHBoxLayout(bootGroup);
@@ -190,10 +323,12 @@ void AdvancedVMConfigDialog::setupSystemTab()
     
     layout->addWidget(memoryGroup);
     layout->addWidget(cpuGroup);
+    layout->addWidget(devicesGroup);
     layout->addWidget(bootGroup);
     layout->addStretch();
     
     updateMemoryInfo();
+    updateCpuTopologyInfo();
 }
 
 void AdvancedVMConfigDialog::setupStorageTab()
@@ -263,8 +398,14 @@ void AdvancedVMConfigDialog::setupStorageTab()
     m_storageSplitter->addWidget(m_storageDetailsPanel);
     m_storageSplitter->setSizes({400, 300});
     
+    m_ephemeralCheck = new QCheckBox("Modo &efímero: descartar lo escrito en los discos al apagar");
+    m_ephemeralCheck->setToolTip("Las escrituras van a capas temporales en la carpeta efímera de las preferencias "
+                                 "(por defecto /dev/shm, en RAM); los discos no se modifican. "
+                                 "Se aplica en el siguiente arranque");
+    
     layout->addLayout(toolbarLayout);
     layout->addWidget(m_storageSplitter);
+    layout->addWidget(m_ephemeralCheck);
     
     updateStorageList();
 }
@@ -408,7 +549,35 @@ void AdvancedVMConfigDialog::loadVMSettings()
     // System
     m_memorySpin->setValue(m_vm->getMemoryMB());
     m_memorySlider->setValue(m_vm->getMemoryMB());
+    m_memoryBackingCombo->setCurrentIndex(qMax(0, m_memoryBackingCombo->findData(m_vm->getMemoryBacking())));
+    m_hugePageSizeCombo->setCurrentIndex(qMax(0, m_hugePageSizeCombo->findData(m_vm->getHugePageSizeKB())));
+    m_memoryPreallocCheck->setChecked(m_vm->isMemoryPrealloc());
+    m_memoryShareCheck->setChecked(m_vm->isMemoryShared());
+    m_memoryMergeCheck->setChecked(m_vm->isMemoryMergeable());
+    m_memoryPriorityCombo->setCurrentIndex(qMax(0, m_memoryPriorityCombo->findData(m_vm->getPriority())));
     m_cpuCountSpin->setValue(m_vm->getCPUCount());
+    int cpuModelIndex = m_cpuModelCombo->findData(m_vm->getCPUModel());
+    if (cpuModelIndex < 0) {
+        // Model not reported by this QEMU build: keep it selectable
+        m_cpuModelCombo->addItem(m_vm->getCPUModel(), m_vm->getCPUModel());
+        cpuModelIndex = m_cpuModelCombo->count() - 1;
+    }
+    m_cpuModelCombo->setCurrentIndex(cpuModelIndex);
+    if (m_vm->hasCPUTopology()) {
+        m_cpuSocketsSpin->setValue(m_vm->getCPUSockets());
+        m_cpuDiesSpin->setValue(m_vm->getCPUDies());
+        m_cpuCoresSpin->setValue(m_vm->getCPUCores());
+        m_cpuThreadsSpin->setValue(m_vm->getCPUThreads());
+    } else {
+        m_cpuCoresSpin->setValue(m_vm->getCPUCount());
+    }
+    m_customTopologyCheck->setChecked(m_vm->hasCPUTopology());
+    m_cpuPinningCombo->setCurrentIndex(qMax(0, m_cpuPinningCombo->findData(m_vm->getCPUPinning())));
+    m_cpuSetEdit->setText(m_vm->getCPUSet());
+    m_deviceProfileCombo->setCurrentIndex(qMax(0, m_deviceProfileCombo->findData(m_vm->getDeviceProfile())));
+    m_diskControllerCombo->setCurrentIndex(qMax(0, m_diskControllerCombo->findData(m_vm->getDiskController())));
+    m_diskControllerCombo->setEnabled(m_vm->getDeviceProfile() != "legacy");
+    m_ephemeralCheck->setChecked(m_vm->isEphemeral());
     
     // Boot Order
     QStringList bootOrder = m_vm->getBootOrder();
@@ -434,7 +603,25 @@ void AdvancedVMConfigDialog::saveVMSettings()
     
     // System
     m_vm->setMemoryMB(m_memorySpin->value());
-    m_vm->setCPUCount(m_cpuCountSpin->value());
+    m_vm->setMemoryBacking(m_memoryBackingCombo->currentData().toString());
+    m_vm->setHugePageSizeKB(m_hugePageSizeCombo->currentData().toInt());
+    m_vm->setMemoryPrealloc(m_memoryPreallocCheck->isChecked());
+    m_vm->setMemoryShared(m_memoryShareCheck->isChecked());
+    m_vm->setMemoryMergeable(m_memoryMergeCheck->isChecked());
+    m_vm->setPriority(m_memoryPriorityCombo->currentData().toString());
+    m_vm->setCPUModel(m_cpuModelCombo->currentData().toString());
+    if (m_customTopologyCheck->isChecked()) {
+        m_vm->setCPUTopology(m_cpuSocketsSpin->value(), m_cpuDiesSpin->value(),
+                             m_cpuCoresSpin->value(), m_cpuThreadsSpin->value());
+    } else {
+        m_vm->clearCPUTopology();
+        m_vm->setCPUCount(m_cpuCountSpin->value());
+    }
+    m_vm->setCPUPinning(m_cpuPinningCombo->currentData().toString());
+    m_vm->setCPUSet(m_cpuSetEdit->text().trimmed());
+    m_vm->setDeviceProfile(m_deviceProfileCombo->currentData().toString());
+    m_vm->setDiskController(m_diskControllerCombo->currentData().toString());
+    m_vm->setEphemeral(m_ephemeralCheck->isChecked());
     
     // Boot Order - Get current order from list
     QStringList bootOrder;
@@ -470,6 +657,53 @@ bool AdvancedVMConfigDialog::validateSettings()
         return false;
     }
     
+    // Huge pages must be reserved before the VM can start
+    if (m_memoryBackingCombo->currentData().toString() == "hugepages") {
+        QString error;
+        if (!QemuManager::checkHugePages(memory, m_hugePageSizeCombo->currentData().toInt(), &error)) {
+            int answer = QMessageBox::question(this, "Páginas enormes",
+                                               error + "\n\nLa VM no podrá arrancar hasta que se reserven. "
+                                               "¿Guardar la configuración de todos modos?");
+            if (answer != QMessageBox::Yes) {
+                m_tabWidget->setCurrentWidget(m_systemTab);
+                m_memoryBackingCombo->setFocus();
+                return false;
+            }
+        }
+    }
+    
+    // Validate CPU topology
+    if (m_customTopologyCheck->isChecked()) {
+        QString error;
+        if (!HostInfo::validateCpuTopology(m_cpuCountSpin->value(), m_cpuSocketsSpin->value(), m_cpuDiesSpin->value(),
+                                           m_cpuCoresSpin->value(), m_cpuThreadsSpin->value(), &error)) {
+            QMessageBox::warning(this, "Error de Validación", error);
+            m_tabWidget->setCurrentWidget(m_systemTab);
+            m_cpuSocketsSpin->setFocus();
+            return false;
+        }
+    }
+    
+    // Validate host CPU list for manual pinning
+    if (m_cpuPinningCombo->currentData().toString() == "manual") {
+        QList<int> hostCpus;
+        for (const HostInfo::LogicalCpu &cpu : HostInfo::cpuTopology().cpus) {
+            hostCpus.append(cpu.id);
+        }
+        QList<int> cpus = HostInfo::parseCpuList(m_cpuSetEdit->text());
+        bool valid = !cpus.isEmpty();
+        for (int cpu : cpus) {
+            valid = valid && hostCpus.contains(cpu);
+        }
+        if (!valid) {
+            QMessageBox::warning(this, "Error de Validación",
+                               "La lista de CPUs del anfitrión no es válida o incluye CPUs que no existen.");
+            m_tabWidget->setCurrentWidget(m_systemTab);
+            m_cpuSetEdit->setFocus();
+            return false;
+        }
+    }
+    
     return true;
 }
 
@@ -509,7 +743,49 @@ void AdvancedVMConfigDialog::onMemorySpinChanged(int value)
 void AdvancedVMConfigDialog::onCPUCountChanged(int value)
 {
     Q_UNUSED(value)
-    // Update CPU-related info if needed
+    updateCpuTopologyInfo();
+}
+
+void AdvancedVMConfigDialog::updateCpuTopologyInfo()
+{
+    bool custom = m_customTopologyCheck->isChecked();
+    m_cpuSocketsSpin->setEnabled(custom);
+    m_cpuDiesSpin->setEnabled(custom);
+    m_cpuCoresSpin->setEnabled(custom);
+    m_cpuThreadsSpin->setEnabled(custom);
+    m_cpuCountSpin->setEnabled(!custom);
+    
+    // With a custom topology the vCPU count is derived from it
+    if (custom) {
+        QSignalBlocker blocker(m_cpuCountSpin);
+        m_cpuCountSpin->setValue(m_cpuSocketsSpin->value() * m_cpuDiesSpin->value()
+                                 * m_cpuCoresSpin->value() * m_cpuThreadsSpin->value());
+    }
+    
+    HostInfo::CpuTopology host = HostInfo::cpuTopology();
+    QString info = QString("Anfitrión: %1 CPUs lógicas (%2 sockets, %3 dies, %4 núcleos, %5 hilos por núcleo)")
+                       .arg(host.logicalCpus()).arg(host.sockets).arg(host.diesPerSocket)
+                       .arg(host.coresPerDie).arg(host.threadsPerCore);
+    int numaNodes = HostInfo::numaNodes().size();
+    if (numaNodes > 1) {
+        info += QString(", %1 nodos NUMA").arg(numaNodes);
+    }
+    
+    if (custom) {
+        QString error;
+        QStringList warnings;
+        if (!HostInfo::validateCpuTopology(m_cpuCountSpin->value(), m_cpuSocketsSpin->value(), m_cpuDiesSpin->value(),
+                                           m_cpuCoresSpin->value(), m_cpuThreadsSpin->value(), &error, &warnings)) {
+            warnings.prepend(error);
+        }
+        for (const QString &warning : warnings) {
+            info += "\n⚠ " + warning;
+        }
+    } else if (host.logicalCpus() > 0 && m_cpuCountSpin->value() > host.logicalCpus()) {
+        info += "\n⚠ Más vCPUs que CPUs lógicas en el anfitrión";
+    }
+    
+    m_cpuTopologyInfoLabel->setText(info);
 }
 
 void AdvancedVMConfigDialog::onBootOrderChanged()
@@ -607,9 +883,17 @@ void AdvancedVMConfigDialog::modifyHardDisk()
             }
         }
     } else {
-        // Hard disk properties - to be implemented
-        QMessageBox::information(this, "Información",
-                               "Propiedades de disco duro en desarrollo.");
+        // Hard disk I/O properties
+        QString diskPath = currentItem->text(3);
+        QString deviceProfile = m_deviceProfileCombo->currentData().toString();
+        VirtualMachine::DiskTuning tuning = m_vm->hasDiskTuning(diskPath)
+            ? m_vm->getDiskTuning(diskPath) : QemuManager::defaultDiskTuning(diskPath, deviceProfile);
+        
+        HardDiskPropertiesDialog dialog(diskPath, deviceProfile, tuning, this);
+        if (dialog.exec() == QDialog::Accepted) {
+            m_vm->setDiskTuning(diskPath, dialog.getTuning());
+            onStorageSelectionChanged();
+        }
     }
 }
 
@@ -694,6 +978,15 @@ void AdvancedVMConfigDialog::onStorageSelectionChanged()
                           .arg(currentItem->text(2))
                           .arg(currentItem->text(3));
         
+        QString diskPath = currentItem->text(3);
+        if (currentItem->text(1) == "Disco Duro" && m_vm) {
+            VirtualMachine::DiskTuning tuning = m_vm->hasDiskTuning(diskPath)
+                ? m_vm->getDiskTuning(diskPath)
+                : QemuManager::defaultDiskTuning(diskPath, m_deviceProfileCombo->currentData().toString());
+            details += QString("\nCaché: %1\nE/S asíncrona: %2\nIOThread: %3")
+                       .arg(tuning.cache, tuning.aio, tuning.iothread ? "Sí" : "No");
+        }
+        
         m_storageDetailsLabel->setText(details);
     } else {
         m_storageDetailsLabel->setText("Seleccione un dispositivo para ver detalles");
@@ -819,13 +1112,53 @@ void AdvancedVMConfigDialog::updateMemoryInfo()
 {
     int vmMemory = m_memorySpin->value();
     
-    // Get system memory info (simplified)
-    int totalMemory = 8192; // Would get from system
-    int usedMemory = vmMemory;
-    int percentage = (usedMemory * 100) / totalMemory;
+    // Same figures the admission controller uses when the VM starts; a
+    // running VM is already in the ledger with its current size
+    AdmissionController::Usage usage = m_kvmManager->getAdmissionController()->usage();
+    QString state = m_vm->getState();
+    bool committed = state != "shut off" && state != "shutoff" && state != "saved" && state != "crashed";
+    qint64 others = usage.committedMemoryMB - (committed ? m_vm->getMemoryMB() : 0);
+    qint64 total = others + vmMemory;
+    qint64 capacity = qMax<qint64>(1, usage.memoryCapacityMB);
+    
+    m_hostMemoryBar->setMaximum(int(capacity));
+    m_hostMemoryBar->setValue(int(qMin(total, capacity)));
+    m_hostMemoryBar->setFormat(QString("Comprometida: %1 de %2 MB (%3 %)")
+                               .arg(total).arg(capacity).arg(total * 100 / capacity));
+    
+    QString info = QString("Memoria asignada: %1 MB · otras VMs en marcha: %2 MB · libre para VMs: %3 MB · "
+                           "disponible ahora en el anfitrión: %4 MB")
+                   .arg(vmMemory).arg(others).arg(qMax<qint64>(0, capacity - others)).arg(usage.hostAvailableMB);
+    if (total > capacity) {
+        info += "\n⚠ No cabe junto a las VMs en marcha: al arrancar se avisará, esperará en cola o se rechazará según "
+                "Preferencias → Memoria";
+    }
+    m_memoryInfoLabel->setText(info);
+    updateHugePagesInfo();
+}
+
+void AdvancedVMConfigDialog::updateHugePagesInfo()
+{
+    bool hugePages = m_memoryBackingCombo->currentData().toString() == "hugepages";
+    m_hugePageSizeCombo->setEnabled(hugePages);
+    m_hugePagesInfoLabel->setVisible(hugePages);
+    // KSM never merges huge pages
+    m_memoryMergeCheck->setEnabled(!hugePages);
+    if (!hugePages) {
+        return;
+    }
+    
+    int sizeKB = m_hugePageSizeCombo->currentData().toInt();
+    HostInfo::HugePagePool pool = HostInfo::hugePagePool(sizeKB);
+    qint64 needed = (qint64(m_memorySpin->value()) * 1024 + sizeKB - 1) / sizeKB;
+    QString info = QString("Páginas de %1: %2 libres de %3 reservadas, la VM necesita %4")
+                   .arg(m_hugePageSizeCombo->currentText()).arg(pool.free).arg(pool.total).arg(needed);
     
-    m_memoryInfoLabel->setText(QString("Memoria asignada: %1 MB").arg(vmMemory));
-    m_hostMemoryBar->setValue(percentage);
+    QString error;
+    if (!QemuManager::checkHugePages(m_memorySpin->value(), sizeKB, &error)) {
+        info += "\n⚠ " + error;
+    }
+    m_hugePagesInfoLabel->setText(info);
 }
 
 void AdvancedVMConfigDialog::updateStorageList()
@@ -840,7 +1173,12 @@ void AdvancedVMConfigDialog::updateStorageList()
         auto *item = new QTreeWidgetItem(m_storageTree);
         item->setText(0, QFileInfo(diskPath).baseName());
         item->setText(1, "Disco Duro");
-        item->setText(2, "Variable"); // Would calculate actual size
+        DiskImageProbe::Info image = DiskImageProbe::probe(diskPath);
+        if (image.virtualSize > 0) {
+            item->setText(2, QString("%1 GB (%2)").arg(image.virtualSize / (1024.0 * 1024 * 1024), 0, 'f', 1).arg(image.format));
+        } else {
+            item->setText(2, "Variable");
+        }
         item->setText(3, diskPath);
         item->setIcon(0, QIcon(":/icons/hdd.png"));
     }
@@ -1095,6 +1433,139 @@ bool AddHardDiskDialog::validateInput()
     }
 }
 
+// HardDiskPropertiesDialog Implementation
+
+HardDiskPropertiesDialog::HardDiskPropertiesDialog(const QString &diskPath, const QString &deviceProfile,
+                                                   const VirtualMachine::DiskTuning &tuning, QWidget *parent)
+    : QDialog(parent)
+    , m_diskPath(diskPath)
+    , m_deviceProfile(deviceProfile)
+{
+    setWindowTitle("Propiedades de Disco Duro");
+    setWindowFlags(windowFlags() & ~Qt::WindowContextHelpButtonHint);
+    resize(450, 320);
+    
+    setupUI();
+    setTuning(tuning);
+}
+
+void HardDiskPropertiesDialog::setupUI()
+{
+    auto *mainLayout = new QVBoxLayout(this);
+    
+    auto *pathLabel = new QLabel(m_diskPath);
+    pathLabel->setWordWrap(true);
+    
+    QStorageInfo storage(QFileInfo(m_diskPath).absolutePath());
+    m_filesystemLabel = new QLabel(QString("Sistema de archivos del anfitrión: %1")
+                                   .arg(storage.isValid() ? QString::fromLatin1(storage.fileSystemType()) : "desconocido"));
+    
+    // Host cache and AIO engine
+    auto *ioGroup = new QGroupBox("Entrada/Salida");
+    auto *ioLayout = new QFormLayout(ioGroup);
+    
+    m_cacheCombo = new QComboBox;
+    m_cacheCombo->addItem("none (O_DIRECT, sin caché del anfitrión)", "none");
+    m_cacheCombo->addItem("writeback (caché del anfitrión)", "writeback");
+    m_cacheCombo->addItem("unsafe (ignora flush, sólo datos desechables)", "unsafe");
+    connect(m_cacheCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &HardDiskPropertiesDialog::onCacheChanged);
+    
+    m_aioCombo = new QComboBox;
+    m_aioCombo->addItem("threads (pool de hilos)", "threads");
+    m_aioCombo->addItem("native (Linux AIO)", "native");
+    m_aioCombo->addItem("io_uring", "io_uring");
+    
+    m_discardCheck = new QCheckBox("Liberar en el anfitrión los bloques descartados (discard)");
+    
+    m_detectZeroesCombo = new QComboBox;
+    m_detectZeroesCombo->addItem("Desactivado", "off");
+    m_detectZeroesCombo->addItem("Activado", "on");
+    m_detectZeroesCombo->addItem("Liberar (unmap)", "unmap");
+    
+    ioLayout->addRow("&Caché:", m_cacheCombo);
+    ioLayout->addRow("E/S &asíncrona:", m_aioCombo);
+    ioLayout->addRow(m_discardCheck);
+    ioLayout->addRow("Detectar &ceros:", m_detectZeroesCombo);
+    
+    // Virtio queues (ignored by the legacy profile)
+    auto *queueGroup = new QGroupBox("Colas (perfiles virtio)");
+    auto *queueLayout = new QFormLayout(queueGroup);
+    
+    m_iothreadCheck = new QCheckBox("IOThread dedicado para este disco");
+    
+    m_queuesSpin = new QSpinBox;
+    m_queuesSpin->setRange(0, 64);
+    m_queuesSpin->setSpecialValueText("Una por vCPU");
+    
+    queueLayout->addRow(m_iothreadCheck);
+    queueLayout->addRow("Nú&mero de colas:", m_queuesSpin);
+    
+    // Buttons
+    auto *buttonLayout = new QHBoxLayout;
+    
+    auto *defaultsButton = new QPushButton("&Valores recomendados");
+    connect(defaultsButton, &QPushButton::clicked, this, &HardDiskPropertiesDialog::onRestoreDefaults);
+    
+    auto *okButton = new QPushButton("&Aceptar");
+    auto *cancelButton = new QPushButton("&Cancelar");
+    
+    connect(okButton, &QPushButton::clicked, this, &QDialog::accept);
+    connect(cancelButton, &QPushButton::clicked, this, &QDialog::reject);
+    
+    buttonLayout->addWidget(defaultsButton);
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(okButton);
+    buttonLayout->addWidget(cancelButton);
+    
+    mainLayout->addWidget(pathLabel);
+    mainLayout->addWidget(m_filesystemLabel);
+    mainLayout->addWidget(ioGroup);
+    mainLayout->addWidget(queueGroup);
+    mainLayout->addStretch();
+    mainLayout->addLayout(buttonLayout);
+}
+
+void HardDiskPropertiesDialog::setTuning(const VirtualMachine::DiskTuning &tuning)
+{
+    m_cacheCombo->setCurrentIndex(qMax(0, m_cacheCombo->findData(tuning.cache)));
+    m_aioCombo->setCurrentIndex(qMax(0, m_aioCombo->findData(tuning.aio)));
+    m_discardCheck->setChecked(tuning.discard);
+    m_detectZeroesCombo->setCurrentIndex(qMax(0, m_detectZeroesCombo->findData(tuning.detectZeroes)));
+    m_iothreadCheck->setChecked(tuning.iothread);
+    m_queuesSpin->setValue(tuning.queues);
+    onCacheChanged();
+}
+
+VirtualMachine::DiskTuning HardDiskPropertiesDialog::getTuning() const
+{
+    VirtualMachine::DiskTuning tuning;
+    tuning.cache = m_cacheCombo->currentData().toString();
+    tuning.aio = m_aioCombo->currentData().toString();
+    tuning.discard = m_discardCheck->isChecked();
+    tuning.detectZeroes = m_detectZeroesCombo->currentData().toString();
+    tuning.iothread = m_iothreadCheck->isChecked();
+    tuning.queues = m_queuesSpin->value();
+    return tuning;
+}
+
+void HardDiskPropertiesDialog::onRestoreDefaults()
+{
+    setTuning(QemuManager::defaultDiskTuning(m_diskPath, m_deviceProfile));
+}
+
+void HardDiskPropertiesDialog::onCacheChanged()
+{
+    // Linux AIO necesita O_DIRECT: sólo está disponible con cache=none
+    bool direct = m_cacheCombo->currentData().toString() == "none";
+    auto *model = qobject_cast<QStandardItemModel*>(m_aioCombo->model());
+    if (model) {
+        model->item(m_aioCombo->findData("native"))->setEnabled(direct);
+    }
+    if (!direct && m_aioCombo->currentData().toString() == "native") {
+        m_aioCombo->setCurrentIndex(m_aioCombo->findData("threads"));
+    }
+}
+
 // AddOpticalDriveDialog Implementation
 
 AddOpticalDriveDialog::AddOpticalDriveDialog(QWidget *parent)
@@ -24,7 +24,8 @@
 #include <QSplitter>
 #include <QHeaderView>
 
-class VirtualMachine;
+#include "../core/VirtualMachine.h"
+
 class KVMManager;
 class QemuManager;
 
@@ -88,6 +89,8 @@ private:
     bool validateSettings();
     
     void updateMemoryInfo();
+    void updateCpuTopologyInfo();
+    void updateHugePagesInfo();
     void updateStorageList();
     void updateNetworkList();
     void updateSharedFoldersList();
@@ -112,10 +115,28 @@ private:
     QSpinBox *m_memorySpin;
     QLabel *m_memoryInfoLabel;
     QProgressBar *m_hostMemoryBar;
+    QComboBox *m_memoryBackingCombo;
+    QComboBox *m_hugePageSizeCombo;
+    QCheckBox *m_memoryPreallocCheck;
+    QCheckBox *m_memoryShareCheck;
+    QCheckBox *m_memoryMergeCheck;
+    QComboBox *m_memoryPriorityCombo;
+    QLabel *m_hugePagesInfoLabel;
     QSpinBox *m_cpuCountSpin;
+    QComboBox *m_cpuModelCombo;
+    QCheckBox *m_customTopologyCheck;
+    QSpinBox *m_cpuSocketsSpin;
+    QSpinBox *m_cpuDiesSpin;
+    QSpinBox *m_cpuCoresSpin;
+    QSpinBox *m_cpuThreadsSpin;
+    QLabel *m_cpuTopologyInfoLabel;
+    QComboBox *m_cpuPinningCombo;
+    QLineEdit *m_cpuSetEdit;
     QComboBox *m_chipsetCombo;
     QCheckBox *m_enablePAECheck;
     QCheckBox *m_enableVTxCheck;
+    QComboBox *m_deviceProfileCombo;
+    QComboBox *m_diskControllerCombo;
     QListWidget *m_bootOrderList;
     QPushButton *m_bootUpButton;
     QPushButton *m_bootDownButton;
@@ -130,6 +151,7 @@ private:
     QPushButton *m_addOpticalButton;
     QPushButton *m_removeStorageButton;
     QPushButton *m_modifyStorageButton;
+    QCheckBox *m_ephemeralCheck;
     
     // Network Tab
     QWidget *m_networkTab;
@@ -205,6 +227,37 @@ private:
     QPushButton *m_browseExistingButton;
 };
 
+// Dialog de propiedades de E/S de un disco duro
+class HardDiskPropertiesDialog : public QDialog
+{
+    Q_OBJECT
+    
+public:
+    explicit HardDiskPropertiesDialog(const QString &diskPath, const QString &deviceProfile,
+                                      const VirtualMachine::DiskTuning &tuning, QWidget *parent = nullptr);
+    
+    VirtualMachine::DiskTuning getTuning() const;
+    
+private slots:
+    void onRestoreDefaults();
+    void onCacheChanged();
+    
+private:
+    void setupUI();
+    void setTuning(const VirtualMachine::DiskTuning &tuning);
+    
+    QString m_diskPath;
+    QString m_deviceProfile;
+    
+    QComboBox *m_cacheCombo;
+    QComboBox *m_aioCombo;
+    QCheckBox *m_discardCheck;
+    QComboBox *m_detectZeroesCombo;
+    QCheckBox *m_iothreadCheck;
+    QSpinBox *m_queuesSpin;
+    QLabel *m_filesystemLabel;
+};
+
 // Dialog para añadir unidad óptica
 class AddOpticalDriveDialog : public QDialog
 {
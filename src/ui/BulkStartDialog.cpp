@@ -0,0 +1,331 @@
+#include "BulkStartDialog.h"
+#include "../core/KVMManager.h"
+#include "../core/VirtualMachine.h"
+
+#include <QApplication>
+#include <QDialogButtonBox>
+#include <QHeaderView>
+#include <QHash>
+#include <QJsonArray>
+#include <QPointer>
+
+namespace {
+// Tree columns
+const int NameColumn = 0;
+const int PriorityColumn = 1;
+const int StartAfterColumn = 2;
+const int StageColumn = 3;
+const int TimeColumn = 4;
+}
+
+BulkStartDialog::BulkStartDialog(KVMManager *kvmManager, const QStringList &vmNames,
+                                 BootScheduler::Action action, QWidget *parent)
+    : QDialog(parent)
+    , m_kvmManager(kvmManager)
+    , m_vmNames(vmNames)
+    , m_action(action)
+    , m_running(false)
+{
+    setWindowTitle(action == BootScheduler::Start ? tr("Iniciar %1 máquinas virtuales").arg(vmNames.size())
+                                                  : tr("Detener %1 máquinas virtuales").arg(vmNames.size()));
+    setWindowIcon(QApplication::style()->standardIcon(action == BootScheduler::Start ? QStyle::SP_MediaPlay
+                                                                                     : QStyle::SP_MediaStop));
+    resize(720, 520);
+    setModal(true);
+    
+    setupUI();
+    populateTree();
+    
+    connect(m_kvmManager, &KVMManager::bulkProgress, this, &BulkStartDialog::onProgress);
+}
+
+void BulkStartDialog::setupUI()
+{
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    BootScheduler::Options defaults = BootScheduler::loadOptions();
+    bool starting = m_action == BootScheduler::Start;
+    
+    // Pacing
+    QGroupBox *optionsGroup = new QGroupBox(tr("Ritmo"));
+    QFormLayout *optionsLayout = new QFormLayout(optionsGroup);
+    
+    m_parallelSpin = new QSpinBox;
+    m_parallelSpin->setRange(1, 64);
+    m_parallelSpin->setValue(defaults.maxParallel);
+    m_parallelSpin->setToolTip(starting ? tr("VMs que pueden estar arrancando a la vez; una VM deja su hueco al estar lista")
+                                        : tr("VMs que pueden estar apagándose a la vez"));
+    optionsLayout->addRow(starting ? tr("Arranques simultáneos:") : tr("Paradas simultáneas:"), m_parallelSpin);
+    
+    m_rampSpin = new QSpinBox;
+    m_rampSpin->setRange(0, 600000);
+    m_rampSpin->setSingleStep(500);
+    m_rampSpin->setSuffix(" ms");
+    m_rampSpin->setValue(defaults.rampUpMs);
+    m_rampSpin->setToolTip(tr("Pausa mínima entre dos lanzamientos, para no leer todas las imágenes a la vez"));
+    optionsLayout->addRow(tr("Rampa:"), m_rampSpin);
+    
+    m_readinessCombo = new QComboBox;
+    m_readinessCombo->addItem(tr("Agente del invitado (qemu-ga)"), "agent");
+    m_readinessCombo->addItem(tr("QMP responde"), "qmp");
+    m_readinessCombo->addItem(tr("Proceso lanzado"), "none");
+    m_readinessCombo->setCurrentIndex(qMax(0, m_readinessCombo->findData(defaults.readiness)));
+    m_readinessCombo->setToolTip(tr("Con el agente, una VM está lista cuando su sistema ha arrancado; "
+                                    "las VMs sin canal de agente (perfil legacy) usan QMP"));
+    optionsLayout->addRow(tr("Lista cuando:"), m_readinessCombo);
+    
+    m_readyTimeoutSpin = new QSpinBox;
+    m_readyTimeoutSpin->setRange(5, 3600);
+    m_readyTimeoutSpin->setSuffix(" s");
+    m_readyTimeoutSpin->setValue(defaults.readyTimeoutSecs);
+    m_readyTimeoutSpin->setToolTip(tr("Pasado este tiempo la VM se da por arrancada y deja libre su hueco"));
+    optionsLayout->addRow(tr("Espera máxima:"), m_readyTimeoutSpin);
+    
+    m_ioLimitSpin = new QDoubleSpinBox;
+    m_ioLimitSpin->setRange(0, 100);
+    m_ioLimitSpin->setDecimals(1);
+    m_ioLimitSpin->setSuffix(" %");
+    m_ioLimitSpin->setSpecialValueText(tr("Sin límite"));
+    m_ioLimitSpin->setValue(defaults.maxIoPressure);
+    m_ioLimitSpin->setToolTip(tr("No lanzar más arranques mientras las tareas del anfitrión pasen más de este "
+                                 "porcentaje del tiempo esperando al disco (/proc/pressure/io)"));
+    optionsLayout->addRow(tr("Presión de E/S máxima:"), m_ioLimitSpin);
+    
+    m_saveDefaultsCheck = new QCheckBox(tr("Usar estos valores por defecto"));
+    optionsLayout->addRow(QString(), m_saveDefaultsCheck);
+    
+    // Ramp, readiness and I/O limits only pace starts
+    m_rampSpin->setEnabled(starting);
+    m_readinessCombo->setEnabled(starting);
+    m_readyTimeoutSpin->setEnabled(starting);
+    m_ioLimitSpin->setEnabled(starting);
+    
+    mainLayout->addWidget(optionsGroup);
+    
+    // Order
+    QGroupBox *orderGroup = new QGroupBox(tr("Orden"));
+    QVBoxLayout *orderLayout = new QVBoxLayout(orderGroup);
+    
+    QLabel *orderInfo = new QLabel(starting
+        ? tr("Cada VM espera a que estén listas las de su columna «Después de» (nombres separados por comas); "
+             "entre las que pueden arrancar, primero las de prioridad alta.")
+        : tr("Una VM no se detiene hasta que se han detenido las que arrancan después de ella; "
+             "entre las que pueden pararse, primero las de prioridad baja."));
+    orderInfo->setWordWrap(true);
+    orderLayout->addWidget(orderInfo);
+    
+    m_vmTree = new QTreeWidget;
+    m_vmTree->setHeaderLabels({tr("Nombre"), tr("Prioridad"), tr("Después de"), tr("Estado"), tr("Tiempo")});
+    m_vmTree->setRootIsDecorated(false);
+    m_vmTree->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_vmTree->header()->setSectionResizeMode(StartAfterColumn, QHeaderView::Stretch);
+    orderLayout->addWidget(m_vmTree);
+    
+    // Only the dependency list is typed in
+    connect(m_vmTree, &QTreeWidget::itemDoubleClicked, this, [this](QTreeWidgetItem *item, int column) {
+        if (column == StartAfterColumn && !m_running) {
+            m_vmTree->editItem(item, column);
+        }
+    });
+    
+    m_saveDependenciesCheck = new QCheckBox(tr("Guardar las dependencias en la configuración de cada VM"));
+    orderLayout->addWidget(m_saveDependenciesCheck);
+    
+    mainLayout->addWidget(orderGroup);
+    
+    m_statusLabel = new QLabel;
+    m_statusLabel->setWordWrap(true);
+    mainLayout->addWidget(m_statusLabel);
+    
+    m_buttonBox = new QDialogButtonBox(QDialogButtonBox::Close);
+    m_runButton = m_buttonBox->addButton(starting ? tr("&Iniciar") : tr("&Detener"), QDialogButtonBox::ActionRole);
+    m_runButton->setIcon(windowIcon());
+    m_runButton->setDefault(true);
+    connect(m_runButton, &QPushButton::clicked, this, &BulkStartDialog::run);
+    connect(m_buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    mainLayout->addWidget(m_buttonBox);
+}
+
+void BulkStartDialog::populateTree()
+{
+    for (const QString &vmName : m_vmNames) {
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(vmName);
+        if (!vm) {
+            continue;
+        }
+        
+        QTreeWidgetItem *item = new QTreeWidgetItem(m_vmTree);
+        item->setFlags(item->flags() | Qt::ItemIsEditable);
+        item->setText(NameColumn, vmName);
+        item->setText(StartAfterColumn, vm->getStartAfter().join(", "));
+        item->setText(StageColumn, m_kvmManager->getVMState(vmName));
+        
+        QComboBox *priorityCombo = new QComboBox;
+        priorityCombo->addItem(tr("Alta"), 2);
+        priorityCombo->addItem(tr("Normal"), 1);
+        priorityCombo->addItem(tr("Baja"), 0);
+        priorityCombo->setCurrentIndex(qMax(0, priorityCombo->findData(BootScheduler::defaultPriority(vm))));
+        m_vmTree->setItemWidget(item, PriorityColumn, priorityCombo);
+    }
+}
+
+BootScheduler::Options BulkStartDialog::collectOptions() const
+{
+    BootScheduler::Options options;
+    options.maxParallel = m_parallelSpin->value();
+    options.rampUpMs = m_rampSpin->value();
+    options.readiness = m_readinessCombo->currentData().toString();
+    options.readyTimeoutSecs = m_readyTimeoutSpin->value();
+    options.maxIoPressure = m_ioLimitSpin->value();
+    
+    // The tree overrides what each VM has saved
+    for (int i = 0; i < m_vmTree->topLevelItemCount(); ++i) {
+        QTreeWidgetItem *item = m_vmTree->topLevelItem(i);
+        QString vmName = item->text(NameColumn);
+        
+        QStringList dependencies;
+        for (const QString &part : item->text(StartAfterColumn).split(',', Qt::SkipEmptyParts)) {
+            if (!part.trimmed().isEmpty()) {
+                dependencies.append(part.trimmed());
+            }
+        }
+        options.dependencies[vmName] = dependencies;
+        
+        QComboBox *priorityCombo = qobject_cast<QComboBox*>(m_vmTree->itemWidget(item, PriorityColumn));
+        options.priorities[vmName] = priorityCombo ? priorityCombo->currentData().toInt() : 1;
+    }
+    
+    return options;
+}
+
+void BulkStartDialog::saveDependencies()
+{
+    for (int i = 0; i < m_vmTree->topLevelItemCount(); ++i) {
+        QTreeWidgetItem *item = m_vmTree->topLevelItem(i);
+        QString vmName = item->text(NameColumn);
+        QString value = item->text(StartAfterColumn).simplified().remove(' ');
+        
+        // setVMOption reports unknown names through errorOccurred
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(vmName);
+        if (vm && m_kvmManager->setVMOption(vmName, "start-after", value.isEmpty() ? "none" : value)) {
+            m_kvmManager->saveVMConfiguration(vm);
+        }
+    }
+}
+
+void BulkStartDialog::run()
+{
+    BootScheduler::Options options = collectOptions();
+    if (m_saveDefaultsCheck->isChecked()) {
+        BootScheduler::saveOptions(options);
+    }
+    if (m_saveDependenciesCheck->isChecked()) {
+        saveDependencies();
+    }
+    
+    m_running = true;
+    m_runButton->setEnabled(false);
+    for (int i = 0; i < m_vmTree->topLevelItemCount(); ++i) {
+        if (QWidget *priorityCombo = m_vmTree->itemWidget(m_vmTree->topLevelItem(i), PriorityColumn)) {
+            priorityCombo->setEnabled(false);
+        }
+    }
+    m_statusLabel->setText(m_action == BootScheduler::Start ? tr("Iniciando...") : tr("Deteniendo..."));
+    
+    // The scheduler outlives the dialog if it is closed early
+    QPointer<BulkStartDialog> self(this);
+    VMBackend::Callback done = [self](const VMBackend::Result &result) {
+        if (self) {
+            self->showSummary(result.value.toObject());
+        }
+    };
+    
+    QStringList vmNames;
+    for (int i = 0; i < m_vmTree->topLevelItemCount(); ++i) {
+        vmNames.append(m_vmTree->topLevelItem(i)->text(NameColumn));
+    }
+    if (m_action == BootScheduler::Start) {
+        m_kvmManager->startVMsAsync(vmNames, options, done);
+    } else {
+        m_kvmManager->stopVMsAsync(vmNames, options, done);
+    }
+}
+
+void BulkStartDialog::onProgress(const QString &vmName, const QString &stage, const QString &detail)
+{
+    if (!m_running) {
+        return;
+    }
+    
+    // Host-wide events carry no VM name
+    if (vmName.isEmpty()) {
+        m_statusLabel->setText(stage == "throttled" ? tr("En pausa: %1").arg(detail) : tr("Reanudado: %1").arg(detail));
+        return;
+    }
+    
+    QTreeWidgetItem *item = findItem(vmName);
+    if (!item) {
+        return;
+    }
+    
+    QString text = stageText(stage);
+    if (stage == "booting" && !detail.isEmpty()) {
+        text = tr("Esperando a %1").arg(detail == "agent" ? tr("qemu-ga") : detail.toUpper());
+    }
+    item->setText(StageColumn, text);
+    item->setToolTip(StageColumn, stage == "booting" ? QString() : detail);
+    if (stage == "failed" || stage == "skipped" || stage == "timeout") {
+        item->setForeground(StageColumn, stage == "timeout" ? Qt::darkYellow : Qt::red);
+    }
+}
+
+void BulkStartDialog::showSummary(const QJsonObject &summary)
+{
+    m_running = false;
+    
+    // Final results carry the launch-to-ready time of each VM
+    for (const QJsonValue &value : summary.value("vms").toArray()) {
+        QJsonObject vm = value.toObject();
+        QTreeWidgetItem *item = findItem(vm.value("name").toString());
+        if (!item) {
+            continue;
+        }
+        QString result = vm.value("result").toString();
+        item->setText(StageColumn, stageText(result));
+        if (vm.contains("durationMs")) {
+            item->setText(TimeColumn, QString("%1 s").arg(vm.value("durationMs").toInteger() / 1000.0, 0, 'f', 1));
+        }
+    }
+    
+    int failed = summary.value("failed").toInt();
+    QString elapsed = QString::number(summary.value("elapsedMs").toInteger() / 1000.0, 'f', 1);
+    m_statusLabel->setText(failed ? tr("Terminado en %1 s: %2 VMs con errores").arg(elapsed).arg(failed)
+                                  : tr("Terminado en %1 s").arg(elapsed));
+}
+
+QTreeWidgetItem* BulkStartDialog::findItem(const QString &vmName) const
+{
+    for (int i = 0; i < m_vmTree->topLevelItemCount(); ++i) {
+        if (m_vmTree->topLevelItem(i)->text(NameColumn) == vmName) {
+            return m_vmTree->topLevelItem(i);
+        }
+    }
+    return nullptr;
+}
+
+QString BulkStartDialog::stageText(const QString &stage)
+{
+    static const QHash<QString, const char*> texts = {
+        {"waiting", QT_TR_NOOP("En espera")},
+        {"starting", QT_TR_NOOP("Arrancando")},
+        {"booting", QT_TR_NOOP("Arrancando el sistema")},
+        {"ready", QT_TR_NOOP("Lista")},
+        {"already-running", QT_TR_NOOP("Ya estaba en marcha")},
+        {"stopping", QT_TR_NOOP("Deteniendo")},
+        {"stopped", QT_TR_NOOP("Detenida")},
+        {"already-stopped", QT_TR_NOOP("Ya estaba detenida")},
+        {"timeout", QT_TR_NOOP("Sin respuesta")},
+        {"failed", QT_TR_NOOP("Error")},
+        {"skipped", QT_TR_NOOP("Omitida")}
+    };
+    return texts.contains(stage) ? tr(texts.value(stage)) : stage;
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef BULKSTARTDIALOG_H
+#define BULKSTARTDIALOG_H
+
+#include <QDialog>
+#include <QTreeWidget>
+#include <QPushButton>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QFormLayout>
+#include <QLabel>
+#include <QSpinBox>
+#include <QDoubleSpinBox>
+#include <QComboBox>
+#include <QCheckBox>
+#include <QGroupBox>
+#include <QJsonObject>
+
+#include "../core/BootScheduler.h"
+
+class KVMManager;
+class QDialogButtonBox;
+
+/**
+ * @brief Arranque o parada en bloque de las VMs seleccionadas
+ * Permite ajustar el paralelismo, la rampa, la señal de disponibilidad y
+ * el orden (prioridad y dependencias de cada VM) antes de lanzar el
+ * BootScheduler, y muestra la etapa en que está cada VM.
+ */
+class BulkStartDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    BulkStartDialog(KVMManager *kvmManager, const QStringList &vmNames,
+                    BootScheduler::Action action, QWidget *parent = nullptr);
+
+private slots:
+    void run();
+    void onProgress(const QString &vmName, const QString &stage, const QString &detail);
+
+private:
+    void setupUI();
+    void populateTree();
+    BootScheduler::Options collectOptions() const;
+    void saveDependencies();
+    void showSummary(const QJsonObject &summary);
+    QTreeWidgetItem* findItem(const QString &vmName) const;
+    static QString stageText(const QString &stage);
+    
+    KVMManager *m_kvmManager;
+    QStringList m_vmNames;
+    BootScheduler::Action m_action;
+    bool m_running;
+    
+    // Options
+    QSpinBox *m_parallelSpin;
+    QSpinBox *m_rampSpin;
+    QComboBox *m_readinessCombo;
+    QSpinBox *m_readyTimeoutSpin;
+    QDoubleSpinBox *m_ioLimitSpin;
+    QCheckBox *m_saveDefaultsCheck;
+    QCheckBox *m_saveDependenciesCheck;
+    
+    // Order and progress
+    QTreeWidget *m_vmTree;
+    QLabel *m_statusLabel;
+    QPushButton *m_runButton;
+    QDialogButtonBox *m_buttonBox;
+};
+
+#endif // BULKSTARTDIALOG_H
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "KsmDialog.h"
+#include "../core/KVMManager.h"
+
+#include <QApplication>
+#include <QDialogButtonBox>
+#include <QHeaderView>
+#include <QJsonArray>
+#include <QMessageBox>
+#include <QTimer>
+
+KsmDialog::KsmDialog(KVMManager *kvmManager, QWidget *parent)
+    : QDialog(parent)
+    , m_kvmManager(kvmManager)
+    , m_refreshTimer(new QTimer(this))
+    , m_pageSizeKB(4)
+    , m_lastCpuTimeMs(-1)
+    , m_settingsLoaded(false)
+{
+    setWindowTitle(tr("Memoria compartida (KSM)"));
+    setWindowIcon(QApplication::style()->standardIcon(QStyle::SP_ComputerIcon));
+    resize(640, 560);
+    setModal(true);
+    
+    setupUI();
+    
+    connect(m_refreshTimer, &QTimer::timeout, this, &KsmDialog::refresh);
+    m_refreshTimer->start(2000);
+    refresh();
+}
+
+void KsmDialog::setupUI()
+{
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    
+    // Settings
+    QGroupBox *settingsGroup = new QGroupBox(tr("Ajustes de ksmd"));
+    QGridLayout *settingsLayout = new QGridLayout(settingsGroup);
+    
+    m_enabledCheck = new QCheckBox(tr("Fusionar las páginas idénticas de las VMs"));
+    settingsLayout->addWidget(m_enabledCheck, 0, 0, 1, 3);
+    
+    m_pagesToScanSpin = new QSpinBox;
+    m_pagesToScanSpin->setRange(1, 100000);
+    m_pagesToScanSpin->setSuffix(tr(" páginas"));
+    settingsLayout->addWidget(new QLabel(tr("Páginas por pasada:")), 1, 0);
+    settingsLayout->addWidget(m_pagesToScanSpin, 1, 1);
+    
+    m_sleepSpin = new QSpinBox;
+    m_sleepSpin->setRange(0, 60000);
+    m_sleepSpin->setSuffix(" ms");
+    settingsLayout->addWidget(new QLabel(tr("Pausa entre pasadas:")), 2, 0);
+    settingsLayout->addWidget(m_sleepSpin, 2, 1);
+    
+    m_scanRateLabel = new QLabel;
+    settingsLayout->addWidget(m_scanRateLabel, 1, 2, 2, 1);
+    
+    connect(m_pagesToScanSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, &KsmDialog::updateScanRate);
+    connect(m_sleepSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, &KsmDialog::updateScanRate);
+    
+    QHBoxLayout *settingsButtons = new QHBoxLayout;
+    m_unmergeButton = new QPushButton(tr("&Deshacer fusiones"));
+    m_unmergeButton->setToolTip(tr("Para ksmd y vuelve a dar a cada VM su propia copia de las páginas fusionadas"));
+    m_applyButton = new QPushButton(QApplication::style()->standardIcon(QStyle::SP_DialogApplyButton), tr("&Aplicar"));
+    settingsButtons->addWidget(m_unmergeButton);
+    settingsButtons->addStretch();
+    settingsButtons->addWidget(m_applyButton);
+    settingsLayout->addLayout(settingsButtons, 3, 0, 1, 3);
+    
+    connect(m_applyButton, &QPushButton::clicked, this, &KsmDialog::applySettings);
+    connect(m_unmergeButton, &QPushButton::clicked, this, &KsmDialog::unmergeAll);
+    
+    QLabel *permissionInfo = new QLabel(tr("Cambiar estos ajustes requiere permisos de administrador "
+                                           "(/sys/kernel/mm/ksm). Cuanto más deprisa explora ksmd, antes "
+                                           "aparece el ahorro y más CPU consume."));
+    permissionInfo->setWordWrap(true);
+    settingsLayout->addWidget(permissionInfo, 4, 0, 1, 3);
+    
+    mainLayout->addWidget(settingsGroup);
+    
+    // Savings
+    QGroupBox *savingsGroup = new QGroupBox(tr("Ahorro"));
+    QGridLayout *savingsLayout = new QGridLayout(savingsGroup);
+    
+    auto addValue = [savingsLayout](int row, int column, const QString &label, const QString &toolTip) {
+        QLabel *title = new QLabel(label);
+        title->setToolTip(toolTip);
+        QLabel *value = new QLabel("-");
+        value->setTextInteractionFlags(Qt::TextSelectableByMouse);
+        savingsLayout->addWidget(title, row, column * 2);
+        savingsLayout->addWidget(value, row, column * 2 + 1);
+        return value;
+    };
+    m_savedLabel = addValue(0, 0, tr("RAM ahorrada:"), tr("pages_sharing más las páginas fusionadas con la página cero"));
+    m_profitLabel = addValue(0, 1, tr("Beneficio neto:"), tr("Ahorro menos la memoria que ocupan los metadatos de KSM"));
+    m_sharedLabel = addValue(1, 0, tr("Páginas compartidas:"), tr("Copias únicas que sustituyen a las repetidas (pages_shared)"));
+    m_sharingLabel = addValue(1, 1, tr("Referencias:"), tr("Páginas que apuntan a una compartida (pages_sharing)"));
+    m_unsharedLabel = addValue(2, 0, tr("Sin pareja:"), tr("Revisadas sin encontrar otra igual (pages_unshared)"));
+    m_volatileLabel = addValue(2, 1, tr("Volátiles:"), tr("Cambian demasiado deprisa para fusionarlas (pages_volatile)"));
+    m_fullScansLabel = addValue(3, 0, tr("Exploraciones completas:"), tr("Veces que ksmd ha recorrido toda la memoria marcada"));
+    m_cpuLabel = addValue(3, 1, tr("CPU de ksmd:"), tr("Uso medio de CPU del hilo ksmd desde la última actualización"));
+    
+    mainLayout->addWidget(savingsGroup);
+    
+    // Per-VM breakdown (QEMU guests only; needs /proc/<pid>/ksm_merging_pages)
+    QGroupBox *vmGroup = new QGroupBox(tr("Máquinas virtuales en ejecución"));
+    QVBoxLayout *vmLayout = new QVBoxLayout(vmGroup);
+    
+    m_vmTree = new QTreeWidget;
+    m_vmTree->setHeaderLabels({tr("Nombre"), tr("Fusionable"), tr("Memoria"), tr("Fusionada"), tr("% de su RAM")});
+    m_vmTree->setRootIsDecorated(false);
+    m_vmTree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    vmLayout->addWidget(m_vmTree);
+    
+    mainLayout->addWidget(vmGroup);
+    
+    QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Close);
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    mainLayout->addWidget(buttonBox);
+}
+
+void KsmDialog::refresh()
+{
+    QJsonObject status = m_kvmManager->getKsmStatus();
+    if (!status.value("supported").toBool()) {
+        m_refreshTimer->stop();
+        setEnabled(false);
+        m_savedLabel->setText(tr("El kernel no tiene soporte de KSM"));
+        return;
+    }
+    
+    // The settings are read once so a refresh does not overwrite edits
+    m_pageSizeKB = status.value("pageSizeKB").toInt(4);
+    if (!m_settingsLoaded) {
+        loadSettings(status);
+    }
+    
+    m_savedLabel->setText(formatKB(status.value("savedKB").toInteger()));
+    m_profitLabel->setText(status.contains("generalProfitKB")
+                           ? formatKB(status.value("generalProfitKB").toInteger()) : tr("no disponible"));
+    m_sharedLabel->setText(QString("%1 (%2)").arg(status.value("pagesShared").toInteger())
+                           .arg(formatKB(status.value("pagesShared").toInteger() * m_pageSizeKB)));
+    m_sharingLabel->setText(QString::number(status.value("pagesSharing").toInteger()));
+    m_unsharedLabel->setText(QString::number(status.value("pagesUnshared").toInteger()));
+    m_volatileLabel->setText(QString::number(status.value("pagesVolatile").toInteger()));
+    m_fullScansLabel->setText(QString::number(status.value("fullScans").toInteger()));
+    
+    // ksmd CPU usage between two consecutive refreshes
+    if (status.contains("ksmdCpuTimeMs")) {
+        qint64 cpuTimeMs = status.value("ksmdCpuTimeMs").toInteger();
+        if (m_lastCpuTimeMs >= 0 && m_lastSample.elapsed() > 0) {
+            double percent = 100.0 * (cpuTimeMs - m_lastCpuTimeMs) / m_lastSample.elapsed();
+            m_cpuLabel->setText(QString("%1 %").arg(percent, 0, 'f', 1));
+        }
+        m_lastCpuTimeMs = cpuTimeMs;
+        m_lastSample.restart();
+    } else {
+        m_cpuLabel->setText(tr("no disponible"));
+    }
+    
+    m_vmTree->clear();
+    for (const QJsonValue &value : status.value("vms").toArray()) {
+        QJsonObject vm = value.toObject();
+        QTreeWidgetItem *item = new QTreeWidgetItem(m_vmTree);
+        qint64 memoryKB = vm.value("memoryMB").toInteger() * 1024;
+        item->setText(0, vm.value("name").toString());
+        item->setText(1, vm.value("mergeable").toBool() ? tr("Sí") : tr("No"));
+        item->setText(2, formatKB(memoryKB));
+        if (vm.contains("mergedKB")) {
+            qint64 mergedKB = vm.value("mergedKB").toInteger();
+            item->setText(3, formatKB(mergedKB));
+            item->setText(4, QString("%1 %").arg(memoryKB ? 100.0 * mergedKB / memoryKB : 0.0, 0, 'f', 1));
+        } else {
+            item->setText(3, tr("n/d"));
+            item->setToolTip(3, tr("Requiere un kernel 5.19 o posterior"));
+        }
+    }
+}
+
+void KsmDialog::loadSettings(const QJsonObject &status)
+{
+    m_enabledCheck->setChecked(status.value("run").toInt() == 1);
+    m_pagesToScanSpin->setValue(status.value("pagesToScan").toInt());
+    m_sleepSpin->setValue(status.value("sleepMillisecs").toInt());
+    m_settingsLoaded = true;
+    updateScanRate();
+}
+
+void KsmDialog::applySettings()
+{
+    if (!m_kvmManager->setKsm(m_enabledCheck->isChecked() ? 1 : 0,
+                              m_pagesToScanSpin->value(), m_sleepSpin->value())) {
+        // KVMManager::errorOccurred already reported why
+        return;
+    }
+    
+    m_settingsLoaded = false;
+    refresh();
+}
+
+void KsmDialog::unmergeAll()
+{
+    int ret = QMessageBox::question(this, tr("Deshacer fusiones"),
+                                    tr("Cada VM volverá a ocupar toda su memoria. Compruebe que el anfitrión "
+                                       "tiene RAM libre suficiente (ahorro actual: %1).\n\n¿Continuar?")
+                                    .arg(m_savedLabel->text()),
+                                    QMessageBox::Yes | QMessageBox::No);
+    if (ret != QMessageBox::Yes || !m_kvmManager->setKsm(2)) {
+        return;
+    }
+    
+    m_settingsLoaded = false;
+    refresh();
+}
+
+void KsmDialog::updateScanRate()
+{
+    // ksmd checks pages_to_scan pages every sleep_millisecs
+    double pagesPerSecond = m_pagesToScanSpin->value() * 1000.0 / qMax(1, m_sleepSpin->value());
+    m_scanRateLabel->setText(tr("≈ %1 MB/s explorados").arg(pagesPerSecond * m_pageSizeKB / 1024, 0, 'f', 1));
+}
+
+QString KsmDialog::formatKB(qint64 kb)
+{
+    // general_profit puede ser negativo
+    if (qAbs(kb) >= 1024 * 1024) {
+        return QString("%1 GB").arg(kb / (1024.0 * 1024.0), 0, 'f', 2);
+    }
+    return QString("%1 MB").arg(kb / 1024.0, 0, 'f', 1);
+}
\ No newline at end of file
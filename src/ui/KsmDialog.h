@@ -0,0 +1,74 @@
+#ifndef KSMDIALOG_H
+#define KSMDIALOG_H
+
+#include <QDialog>
+#include <QTreeWidget>
+#include <QPushButton>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QGridLayout>
+#include <QLabel>
+#include <QSpinBox>
+#include <QCheckBox>
+#include <QGroupBox>
+#include <QElapsedTimer>
+#include <QJsonObject>
+
+class KVMManager;
+class QTimer;
+
+/**
+ * @brief Panel de KSM (kernel samepage merging)
+ * Muestra cuánta RAM ahorra la fusión de páginas idénticas, en total y por
+ * VM, junto con la CPU que consume ksmd, y permite ajustar la velocidad de
+ * exploración.
+ */
+class KsmDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit KsmDialog(KVMManager *kvmManager, QWidget *parent = nullptr);
+
+private slots:
+    void refresh();
+    void applySettings();
+    void unmergeAll();
+    void updateScanRate();
+
+private:
+    void setupUI();
+    void loadSettings(const QJsonObject &status);
+    static QString formatKB(qint64 kb);
+    
+    KVMManager *m_kvmManager;
+    QTimer *m_refreshTimer;
+    
+    // Settings
+    QCheckBox *m_enabledCheck;
+    QSpinBox *m_pagesToScanSpin;
+    QSpinBox *m_sleepSpin;
+    QLabel *m_scanRateLabel;
+    QPushButton *m_applyButton;
+    QPushButton *m_unmergeButton;
+    
+    // Savings
+    QLabel *m_savedLabel;
+    QLabel *m_profitLabel;
+    QLabel *m_sharedLabel;
+    QLabel *m_sharingLabel;
+    QLabel *m_unsharedLabel;
+    QLabel *m_volatileLabel;
+    QLabel *m_fullScansLabel;
+    QLabel *m_cpuLabel;
+    QTreeWidget *m_vmTree;
+    
+    int m_pageSizeKB;
+    
+    // Previous ksmd CPU sample, to report usage between refreshes
+    qint64 m_lastCpuTimeMs;
+    QElapsedTimer m_lastSample;
+    bool m_settingsLoaded;
+};
+
+#endif // KSMDIALOG_H
\ No newline at end of file
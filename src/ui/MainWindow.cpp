@@ -8,8 +8,15 @@
 #include "DiskManagerDialog.h"
 #include "MediaManagerDialog.h"
 #include "NetworkManagerDialog.h"
+#include "KsmDialog.h"
+#include "BulkStartDialog.h"
+#include "WarmPoolDialog.h"
 #include "SnapshotManagerDialog.h"
 #include "../core/KVMManager.h"
+#include "../core/ControlServer.h"
+#include "../core/MemoryPressureController.h"
+#include "../core/AdmissionController.h"
+#include "../core/WarmPool.h"
 #include "../core/VirtualMachine.h"
 
 #include <QApplication>
@@ -26,12 +33,19 @@
 #include <QLabel>
 #include <QIcon>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QInputDialog>
 #include <QStandardPaths>
+#include <QDebug>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDateTime>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , m_kvmManager(new KVMManager(this))
+    , m_controlServer(new ControlServer(m_kvmManager, this))
+    , m_pressureController(new MemoryPressureController(m_kvmManager, this))
     , m_centralSplitter(nullptr)
     , m_vmListWidget(nullptr)
     , m_vmDetailsWidget(nullptr)
@@ -43,6 +57,49 @@ MainWindow::MainWindow(QWidget *parent)
     
     setupUI();
     updateUIState();
+    
+    // Socket de control para scripts y herramientas externas
+    if (!m_controlServer->listen()) {
+        qWarning() << "No se pudo abrir el socket de control en" << ControlServer::defaultSocketPath();
+    }
+    
+    // Protección del anfitrión cuando se queda sin memoria; las decisiones
+    // se muestran en la barra de estado (y quedan en el registro)
+    m_controlServer->setMemoryPressureController(m_pressureController);
+    connect(m_pressureController, &MemoryPressureController::decisionMade, this, [this](const QString &message) {
+        statusBar()->showMessage(message, 10000);
+    });
+    m_pressureController->start();
+    
+    // Long external snapshot chains slow down every read of older data
+    connect(m_kvmManager, &KVMManager::chainDepthWarning, this, [this](const QString &name, const QString &disk, int depth) {
+        statusBar()->showMessage(tr("'%1': el disco %2 tiene %3 capas externas; conviene consolidarlo desde Instantáneas")
+                                 .arg(name, QFileInfo(disk).fileName()).arg(depth), 15000);
+    });
+    
+    // Starts that do not fit in the host's committed RAM/vCPUs
+    AdmissionController *admission = m_kvmManager->getAdmissionController();
+    connect(admission, &AdmissionController::vmQueued, this, [this](const QString &name, const QString &reason) {
+        statusBar()->showMessage(tr("'%1' espera en cola para arrancar: %2").arg(name, reason), 15000);
+    });
+    connect(admission, &AdmissionController::warning, this, [this](const QString &message) {
+        QMessageBox::warning(this, tr("Recursos insuficientes"), message);
+    });
+    
+    // Standby instances are refilled while the main window is open
+    WarmPool *warmPool = m_kvmManager->getWarmPool();
+    connect(warmPool, &WarmPool::instanceFailed, this,
+            [this](const QString &templateName, const QString &name, const QString &error) {
+        statusBar()->showMessage(tr("Reserva de '%1': se descartó %2 (%3)").arg(templateName, name, error), 15000);
+    });
+    warmPool->start();
+    
+    // Sincronización incremental con los dominios de libvirt del anfitrión
+    if (m_kvmManager->isLibvirtRunning()) {
+        QTimer::singleShot(0, this, [this]() {
+            m_kvmManager->syncLibvirtDomainsAsync(false);
+        });
+    }
 }
 
 MainWindow::~MainWindow()
@@ -65,81 +122,106 @@ void MainWindow::createActions()
     m_newVMAction->setShortcut(QKeySequence::New);
     m_newVMAction->setStatusTip(tr("Crear una nueva máquina virtual"));
     connect(m_newVMAction, &QAction::triggered, this, &MainWindow::newVM);
-
+    
     m_addVMAction = new QAction(QApplication::style()->standardIcon(QStyle::SP_DialogOpenButton), tr("&Agregar..."), this);
     m_addVMAction->setShortcut(QKeySequence("Ctrl+A"));
     m_addVMAction->setStatusTip(tr("Agregar una máquina virtual existente"));
     connect(m_addVMAction, &QAction::triggered, this, &MainWindow::addVM);
-
+    
     m_preferencesAction = new QAction(QApplication::style()->standardIcon(QStyle::SP_FileDialogDetailedView), tr("&Preferencias..."), this);
     m_preferencesAction->setShortcut(QKeySequence::Preferences);
     m_preferencesAction->setStatusTip(tr("Configurar preferencias globales"));
     connect(m_preferencesAction, &QAction::triggered, this, &MainWindow::showPreferences);
-
+    
     m_exitAction = new QAction(QApplication::style()->standardIcon(QStyle::SP_DialogCloseButton), tr("&Salir"), this);
     m_exitAction->setShortcut(QKeySequence::Quit);
     m_exitAction->setStatusTip(tr("Salir de la aplicación"));
     connect(m_exitAction, &QAction::triggered, this, &QWidget::close);
-
+    
     // Machine menu actions
     m_removeVMAction = new QAction(QApplication::style()->standardIcon(QStyle::SP_TrashIcon), tr("&Eliminar..."), this);
     m_removeVMAction->setShortcut(QKeySequence::Delete);
     m_removeVMAction->setStatusTip(tr("Eliminar la máquina virtual seleccionada"));
     connect(m_removeVMAction, &QAction::triggered, this, &MainWindow::removeVM);
-
+    
     m_configureVMAction = new QAction(QApplication::style()->standardIcon(QStyle::SP_ComputerIcon), tr("&Configuración..."), this);
     m_configureVMAction->setShortcut(QKeySequence("Ctrl+S"));
     m_configureVMAction->setStatusTip(tr("Configurar la máquina virtual seleccionada"));
     connect(m_configureVMAction, &QAction::triggered, this, &MainWindow::configureVM);
-
+    
     m_startVMAction = new QAction(QApplication::style()->standardIcon(QStyle::SP_MediaPlay), tr("&Iniciar"), this);
     m_startVMAction->setShortcut(QKeySequence("Ctrl+T"));
     m_startVMAction->setStatusTip(tr("Iniciar la máquina virtual seleccionada"));
     connect(m_startVMAction, &QAction::triggered, this, &MainWindow::startVM);
-
+    
     m_pauseVMAction = new QAction(QApplication::style()->standardIcon(QStyle::SP_MediaPause), tr("&Pausar"), this);
     m_pauseVMAction->setStatusTip(tr("Pausar la máquina virtual en ejecución"));
     connect(m_pauseVMAction, &QAction::triggered, this, &MainWindow::pauseVM);
-
+    
     m_stopVMAction = new QAction(QApplication::style()->standardIcon(QStyle::SP_MediaStop), tr("&Detener"), this);
     m_stopVMAction->setShortcut(QKeySequence("Ctrl+H"));
     m_stopVMAction->setStatusTip(tr("Detener la máquina virtual en ejecución"));
     connect(m_stopVMAction, &QAction::triggered, this, &MainWindow::stopVM);
-
+    
     // New manager actions
     m_diskManagerAction = new QAction(QIcon(":/icons/disk-manager.png"), tr("Administrador de &discos virtuales..."), this);
     m_diskManagerAction->setStatusTip(tr("Administrar discos duros virtuales - crear, copiar, modificar y eliminar"));
     connect(m_diskManagerAction, &QAction::triggered, this, &MainWindow::showDiskManager);
-
+    
     m_mediaManagerAction = new QAction(QApplication::style()->standardIcon(QStyle::SP_DriveHDIcon), tr("Administrador de &medios virtuales..."), this);
     m_mediaManagerAction->setStatusTip(tr("Administrar discos duros virtuales, CD/DVD e imágenes de disquete"));
     connect(m_mediaManagerAction, &QAction::triggered, this, &MainWindow::showMediaManager);
-
+    
     m_networkManagerAction = new QAction(QApplication::style()->standardIcon(QStyle::SP_ComputerIcon), tr("Administrador de &red..."), this);
     m_networkManagerAction->setStatusTip(tr("Administrar redes NAT y adaptadores solo anfitrión"));
     connect(m_networkManagerAction, &QAction::triggered, this, &MainWindow::showNetworkManager);
-
+    
+    m_ksmAction = new QAction(QApplication::style()->standardIcon(QStyle::SP_ComputerIcon), tr("Memoria &compartida (KSM)..."), this);
+    m_ksmAction->setStatusTip(tr("Ver la RAM que ahorra la fusión de páginas idénticas y ajustar ksmd"));
+    connect(m_ksmAction, &QAction::triggered, this, &MainWindow::showKsmDialog);
+    
+    m_warmPoolAction = new QAction(QApplication::style()->standardIcon(QStyle::SP_MediaPlay), tr("Reservas de instancias en &espera..."), this);
+    m_warmPoolAction->setStatusTip(tr("Mantener instancias arrancadas de una plantilla para entregarlas al instante"));
+    connect(m_warmPoolAction, &QAction::triggered, this, &MainWindow::showWarmPoolDialog);
+    
     m_snapshotManagerAction = new QAction(QApplication::style()->standardIcon(QStyle::SP_FileIcon), tr("&Instantáneas..."), this);
     m_snapshotManagerAction->setStatusTip(tr("Administrar instantáneas de la máquina virtual"));
     connect(m_snapshotManagerAction, &QAction::triggered, this, &MainWindow::showSnapshotManager);
-
+    
     m_importVMAction = new QAction(QApplication::style()->standardIcon(QStyle::SP_ArrowDown), tr("&Importar servicio virtualizado..."), this);
     m_importVMAction->setStatusTip(tr("Importar una máquina virtual desde un archivo OVA/OVF"));
     connect(m_importVMAction, &QAction::triggered, this, &MainWindow::importVM);
-
+    
+    m_importLibvirtAction = new QAction(QApplication::style()->standardIcon(QStyle::SP_BrowserReload), tr("Importar dominios de &libvirt"), this);
+    m_importLibvirtAction->setStatusTip(tr("Importar y sincronizar los dominios existentes en libvirt"));
+    connect(m_importLibvirtAction, &QAction::triggered, this, &MainWindow::importLibvirtDomains);
+    
     m_exportVMAction = new QAction(QApplication::style()->standardIcon(QStyle::SP_ArrowUp), tr("&Exportar servicio virtualizado..."), this);
     m_exportVMAction->setStatusTip(tr("Exportar la máquina virtual a un archivo OVA/OVF"));
     connect(m_exportVMAction, &QAction::triggered, this, &MainWindow::exportVM);
-
+    
     m_cloneVMAction = new QAction(QApplication::style()->standardIcon(QStyle::SP_DialogSaveButton), tr("&Clonar..."), this);
     m_cloneVMAction->setStatusTip(tr("Crear una copia de la máquina virtual"));
     connect(m_cloneVMAction, &QAction::triggered, this, &MainWindow::cloneVM);
-
+    
+    m_forkVMAction = new QAction(tr("Clonar en c&aliente..."), this);
+    m_forkVMAction->setStatusTip(tr("Crear copias en marcha de la máquina a partir de una sola captura de su memoria"));
+    connect(m_forkVMAction, &QAction::triggered, this, &MainWindow::forkVM);
+    
+    m_groupSnapshotAction = new QAction(tr("Instantánea del &grupo..."), this);
+    m_groupSnapshotAction->setStatusTip(tr("Capturar a la vez los discos de todas las máquinas del grupo"));
+    connect(m_groupSnapshotAction, &QAction::triggered, this, &MainWindow::createGroupSnapshot);
+    
+    m_templateVMAction = new QAction(tr("Usar como &plantilla"), this);
+    m_templateVMAction->setCheckable(true);
+    m_templateVMAction->setStatusTip(tr("Congelar los discos de la máquina para crear otras a partir de ella al instante"));
+    connect(m_templateVMAction, &QAction::triggered, this, &MainWindow::setVMTemplate);
+    
     // Help menu actions
     m_aboutAction = new QAction(QApplication::style()->standardIcon(QStyle::SP_MessageBoxInformation), tr("&Acerca de KVM Manager"), this);
     m_aboutAction->setStatusTip(tr("Mostrar información sobre la aplicación"));
     connect(m_aboutAction, &QAction::triggered, this, &MainWindow::showAbout);
-
+    
     m_aboutQtAction = new QAction(tr("Acerca de &Qt"), this);
     m_aboutQtAction->setStatusTip(tr("Mostrar información sobre Qt"));
     connect(m_aboutQtAction, &QAction::triggered, qApp, &QApplication::aboutQt);
@@ -153,20 +235,25 @@ void MainWindow::setupMenuBar()
     m_fileMenu->addAction(m_addVMAction);
     m_fileMenu->addSeparator();
     m_fileMenu->addAction(m_importVMAction);
+    m_fileMenu->addAction(m_importLibvirtAction);
     m_fileMenu->addAction(m_exportVMAction);
     m_fileMenu->addSeparator();
     m_fileMenu->addAction(m_diskManagerAction);
     m_fileMenu->addAction(m_mediaManagerAction);
     m_fileMenu->addAction(m_networkManagerAction);
+    m_fileMenu->addAction(m_ksmAction);
+    m_fileMenu->addAction(m_warmPoolAction);
     m_fileMenu->addSeparator();
     m_fileMenu->addAction(m_preferencesAction);
     m_fileMenu->addSeparator();
     m_fileMenu->addAction(m_exitAction);
-
+    
     // Machine menu
     m_machineMenu = menuBar()->addMenu(tr("&Máquina"));
     m_machineMenu->addAction(m_removeVMAction);
     m_machineMenu->addAction(m_cloneVMAction);
+    m_machineMenu->addAction(m_forkVMAction);
+    m_machineMenu->addAction(m_templateVMAction);
     m_machineMenu->addAction(m_configureVMAction);
     m_machineMenu->addSeparator();
     m_machineMenu->addAction(m_startVMAction);
@@ -174,10 +261,11 @@ void MainWindow::setupMenuBar()
     m_machineMenu->addAction(m_stopVMAction);
     m_machineMenu->addSeparator();
     m_machineMenu->addAction(m_snapshotManagerAction);
-
+    m_machineMenu->addAction(m_groupSnapshotAction);
+    
     // View menu
     m_viewMenu = menuBar()->addMenu(tr("&Ver"));
-
+    
     // Help menu
     m_helpMenu = menuBar()->addMenu(tr("A&yuda"));
     m_helpMenu->addAction(m_aboutAction);
@@ -210,7 +298,7 @@ void MainWindow::setupCentralWidget()
     m_vmListWidget->setMaximumWidth(400);
     
     // Create VM details widget (right panel)
-    m_vmDetailsWidget = new VMDetailsWidget(this);
+    m_vmDetailsWidget = new VMDetailsWidget(m_kvmManager, this);
     
     // Add widgets to splitter
     m_centralSplitter->addWidget(m_vmListWidget);
@@ -230,6 +318,9 @@ void MainWindow::setupCentralWidget()
     // Connect KVMManager signals to refresh VM list
     connect(m_kvmManager, &KVMManager::vmListChanged,
             m_vmListWidget, &VMListWidget::refreshVMList);
+    connect(m_kvmManager, &KVMManager::vmStateChanged, this, [this]() {
+        updateUIState();
+    });
     
     // Connect error signals
     connect(m_kvmManager, &KVMManager::errorOccurred,
@@ -324,6 +415,15 @@ void MainWindow::configureVM()
 
 void MainWindow::startVM()
 {
+    // Several VMs: paced by the boot scheduler
+    QStringList selectedVMs = m_vmListWidget->getSelectedVMs();
+    if (selectedVMs.size() > 1) {
+        BulkStartDialog dialog(m_kvmManager, selectedVMs, BootScheduler::Start, this);
+        dialog.exec();
+        updateUIState();
+        return;
+    }
+    
     QString selectedVM = m_vmListWidget->getSelectedVM();
     if (selectedVM.isEmpty()) {
         QMessageBox::warning(this, tr("Iniciar VM"), 
@@ -331,15 +431,14 @@ void MainWindow::startVM()
         return;
     }
     
-    // Intentar iniciar la VM usando KVMManager
-    if (m_kvmManager->startVM(selectedVM)) {
-        m_statusLabel->setText(tr("Máquina virtual '%1' iniciada correctamente").arg(selectedVM));
-        // Actualizar estado de botones
+    // El arranque puede esperar minutos en la cola de admisión; la interfaz
+    // sigue respondiendo entretanto. Los errores llegan por errorOccurred
+    m_statusLabel->setText(tr("Iniciando la máquina virtual '%1'...").arg(selectedVM));
+    m_kvmManager->startVMAsync(selectedVM, [this, selectedVM](const VMBackend::Result &result) {
+        m_statusLabel->setText(result.ok ? tr("Máquina virtual '%1' iniciada correctamente").arg(selectedVM)
+                                         : tr("Error al iniciar la máquina virtual"));
         updateUIState();
-    } else {
-        // El error ya se mostrará via señal errorOccurred
-        m_statusLabel->setText(tr("Error al iniciar la máquina virtual"));
-    }
+    });
 }
 
 void MainWindow::pauseVM()
@@ -351,15 +450,35 @@ void MainWindow::pauseVM()
 
 void MainWindow::stopVM()
 {
-    // TODO: Implement VM stop
-    QMessageBox::information(this, tr("Detener VM"), 
-                           tr("Funcionalidad de detener VM será implementada próximamente."));
+    QStringList selectedVMs = m_vmListWidget->getSelectedVMs();
+    if (selectedVMs.size() > 1) {
+        BulkStartDialog dialog(m_kvmManager, selectedVMs, BootScheduler::Stop, this);
+        dialog.exec();
+        updateUIState();
+        return;
+    }
+    
+    QString selectedVM = m_vmListWidget->getSelectedVM();
+    if (selectedVM.isEmpty()) {
+        return;
+    }
+    
+    // The guest gets an ACPI shutdown request; don't block the UI while it powers off
+    m_statusLabel->setText(tr("Deteniendo la máquina virtual '%1'...").arg(selectedVM));
+    m_kvmManager->stopVMAsync(selectedVM, [this, selectedVM](const VMBackend::Result &result) {
+        m_statusLabel->setText(result.ok ? tr("Máquina virtual '%1' detenida").arg(selectedVM)
+                                         : tr("Error al detener la máquina virtual"));
+        updateUIState();
+    });
 }
 
 void MainWindow::showPreferences()
 {
     PreferencesDialog dialog(m_kvmManager, this);
     dialog.exec();
+    
+    // La política de presión de memoria puede haber cambiado (Aceptar o Aplicar)
+    m_pressureController->reloadPolicy();
 }
 
 void MainWindow::showAbout()
@@ -392,15 +511,27 @@ void MainWindow::updateUIState()
     QString selectedVM = m_vmListWidget->getSelectedVM();
     bool hasSelection = !selectedVM.isEmpty();
     
+    // Stop applies to the whole selection: enabled if any of it is up
+    bool anyActive = false;
+    for (const QString &vmName : m_vmListWidget->getSelectedVMs()) {
+        QString state = m_kvmManager->getVMState(vmName);
+        anyActive = anyActive || state == "running" || state == "paused";
+    }
+    
     // Enable/disable actions based on selection
     m_removeVMAction->setEnabled(hasSelection);
     m_configureVMAction->setEnabled(hasSelection);
     m_startVMAction->setEnabled(hasSelection);
     m_pauseVMAction->setEnabled(false); // TODO: Enable when VM is running
-    m_stopVMAction->setEnabled(false);  // TODO: Enable when VM is running
+    m_stopVMAction->setEnabled(anyActive);
     m_cloneVMAction->setEnabled(hasSelection);
+    VirtualMachine *vm = hasSelection ? m_kvmManager->getVirtualMachine(selectedVM) : nullptr;
+    m_forkVMAction->setEnabled(vm && vm->getBackend() == "qemu" && m_kvmManager->getVMState(selectedVM) == "running");
+    m_templateVMAction->setEnabled(vm && vm->getBackend() == "qemu");
+    m_templateVMAction->setChecked(vm && vm->isTemplate());
     m_exportVMAction->setEnabled(hasSelection);
     m_snapshotManagerAction->setEnabled(hasSelection);
+    m_groupSnapshotAction->setEnabled(vm && !vm->getGroup().isEmpty());
 }
 
 // New manager implementations
@@ -422,6 +553,18 @@ void MainWindow::showNetworkManager()
     dialog.exec();
 }
 
+void MainWindow::showKsmDialog()
+{
+    KsmDialog dialog(m_kvmManager, this);
+    dialog.exec();
+}
+
+void MainWindow::showWarmPoolDialog()
+{
+    WarmPoolDialog dialog(m_kvmManager, this);
+    dialog.exec();
+}
+
 void MainWindow::showSnapshotManager()
 {
     QString selectedVM = m_vmListWidget->getSelectedVM();
@@ -433,7 +576,7 @@ void MainWindow::showSnapshotManager()
     
     VirtualMachine *vm = m_kvmManager->getVirtualMachine(selectedVM);
     if (vm) {
-        SnapshotManagerDialog dialog(vm, this);
+        SnapshotManagerDialog dialog(m_kvmManager, vm, this);
         dialog.exec();
     }
 }
@@ -451,6 +594,26 @@ void MainWindow::importVM()
     }
 }
 
+void MainWindow::importLibvirtDomains()
+{
+    // Con muchos dominios tarda: la ventana sigue respondiendo mientras tanto
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    m_kvmManager->syncLibvirtDomainsAsync(true, [this](const VMBackend::Result &result) {
+        QApplication::restoreOverrideCursor();
+        if (!result.ok) {
+            return;
+        }
+        
+        QJsonObject summary = result.value.toObject();
+        m_statusLabel->setText(tr("libvirt: %1 dominios (%2 importados, %3 actualizados, %4 eliminados) en %5 ms")
+                               .arg(summary["domains"].toInt())
+                               .arg(summary["imported"].toInt())
+                               .arg(summary["updated"].toInt())
+                               .arg(summary["removed"].toInt())
+                               .arg(summary["elapsedMs"].toInteger()));
+    });
+}
+
 void MainWindow::exportVM()
 {
     QString selectedVM = m_vmListWidget->getSelectedVM();
@@ -471,6 +634,84 @@ void MainWindow::exportVM()
     }
 }
 
+void MainWindow::setVMTemplate(bool isTemplate)
+{
+    QString selectedVM = m_vmListWidget->getSelectedVM();
+    if (selectedVM.isEmpty()) {
+        return;
+    }
+    
+    // El error ya se mostró a través del signal errorOccurred
+    if (m_kvmManager->setVMTemplate(selectedVM, isTemplate)) {
+        m_statusLabel->setText(isTemplate ? tr("'%1' es ahora una plantilla").arg(selectedVM)
+                                          : tr("'%1' ya no es una plantilla").arg(selectedVM));
+    }
+    updateUIState();
+}
+
+void MainWindow::forkVM()
+{
+    QString selectedVM = m_vmListWidget->getSelectedVM();
+    if (selectedVM.isEmpty()) {
+        return;
+    }
+    
+    bool ok;
+    int count = QInputDialog::getInt(this, tr("Clonar en caliente"),
+        tr("Número de clones de '%1' (arrancarán desde su memoria actual):").arg(selectedVM),
+        1, 1, 64, 1, &ok);
+    if (!ok) {
+        return;
+    }
+    
+    m_statusLabel->setText(tr("Clonando '%1' en caliente...").arg(selectedVM));
+    m_kvmManager->forkVMAsync(selectedVM, count, QString(), [this, selectedVM](const VMBackend::Result &result) {
+        QJsonObject value = result.value.toObject();
+        if (!value.isEmpty()) {
+            m_statusLabel->setText(tr("%1 clones de '%2' en marcha en %3 ms (captura de memoria: %4 ms)")
+                                   .arg(value.value("created").toArray().size())
+                                   .arg(selectedVM)
+                                   .arg(value.value("msecs").toInteger())
+                                   .arg(value.value("captureMsecs").toInteger()));
+        } else {
+            m_statusLabel->setText(tr("No se pudo clonar '%1' en caliente").arg(selectedVM));
+        }
+        updateUIState();
+    });
+}
+
+void MainWindow::createGroupSnapshot()
+{
+    VirtualMachine *vm = m_kvmManager->getVirtualMachine(m_vmListWidget->getSelectedVM());
+    if (!vm || vm->getGroup().isEmpty()) {
+        return;
+    }
+    
+    QString group = vm->getGroup();
+    bool ok;
+    QString tag = QInputDialog::getText(this, tr("Instantánea del grupo"),
+        tr("Nombre de la instantánea de %1:").arg(m_kvmManager->getGroupMembers(group).join(", ")),
+        QLineEdit::Normal, QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss"), &ok).trimmed();
+    if (!ok || tag.isEmpty()) {
+        return;
+    }
+    
+    m_statusLabel->setText(tr("Instantánea del grupo '%1' en curso...").arg(group));
+    m_kvmManager->createGroupSnapshotAsync(group, tag, [this, group](const VMBackend::Result &result) {
+        QJsonObject value = result.value.toObject();
+        if (result.ok) {
+            m_statusLabel->setText(tr("Instantánea del grupo '%1': %2 VMs, %3 ms en pausa (%4 congeladas)")
+                                   .arg(group)
+                                   .arg(value.value("members").toArray().size())
+                                   .arg(value.value("pauseMsecs").toInteger())
+                                   .arg(value.value("quiesced").toArray().size()));
+        } else {
+            m_statusLabel->setText(tr("No se pudo tomar la instantánea del grupo '%1'").arg(group));
+        }
+        updateUIState();
+    });
+}
+
 void MainWindow::cloneVM()
 {
     QString selectedVM = m_vmListWidget->getSelectedVM();
@@ -493,7 +734,7 @@ void MainWindow::cloneVM()
             .arg(selectedVM).arg(cloneName),
             QMessageBox::Yes | QMessageBox::No, 
             QMessageBox::Yes);
-            
+        
         if (reply == QMessageBox::Yes) {
             // Crear un progreso dialog para mostrar el progreso
             QProgressDialog progress(tr("Clonando máquina virtual..."), tr("Cancelar"), 0, 0, this);
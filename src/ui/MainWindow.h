@@ -15,6 +15,8 @@
 class VMListWidget;
 class VMDetailsWidget;
 class KVMManager;
+class ControlServer;
+class MemoryPressureController;
 class MediaManagerDialog;
 class NetworkManagerDialog;
 class SnapshotManagerDialog;
@@ -44,10 +46,16 @@ private slots:
     void showDiskManager();
     void showMediaManager();
     void showNetworkManager();
+    void showKsmDialog();
+    void showWarmPoolDialog();
     void showSnapshotManager();
     void importVM();
+    void importLibvirtDomains();
     void exportVM();
     void cloneVM();
+    void forkVM();
+    void createGroupSnapshot();
+    void setVMTemplate(bool isTemplate);
 
 private:
     void setupUI();
@@ -60,6 +68,8 @@ private:
 
     // Core components
     KVMManager *m_kvmManager;
+    ControlServer *m_controlServer;
+    MemoryPressureController *m_pressureController;
     
     // UI components
     QSplitter *m_centralSplitter;
@@ -71,6 +81,9 @@ private:
     QAction *m_addVMAction;
     QAction *m_removeVMAction;
     QAction *m_cloneVMAction;
+    QAction *m_forkVMAction;
+    QAction *m_groupSnapshotAction;
+    QAction *m_templateVMAction;
     QAction *m_configureVMAction;
     QAction *m_startVMAction;
     QAction *m_pauseVMAction;
@@ -84,8 +97,11 @@ private:
     QAction *m_diskManagerAction;
     QAction *m_mediaManagerAction;
     QAction *m_networkManagerAction;
+    QAction *m_ksmAction;
+    QAction *m_warmPoolAction;
     QAction *m_snapshotManagerAction;
     QAction *m_importVMAction;
+    QAction *m_importLibvirtAction;
     QAction *m_exportVMAction;
     
     // Menus
@@ -1,5 +1,8 @@
 #include "PreferencesDialog.h"
 #include "../core/KVMManager.h"
+#include "../core/MemoryPressureController.h"
+#include "../core/AdmissionController.h"
+#include "../core/QemuManager.h"
 
 #include <QDialogButtonBox>
 #include <QVBoxLayout>
@@ -48,6 +51,7 @@ void PreferencesDialog::setupUI()
     createNetworkTab();
     createProxyTab();
     createInterfaceTab();
+    createMemoryTab();
     
     mainLayout->addWidget(m_tabWidget);
     
@@ -59,7 +63,10 @@ void PreferencesDialog::setupUI()
     m_cancelButton = buttonBox->button(QDialogButtonBox::Cancel);
     m_applyButton = buttonBox->button(QDialogButtonBox::Apply);
     
-    connect(buttonBox, &QDialogButtonBox::accepted, this, &PreferencesDialog::accept);
+    connect(buttonBox, &QDialogButtonBox::accepted, this, [this]() {
+        saveSettings();
+        accept();
+    });
     connect(buttonBox, &QDialogButtonBox::rejected, this, &PreferencesDialog::reject);
     connect(m_applyButton, &QPushButton::clicked, this, &PreferencesDialog::saveSettings);
     
@@ -108,6 +115,35 @@ void PreferencesDialog::createGeneralTab()
     snapshotLayout->addWidget(m_browseSnapshotButton);
     foldersLayout->addLayout(snapshotLayout, 1, 1);
     
+    // External snapshot overlays
+    m_overlayInSnapshotFolderCheckBox = new QCheckBox(tr("Crear las capas externas en la carpeta de instantáneas (si no, junto a cada disco)"));
+    foldersLayout->addWidget(m_overlayInSnapshotFolderCheckBox, 2, 0, 1, 2);
+    foldersLayout->addWidget(new QLabel(tr("Avisar con más de:")), 3, 0);
+    m_chainWarningSpin = new QSpinBox();
+    m_chainWarningSpin->setRange(1, 64);
+    m_chainWarningSpin->setSuffix(tr(" capas por disco"));
+    m_chainWarningSpin->setToolTip(tr("Cada capa externa añade una búsqueda en las lecturas; pasado este número se sugiere consolidar"));
+    foldersLayout->addWidget(m_chainWarningSpin, 3, 1);
+    
+    // Throwaway overlays of VMs in ephemeral mode
+    foldersLayout->addWidget(new QLabel(tr("Carpeta de las VMs efímeras:")), 4, 0);
+    m_ephemeralFolderEdit = new QLineEdit();
+    m_ephemeralFolderEdit->setToolTip(tr("Aquí van las escrituras descartables; en tmpfs ocupan RAM y, si se llena, "
+                                         "la VM se pausa hasta liberar espacio. Vacía: /dev/shm"));
+    QPushButton *browseEphemeralButton = new QPushButton(tr("Examinar..."));
+    connect(browseEphemeralButton, &QPushButton::clicked, this, [this]() {
+        QString folder = QFileDialog::getExistingDirectory(this, tr("Seleccionar carpeta de las VMs efímeras"),
+                                                         QemuManager::ephemeralDirectory());
+        if (!folder.isEmpty()) {
+            m_ephemeralFolderEdit->setText(folder);
+        }
+    });
+    
+    QHBoxLayout *ephemeralLayout = new QHBoxLayout();
+    ephemeralLayout->addWidget(m_ephemeralFolderEdit);
+    ephemeralLayout->addWidget(browseEphemeralButton);
+    foldersLayout->addLayout(ephemeralLayout, 4, 1);
+    
     layout->addWidget(foldersGroup);
     
     // Auto-update section
@@ -395,6 +431,134 @@ void PreferencesDialog::createInterfaceTab()
     m_tabWidget->addTab(m_interfaceTab, tr("Interfaz"));
 }
 
+void PreferencesDialog::createMemoryTab()
+{
+    m_memoryTab = new QWidget();
+    QVBoxLayout *layout = new QVBoxLayout(m_memoryTab);
+    
+    QGroupBox *pressureGroup = new QGroupBox(tr("🧠 Presión de memoria del anfitrión"));
+    QGridLayout *pressureLayout = new QGridLayout(pressureGroup);
+    
+    m_pressureEnabledCheckBox = new QCheckBox(tr("Recuperar memoria de las VMs cuando el anfitrión se quede sin RAM"));
+    pressureLayout->addWidget(m_pressureEnabledCheckBox, 0, 0, 1, 2);
+    
+    // Umbrales de PSI (/proc/pressure/memory, media de 10 s) y de MemAvailable
+    auto addPercentSpin = [pressureLayout](int row, const QString &label, int minimum, int maximum) {
+        pressureLayout->addWidget(new QLabel(label), row, 0);
+        QSpinBox *spin = new QSpinBox();
+        spin->setRange(minimum, maximum);
+        spin->setSuffix(" %");
+        pressureLayout->addWidget(spin, row, 1);
+        return spin;
+    };
+    m_pressureSomeSpin = addPercentSpin(1, tr("Tiempo con tareas esperando memoria (some):"), 1, 100);
+    m_pressureFullSpin = addPercentSpin(2, tr("Tiempo con todo el sistema esperando (full):"), 1, 100);
+    m_minAvailableSpin = addPercentSpin(3, tr("Memoria disponible mínima:"), 1, 90);
+    m_recoverySpin = addPercentSpin(4, tr("Devolver memoria por encima de:"), 2, 95);
+    m_balloonStepSpin = addPercentSpin(5, tr("Memoria recuperada en cada paso del balón:"), 5, 50);
+    m_balloonFloorSpin = addPercentSpin(6, tr("Memoria mínima que conserva el invitado:"), 10, 95);
+    
+    pressureLayout->addWidget(new QLabel(tr("Espera entre acciones:")), 7, 0);
+    m_cooldownSpin = new QSpinBox();
+    m_cooldownSpin->setRange(1, 300);
+    m_cooldownSpin->setSuffix(" s");
+    pressureLayout->addWidget(m_cooldownSpin, 7, 1);
+    
+    layout->addWidget(pressureGroup);
+    
+    QGroupBox *actionsGroup = new QGroupBox(tr("Acciones permitidas (de menor a mayor impacto)"));
+    QVBoxLayout *actionsLayout = new QVBoxLayout(actionsGroup);
+    
+    m_allowBalloonCheckBox = new QCheckBox(tr("Encoger el balón de memoria"));
+    m_allowPauseCheckBox = new QCheckBox(tr("Pausar la VM"));
+    m_allowSaveCheckBox = new QCheckBox(tr("Suspender la VM a disco"));
+    m_restoreSavedCheckBox = new QCheckBox(tr("Restaurar las VMs suspendidas cuando vuelva a haber memoria"));
+    actionsLayout->addWidget(m_allowBalloonCheckBox);
+    actionsLayout->addWidget(m_allowPauseCheckBox);
+    actionsLayout->addWidget(m_allowSaveCheckBox);
+    actionsLayout->addWidget(m_restoreSavedCheckBox);
+    
+    QLabel *priorityInfo = new QLabel(tr("Se actúa primero sobre las VMs de prioridad baja y después sobre las normales; "
+                                         "las de prioridad alta nunca se tocan. La prioridad se elige en la configuración "
+                                         "de cada VM. Las decisiones se registran en %1.").arg(MemoryPressureController::logPath()));
+    priorityInfo->setWordWrap(true);
+    actionsLayout->addWidget(priorityInfo);
+    
+    layout->addWidget(actionsGroup);
+    
+    QGroupBox *admissionGroup = new QGroupBox(tr("🚦 Control de admisión"));
+    QGridLayout *admissionLayout = new QGridLayout(admissionGroup);
+    
+    m_admissionEnabledCheckBox = new QCheckBox(tr("Comprobar la RAM y las CPUs comprometidas antes de arrancar una VM"));
+    admissionLayout->addWidget(m_admissionEnabledCheckBox, 0, 0, 1, 2);
+    
+    admissionLayout->addWidget(new QLabel(tr("Si la VM no cabe:")), 1, 0);
+    m_admissionModeCombo = new QComboBox();
+    m_admissionModeCombo->addItem(tr("Avisar y arrancar igualmente"), "warn");
+    m_admissionModeCombo->addItem(tr("Esperar en cola a que se liberen recursos"), "queue");
+    m_admissionModeCombo->addItem(tr("Rechazar el arranque"), "refuse");
+    admissionLayout->addWidget(m_admissionModeCombo, 1, 1);
+    
+    admissionLayout->addWidget(new QLabel(tr("Sobreasignación de memoria:")), 2, 0);
+    m_memoryOvercommitSpin = new QDoubleSpinBox();
+    m_memoryOvercommitSpin->setRange(0.5, 4.0);
+    m_memoryOvercommitSpin->setSingleStep(0.1);
+    m_memoryOvercommitSpin->setPrefix("× ");
+    m_memoryOvercommitSpin->setToolTip(tr("RAM de las VMs en marcha respecto a la del anfitrión; por encima de 1 "
+                                          "se cuenta con el balón, KSM o memoria que los invitados no usan"));
+    admissionLayout->addWidget(m_memoryOvercommitSpin, 2, 1);
+    
+    admissionLayout->addWidget(new QLabel(tr("Sobreasignación de CPU:")), 3, 0);
+    m_cpuOvercommitSpin = new QDoubleSpinBox();
+    m_cpuOvercommitSpin->setRange(1.0, 16.0);
+    m_cpuOvercommitSpin->setSingleStep(0.5);
+    m_cpuOvercommitSpin->setPrefix("× ");
+    m_cpuOvercommitSpin->setToolTip(tr("vCPUs de las VMs en marcha por cada CPU lógica del anfitrión"));
+    admissionLayout->addWidget(m_cpuOvercommitSpin, 3, 1);
+    
+    admissionLayout->addWidget(new QLabel(tr("Memoria reservada para el anfitrión:")), 4, 0);
+    m_reservedMemorySpin = new QSpinBox();
+    m_reservedMemorySpin->setRange(0, 1024 * 1024);
+    m_reservedMemorySpin->setSingleStep(256);
+    m_reservedMemorySpin->setSuffix(" MB");
+    admissionLayout->addWidget(m_reservedMemorySpin, 4, 1);
+    
+    admissionLayout->addWidget(new QLabel(tr("Espera máxima en cola:")), 5, 0);
+    m_queueTimeoutSpin = new QSpinBox();
+    m_queueTimeoutSpin->setRange(10, 3600);
+    m_queueTimeoutSpin->setSuffix(" s");
+    admissionLayout->addWidget(m_queueTimeoutSpin, 5, 1);
+    
+    layout->addWidget(admissionGroup);
+    
+    QGroupBox *saveGroup = new QGroupBox(tr("💾 Suspensión a disco"));
+    QGridLayout *saveLayout = new QGridLayout(saveGroup);
+    
+    saveLayout->addWidget(new QLabel(tr("Compresión del estado:")), 0, 0);
+    m_saveCompressionCombo = new QComboBox();
+    m_saveCompressionCombo->addItem(tr("Automática (la más rápida medida en este equipo)"), "auto");
+    m_saveCompressionCombo->addItem(tr("Sin comprimir (mapped-ram en paralelo si QEMU lo admite)"), "none");
+    m_saveCompressionCombo->addItem(tr("zstd (archivo más pequeño, más CPU)"), "zstd");
+    saveLayout->addWidget(m_saveCompressionCombo, 0, 1);
+    
+    saveLayout->addWidget(new QLabel(tr("Canales / hilos:")), 1, 0);
+    m_saveChannelsSpin = new QSpinBox();
+    m_saveChannelsSpin->setRange(0, 64);
+    m_saveChannelsSpin->setSpecialValueText(tr("Automático"));
+    m_saveChannelsSpin->setToolTip(tr("Canales multifd o hilos de zstd; en automático, la mitad de las CPUs (de 2 a 8)"));
+    saveLayout->addWidget(m_saveChannelsSpin, 1, 1);
+    
+    m_saveThroughputLabel = new QLabel();
+    m_saveThroughputLabel->setWordWrap(true);
+    m_saveThroughputLabel->setStyleSheet("color: #888; font-size: 11px;");
+    saveLayout->addWidget(m_saveThroughputLabel, 2, 0, 1, 2);
+    
+    layout->addWidget(saveGroup);
+    layout->addStretch();
+    
+    m_tabWidget->addTab(m_memoryTab, tr("Memoria"));
+}
+
 void PreferencesDialog::loadSettings()
 {
     QSettings settings;
@@ -405,6 +569,12 @@ void PreferencesDialog::loadSettings()
     m_snapshotFolderEdit->setText(settings.value("general/snapshotFolder", 
                                  QStandardPaths::writableLocation(QStandardPaths::HomeLocation) + "/.local/share/kvm/snapshots").toString());
     
+    QemuManager::OverlayPolicy overlays = QemuManager::loadOverlayPolicy();
+    m_overlayInSnapshotFolderCheckBox->setChecked(overlays.useSnapshotFolder);
+    m_chainWarningSpin->setValue(overlays.chainWarningDepth);
+    m_ephemeralFolderEdit->setText(settings.value("ephemeral/directory").toString());
+    m_ephemeralFolderEdit->setPlaceholderText(QemuManager::ephemeralDirectory());
+    
     m_languageCombo->setCurrentText(settings.value("general/language", tr("Español")).toString());
     m_autoUpdateCheckBox->setChecked(settings.value("general/autoUpdate", true).toBool());
     m_updateFrequencyCombo->setCurrentText(settings.value("general/updateFrequency", tr("Semanal")).toString());
@@ -429,6 +599,43 @@ void PreferencesDialog::loadSettings()
     m_showStatusbarCheckBox->setChecked(settings.value("interface/showStatusbar", true).toBool());
     m_themeCombo->setCurrentText(settings.value("interface/theme", tr("Oscuro")).toString());
     m_iconSizeCombo->setCurrentText(settings.value("interface/iconSize", tr("Mediano (24px)")).toString());
+    
+    // Host memory tab
+    MemoryPressureController::Policy policy = MemoryPressureController::loadPolicy();
+    m_pressureEnabledCheckBox->setChecked(policy.enabled);
+    m_pressureSomeSpin->setValue(qRound(policy.someThreshold));
+    m_pressureFullSpin->setValue(qRound(policy.fullThreshold));
+    m_minAvailableSpin->setValue(policy.minAvailablePercent);
+    m_recoverySpin->setValue(policy.recoveryPercent);
+    m_balloonStepSpin->setValue(policy.balloonStepPercent);
+    m_balloonFloorSpin->setValue(policy.balloonFloorPercent);
+    m_cooldownSpin->setValue(policy.cooldownSecs);
+    m_allowBalloonCheckBox->setChecked(policy.allowBalloon);
+    m_allowPauseCheckBox->setChecked(policy.allowPause);
+    m_allowSaveCheckBox->setChecked(policy.allowSave);
+    m_restoreSavedCheckBox->setChecked(policy.restoreSaved);
+    
+    AdmissionController::Policy admission = AdmissionController::loadPolicy();
+    m_admissionEnabledCheckBox->setChecked(admission.enabled);
+    m_admissionModeCombo->setCurrentIndex(qMax(0, m_admissionModeCombo->findData(admission.mode)));
+    m_memoryOvercommitSpin->setValue(admission.memoryOvercommit);
+    m_cpuOvercommitSpin->setValue(admission.cpuOvercommit);
+    m_reservedMemorySpin->setValue(admission.reservedMB);
+    m_queueTimeoutSpin->setValue(admission.queueTimeoutSecs);
+    
+    QemuManager::SaveStatePolicy savePolicy = QemuManager::loadSaveStatePolicy();
+    m_saveCompressionCombo->setCurrentIndex(qMax(0, m_saveCompressionCombo->findData(savePolicy.compression)));
+    m_saveChannelsSpin->setValue(savePolicy.channels);
+    QStringList measured;
+    for (const QString &format : {QString("mapped-ram"), QString("stream"), QString("zstd")}) {
+        double mbps = QemuManager::measuredSaveThroughput(format);
+        if (mbps > 0) {
+            measured.append(QString("%1: %2 MB/s").arg(format).arg(qRound(mbps)));
+        }
+    }
+    m_saveThroughputLabel->setText(measured.isEmpty()
+        ? tr("Aún no se ha medido ningún guardado en este equipo.")
+        : tr("Rendimiento medido (RAM del invitado por segundo): %1").arg(measured.join(", ")));
 }
 
 void PreferencesDialog::saveSettings()
@@ -442,6 +649,12 @@ void PreferencesDialog::saveSettings()
     settings.setValue("general/autoUpdate", m_autoUpdateCheckBox->isChecked());
     settings.setValue("general/updateFrequency", m_updateFrequencyCombo->currentText());
     
+    QemuManager::OverlayPolicy overlays;
+    overlays.useSnapshotFolder = m_overlayInSnapshotFolderCheckBox->isChecked();
+    overlays.chainWarningDepth = m_chainWarningSpin->value();
+    QemuManager::saveOverlayPolicy(overlays);
+    QemuManager::setEphemeralDirectory(m_ephemeralFolderEdit->text().trimmed());
+    
     // Input tab
     settings.setValue("input/hostKey", m_hostKeyCombo->currentText());
     
@@ -463,6 +676,36 @@ void PreferencesDialog::saveSettings()
     settings.setValue("interface/theme", m_themeCombo->currentText());
     settings.setValue("interface/iconSize", m_iconSizeCombo->currentText());
     
+    // Host memory tab
+    MemoryPressureController::Policy policy;
+    policy.enabled = m_pressureEnabledCheckBox->isChecked();
+    policy.someThreshold = m_pressureSomeSpin->value();
+    policy.fullThreshold = m_pressureFullSpin->value();
+    policy.minAvailablePercent = m_minAvailableSpin->value();
+    policy.recoveryPercent = m_recoverySpin->value();
+    policy.balloonStepPercent = m_balloonStepSpin->value();
+    policy.balloonFloorPercent = m_balloonFloorSpin->value();
+    policy.cooldownSecs = m_cooldownSpin->value();
+    policy.allowBalloon = m_allowBalloonCheckBox->isChecked();
+    policy.allowPause = m_allowPauseCheckBox->isChecked();
+    policy.allowSave = m_allowSaveCheckBox->isChecked();
+    policy.restoreSaved = m_restoreSavedCheckBox->isChecked();
+    MemoryPressureController::savePolicy(policy);
+    
+    AdmissionController::Policy admission;
+    admission.enabled = m_admissionEnabledCheckBox->isChecked();
+    admission.mode = m_admissionModeCombo->currentData().toString();
+    admission.memoryOvercommit = m_memoryOvercommitSpin->value();
+    admission.cpuOvercommit = m_cpuOvercommitSpin->value();
+    admission.reservedMB = m_reservedMemorySpin->value();
+    admission.queueTimeoutSecs = m_queueTimeoutSpin->value();
+    AdmissionController::savePolicy(admission);
+    
+    QemuManager::SaveStatePolicy savePolicy;
+    savePolicy.compression = m_saveCompressionCombo->currentData().toString();
+    savePolicy.channels = m_saveChannelsSpin->value();
+    QemuManager::saveSaveStatePolicy(savePolicy);
+    
     // Update KVM Manager settings if needed
     if (m_kvmManager) {
         m_kvmManager->setDefaultVMPath(m_defaultVMFolderEdit->text());
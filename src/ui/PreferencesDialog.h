@@ -12,6 +12,7 @@
 #include <QComboBox>
 #include <QCheckBox>
 #include <QSpinBox>
+#include <QDoubleSpinBox>
 #include <QPushButton>
 #include <QFileDialog>
 #include <QListWidget>
@@ -51,6 +52,7 @@ private:
     void createNetworkTab();
     void createProxyTab();
     void createInterfaceTab();
+    void createMemoryTab();
     
     // UI Components
     QTabWidget *m_tabWidget;
@@ -62,6 +64,9 @@ private:
     QPushButton *m_browseVMFolderButton;
     QLineEdit *m_snapshotFolderEdit;
     QPushButton *m_browseSnapshotButton;
+    QCheckBox *m_overlayInSnapshotFolderCheckBox;
+    QSpinBox *m_chainWarningSpin;
+    QLineEdit *m_ephemeralFolderEdit;
     QCheckBox *m_autoUpdateCheckBox;
     QComboBox *m_updateFrequencyCombo;
     
@@ -110,6 +115,34 @@ private:
     QComboBox *m_themeCombo;
     QComboBox *m_iconSizeCombo;
     
+    // Host Memory Tab (memory-pressure controller policy)
+    QWidget *m_memoryTab;
+    QCheckBox *m_pressureEnabledCheckBox;
+    QSpinBox *m_pressureSomeSpin;
+    QSpinBox *m_pressureFullSpin;
+    QSpinBox *m_minAvailableSpin;
+    QSpinBox *m_recoverySpin;
+    QSpinBox *m_balloonStepSpin;
+    QSpinBox *m_balloonFloorSpin;
+    QSpinBox *m_cooldownSpin;
+    QCheckBox *m_allowBalloonCheckBox;
+    QCheckBox *m_allowPauseCheckBox;
+    QCheckBox *m_allowSaveCheckBox;
+    QCheckBox *m_restoreSavedCheckBox;
+    
+    // Admission control (committed RAM/vCPUs before each start)
+    QCheckBox *m_admissionEnabledCheckBox;
+    QComboBox *m_admissionModeCombo;
+    QDoubleSpinBox *m_memoryOvercommitSpin;
+    QDoubleSpinBox *m_cpuOvercommitSpin;
+    QSpinBox *m_reservedMemorySpin;
+    QSpinBox *m_queueTimeoutSpin;
+    
+    // Suspend to disk (format and parallelism of the state file)
+    QComboBox *m_saveCompressionCombo;
+    QSpinBox *m_saveChannelsSpin;
+    QLabel *m_saveThroughputLabel;
+    
     // Buttons
     QPushButton *m_okButton;
     QPushButton *m_cancelButton;
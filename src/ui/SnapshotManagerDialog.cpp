@@ -1,4 +1,5 @@
 #include "SnapshotManagerDialog.h"
+#include "../core/KVMManager.h"
 #include "../core/VirtualMachine.h"
 
 #include <QApplication>
@@ -6,12 +7,23 @@
 #include <QTreeWidgetItem>
 #include <QMessageBox>
 #include <QInputDialog>
+#include <QLocale>
+#include <QPointer>
 #include <QFileInfo>
-#include <QRandomGenerator>
 
-SnapshotManagerDialog::SnapshotManagerDialog(VirtualMachine *vm, QWidget *parent)
+namespace {
+// Marks the "current state" pseudo-item, which is not a snapshot
+const int CurrentStateRole = Qt::UserRole + 1;
+// Overlays above the base image, on a chain's top-level item
+const int ChainDepthRole = Qt::UserRole + 2;
+}
+
+SnapshotManagerDialog::SnapshotManagerDialog(KVMManager *kvmManager, VirtualMachine *vm, QWidget *parent)
     : QDialog(parent)
+    , m_kvmManager(kvmManager)
     , m_vm(vm)
+    , m_vmName(vm ? vm->getName() : QString())
+    , m_busy(false)
 {
     setWindowTitle(tr("Instantáneas - %1").arg(vm ? vm->getName() : tr("Sin VM")));
     setWindowIcon(QApplication::style()->standardIcon(QStyle::SP_FileIcon));
@@ -20,6 +32,14 @@ SnapshotManagerDialog::SnapshotManagerDialog(VirtualMachine *vm, QWidget *parent
     
     setupUI();
     refreshSnapshots();
+    
+    connect(m_kvmManager, &KVMManager::jobProgress, this, &SnapshotManagerDialog::onJobProgress);
+    connect(m_kvmManager, &KVMManager::vmStateChanged, this, [this](const QString &name, const QString &) {
+        // A live restore also changes the state; the job refreshes on its own
+        if (name == m_vmName && !m_busy) {
+            refreshSnapshots();
+        }
+    });
 }
 
 void SnapshotManagerDialog::setupUI()
@@ -40,7 +60,7 @@ void SnapshotManagerDialog::setupUI()
     
     // Tree widget
     m_snapshotTree = new QTreeWidget();
-    m_snapshotTree->setHeaderLabels({tr("Nombre"), tr("Tomada")});
+    m_snapshotTree->setHeaderLabels({tr("Nombre"), tr("Tomada"), tr("Memoria")});
     m_snapshotTree->header()->setStretchLastSection(true);
     m_snapshotTree->setAlternatingRowColors(true);
     m_snapshotTree->setRootIsDecorated(true);
@@ -68,6 +88,73 @@ void SnapshotManagerDialog::setupUI()
     
     leftLayout->addLayout(buttonLayout);
     
+    // External overlays: one branch per disk, from the image in use down to its base
+    QGroupBox *chainGroup = new QGroupBox(tr("Capas externas"));
+    QVBoxLayout *chainLayout = new QVBoxLayout(chainGroup);
+    m_chainTree = new QTreeWidget();
+    m_chainTree->setHeaderLabels({tr("Imagen"), tr("Formato"), tr("Ocupa")});
+    m_chainTree->header()->setStretchLastSection(true);
+    m_chainTree->setMaximumHeight(160);
+    connect(m_chainTree, &QTreeWidget::itemSelectionChanged, this, &SnapshotManagerDialog::updateSnapshotDetails);
+    chainLayout->addWidget(m_chainTree);
+    
+    QHBoxLayout *chainButtonLayout = new QHBoxLayout();
+    m_overlayButton = new QPushButton(tr("&Nueva capa"));
+    m_overlayButton->setToolTip(tr("Congela los discos actuales y sigue escribiendo en una capa qcow2 nueva"));
+    m_commitButton = new QPushButton(tr("C&onsolidar"));
+    m_commitButton->setToolTip(tr("Vuelca las capas del disco seleccionado en su imagen base y las elimina"));
+    m_streamButton = new QPushButton(tr("&Aplanar"));
+    m_streamButton->setToolTip(tr("Copia en la capa superior los datos de sus bases y la deja independiente"));
+    chainButtonLayout->addWidget(m_overlayButton);
+    chainButtonLayout->addStretch();
+    chainButtonLayout->addWidget(m_commitButton);
+    chainButtonLayout->addWidget(m_streamButton);
+    chainLayout->addLayout(chainButtonLayout);
+    leftLayout->addWidget(chainGroup);
+    
+    connect(m_overlayButton, &QPushButton::clicked, this, &SnapshotManagerDialog::addOverlay);
+    connect(m_commitButton, &QPushButton::clicked, this, &SnapshotManagerDialog::commitChain);
+    connect(m_streamButton, &QPushButton::clicked, this, &SnapshotManagerDialog::streamChain);
+    
+    // Checkpoints: frozen disks (plus RAM if taken while running) to reset a test VM to
+    m_checkpointGroup = new QGroupBox(tr("Puntos de control"));
+    QVBoxLayout *checkpointLayout = new QVBoxLayout(m_checkpointGroup);
+    m_checkpointTree = new QTreeWidget();
+    m_checkpointTree->setHeaderLabels({tr("Nombre"), tr("Creado"), tr("Memoria")});
+    m_checkpointTree->setRootIsDecorated(false);
+    m_checkpointTree->header()->setStretchLastSection(true);
+    m_checkpointTree->setMaximumHeight(120);
+    connect(m_checkpointTree, &QTreeWidget::itemSelectionChanged, this, &SnapshotManagerDialog::updateSnapshotDetails);
+    checkpointLayout->addWidget(m_checkpointTree);
+    
+    QHBoxLayout *checkpointButtonLayout = new QHBoxLayout();
+    m_createCheckpointButton = new QPushButton(tr("Crear &punto"));
+    m_createCheckpointButton->setToolTip(tr("Congela los discos y, si la VM está en marcha, guarda su memoria"));
+    m_resetCheckpointButton = new QPushButton(tr("&Volver al punto"));
+    m_resetCheckpointButton->setToolTip(tr("Descarta todo lo ocurrido desde el punto de control; con memoria, la VM sigue desde ahí"));
+    m_deleteCheckpointButton = new QPushButton(tr("Eliminar p&unto"));
+    checkpointButtonLayout->addWidget(m_createCheckpointButton);
+    checkpointButtonLayout->addStretch();
+    checkpointButtonLayout->addWidget(m_resetCheckpointButton);
+    checkpointButtonLayout->addWidget(m_deleteCheckpointButton);
+    checkpointLayout->addLayout(checkpointButtonLayout);
+    leftLayout->addWidget(m_checkpointGroup);
+    
+    connect(m_createCheckpointButton, &QPushButton::clicked, this, &SnapshotManagerDialog::createCheckpoint);
+    connect(m_resetCheckpointButton, &QPushButton::clicked, this, &SnapshotManagerDialog::resetToCheckpoint);
+    connect(m_deleteCheckpointButton, &QPushButton::clicked, this, &SnapshotManagerDialog::deleteCheckpoint);
+    
+    // Background job progress
+    QHBoxLayout *jobLayout = new QHBoxLayout();
+    m_jobLabel = new QLabel();
+    m_jobLabel->setWordWrap(true);
+    m_progressBar = new QProgressBar();
+    m_progressBar->setRange(0, 100);
+    m_progressBar->setVisible(false);
+    jobLayout->addWidget(m_jobLabel, 1);
+    jobLayout->addWidget(m_progressBar);
+    leftLayout->addLayout(jobLayout);
+    
     // Connect signals
     connect(m_takeSnapshotButton, &QPushButton::clicked, this, &SnapshotManagerDialog::takeSnapshot);
     connect(m_deleteSnapshotButton, &QPushButton::clicked, this, &SnapshotManagerDialog::deleteSnapshot);
@@ -96,7 +183,7 @@ void SnapshotManagerDialog::setupUI()
     m_timestampLabel = new QLabel();
     detailsLayout->addWidget(m_timestampLabel, 2, 1);
     
-    detailsLayout->addWidget(new QLabel(tr("Tamaño:")), 3, 0);
+    detailsLayout->addWidget(new QLabel(tr("Memoria guardada:")), 3, 0);
     m_sizeLabel = new QLabel();
     detailsLayout->addWidget(m_sizeLabel, 3, 1);
     
@@ -104,8 +191,16 @@ void SnapshotManagerDialog::setupUI()
     m_vmStateLabel = new QLabel();
     detailsLayout->addWidget(m_vmStateLabel, 4, 1);
     
+    detailsLayout->addWidget(new QLabel(tr("Tiempo del invitado:")), 5, 0);
+    m_vmClockLabel = new QLabel();
+    detailsLayout->addWidget(m_vmClockLabel, 5, 1);
+    
+    detailsLayout->addWidget(new QLabel(tr("Tamaño del disco:")), 6, 0);
+    m_diskSizeLabel = new QLabel();
+    detailsLayout->addWidget(m_diskSizeLabel, 6, 1);
+    
     // Add spacer
-    detailsLayout->addItem(new QSpacerItem(20, 40, QSizePolicy::Minimum, QSizePolicy::Expanding), 5, 0, 1, 2);
+    detailsLayout->addItem(new QSpacerItem(20, 40, QSizePolicy::Minimum, QSizePolicy::Expanding), 7, 0, 1, 2);
     
     m_splitter->addWidget(m_detailsGroup);
     m_splitter->setSizes({500, 300});
@@ -124,224 +219,532 @@ void SnapshotManagerDialog::setupUI()
 
 void SnapshotManagerDialog::refreshSnapshots()
 {
-    populateSnapshotTree();
-    updateSnapshotDetails();
+    refreshChains();
+    refreshCheckpoints();
+    if (m_vmName.isEmpty()) {
+        populateSnapshotTree(QJsonArray());
+        updateSnapshotDetails();
+        return;
+    }
+    
+    QPointer<SnapshotManagerDialog> self(this);
+    m_kvmManager->querySnapshotTree(m_vmName, [self](const VMBackend::Result &result) {
+        if (!self) {
+            return;
+        }
+        self->populateSnapshotTree(result.ok ? result.value.toArray() : QJsonArray());
+        self->updateSnapshotDetails();
+    });
 }
 
-void SnapshotManagerDialog::populateSnapshotTree()
+void SnapshotManagerDialog::populateSnapshotTree(const QJsonArray &snapshots)
 {
+    QString selected = selectedSnapshot();
     m_snapshotTree->clear();
+    m_snapshots.clear();
+    m_currentSnapshot.clear();
+    
+    QHash<QString, QTreeWidgetItem*> items;
+    for (const QJsonValue &value : snapshots) {
+        QJsonObject snapshot = value.toObject();
+        QString name = snapshot.value("name").toString();
+        m_snapshots.insert(name, snapshot);
+        if (snapshot.value("current").toBool()) {
+            m_currentSnapshot = name;
+        }
+        
+        QTreeWidgetItem *item = new QTreeWidgetItem();
+        item->setText(0, name);
+        QDateTime created = QDateTime::fromString(snapshot.value("created").toString(), Qt::ISODate);
+        item->setText(1, created.isValid() ? created.toLocalTime().toString("dd/MM/yyyy hh:mm") : QString());
+        qint64 vmStateSize = snapshot.value("vmStateSize").toInteger();
+        item->setText(2, vmStateSize > 0 ? QLocale().formattedDataSize(vmStateSize) : QString());
+        item->setIcon(0, QApplication::style()->standardIcon(vmStateSize > 0 ? QStyle::SP_MediaPlay : QStyle::SP_FileIcon));
+        item->setData(0, Qt::UserRole, name);
+        items.insert(name, item);
+    }
+    
+    // Attach each snapshot to its parent; a broken chain falls back to the top level
+    auto descendsFrom = [this](QString name, const QString &ancestor) {
+        for (int depth = 0; !name.isEmpty() && depth <= m_snapshots.size(); ++depth) {
+            if (name == ancestor) {
+                return true;
+            }
+            name = m_snapshots.value(name).value("parent").toString();
+        }
+        return false;
+    };
+    for (const QJsonValue &value : snapshots) {
+        QString name = value.toObject().value("name").toString();
+        QString parent = value.toObject().value("parent").toString();
+        if (items.contains(parent) && !descendsFrom(parent, name)) {
+            items.value(parent)->addChild(items.value(name));
+        } else {
+            m_snapshotTree->addTopLevelItem(items.value(name));
+        }
+    }
+    
+    // The running/stopped machine hangs from the snapshot it descends from
+    QTreeWidgetItem *currentState = new QTreeWidgetItem();
+    currentState->setText(0, tr("Estado actual"));
+    currentState->setText(1, tr("Ahora"));
+    currentState->setIcon(0, QApplication::style()->standardIcon(QStyle::SP_ComputerIcon));
+    currentState->setData(0, CurrentStateRole, true);
+    if (QTreeWidgetItem *current = items.value(m_currentSnapshot)) {
+        QFont font = current->font(0);
+        font.setBold(true);
+        current->setFont(0, font);
+        current->addChild(currentState);
+    } else {
+        m_snapshotTree->addTopLevelItem(currentState);
+    }
     
-    if (!m_vm) return;
-    
-    // Add some sample snapshots to demonstrate the tree structure
-    QTreeWidgetItem *rootSnapshot = new QTreeWidgetItem(m_snapshotTree);
-    rootSnapshot->setText(0, tr("Instalación base"));
-    rootSnapshot->setText(1, QDateTime::currentDateTime().addDays(-7).toString("dd/MM/yyyy hh:mm"));
-    rootSnapshot->setIcon(0, QApplication::style()->standardIcon(QStyle::SP_FileIcon));
-    rootSnapshot->setData(0, Qt::UserRole, "snapshot1");
-    
-    QTreeWidgetItem *beforeUpdate = new QTreeWidgetItem(rootSnapshot);
-    beforeUpdate->setText(0, tr("Antes de actualizaciones"));
-    beforeUpdate->setText(1, QDateTime::currentDateTime().addDays(-3).toString("dd/MM/yyyy hh:mm"));
-    beforeUpdate->setIcon(0, QApplication::style()->standardIcon(QStyle::SP_FileIcon));
-    beforeUpdate->setData(0, Qt::UserRole, "snapshot2");
-    
-    QTreeWidgetItem *afterUpdate = new QTreeWidgetItem(beforeUpdate);
-    afterUpdate->setText(0, tr("Después de actualizaciones"));
-    afterUpdate->setText(1, QDateTime::currentDateTime().addDays(-1).toString("dd/MM/yyyy hh:mm"));
-    afterUpdate->setIcon(0, QApplication::style()->standardIcon(QStyle::SP_FileIcon));
-    afterUpdate->setData(0, Qt::UserRole, "snapshot3");
-    
-    QTreeWidgetItem *currentSnapshot = new QTreeWidgetItem(afterUpdate);
-    currentSnapshot->setText(0, tr("Estado actual"));
-    currentSnapshot->setText(1, tr("Ahora"));
-    currentSnapshot->setIcon(0, QApplication::style()->standardIcon(QStyle::SP_ComputerIcon));
-    currentSnapshot->setData(0, Qt::UserRole, "current");
+    m_currentSnapshotLabel->setText(m_currentSnapshot.isEmpty()
+        ? tr("Instantánea actual: <b>Estado actual de la máquina</b>")
+        : tr("Instantánea actual: <b>%1</b>").arg(m_currentSnapshot.toHtmlEscaped()));
     
     // Expand all items
     m_snapshotTree->expandAll();
     
-    // Select the current state
-    m_snapshotTree->setCurrentItem(currentSnapshot);
+    // Keep the selection across refreshes; by default, the current state
+    m_snapshotTree->setCurrentItem(items.value(selected, currentState));
+}
+
+void SnapshotManagerDialog::refreshChains()
+{
+    QString selected = selectedDisk();
+    m_chainTree->clear();
+    
+    QTreeWidgetItem *selectedItem = nullptr;
+    for (const QJsonValue &value : m_kvmManager->getDiskChains(m_vmName)) {
+        QJsonObject chain = value.toObject();
+        QString disk = chain.value("disk").toString();
+        int depth = chain.value("depth").toInt();
+        
+        QTreeWidgetItem *diskItem = new QTreeWidgetItem();
+        diskItem->setText(0, depth > 0 ? tr("%1 (%n capa(s))", "", depth).arg(QFileInfo(disk).fileName())
+                                       : QFileInfo(disk).fileName());
+        diskItem->setIcon(0, QApplication::style()->standardIcon(chain.value("warning").toBool()
+            ? QStyle::SP_MessageBoxWarning : QStyle::SP_DriveHDIcon));
+        diskItem->setToolTip(0, chain.value("warning").toBool()
+            ? tr("Cadena larga: cada capa añade una búsqueda en las lecturas. Conviene consolidarla.") : disk);
+        diskItem->setData(0, Qt::UserRole, disk);
+        diskItem->setData(0, ChainDepthRole, depth);
+        
+        for (const QJsonValue &imageValue : chain.value("chain").toArray()) {
+            QJsonObject image = imageValue.toObject();
+            QTreeWidgetItem *imageItem = new QTreeWidgetItem(diskItem);
+            imageItem->setText(0, QFileInfo(image.value("path").toString()).fileName());
+            imageItem->setToolTip(0, image.value("path").toString());
+            imageItem->setText(1, image.value("format").toString());
+            imageItem->setText(2, QLocale().formattedDataSize(image.value("fileSize").toInteger()));
+        }
+        
+        m_chainTree->addTopLevelItem(diskItem);
+        diskItem->setExpanded(depth > 0);
+        if (disk == selected) {
+            selectedItem = diskItem;
+        }
+    }
+    
+    if (selectedItem) {
+        m_chainTree->setCurrentItem(selectedItem);
+    }
+}
+
+void SnapshotManagerDialog::refreshCheckpoints()
+{
+    QString selected = selectedCheckpoint();
+    m_checkpointTree->clear();
+    m_checkpointGroup->setVisible(m_vm && m_vm->getBackend() == "qemu");
+    
+    for (const QJsonValue &value : m_kvmManager->getCheckpoints(m_vmName)) {
+        QJsonObject checkpoint = value.toObject();
+        QString name = checkpoint.value("name").toString();
+        QTreeWidgetItem *item = new QTreeWidgetItem();
+        item->setText(0, name);
+        item->setData(0, Qt::UserRole, name);
+        item->setText(1, QLocale().toString(QDateTime::fromString(checkpoint.value("created").toString(), Qt::ISODate),
+                                            QLocale::ShortFormat));
+        item->setText(2, checkpoint.value("memory").toBool()
+            ? QLocale().formattedDataSize(checkpoint.value("fileBytes").toInteger()) : tr("Sólo discos"));
+        m_checkpointTree->addTopLevelItem(item);
+        if (name == selected) {
+            m_checkpointTree->setCurrentItem(item);
+        }
+    }
+}
+
+QString SnapshotManagerDialog::selectedCheckpoint() const
+{
+    QTreeWidgetItem *current = m_checkpointTree->currentItem();
+    return current ? current->data(0, Qt::UserRole).toString() : QString();
 }
 
 void SnapshotManagerDialog::takeSnapshot()
 {
-    if (!m_vm) return;
+    if (!m_vm || m_busy) return;
     
     bool ok;
     QString snapshotName = QInputDialog::getText(this, tr("Tomar instantánea"),
-        tr("Nombre de la instantánea:"), QLineEdit::Normal, 
-        tr("Instantánea %1").arg(QDateTime::currentDateTime().toString("dd-MM-yyyy hh:mm")), &ok);
+        tr("Nombre de la instantánea:"), QLineEdit::Normal,
+        tr("Instantánea %1").arg(QDateTime::currentDateTime().toString("dd-MM-yyyy hh:mm")), &ok).trimmed();
     
-    if (ok && !snapshotName.isEmpty()) {
-        QString description = QInputDialog::getMultiLineText(this, tr("Tomar instantánea"),
-            tr("Descripción (opcional):"), "", &ok);
-        
-        if (ok) {
-            // Create new snapshot item
-            QTreeWidgetItem *current = m_snapshotTree->currentItem();
-            QTreeWidgetItem *newSnapshot = new QTreeWidgetItem();
-            newSnapshot->setText(0, snapshotName);
-            newSnapshot->setText(1, QDateTime::currentDateTime().toString("dd/MM/yyyy hh:mm"));
-            newSnapshot->setIcon(0, QApplication::style()->standardIcon(QStyle::SP_FileIcon));
-            newSnapshot->setData(0, Qt::UserRole, QString("snapshot_%1").arg(QDateTime::currentDateTime().toMSecsSinceEpoch()));
-            
-            if (current) {
-                // If current item is "Estado actual", replace it
-                if (current->data(0, Qt::UserRole).toString() == "current") {
-                    QTreeWidgetItem *parent = current->parent();
-                    if (parent) {
-                        parent->addChild(newSnapshot);
-                    } else {
-                        m_snapshotTree->addTopLevelItem(newSnapshot);
-                    }
-                    
-                    // Create new current state
-                    QTreeWidgetItem *newCurrent = new QTreeWidgetItem(newSnapshot);
-                    newCurrent->setText(0, tr("Estado actual"));
-                    newCurrent->setText(1, tr("Ahora"));
-                    newCurrent->setIcon(0, QApplication::style()->standardIcon(QStyle::SP_ComputerIcon));
-                    newCurrent->setData(0, Qt::UserRole, "current");
-                    
-                    delete current;
-                    m_snapshotTree->setCurrentItem(newCurrent);
-                } else {
-                    current->addChild(newSnapshot);
-                }
-            } else {
-                m_snapshotTree->addTopLevelItem(newSnapshot);
-            }
-            
-            m_snapshotTree->expandAll();
-            
-            QMessageBox::information(this, tr("Instantánea creada"), 
-                tr("Instantánea '%1' creada correctamente.").arg(snapshotName));
-        }
+    if (!ok || snapshotName.isEmpty()) {
+        return;
     }
+    if (m_snapshots.contains(snapshotName)) {
+        QMessageBox::warning(this, tr("Nombre en uso"),
+            tr("Ya existe una instantánea llamada '%1'.").arg(snapshotName));
+        return;
+    }
+    
+    QString description = QInputDialog::getMultiLineText(this, tr("Tomar instantánea"),
+        tr("Descripción (opcional):"), "", &ok);
+    if (!ok) {
+        return;
+    }
+    
+    // With the VM running the guest RAM is saved too and the guest pauses meanwhile
+    QString jobText = isVMActive()
+        ? tr("Guardando discos y memoria en '%1'...").arg(snapshotName)
+        : tr("Tomando instantánea '%1'...").arg(snapshotName);
+    QString vmName = m_vmName;
+    runJob(jobText, [this, vmName, snapshotName, description](VMBackend::Callback done) {
+        m_kvmManager->createSnapshotAsync(vmName, snapshotName, description, done);
+    });
 }
 
 void SnapshotManagerDialog::deleteSnapshot()
 {
-    QTreeWidgetItem *current = m_snapshotTree->currentItem();
-    if (!current) return;
-    
-    // Don't allow deleting current state
-    if (current->data(0, Qt::UserRole).toString() == "current") {
-        QMessageBox::warning(this, tr("No se puede eliminar"), 
-            tr("No se puede eliminar el estado actual de la máquina virtual."));
-        return;
-    }
+    QString name = selectedSnapshot();
+    if (name.isEmpty() || m_busy) return;
     
     int ret = QMessageBox::question(this, tr("Confirmar eliminación"),
         tr("¿Está seguro de que desea eliminar la instantánea '%1'?\n\n"
-           "Esta acción no se puede deshacer y también eliminará todas las instantáneas hijas.")
-           .arg(current->text(0)),
+           "Esta acción no se puede deshacer. Las instantáneas hijas pasarán a depender de la anterior.")
+           .arg(name),
         QMessageBox::Yes | QMessageBox::No);
     
     if (ret == QMessageBox::Yes) {
-        delete current;
-        QMessageBox::information(this, tr("Instantánea eliminada"), 
-            tr("Instantánea eliminada correctamente."));
+        QString vmName = m_vmName;
+        runJob(tr("Eliminando instantánea '%1'...").arg(name), [this, vmName, name](VMBackend::Callback done) {
+            m_kvmManager->deleteSnapshotAsync(vmName, name, done);
+        });
     }
 }
 
 void SnapshotManagerDialog::restoreSnapshot()
 {
-    QTreeWidgetItem *current = m_snapshotTree->currentItem();
-    if (!current) return;
-    
-    // Don't allow restoring current state
-    if (current->data(0, Qt::UserRole).toString() == "current") {
-        QMessageBox::information(this, tr("Ya está en el estado actual"), 
-            tr("La máquina virtual ya está en el estado actual."));
+    QString name = selectedSnapshot();
+    if (name.isEmpty() || m_busy) return;
+    
+    // A disk-only snapshot cannot replace the disks under a running guest
+    bool hasMemory = m_snapshots.value(name).value("vmStateSize").toInteger() > 0;
+    if (isVMActive() && !hasMemory) {
+        QMessageBox::warning(this, tr("Apague la máquina virtual"),
+            tr("La instantánea '%1' no incluye la memoria de la máquina virtual. "
+               "Apáguela antes de restaurarla.").arg(name));
         return;
     }
     
     int ret = QMessageBox::question(this, tr("Confirmar restauración"),
         tr("¿Está seguro de que desea restaurar la instantánea '%1'?\n\n"
            "El estado actual de la máquina virtual se perderá.")
-           .arg(current->text(0)),
+           .arg(name),
         QMessageBox::Yes | QMessageBox::No);
     
     if (ret == QMessageBox::Yes) {
-        QMessageBox::information(this, tr("Instantánea restaurada"), 
-            tr("La máquina virtual ha sido restaurada a la instantánea '%1'.").arg(current->text(0)));
-        
-        // Update current snapshot indicator
-        m_currentSnapshotLabel->setText(tr("Instantánea actual: <b>%1</b>").arg(current->text(0)));
+        QString vmName = m_vmName;
+        runJob(tr("Restaurando instantánea '%1'...").arg(name), [this, vmName, name](VMBackend::Callback done) {
+            m_kvmManager->revertSnapshotAsync(vmName, name, done);
+        });
     }
 }
 
 void SnapshotManagerDialog::showSnapshotDetails()
 {
-    QTreeWidgetItem *current = m_snapshotTree->currentItem();
-    if (!current) return;
-    
-    QString details = tr("Detalles de la instantánea '%1':\n\n").arg(current->text(0));
-    details += tr("Nombre: %1\n").arg(current->text(0));
-    details += tr("Tomada: %1\n").arg(current->text(1));
-    details += tr("Estado: %1\n").arg(current->data(0, Qt::UserRole).toString() == "current" ? tr("Estado actual") : tr("Instantánea guardada"));
-    details += tr("Tamaño estimado: %1 MB\n").arg(QString::number(QRandomGenerator::global()->bounded(100, 1000)));
+    QString name = selectedSnapshot();
+    if (name.isEmpty()) return;
+    
+    QJsonObject snapshot = m_snapshots.value(name);
+    qint64 vmStateSize = snapshot.value("vmStateSize").toInteger();
+    QString details = tr("Detalles de la instantánea '%1':\n\n").arg(name);
+    details += tr("Padre: %1\n").arg(snapshot.value("parent").toString().isEmpty() ? tr("(ninguno)") : snapshot.value("parent").toString());
+    details += tr("Tomada: %1\n").arg(m_timestampLabel->text());
+    if (snapshot.contains("id")) {
+        details += tr("ID en la imagen: %1\n").arg(snapshot.value("id").toString());
+    }
+    details += tr("Memoria guardada: %1\n").arg(vmStateSize > 0 ? QLocale().formattedDataSize(vmStateSize) : tr("ninguna (sólo discos)"));
+    if (snapshot.contains("vmClockNsec")) {
+        details += tr("Tiempo del invitado: %1\n").arg(formatVMClock(snapshot.value("vmClockNsec").toInteger()));
+    }
+    if (snapshot.value("diskSize").toInteger() > 0) {
+        details += tr("Tamaño virtual del disco: %1\n").arg(QLocale().formattedDataSize(snapshot.value("diskSize").toInteger()));
+    }
+    if (name == m_currentSnapshot) {
+        details += tr("\nEl estado actual de la máquina parte de esta instantánea.");
+    }
     
     QMessageBox::information(this, tr("Detalles de instantánea"), details);
 }
 
 void SnapshotManagerDialog::cloneFromSnapshot()
 {
-    QTreeWidgetItem *current = m_snapshotTree->currentItem();
-    if (!current) return;
+    QString name = selectedSnapshot();
+    if (name.isEmpty() || m_busy) return;
     
     bool ok;
     QString cloneName = QInputDialog::getText(this, tr("Clonar desde instantánea"),
-        tr("Nombre de la nueva máquina virtual:"), QLineEdit::Normal, 
-        tr("%1 - Clon").arg(m_vm->getName()), &ok);
+        tr("Nombre de la nueva máquina virtual:"), QLineEdit::Normal,
+        tr("%1 - Clon").arg(m_vmName), &ok);
     
     if (ok && !cloneName.isEmpty()) {
-        QMessageBox::information(this, tr("Clon creado"), 
-            tr("Se ha creado un clon '%1' basado en la instantánea '%2'.")
-            .arg(cloneName).arg(current->text(0)));
+        // The disks are copied as they were in the snapshot; the error, if
+        // any, is shown through KVMManager::errorOccurred
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        bool cloned = m_kvmManager->cloneVirtualMachine(m_vmName, cloneName, name);
+        QApplication::restoreOverrideCursor();
+        
+        if (cloned) {
+            QMessageBox::information(this, tr("Clon creado"),
+                tr("Se ha creado un clon '%1' basado en la instantánea '%2'.")
+                .arg(cloneName).arg(name));
+        }
     }
 }
 
+void SnapshotManagerDialog::addOverlay()
+{
+    if (!m_vm || m_busy) return;
+    
+    bool ok;
+    QString tag = QInputDialog::getText(this, tr("Nueva capa externa"),
+        tr("Nombre de la capa (se añade al nombre de cada disco):"), QLineEdit::Normal,
+        QDateTime::currentDateTime().toString("yyyyMMdd-hhmm"), &ok).trimmed();
+    if (!ok || tag.isEmpty()) {
+        return;
+    }
+    
+    QString vmName = m_vmName;
+    runJob(tr("Creando capa externa '%1'...").arg(tag), [this, vmName, tag](VMBackend::Callback done) {
+        m_kvmManager->createExternalSnapshotAsync(vmName, tag, done);
+    });
+}
+
+void SnapshotManagerDialog::commitChain()
+{
+    mergeChain("commit");
+}
+
+void SnapshotManagerDialog::streamChain()
+{
+    mergeChain("stream");
+}
+
+void SnapshotManagerDialog::mergeChain(const QString &mode)
+{
+    QString disk = selectedDisk();
+    if (disk.isEmpty() || m_busy) return;
+    
+    QString question = mode == "commit"
+        ? tr("Se volcarán las capas de '%1' en su imagen base y se eliminarán.\n\n"
+             "Si otra máquina virtual usa esa imagen base, dejará de ser válida para ella. ¿Continuar?")
+        : tr("Se copiarán en '%1' todos los datos de sus imágenes base, que se conservan.\n\n"
+             "Necesita espacio libre para el disco completo. ¿Continuar?");
+    if (QMessageBox::question(this, tr("Fusionar cadena"), question.arg(QFileInfo(disk).fileName()),
+                              QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes) {
+        return;
+    }
+    
+    // Runs in the background with the VM in use; progress arrives as jobProgress
+    QString vmName = m_vmName;
+    QString jobText = mode == "commit" ? tr("Consolidando %1...").arg(QFileInfo(disk).fileName())
+                                       : tr("Aplanando %1...").arg(QFileInfo(disk).fileName());
+    runJob(jobText, [this, vmName, disk, mode](VMBackend::Callback done) {
+        m_kvmManager->mergeDiskChainAsync(vmName, disk, mode, done);
+    });
+}
+
+void SnapshotManagerDialog::createCheckpoint()
+{
+    if (!m_vm || m_busy) return;
+    
+    bool ok;
+    QString name = QInputDialog::getText(this, tr("Nuevo punto de control"),
+        tr("Nombre (letras, números, '.', '_' o '-'):"), QLineEdit::Normal,
+        QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss"), &ok).trimmed();
+    if (!ok || name.isEmpty()) {
+        return;
+    }
+    
+    QString vmName = m_vmName;
+    runJob(tr("Creando punto de control '%1'...").arg(name), [this, vmName, name](VMBackend::Callback done) {
+        m_kvmManager->createCheckpointAsync(vmName, name, done);
+    });
+}
+
+void SnapshotManagerDialog::resetToCheckpoint()
+{
+    QString name = selectedCheckpoint();
+    if (name.isEmpty() || m_busy) return;
+    
+    if (QMessageBox::question(this, tr("Volver al punto de control"),
+            tr("Se perderá todo lo ocurrido en la máquina virtual desde el punto de control '%1'. ¿Continuar?").arg(name),
+            QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes) {
+        return;
+    }
+    
+    QString vmName = m_vmName;
+    runJob(tr("Volviendo al punto de control '%1'...").arg(name), [this, vmName, name](VMBackend::Callback done) {
+        m_kvmManager->resetToCheckpointAsync(vmName, name, done);
+    });
+}
+
+void SnapshotManagerDialog::deleteCheckpoint()
+{
+    QString name = selectedCheckpoint();
+    if (name.isEmpty() || m_busy) return;
+    
+    if (QMessageBox::question(this, tr("Eliminar punto de control"),
+            tr("¿Eliminar el punto de control '%1'? Los discos actuales no cambian.").arg(name),
+            QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes) {
+        return;
+    }
+    
+    QString vmName = m_vmName;
+    runJob(tr("Eliminando punto de control '%1'...").arg(name), [this, vmName, name](VMBackend::Callback done) {
+        m_kvmManager->deleteCheckpointAsync(vmName, name, done);
+    });
+}
+
+QString SnapshotManagerDialog::selectedDisk() const
+{
+    QTreeWidgetItem *current = m_chainTree->currentItem();
+    while (current && current->parent()) {
+        current = current->parent();
+    }
+    return current ? current->data(0, Qt::UserRole).toString() : QString();
+}
+
 void SnapshotManagerDialog::onSnapshotSelectionChanged()
 {
     updateSnapshotDetails();
 }
 
+void SnapshotManagerDialog::onJobProgress(const QString &vmName, const QString &job, int percent)
+{
+    Q_UNUSED(job)
+    if (vmName == m_vmName && m_busy) {
+        m_progressBar->setValue(percent);
+    }
+}
+
+void SnapshotManagerDialog::runJob(const QString &description, const std::function<void(VMBackend::Callback)> &operation)
+{
+    setBusy(true);
+    m_jobLabel->setText(description);
+    m_progressBar->setValue(0);
+    
+    QPointer<SnapshotManagerDialog> self(this);
+    operation([self](const VMBackend::Result &result) {
+        if (!self) {
+            return;
+        }
+        self->setBusy(false);
+        // Failures were already reported through KVMManager::errorOccurred
+        self->m_jobLabel->setText(result.ok ? QString() : tr("La operación no se completó"));
+        self->refreshSnapshots();
+    });
+}
+
+void SnapshotManagerDialog::setBusy(bool busy)
+{
+    m_busy = busy;
+    m_progressBar->setVisible(busy);
+    updateSnapshotDetails();
+}
+
+QString SnapshotManagerDialog::selectedSnapshot() const
+{
+    QTreeWidgetItem *current = m_snapshotTree->currentItem();
+    if (!current || current->data(0, CurrentStateRole).toBool()) {
+        return QString();
+    }
+    return current->data(0, Qt::UserRole).toString();
+}
+
+bool SnapshotManagerDialog::isVMActive() const
+{
+    VirtualMachine *vm = m_kvmManager->getVirtualMachine(m_vmName);
+    return vm && (vm->isRunning() || vm->isPaused());
+}
+
+QString SnapshotManagerDialog::formatVMClock(qint64 nsec)
+{
+    qint64 seconds = nsec / 1000000000LL;
+    return QString("%1:%2:%3").arg(seconds / 3600)
+                              .arg(seconds / 60 % 60, 2, 10, QChar('0'))
+                              .arg(seconds % 60, 2, 10, QChar('0'));
+}
+
 void SnapshotManagerDialog::updateSnapshotDetails()
 {
     QTreeWidgetItem *current = m_snapshotTree->currentItem();
-    if (current) {
+    QString name = selectedSnapshot();
+    m_takeSnapshotButton->setEnabled(m_vm && !m_busy);
+    
+    if (current && name.isEmpty()) {
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(m_vmName);
         m_nameEdit->setText(current->text(0));
         m_timestampLabel->setText(current->text(1));
-        
-        if (current->data(0, Qt::UserRole).toString() == "current") {
-            m_descriptionEdit->setPlainText(tr("Estado actual de la máquina virtual en ejecución."));
-            m_sizeLabel->setText(tr("N/A"));
-            m_vmStateLabel->setText(tr("En ejecución"));
-        } else {
-            m_descriptionEdit->setPlainText(tr("Instantánea tomada el %1. "
-                "Contiene el estado completo de la máquina virtual en ese momento.")
-                .arg(current->text(1)));
-            m_sizeLabel->setText(tr("%1 MB").arg(QString::number(QRandomGenerator::global()->bounded(100, 1000))));
-            m_vmStateLabel->setText(tr("Apagada"));
-        }
-        
-        // Enable/disable buttons based on selection
-        bool isCurrent = (current->data(0, Qt::UserRole).toString() == "current");
-        m_deleteSnapshotButton->setEnabled(!isCurrent);
-        m_restoreSnapshotButton->setEnabled(!isCurrent);
-        
+        m_descriptionEdit->setPlainText(m_currentSnapshot.isEmpty()
+            ? tr("Estado actual de la máquina virtual.")
+            : tr("Estado actual de la máquina virtual, derivado de la instantánea '%1'.").arg(m_currentSnapshot));
+        m_sizeLabel->setText(tr("N/A"));
+        m_vmStateLabel->setText(vm ? vm->getState() : QString());
+        m_vmClockLabel->clear();
+        m_diskSizeLabel->clear();
+    } else if (current) {
+        QJsonObject snapshot = m_snapshots.value(name);
+        qint64 vmStateSize = snapshot.value("vmStateSize").toInteger();
+        m_nameEdit->setText(name);
+        m_timestampLabel->setText(current->text(1));
+        m_descriptionEdit->setPlainText(snapshot.value("description").toString());
+        m_sizeLabel->setText(vmStateSize > 0 ? QLocale().formattedDataSize(vmStateSize) : tr("Ninguna"));
+        m_vmStateLabel->setText(vmStateSize > 0 ? tr("En ejecución (con memoria)") : tr("Apagada (sólo discos)"));
+        m_vmClockLabel->setText(snapshot.contains("vmClockNsec")
+            ? formatVMClock(snapshot.value("vmClockNsec").toInteger()) : tr("N/A"));
+        qint64 diskSize = snapshot.value("diskSize").toInteger();
+        m_diskSizeLabel->setText(diskSize > 0 ? QLocale().formattedDataSize(diskSize) : tr("N/A"));
     } else {
         m_nameEdit->clear();
         m_descriptionEdit->clear();
         m_timestampLabel->clear();
         m_sizeLabel->clear();
         m_vmStateLabel->clear();
-        
-        m_deleteSnapshotButton->setEnabled(false);
-        m_restoreSnapshotButton->setEnabled(false);
+        m_vmClockLabel->clear();
+        m_diskSizeLabel->clear();
+    }
+    
+    // Enable/disable buttons based on selection
+    bool isSnapshot = !name.isEmpty() && !m_busy;
+    m_deleteSnapshotButton->setEnabled(isSnapshot);
+    m_restoreSnapshotButton->setEnabled(isSnapshot);
+    m_cloneButton->setEnabled(isSnapshot);
+    m_showDetailsButton->setEnabled(!name.isEmpty());
+    
+    QTreeWidgetItem *diskItem = m_chainTree->currentItem();
+    while (diskItem && diskItem->parent()) {
+        diskItem = diskItem->parent();
     }
+    bool layered = diskItem && diskItem->data(0, ChainDepthRole).toInt() > 0 && !m_busy;
+    m_overlayButton->setEnabled(m_vm && !m_busy);
+    m_commitButton->setEnabled(layered);
+    m_streamButton->setEnabled(layered);
+    
+    bool checkpoint = !selectedCheckpoint().isEmpty() && !m_busy;
+    m_createCheckpointButton->setEnabled(m_vm && !m_busy);
+    m_resetCheckpointButton->setEnabled(checkpoint);
+    m_deleteCheckpointButton->setEnabled(checkpoint);
 }
\ No newline at end of file
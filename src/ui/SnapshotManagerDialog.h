@@ -13,21 +13,32 @@
 #include <QGroupBox>
 #include <QSplitter>
 #include <QProgressBar>
-#include <QDateTimeEdit>
 #include <QDateTime>
+#include <QHash>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <functional>
 
+#include "../core/VMBackend.h"
+
+class KVMManager;
 class VirtualMachine;
 
 /**
  * @brief Administrador de instantáneas - Gestiona snapshots de VM
- * Equivalente a la ventana "Instantáneas" de VirtualBox
+ * Equivalente a la ventana "Instantáneas" de VirtualBox. El árbol sale de
+ * las tablas de instantáneas de los discos y de los metadatos de la VM;
+ * tomar, restaurar y eliminar se ejecutan en segundo plano con progreso.
+ * Debajo se ven las cadenas de capas externas de cada disco, que se pueden
+ * alargar con una capa nueva o fusionar (commit o stream) sin parar la VM,
+ * y los puntos de control a los que devolver una VM de pruebas en segundos.
  */
 class SnapshotManagerDialog : public QDialog
 {
     Q_OBJECT
 
 public:
-    explicit SnapshotManagerDialog(VirtualMachine *vm, QWidget *parent = nullptr);
+    SnapshotManagerDialog(KVMManager *kvmManager, VirtualMachine *vm, QWidget *parent = nullptr);
     
     void refreshSnapshots();
 
@@ -37,16 +48,36 @@ private slots:
     void restoreSnapshot();
     void showSnapshotDetails();
     void cloneFromSnapshot();
+    void addOverlay();
+    void commitChain();
+    void streamChain();
+    void createCheckpoint();
+    void resetToCheckpoint();
+    void deleteCheckpoint();
     void onSnapshotSelectionChanged();
+    void onJobProgress(const QString &vmName, const QString &job, int percent);
 
 private:
     void setupUI();
     void updateSnapshotDetails();
-    void populateSnapshotTree();
-    void addSnapshotToTree(const QString &name, const QString &description, 
-                          const QDateTime &timestamp, QTreeWidgetItem *parent = nullptr);
+    void populateSnapshotTree(const QJsonArray &snapshots);
+    void refreshChains();
+    void refreshCheckpoints();
+    QString selectedCheckpoint() const;
+    void mergeChain(const QString &mode);
+    QString selectedDisk() const;
+    void runJob(const QString &description, const std::function<void(VMBackend::Callback)> &operation);
+    void setBusy(bool busy);
+    QString selectedSnapshot() const;
+    bool isVMActive() const;
+    static QString formatVMClock(qint64 nsec);
     
+    KVMManager *m_kvmManager;
     VirtualMachine *m_vm;
+    QString m_vmName;
+    QHash<QString, QJsonObject> m_snapshots;
+    QString m_currentSnapshot;
+    bool m_busy;
     
     // Main UI
     QSplitter *m_splitter;
@@ -59,6 +90,19 @@ private:
     QPushButton *m_showDetailsButton;
     QPushButton *m_cloneButton;
     
+    // External overlay chains
+    QTreeWidget *m_chainTree;
+    QPushButton *m_overlayButton;
+    QPushButton *m_commitButton;
+    QPushButton *m_streamButton;
+    
+    // Checkpoints
+    QGroupBox *m_checkpointGroup;
+    QTreeWidget *m_checkpointTree;
+    QPushButton *m_createCheckpointButton;
+    QPushButton *m_resetCheckpointButton;
+    QPushButton *m_deleteCheckpointButton;
+    
     // Snapshot Details
     QGroupBox *m_detailsGroup;
     QLineEdit *m_nameEdit;
@@ -66,9 +110,15 @@ private:
     QLabel *m_timestampLabel;
     QLabel *m_sizeLabel;
     QLabel *m_vmStateLabel;
+    QLabel *m_vmClockLabel;
+    QLabel *m_diskSizeLabel;
     
     // Current snapshot indicator
     QLabel *m_currentSnapshotLabel;
+    
+    // Background job
+    QLabel *m_jobLabel;
+    QProgressBar *m_progressBar;
 };
 
 #endif // SNAPSHOTMANAGERDIALOG_H
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "VMCreationWizard.h"
 #include "../core/KVMManager.h"
+#include "../core/VirtualMachine.h"
 
 #include <QApplication>
 #include <QScreen>
@@ -31,12 +32,13 @@ VMCreationWizard::VMCreationWizard(KVMManager *kvmManager, QWidget *parent)
 
 void VMCreationWizard::setupWizardPages()
 {
-    setPage(WelcomePageId, new VMWelcomePage(this));
+    setPage(WelcomePageId, new VMWelcomePage(m_kvmManager->getTemplates(), this));
     setPage(BasicConfigPageId, new VMBasicConfigPage(this));
     setPage(MemoryPageId, new VMMemoryPage(this));
     setPage(HardDiskPageId, new VMHardDiskPage(this));
     setPage(NetworkPageId, new VMNetworkPage(this));
     setPage(SummaryPageId, new VMSummaryPage(this));
+    setPage(TemplatePageId, new VMTemplatePage(m_kvmManager, this));
     
     setStartId(WelcomePageId);
 }
@@ -63,6 +65,9 @@ void VMCreationWizard::onCurrentIdChanged(int id)
         case SummaryPageId:
             setWindowTitle(tr("Asistente para Nueva Máquina Virtual - Resumen"));
             break;
+        case TemplatePageId:
+            setWindowTitle(tr("Asistente para Nueva Máquina Virtual - Desde Plantilla"));
+            break;
     }
 }
 
@@ -75,6 +80,39 @@ void VMCreationWizard::accept()
 
 bool VMCreationWizard::createVirtualMachine()
 {
+    // Desde plantilla: clones enlazados, sin disco nuevo ni instalación
+    if (field("fromTemplate").toBool()) {
+        QString templateName = field("templateName").toString();
+        QString name = field("templateVMName").toString().trimmed();
+        int count = field("templateCount").toInt();
+        
+        if (count > 1) {
+            QJsonObject result = m_kvmManager->createVMsFromTemplate(templateName, name, count);
+            if (result.isEmpty()) {
+                QMessageBox::critical(this, tr("Error"),
+                    tr("No se pudo crear ninguna máquina a partir de '%1'.").arg(templateName));
+                return false;
+            }
+            QStringList created;
+            for (const QJsonValue &value : result.value("created").toArray()) {
+                created.append(value.toString());
+            }
+            QMessageBox::information(this, tr("Éxito"),
+                tr("Se han creado %1 máquinas virtuales en %2 ms:\n%3")
+                .arg(created.size()).arg(result.value("msecs").toInteger()).arg(created.join(", ")));
+            return true;
+        }
+        
+        if (m_kvmManager->createVMFromTemplate(templateName, name)) {
+            QMessageBox::information(this, tr("Éxito"),
+                tr("La máquina virtual '%1' ha sido creada a partir de '%2'.").arg(name, templateName));
+            return true;
+        }
+        QMessageBox::critical(this, tr("Error"),
+            tr("No se pudo crear la máquina virtual '%1'.").arg(name));
+        return false;
+    }
+    
     QString name = field("vmName").toString();
     QString osType = field("osType").toString();
     int memory = field("memory").toInt();
@@ -92,7 +130,7 @@ bool VMCreationWizard::createVirtualMachine()
 }
 
 // Página de bienvenida
-VMWelcomePage::VMWelcomePage(QWidget *parent)
+VMWelcomePage::VMWelcomePage(const QStringList &templates, QWidget *parent)
     : QWizardPage(parent)
 {
     setTitle(tr("Bienvenido al Asistente de Nueva Máquina Virtual"));
@@ -117,6 +155,24 @@ VMWelcomePage::VMWelcomePage(QWidget *parent)
     welcomeLabel->setWordWrap(true);
     layout->addWidget(welcomeLabel);
     
+    // Camino rápido: la plantilla ya tiene el sistema instalado
+    QGroupBox *modeGroup = new QGroupBox(tr("¿Cómo desea crearla?"));
+    QVBoxLayout *modeLayout = new QVBoxLayout(modeGroup);
+    m_templateRadio = new QRadioButton(tr("A partir de una &plantilla (lo más rápido: lista en milisegundos, sin instalar)"));
+    m_installRadio = new QRadioButton(tr("Con un disco nuevo e &instalando el sistema operativo"));
+    modeLayout->addWidget(m_templateRadio);
+    modeLayout->addWidget(m_installRadio);
+    layout->addWidget(modeGroup);
+    
+    if (templates.isEmpty()) {
+        m_templateRadio->setEnabled(false);
+        m_templateRadio->setToolTip(tr("No hay plantillas: use Máquina → Usar como plantilla sobre una VM apagada"));
+        m_installRadio->setChecked(true);
+    } else {
+        m_templateRadio->setChecked(true);
+    }
+    registerField("fromTemplate", m_templateRadio);
+    
     layout->addStretch();
 }
 
@@ -125,6 +181,87 @@ void VMWelcomePage::initializePage()
     // Esta página no necesita inicialización especial
 }
 
+int VMWelcomePage::nextId() const
+{
+    return m_templateRadio->isChecked() ? VMCreationWizard::TemplatePageId : VMCreationWizard::BasicConfigPageId;
+}
+
+// Página de creación a partir de una plantilla
+VMTemplatePage::VMTemplatePage(KVMManager *kvmManager, QWidget *parent)
+    : QWizardPage(parent)
+    , m_kvmManager(kvmManager)
+{
+    setTitle(tr("Crear a partir de una Plantilla"));
+    setSubTitle(tr("Cada máquina es una capa fina sobre los discos de la plantilla, con UUID y MAC propios."));
+    
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    QGroupBox *templateGroup = new QGroupBox(tr("Plantilla"));
+    QFormLayout *templateForm = new QFormLayout(templateGroup);
+    
+    m_templateCombo = new QComboBox();
+    m_templateCombo->addItems(m_kvmManager->getTemplates());
+    templateForm->addRow(tr("&Plantilla:"), m_templateCombo);
+    
+    m_nameEdit = new QLineEdit();
+    templateForm->addRow(tr("&Nombre:"), m_nameEdit);
+    
+    m_countSpin = new QSpinBox();
+    m_countSpin->setRange(1, 100);
+    m_countSpin->setToolTip(tr("Con más de una, el nombre es el prefijo: <nombre>-1, <nombre>-2..."));
+    templateForm->addRow(tr("&Cantidad:"), m_countSpin);
+    
+    mainLayout->addWidget(templateGroup);
+    
+    m_infoLabel = new QLabel();
+    m_infoLabel->setWordWrap(true);
+    mainLayout->addWidget(m_infoLabel);
+    mainLayout->addStretch();
+    
+    registerField("templateName", m_templateCombo, "currentText");
+    registerField("templateVMName*", m_nameEdit);
+    registerField("templateCount", m_countSpin);
+    
+    connect(m_templateCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &VMTemplatePage::updateInfo);
+    connect(m_countSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, &VMTemplatePage::updateInfo);
+}
+
+void VMTemplatePage::initializePage()
+{
+    if (m_nameEdit->text().isEmpty()) {
+        m_nameEdit->setText(m_templateCombo->currentText() + "-1");
+    }
+    updateInfo();
+}
+
+void VMTemplatePage::updateInfo()
+{
+    VirtualMachine *templateVM = m_kvmManager->getVirtualMachine(m_templateCombo->currentText());
+    if (!templateVM) {
+        m_infoLabel->clear();
+        return;
+    }
+    
+    QString info = tr("%1 · %2 MB de RAM · %3 vCPU · %4 disco(s)")
+                   .arg(templateVM->getOSType()).arg(templateVM->getMemoryMB())
+                   .arg(templateVM->getCPUCount()).arg(templateVM->getHardDisks().size());
+    if (m_countSpin->value() > 1) {
+        info += "<br>" + tr("Se crearán %1 máquinas; el nombre se usa como prefijo y se saltan los ya ocupados.")
+                         .arg(m_countSpin->value());
+    }
+    m_infoLabel->setText(info);
+}
+
+bool VMTemplatePage::validatePage()
+{
+    QString name = m_nameEdit->text().trimmed();
+    if (m_countSpin->value() == 1 && m_kvmManager->getVirtualMachine(name)) {
+        QMessageBox::warning(this, tr("Nombre en uso"),
+            tr("Ya existe una máquina virtual con el nombre '%1'.").arg(name));
+        return false;
+    }
+    return true;
+}
+
 // Página de configuración básica
 VMBasicConfigPage::VMBasicConfigPage(QWidget *parent)
     : QWizardPage(parent)
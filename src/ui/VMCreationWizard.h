@@ -36,15 +36,6 @@ public:
     explicit VMCreationWizard(KVMManager *kvmManager, QWidget *parent = nullptr);
     
     void accept() override;
-
-private slots:
-    void onCurrentIdChanged(int id);
-
-private:
-    void setupWizardPages();
-    bool createVirtualMachine();
-    
-    KVMManager *m_kvmManager;
     
     // IDs de páginas
     enum {
@@ -53,8 +44,18 @@ private:
         MemoryPageId,
         HardDiskPageId,
         NetworkPageId,
-        SummaryPageId
+        SummaryPageId,
+        TemplatePageId
     };
+
+private slots:
+    void onCurrentIdChanged(int id);
+
+private:
+    void setupWizardPages();
+    bool createVirtualMachine();
+    
+    KVMManager *m_kvmManager;
 };
 
 // Página de bienvenida
@@ -63,10 +64,39 @@ class VMWelcomePage : public QWizardPage
     Q_OBJECT
 
 public:
-    VMWelcomePage(QWidget *parent = nullptr);
+    VMWelcomePage(const QStringList &templates, QWidget *parent = nullptr);
     
+    int nextId() const override;
+
 protected:
     void initializePage() override;
+
+private:
+    QRadioButton *m_installRadio;
+    QRadioButton *m_templateRadio;
+};
+
+// Página de creación a partir de una plantilla (clones enlazados)
+class VMTemplatePage : public QWizardPage
+{
+    Q_OBJECT
+
+public:
+    VMTemplatePage(KVMManager *kvmManager, QWidget *parent = nullptr);
+    
+    void initializePage() override;
+    bool validatePage() override;
+    int nextId() const override { return -1; }
+
+private slots:
+    void updateInfo();
+
+private:
+    KVMManager *m_kvmManager;
+    QComboBox *m_templateCombo;
+    QLineEdit *m_nameEdit;
+    QSpinBox *m_countSpin;
+    QLabel *m_infoLabel;
 };
 
 // Página de configuración básica
@@ -198,6 +228,8 @@ public:
     VMSummaryPage(QWidget *parent = nullptr);
     
     void initializePage() override;
+    // Última página del camino de instalación (la de plantilla va detrás por id)
+    int nextId() const override { return -1; }
 
 private:
     QTextEdit *m_summaryText;
@@ -1,4 +1,6 @@
 #include "VMDetailsWidget.h"
+#include "../core/KVMManager.h"
+#include "../core/VirtualMachine.h"
 
 #include <QScrollArea>
 #include <QVBoxLayout>
@@ -13,16 +15,23 @@
 #include <QPixmap>
 #include <QApplication>
 #include <QStyle>
+#include <QJsonObject>
 
-VMDetailsWidget::VMDetailsWidget(QWidget *parent)
+VMDetailsWidget::VMDetailsWidget(KVMManager *kvmManager, QWidget *parent)
     : QWidget(parent)
     , m_scrollArea(nullptr)
     , m_contentWidget(nullptr)
     , m_mainLayout(nullptr)
     , m_currentVM("")
+    , m_kvmManager(kvmManager)
+    , m_statsTimer(new QTimer(this))
 {
     setupUI();
     clearDetails();
+    
+    // Same period as the guest's balloon statistics
+    m_statsTimer->setInterval(5000);
+    connect(m_statsTimer, &QTimer::timeout, this, &VMDetailsWidget::updateMemoryStats);
 }
 
 void VMDetailsWidget::setupUI()
@@ -51,6 +60,7 @@ void VMDetailsWidget::setupUI()
     createUSBSection();
     createDisplaySection();
     createSharedFoldersSection();
+    createGuestMemorySection();
     
     // Add stretch to push content to top
     m_mainLayout->addStretch();
@@ -263,13 +273,87 @@ void VMDetailsWidget::createSharedFoldersSection()
     m_mainLayout->addWidget(m_sharedFoldersSection);
 }
 
+void VMDetailsWidget::createGuestMemorySection()
+{
+    m_guestMemorySection = createSection(tr("🎈 Memoria del invitado"));
+    QVBoxLayout *layout = new QVBoxLayout(m_guestMemorySection);
+    
+    QWidget *balloonRow = createInfoRow(tr("Balón:"), tr("No disponible"));
+    m_guestBalloonLabel = qobject_cast<QLabel*>(balloonRow->layout()->itemAt(1)->widget());
+    layout->addWidget(balloonRow);
+    
+    QWidget *freeRow = createInfoRow(tr("Libre:"), tr("No disponible"));
+    m_guestFreeLabel = qobject_cast<QLabel*>(freeRow->layout()->itemAt(1)->widget());
+    layout->addWidget(freeRow);
+    
+    QWidget *cachedRow = createInfoRow(tr("Caché:"), tr("No disponible"));
+    m_guestCachedLabel = qobject_cast<QLabel*>(cachedRow->layout()->itemAt(1)->widget());
+    layout->addWidget(cachedRow);
+    
+    QWidget *faultsRow = createInfoRow(tr("Fallos de página mayores:"), tr("No disponible"));
+    m_guestFaultsLabel = qobject_cast<QLabel*>(faultsRow->layout()->itemAt(1)->widget());
+    layout->addWidget(faultsRow);
+    
+    m_mainLayout->addWidget(m_guestMemorySection);
+}
+
+void VMDetailsWidget::updateMemoryStats()
+{
+    VirtualMachine *vm = m_kvmManager ? m_kvmManager->getVirtualMachine(m_currentVM) : nullptr;
+    VMBackend *backend = m_kvmManager ? m_kvmManager->getVMBackend(m_currentVM) : nullptr;
+    if (!vm || !backend || !m_kvmManager->isVMRunning(m_currentVM)) {
+        QString text = vm ? tr("VM apagada") : tr("No disponible");
+        m_guestBalloonLabel->setText(text);
+        m_guestFreeLabel->setText(text);
+        m_guestCachedLabel->setText(text);
+        m_guestFaultsLabel->setText(text);
+        return;
+    }
+    
+    // Polled straight from the backend: a VM that stops between two polls
+    // must not pop up an error dialog
+    QString vmName = m_currentVM;
+    backend->queryStats(vm, [this, vmName](const VMBackend::Result &result) {
+        if (vmName != m_currentVM) {
+            return;
+        }
+        
+        QJsonObject balloon = result.value.toObject().value("balloon").toObject();
+        if (!result.ok || balloon.isEmpty()) {
+            m_guestBalloonLabel->setText(tr("Sin balón (requiere un perfil virtio)"));
+            m_guestFreeLabel->setText(tr("No disponible"));
+            m_guestCachedLabel->setText(tr("No disponible"));
+            m_guestFaultsLabel->setText(tr("No disponible"));
+            return;
+        }
+        
+        auto megabytes = [balloon](const QString &key) {
+            return balloon.contains(key) ? tr("%1 MB").arg(balloon.value(key).toInteger())
+                                         : tr("Sin datos del invitado");
+        };
+        m_guestBalloonLabel->setText(tr("%1 MB de %2 MB objetivo")
+                                     .arg(balloon.value("actualMB").toInteger())
+                                     .arg(balloon.value("targetMB").toInteger()));
+        m_guestFreeLabel->setText(balloon.contains("availableMB")
+                                  ? tr("%1 (%2 MB disponibles)").arg(megabytes("freeMB")).arg(balloon.value("availableMB").toInteger())
+                                  : megabytes("freeMB"));
+        m_guestCachedLabel->setText(megabytes("cachedMB"));
+        m_guestFaultsLabel->setText(balloon.contains("majorFaults")
+                                    ? QString::number(balloon.value("majorFaults").toInteger())
+                                    : tr("Sin datos del invitado"));
+    });
+}
+
 void VMDetailsWidget::setSelectedVM(const QString &vmName)
 {
     m_currentVM = vmName;
     if (vmName.isEmpty()) {
+        m_statsTimer->stop();
         clearDetails();
     } else {
         updateVMDetails(vmName);
+        updateMemoryStats();
+        m_statsTimer->start();
     }
 }
 
@@ -366,4 +450,9 @@ void VMDetailsWidget::clearDetails()
     m_displayMonitorsLabel->setText(tr("No disponible"));
     
     m_sharedFoldersCountLabel->setText(tr("No disponible"));
+    
+    m_guestBalloonLabel->setText(tr("No disponible"));
+    m_guestFreeLabel->setText(tr("No disponible"));
+    m_guestCachedLabel->setText(tr("No disponible"));
+    m_guestFaultsLabel->setText(tr("No disponible"));
 }
\ No newline at end of file
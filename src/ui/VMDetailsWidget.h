@@ -11,18 +11,24 @@
 #include <QFrame>
 #include <QPushButton>
 #include <QProgressBar>
+#include <QTimer>
+
+class KVMManager;
 
 class VMDetailsWidget : public QWidget
 {
     Q_OBJECT
 
 public:
-    explicit VMDetailsWidget(QWidget *parent = nullptr);
+    explicit VMDetailsWidget(KVMManager *kvmManager, QWidget *parent = nullptr);
 
 public slots:
     void setSelectedVM(const QString &vmName);
     void refreshDetails();
 
+private slots:
+    void updateMemoryStats();
+
 private:
     void setupUI();
     void createGeneralSection();
@@ -33,6 +39,7 @@ private:
     void createUSBSection();
     void createDisplaySection();
     void createSharedFoldersSection();
+    void createGuestMemorySection();
     void updateVMDetails(const QString &vmName);
     void clearDetails();
     
@@ -53,6 +60,7 @@ private:
     QGroupBox *m_usbSection;
     QGroupBox *m_displaySection;
     QGroupBox *m_sharedFoldersSection;
+    QGroupBox *m_guestMemorySection;
     
     // Labels for dynamic content
     QLabel *m_vmNameLabel;
@@ -84,8 +92,16 @@ private:
     
     QLabel *m_sharedFoldersCountLabel;
     
+    QLabel *m_guestBalloonLabel;
+    QLabel *m_guestFreeLabel;
+    QLabel *m_guestCachedLabel;
+    QLabel *m_guestFaultsLabel;
+    
     // Current VM name
     QString m_currentVM;
+    
+    KVMManager *m_kvmManager;
+    QTimer *m_statsTimer;
 };
 
 #endif // VMDETAILSWIDGET_H
\ No newline at end of file
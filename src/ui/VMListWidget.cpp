@@ -16,6 +16,7 @@
 #include <QPainter>
 #include <QApplication>
 #include <QStyle>
+#include <QInputDialog>
 
 VMListWidget::VMListWidget(KVMManager *kvmManager, QWidget *parent)
     : QWidget(parent)
@@ -62,14 +63,16 @@ void VMListWidget::setupUI()
     // VM List
     m_vmListWidget = new QListWidget();
     m_vmListWidget->setAlternatingRowColors(true);
-    m_vmListWidget->setSelectionMode(QAbstractItemView::SingleSelection);
+    // Ctrl/Shift-click selects several VMs for bulk start/stop
+    m_vmListWidget->setSelectionMode(QAbstractItemView::ExtendedSelection);
     m_vmListWidget->setIconSize(QSize(32, 32));
     m_mainLayout->addWidget(m_vmListWidget);
     
     // Group creation button
     m_buttonLayout = new QHBoxLayout();
     m_createGroupButton = new QPushButton(tr("Crear Grupo"));
-    m_createGroupButton->setEnabled(false); // TODO: Enable when implemented
+    m_createGroupButton->setToolTip(tr("Agrupar las máquinas seleccionadas para tomar instantáneas coherentes de todas ellas"));
+    m_createGroupButton->setEnabled(false);
     m_buttonLayout->addWidget(m_createGroupButton);
     m_buttonLayout->addStretch();
     m_mainLayout->addLayout(m_buttonLayout);
@@ -110,6 +113,10 @@ void VMListWidget::populateVMList()
         VirtualMachine *vm = m_kvmManager->getVirtualMachine(vmName);
         if (vm) {
             QListWidgetItem *item = createVMItem(vm->getName(), vm->getOSType(), vm->getState());
+            item->setData(Qt::UserRole + 3, vm->getGroup());
+            if (!vm->getGroup().isEmpty()) {
+                item->setToolTip(item->toolTip() + tr("<br>Grupo: %1").arg(vm->getGroup()));
+            }
             m_vmListWidget->addItem(item);
             m_allVMs.append(vm->getName());
         }
@@ -187,6 +194,18 @@ QString VMListWidget::getSelectedVM() const
     return QString();
 }
 
+QStringList VMListWidget::getSelectedVMs() const
+{
+    QStringList vmNames;
+    for (int i = 0; i < m_vmListWidget->count(); ++i) {
+        QListWidgetItem *item = m_vmListWidget->item(i);
+        if (item && item->isSelected() && !item->isHidden()) {
+            vmNames.append(item->data(Qt::UserRole).toString());
+        }
+    }
+    return vmNames;
+}
+
 void VMListWidget::setSelectedVM(const QString &vmName)
 {
     for (int i = 0; i < m_vmListWidget->count(); ++i) {
@@ -206,6 +225,7 @@ void VMListWidget::refreshVMList()
 
 void VMListWidget::onSelectionChanged()
 {
+    m_createGroupButton->setEnabled(!getSelectedVMs().isEmpty());
     QString selectedVM = getSelectedVM();
     emit vmSelectionChanged(selectedVM);
 }
@@ -244,8 +264,10 @@ void VMListWidget::filterVMs()
         QString vmName = item->data(Qt::UserRole).toString().toLower();
         QString vmOS = item->data(Qt::UserRole + 1).toString().toLower();
         QString vmState = item->data(Qt::UserRole + 2).toString();
+        QString vmGroup = item->data(Qt::UserRole + 3).toString().toLower();
         
-        bool matchesSearch = vmName.contains(searchText) || vmOS.contains(searchText);
+        bool matchesSearch = vmName.contains(searchText) || vmOS.contains(searchText)
+                             || (!vmGroup.isEmpty() && vmGroup.contains(searchText));
         bool matchesFilter = (filter == tr("Todos")) || (vmState == filter);
         
         bool visible = matchesSearch && matchesFilter;
@@ -266,5 +288,28 @@ void VMListWidget::filterVMs()
 
 void VMListWidget::onCreateGroupClicked()
 {
-    // TODO: Implement group creation
+    const QStringList vmNames = getSelectedVMs();
+    if (vmNames.isEmpty()) {
+        return;
+    }
+    
+    // Un grupo existente o uno nuevo; en blanco saca las VMs de su grupo
+    QStringList groups = m_kvmManager->getGroups();
+    groups.prepend(QString());
+    VirtualMachine *vm = m_kvmManager->getVirtualMachine(vmNames.first());
+    int current = vm ? qMax(0, groups.indexOf(vm->getGroup())) : 0;
+    bool ok;
+    QString group = QInputDialog::getItem(this, tr("Crear grupo"),
+        tr("Grupo para %1 (en blanco para quitarlas de su grupo):").arg(vmNames.join(", ")),
+        groups, current, true, &ok).trimmed();
+    if (!ok) {
+        return;
+    }
+    
+    // El error ya se mostró a través del signal errorOccurred
+    for (const QString &vmName : vmNames) {
+        m_kvmManager->setVMGroup(vmName, group);
+    }
+    // vmListChanged ya recargó la lista
+    setSelectedVM(vmNames.first());
 }
\ No newline at end of file
@@ -22,6 +22,8 @@ public:
     explicit VMListWidget(KVMManager *kvmManager, QWidget *parent = nullptr);
     
     QString getSelectedVM() const;
+    // Every selected (and visible) VM, in list order
+    QStringList getSelectedVMs() const;
     void setSelectedVM(const QString &vmName);
     void refreshVMList();
 
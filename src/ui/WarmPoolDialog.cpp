@@ -0,0 +1,293 @@
+#include "WarmPoolDialog.h"
+#include "../core/KVMManager.h"
+#include "../core/VirtualMachine.h"
+#include "../core/WarmPool.h"
+
+#include <QApplication>
+#include <QDialogButtonBox>
+#include <QHeaderView>
+#include <QJsonArray>
+#include <QMessageBox>
+#include <QPointer>
+#include <QSignalBlocker>
+#include <QTimer>
+
+WarmPoolDialog::WarmPoolDialog(KVMManager *kvmManager, QWidget *parent)
+    : QDialog(parent)
+    , m_kvmManager(kvmManager)
+    , m_refreshTimer(new QTimer(this))
+{
+    setWindowTitle(tr("Reservas de instancias en espera"));
+    setWindowIcon(QApplication::style()->standardIcon(QStyle::SP_MediaPlay));
+    resize(680, 600);
+    setModal(true);
+    
+    setupUI();
+    loadSettings();
+    
+    connect(m_kvmManager->getWarmPool(), &WarmPool::poolChanged, this, &WarmPoolDialog::refresh);
+    connect(m_refreshTimer, &QTimer::timeout, this, &WarmPoolDialog::refresh);
+    m_refreshTimer->start(2000);
+    refresh();
+}
+
+void WarmPoolDialog::setupUI()
+{
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    
+    // Settings shared by every pool
+    QGroupBox *settingsGroup = new QGroupBox(tr("Reposición"));
+    QFormLayout *settingsLayout = new QFormLayout(settingsGroup);
+    
+    m_enabledCheck = new QCheckBox(tr("Reponer las reservas en segundo plano"));
+    settingsLayout->addRow(m_enabledCheck);
+    
+    m_budgetSpin = new QSpinBox;
+    m_budgetSpin->setRange(0, 1024 * 1024);
+    m_budgetSpin->setSingleStep(1024);
+    m_budgetSpin->setSuffix(" MB");
+    m_budgetSpin->setToolTip(tr("RAM de las instancias que arrancan más la de las aparcadas en pausa; "
+                                "las suspendidas a disco no cuentan"));
+    settingsLayout->addRow(tr("Presupuesto de memoria:"), m_budgetSpin);
+    
+    m_parallelSpin = new QSpinBox;
+    m_parallelSpin->setRange(1, 16);
+    settingsLayout->addRow(tr("Arranques simultáneos:"), m_parallelSpin);
+    
+    m_bootDelaySpin = new QSpinBox;
+    m_bootDelaySpin->setRange(0, 600);
+    m_bootDelaySpin->setSuffix(" s");
+    m_bootDelaySpin->setToolTip(tr("Sin qemu-guest-agent, tiempo que se deja arrancar al invitado "
+                                   "después de que QMP responda"));
+    settingsLayout->addRow(tr("Margen de arranque:"), m_bootDelaySpin);
+    
+    m_readyTimeoutSpin = new QSpinBox;
+    m_readyTimeoutSpin->setRange(30, 3600);
+    m_readyTimeoutSpin->setSuffix(" s");
+    settingsLayout->addRow(tr("Espera máxima:"), m_readyTimeoutSpin);
+    
+    QPushButton *applySettingsButton = new QPushButton(QApplication::style()->standardIcon(QStyle::SP_DialogApplyButton),
+                                                       tr("&Aplicar"));
+    connect(applySettingsButton, &QPushButton::clicked, this, &WarmPoolDialog::applySettings);
+    settingsLayout->addRow(QString(), applySettingsButton);
+    
+    mainLayout->addWidget(settingsGroup);
+    
+    // Pool of one template
+    QGroupBox *poolGroup = new QGroupBox(tr("Plantilla"));
+    QHBoxLayout *poolLayout = new QHBoxLayout(poolGroup);
+    
+    m_templateCombo = new QComboBox;
+    for (const QString &name : m_kvmManager->getVirtualMachines()) {
+        VirtualMachine *vm = m_kvmManager->getVirtualMachine(name);
+        if (vm && vm->getBackend() == "qemu" && vm->getWarmPool().isEmpty()) {
+            m_templateCombo->addItem(name);
+        }
+    }
+    connect(m_templateCombo, &QComboBox::currentTextChanged, this, &WarmPoolDialog::onTemplateChanged);
+    
+    m_sizeSpin = new QSpinBox;
+    m_sizeSpin->setRange(0, 64);
+    m_sizeSpin->setToolTip(tr("Instancias listas que se mantienen; 0 vacía la reserva"));
+    
+    m_parkCombo = new QComboBox;
+    m_parkCombo->addItem(tr("Suspendidas a disco"), "saved");
+    m_parkCombo->addItem(tr("En pausa"), "paused");
+    m_parkCombo->setToolTip(tr("En pausa se entregan al instante pero ocupan su RAM; "
+                               "suspendidas no ocupan RAM y tardan lo que se lee su estado"));
+    
+    QPushButton *applyPoolButton = new QPushButton(tr("A&plicar a la plantilla"));
+    connect(applyPoolButton, &QPushButton::clicked, this, &WarmPoolDialog::applyPool);
+    
+    poolLayout->addWidget(m_templateCombo, 1);
+    poolLayout->addWidget(new QLabel(tr("Instancias:")));
+    poolLayout->addWidget(m_sizeSpin);
+    poolLayout->addWidget(m_parkCombo);
+    poolLayout->addWidget(applyPoolButton);
+    
+    mainLayout->addWidget(poolGroup);
+    
+    // Instances
+    QGroupBox *instancesGroup = new QGroupBox(tr("Instancias"));
+    QVBoxLayout *instancesLayout = new QVBoxLayout(instancesGroup);
+    
+    m_poolTree = new QTreeWidget;
+    m_poolTree->setHeaderLabels({tr("Nombre"), tr("Etapa"), tr("Memoria")});
+    m_poolTree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    connect(m_poolTree, &QTreeWidget::currentItemChanged, this, [this](QTreeWidgetItem *current) {
+        // Choosing a pool or one of its instances selects its template
+        while (current && current->parent()) {
+            current = current->parent();
+        }
+        if (current) {
+            m_templateCombo->setCurrentText(current->text(0));
+        }
+    });
+    instancesLayout->addWidget(m_poolTree);
+    
+    QHBoxLayout *instanceButtons = new QHBoxLayout;
+    m_memoryLabel = new QLabel;
+    m_acquireButton = new QPushButton(QApplication::style()->standardIcon(QStyle::SP_MediaPlay),
+                                      tr("&Entregar una instancia"));
+    m_acquireButton->setToolTip(tr("Arranca una instancia lista de la plantilla elegida; "
+                                   "si no queda ninguna, un clon enlazado en frío"));
+    connect(m_acquireButton, &QPushButton::clicked, this, &WarmPoolDialog::acquireInstance);
+    instanceButtons->addWidget(m_memoryLabel);
+    instanceButtons->addStretch();
+    instanceButtons->addWidget(m_acquireButton);
+    instancesLayout->addLayout(instanceButtons);
+    
+    m_statusLabel = new QLabel;
+    m_statusLabel->setWordWrap(true);
+    instancesLayout->addWidget(m_statusLabel);
+    
+    mainLayout->addWidget(instancesGroup);
+    
+    QLabel *info = new QLabel(tr("Cada instancia es un clon enlazado: una capa qcow2 sobre los discos de la "
+                                 "plantilla, que no puede arrancarse ni borrarse mientras existan. La "
+                                 "reposición corre con la ventana principal abierta o con kvmctl serve."));
+    info->setWordWrap(true);
+    mainLayout->addWidget(info);
+    
+    QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Close);
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    mainLayout->addWidget(buttonBox);
+}
+
+void WarmPoolDialog::loadSettings()
+{
+    WarmPool::Policy policy = WarmPool::loadPolicy();
+    m_enabledCheck->setChecked(policy.enabled);
+    m_budgetSpin->setValue(policy.memoryBudgetMB);
+    m_parallelSpin->setValue(policy.maxParallel);
+    m_bootDelaySpin->setValue(policy.bootDelaySecs);
+    m_readyTimeoutSpin->setValue(policy.readyTimeoutSecs);
+    onTemplateChanged();
+}
+
+void WarmPoolDialog::refresh()
+{
+    m_status = m_kvmManager->getWarmPool()->status();
+    m_memoryLabel->setText(tr("Memoria en uso: %1 de %2 MB")
+                           .arg(m_status.value("memoryUsedMB").toInteger())
+                           .arg(m_status.value("memoryBudgetMB").toInteger()));
+    
+    // Rebuilt on every refresh; the expanded state follows the template names
+    QStringList collapsed;
+    for (int i = 0; i < m_poolTree->topLevelItemCount(); ++i) {
+        if (!m_poolTree->topLevelItem(i)->isExpanded()) {
+            collapsed.append(m_poolTree->topLevelItem(i)->text(0));
+        }
+    }
+    
+    QSignalBlocker blocker(m_poolTree);
+    m_poolTree->clear();
+    for (const QJsonValue &value : m_status.value("pools").toArray()) {
+        QJsonObject pool = value.toObject();
+        QString templateName = pool.value("template").toString();
+        
+        QTreeWidgetItem *poolItem = new QTreeWidgetItem(m_poolTree);
+        poolItem->setText(0, templateName);
+        poolItem->setText(1, tr("%1 de %2 listas (%3)")
+                          .arg(pool.value("ready").toInt()).arg(pool.value("size").toInt())
+                          .arg(pool.value("park").toString() == "paused" ? tr("en pausa") : tr("suspendidas")));
+        if (pool.value("failures").toInt() > 0) {
+            poolItem->setToolTip(1, tr("%1 fallos seguidos al preparar instancias").arg(pool.value("failures").toInt()));
+        }
+        
+        for (const QJsonValue &instanceValue : pool.value("instances").toArray()) {
+            QJsonObject instance = instanceValue.toObject();
+            QTreeWidgetItem *item = new QTreeWidgetItem(poolItem);
+            item->setText(0, instance.value("name").toString());
+            item->setText(1, stageText(instance.value("stage").toString()));
+            item->setText(2, QString("%1 MB").arg(instance.value("memoryMB").toInt()));
+        }
+        poolItem->setExpanded(!collapsed.contains(templateName));
+    }
+    
+    m_acquireButton->setEnabled(!selectedTemplate().isEmpty());
+}
+
+void WarmPoolDialog::onTemplateChanged()
+{
+    WarmPool::Pool pool = WarmPool::loadPolicy().pool(selectedTemplate());
+    m_sizeSpin->setValue(pool.size);
+    m_parkCombo->setCurrentIndex(qMax(0, m_parkCombo->findData(pool.park)));
+    m_acquireButton->setEnabled(!selectedTemplate().isEmpty());
+}
+
+void WarmPoolDialog::applySettings()
+{
+    WarmPool::Policy policy = WarmPool::loadPolicy();
+    policy.enabled = m_enabledCheck->isChecked();
+    policy.memoryBudgetMB = m_budgetSpin->value();
+    policy.maxParallel = m_parallelSpin->value();
+    policy.bootDelaySecs = m_bootDelaySpin->value();
+    policy.readyTimeoutSecs = m_readyTimeoutSpin->value();
+    WarmPool::savePolicy(policy);
+    refresh();
+}
+
+void WarmPoolDialog::applyPool()
+{
+    QString templateName = selectedTemplate();
+    if (templateName.isEmpty()) {
+        return;
+    }
+    
+    if (m_sizeSpin->value() > 0 && m_kvmManager->getVMState(templateName) != "shut off") {
+        QMessageBox::warning(this, tr("Plantilla en marcha"),
+                             tr("Las instancias se preparan cuando '%1' esté apagada: sus discos pasan a ser "
+                                "la base de todas ellas.").arg(templateName));
+    }
+    m_kvmManager->getWarmPool()->setPool(templateName, m_sizeSpin->value(),
+                                         m_parkCombo->currentData().toString());
+}
+
+void WarmPoolDialog::acquireInstance()
+{
+    QString templateName = selectedTemplate();
+    if (templateName.isEmpty()) {
+        return;
+    }
+    
+    m_acquireButton->setEnabled(false);
+    m_statusLabel->setText(tr("Entregando una instancia de '%1'...").arg(templateName));
+    
+    QPointer<WarmPoolDialog> self(this);
+    m_kvmManager->acquireWarmVMAsync(templateName, [self, templateName](const VMBackend::Result &result) {
+        if (!self) {
+            return;
+        }
+        self->m_acquireButton->setEnabled(true);
+        if (!result.ok) {
+            // KVMManager::errorOccurred already reported why
+            self->m_statusLabel->setText(tr("No se pudo entregar una instancia de '%1'").arg(templateName));
+            return;
+        }
+        
+        QJsonObject value = result.value.toObject();
+        QString from = value.value("from").toString();
+        self->m_statusLabel->setText(tr("'%1' en marcha en %2 ms (%3)")
+                                     .arg(value.value("name").toString())
+                                     .arg(value.value("msecs").toInteger())
+                                     .arg(from == "paused" ? tr("reanudada")
+                                          : from == "saved" ? tr("restaurada") : tr("arranque en frío")));
+        self->refresh();
+    });
+}
+
+QString WarmPoolDialog::selectedTemplate() const
+{
+    return m_templateCombo->currentText();
+}
+
+QString WarmPoolDialog::stageText(const QString &stage)
+{
+    if (stage == "ready") return tr("Lista");
+    if (stage == "launching") return tr("Arrancando");
+    if (stage == "booting") return tr("Esperando al invitado");
+    if (stage == "parking") return tr("Aparcando");
+    if (stage == "discarding") return tr("Descartando");
+    return stage;
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#ifndef WARMPOOLDIALOG_H
+#define WARMPOOLDIALOG_H
+
+#include <QDialog>
+#include <QTreeWidget>
+#include <QPushButton>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QFormLayout>
+#include <QLabel>
+#include <QSpinBox>
+#include <QComboBox>
+#include <QCheckBox>
+#include <QGroupBox>
+#include <QJsonObject>
+
+class KVMManager;
+class QTimer;
+
+/**
+ * @brief Reservas de instancias en espera ("warm pool")
+ * Permite elegir cuántas instancias arrancadas y aparcadas mantener de cada
+ * plantilla, el presupuesto de memoria y el paralelismo de la reposición,
+ * muestra la etapa de cada instancia y entrega una con un clic.
+ */
+class WarmPoolDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit WarmPoolDialog(KVMManager *kvmManager, QWidget *parent = nullptr);
+
+private slots:
+    void refresh();
+    void applySettings();
+    void applyPool();
+    void acquireInstance();
+    void onTemplateChanged();
+
+private:
+    void setupUI();
+    void loadSettings();
+    QString selectedTemplate() const;
+    static QString stageText(const QString &stage);
+    
+    KVMManager *m_kvmManager;
+    QTimer *m_refreshTimer;
+    QJsonObject m_status;
+    
+    // Settings
+    QCheckBox *m_enabledCheck;
+    QSpinBox *m_budgetSpin;
+    QSpinBox *m_parallelSpin;
+    QSpinBox *m_bootDelaySpin;
+    QSpinBox *m_readyTimeoutSpin;
+    
+    // Pool of one template
+    QComboBox *m_templateCombo;
+    QSpinBox *m_sizeSpin;
+    QComboBox *m_parkCombo;
+    
+    // Instances
+    QTreeWidget *m_poolTree;
+    QLabel *m_memoryLabel;
+    QLabel *m_statusLabel;
+    QPushButton *m_acquireButton;
+};
+
+#endif // WARMPOOLDIALOG_H
\ No newline at end of file